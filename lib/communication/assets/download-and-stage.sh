@@ -41,7 +41,9 @@
 #    Static serving in the firmware is very basic (i.e. no directory listings)
 #
 #    This bash script can do gzipping at runtime (to reduce firmware pressure)
-#    but that's it. Nothing fancy.
+#    and prefabricates the HTTP headers of each file, including an ETag from
+#    a hash of its content. Files which are pre-compressed already (foo.js.gz)
+#    are passed through. But that's it. Nothing fancy.
 #
 #    Note to inter-Git-linkage: Since we are interested in build outputs, git
 #    submodules are not an option. Instead, we use a token which is directly
@@ -77,10 +79,49 @@ asset_assembler_includes=$(mktemp)
 
 echo "const web::StaticFile assets[] = {" > $asset_structures
 
+number_of_files=0
+total_size=0
+
 for fn in * */**; do
 [ -d "$fn" ] && continue
-gzip -9q22k "$fn"
-lastmod_unixtime=$(stat -c%Y "${fn}")
+
+# The file which is actually embedded, possibly compressed, and its Content-Encoding.
+# Assets which the SPA build already pre-compressed are passed through as they are,
+# under the name without the .gz suffix.
+served="$fn"
+encoding=""
+if [[ "$fn" == *.gz ]]; then
+  [ -e "${fn%.gz}" ] && continue # handled together with the uncompressed file
+  fn="${fn%.gz}"
+  encoding="gzip"
+elif [ -e "${fn}.gz" ]; then
+  served="${fn}.gz"
+  encoding="gzip"
+fi
+
+if [ -e "$fn" ]; then
+  mime_type="$(file --brief --mime-type "${fn}")"
+else
+  mime_type="$(gzip -dc "${served}" | file --brief --mime-type -)"
+fi
+
+# For CSS and JS files, the correct mime type is important.
+if   [[ "$fn" == *.js  ]]; then mime_type="application/javascript"; # is correctly detected anyway
+elif [[ "$fn" == *.css ]]; then mime_type="text/css";               # this fix is important
+fi
+
+# Compress what compresses well, but not images, fonts and other formats which are compressed already.
+# Without name and timestamp in the gzip header, unchanged files keep their ETag across builds.
+if [ -z "$encoding" ] && [[ "$mime_type" == text/* || "$mime_type" == application/javascript || \
+                            "$mime_type" == application/json || "$mime_type" == image/svg+xml ]]; then
+  gzip -9nkf "$fn"
+  served="${fn}.gz"
+  encoding="gzip"
+fi
+
+lastmod_unixtime=$(stat -c%Y "${served}")
+lastmod_http="$(TZ=GMT date -R -d @$lastmod_unixtime | sed 's/+0000/GMT/')"
+etag="$(sha256sum "${served}" | head -c16)"
 
 # educated guess how the linker rewrites the filename.
 # TODO probably caveat: Subdirectory will not be included into the linker symbol but is here.
@@ -90,7 +131,7 @@ echo "extern uint8_t _binary_${linkerfn}_start[], _binary_${linkerfn}_end[];"  >
 
 # File path relative to platformio project root.
 # or just use a full absolute path
-path_relative_to_project_root="$(realpath "$fn")"
+path_relative_to_project_root="$(realpath "$served")"
 
 
 # Correct section is .progmem
@@ -103,42 +144,32 @@ __asm__(
  ".global _binary_${linkerfn}_start\n"
  ".type   _binary_${linkerfn}_start,%object\n"
  "_binary_${linkerfn}_start:\n"
- ".incbin \"${path_relative_to_project_root}.gz\"\n"
+ ".incbin \"${path_relative_to_project_root}\"\n"
  "_binary_${linkerfn}_end:\n"
  ".previous\n"
 );
 ASM
 
-
-mime_type="$(file --brief --mime-type "${fn}")"
-
-# For CSS and JS files, the correct mime type is important.
-if   [[ "$fn" == *.js  ]]; then mime_type="application/javascript"; # is correctly detected anyway
-elif [[ "$fn" == *.css ]]; then mime_type="text/css";               # this fix is important
-fi
-
-cat << HTTP_HEADER > "${fn}.http"
-{ "Content-Type", "$mime_type" },
-{ "Last-Modified", "$(TZ=GMT date -R -d @$lastmod_unixtime | sed 's/+0000/GMT/')" },
-{ "Date", "$(TZ=GMT date -R -d @$lastmod_unixtime | sed 's/+0000/GMT/')" },
-{ "Cache-Control", "max-age=604800" },
-{ "ETag", "$(md5sum "${fn}.gz" | head -c8)" },
-HTTP_HEADER
-
-# use this fields only when having GZIP encoding turned on:
-
-cat << HTTP_HEADER >> "${fn}.http"
-{ "Content-Length", "$(stat -c%s "${fn}.gz")" },
-{ "Content-Encoding", "gzip" },
+# The HTTP headers are prefabricated once here, instead of assembling them on every request.
+# The validators are also sent with a 304 Not Modified. Content-Length is left to the web server,
+# which has to know about it, see web::write_static_response.
+cat << HTTP_HEADER >> $asset_http_headers
+const char prefab_validators_for_${linkerfn}[] =
+  "Last-Modified: ${lastmod_http}\r\n"
+  "Cache-Control: max-age=604800\r\n"
+  "ETag: \"${etag}\"\r\n";
+const char prefab_http_headers_for_${linkerfn}[] =
+  "Content-Type: ${mime_type}\r\n"
+$([ -n "$encoding" ] && echo "  \"Content-Encoding: ${encoding}\r\n\"")
+  "Last-Modified: ${lastmod_http}\r\n"
+  "Cache-Control: max-age=604800\r\n"
+  "ETag: \"${etag}\"\r\n";
 HTTP_HEADER
 
+echo "{ \"${fn}\", _binary_${linkerfn}_start, (uint32_t)(_binary_${linkerfn}_end - _binary_${linkerfn}_start), prefab_http_headers_for_${linkerfn}, prefab_validators_for_${linkerfn}, \"\\\"${etag}\\\"\", $lastmod_unixtime }," >> $asset_structures
 
-#prefab_http_header_name="prefab_http_headers_for_${linkerfn}";
-#echo "const char ${prefab_http_header_name}[] = " >> $asset_http_headers
-#cat "${fn}.http" | awk -v q='"' '{print q$0"\\n"q}' >> $asset_http_headers
-#echo "; /* end of ${fn} */" >> $asset_http_headers
-
-echo "{ \"${fn}\", _binary_${linkerfn}_start, (uint32_t)(_binary_${linkerfn}_end - _binary_${linkerfn}_start), { $(cat "${fn}.http") }, $lastmod_unixtime }," >> $asset_structures
+number_of_files=$((number_of_files + 1))
+total_size=$((total_size + $(stat -c%s "${served}")))
 
 done
 
@@ -173,5 +204,5 @@ CPP_FOOTER
 # For testing, can do this, should run without error
 #g++ $assets && rm $assets.gch
 
-echo "Number of asset files:  $(find | grep gz | wc -l)"
-echo "Total asset size:       $(find | grep gz | xargs du -hcs | awk '{print $1}' | tail -n1)"
+echo "Number of asset files:  ${number_of_files}"
+echo "Total asset size:       ${total_size} bytes"
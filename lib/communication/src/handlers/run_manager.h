@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include "carrier/carrier.h"
 #include "protocol/handler.h"
 #include "run/run_manager.h"
 
@@ -19,6 +20,18 @@ public:
   }
 };
 
+/// @ingroup MessageHandlers
+class StartSweepRequestHandler : public MessageHandler {
+  carrier::Carrier &carrier;
+
+public:
+  explicit StartSweepRequestHandler(carrier::Carrier &carrier) : carrier(carrier) {}
+
+  int handle(JsonObjectConst msg_in, JsonObject &msg_out) override {
+    return error(run::RunManager::get().start_sweep(msg_in, msg_out, carrier));
+  }
+};
+
 class StopRunRequestHandler : public MessageHandler {
 public:
   int handle(JsonObjectConst msg_in, JsonObject &msg_out) override {
@@ -6,10 +6,13 @@
 #pragma once
 
 #include "build/distributor.h"
+#include "carrier/calibration_cache.h"
+#include "daq/daq.h"
 #include "nvmconfig/vendor.h"
 #include "ota/flasher.h" // reboot()
 #include "protocol/handler.h"
 #include "protocol/jsonl_logging.h"
+#include "protocol/protocol.h"
 #include "utils/hashflash.h"
 #include "lucidac/front_panel_signaling.h"
 #include "mode/counters.h"
@@ -110,6 +113,10 @@ public:
   int handle(JsonObjectConst msg_in, JsonObject &msg_out) override {
     auto perf_counters = msg_out.createNestedObject("perf_counters");
     mode::PerformanceCounter::get().to_json(perf_counters);
+    msg_out["dropped_run_data_writes"] = JsonLinesProtocol::get().broadcast.dropped_writes;
+    JsonLinesProtocol::get().envelopes.to_json(msg_out.createNestedObject("envelopes"));
+    daq::dma::to_json(msg_out.createNestedObject("dma_buffer"));
+    platform::CalibrationCache::get().to_json(msg_out.createNestedObject("calibration_cache"));
     return success;
   }
 };
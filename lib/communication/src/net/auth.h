@@ -4,6 +4,21 @@
 
 #pragma once
 
+#include <string>
+
+namespace net {
+namespace auth {
+
+/**
+ * Simple security levels for the message handlers
+ **/
+enum class SecurityLevel { RequiresAdmin, RequiresLogin, RequiresNothing };
+
+using User = std::string;
+
+} // namespace auth
+} // namespace net
+
 #ifdef ARDUINO
 
 #include <IPAddress.h>
@@ -29,13 +44,6 @@ namespace net {
  **/
 namespace auth {
 
-/**
- * Simple security levels for the message handlers
- **/
-enum class SecurityLevel { RequiresAdmin, RequiresLogin, RequiresNothing };
-
-using User = std::string;
-
 class AuthentificationContext; // defined below
 
 /**
@@ -267,4 +275,23 @@ public:
 } // namespace auth
 } // namespace net
 
+#else
+
+namespace net {
+namespace auth {
+
+/**
+ * Native builds, such as the simulator, have neither users nor persistent settings,
+ * so anybody may do anything.
+ **/
+class AuthentificationContext {
+public:
+  bool can_do(SecurityLevel task) const { return true; }
+
+  User user() const { return "[nobody]"; }
+};
+
+} // namespace auth
+} // namespace net
+
 #endif // ARDUINO
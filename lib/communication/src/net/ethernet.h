@@ -96,4 +96,15 @@ JSON_CONVERT_SUGAR(StartupConfig);
 
 } // namespace net
 
+#else
+
+#include "net/posix_client.h"
+
+namespace net {
+
+/// Natively, TCP/IP connections are plain sockets of the operating system
+using EthernetClient = PosixClient;
+
+} // namespace net
+
 #endif // ARDUINO
@@ -0,0 +1,115 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#ifndef ARDUINO
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace net {
+
+/**
+ * A TCP/IP connection on a POSIX socket, with the methods of the QNEthernet client which the
+ * protocol code uses. This allows native builds, such as the simulator, to serve the JSONL protocol
+ * with the same code as the hardware.
+ *
+ * The socket is non-blocking for reading. Writes wait until all data is sent, such that a message is
+ * never sent partially, and a failed write closes the connection.
+ **/
+class PosixClient {
+  int fd = -1;
+
+public:
+  /// Time a write waits for the peer to take data before checking again
+  static constexpr int WRITE_POLL_MS = 100;
+
+  PosixClient() = default;
+
+  explicit PosixClient(int fd) : fd(fd) {
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+  }
+
+  PosixClient(const PosixClient &) = delete;
+  PosixClient &operator=(const PosixClient &) = delete;
+
+  ~PosixClient() { stop(); }
+
+  int get_fd() const { return fd; }
+
+  /// Whether the connection is open. A connection closed by the peer is stopped.
+  bool connected() {
+    if (fd < 0)
+      return false;
+    pollfd pfd{fd, POLLIN, 0};
+    uint8_t peek;
+    if (poll(&pfd, 1, 0) > 0 and
+        (pfd.revents & (POLLERR | POLLHUP) or (pfd.revents & POLLIN and ::recv(fd, &peek, 1, MSG_PEEK) == 0)))
+      stop();
+    return fd >= 0;
+  }
+
+  void stop() {
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+  }
+
+  int available() {
+    int count = 0;
+    return fd >= 0 and ioctl(fd, FIONREAD, &count) == 0 ? count : 0;
+  }
+
+  int read(uint8_t *buffer, size_t size) { return fd >= 0 ? ::recv(fd, buffer, size, 0) : -1; }
+
+  /**
+   * Writes wait for the peer instead of failing on a full send buffer, which suits a simulation
+   * running faster than real time: Clients get all run data, they only slow the simulation down.
+   **/
+  int availableForWrite() { return fd >= 0 ? std::numeric_limits<int>::max() : 0; }
+
+  size_t writeFully(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (fd >= 0 and written < size) {
+      auto count = ::send(fd, buffer + written, size - written, MSG_NOSIGNAL);
+      if (count < 0 and (errno == EAGAIN or errno == EWOULDBLOCK)) {
+        pollfd pfd{fd, POLLOUT, 0};
+        poll(&pfd, 1, WRITE_POLL_MS);
+        continue;
+      }
+      if (count <= 0) {
+        stop();
+        break;
+      }
+      written += count;
+    }
+    return written;
+  }
+
+  size_t writeFully(uint8_t b) { return writeFully(&b, 1); }
+
+  size_t write(const uint8_t *buffer, size_t size) { return writeFully(buffer, size); }
+
+  size_t write(uint8_t b) { return writeFully(&b, 1); }
+
+  /// Data is sent right away, as Nagle's algorithm is turned off
+  void flush() {}
+};
+
+} // namespace net
+
+#endif // ARDUINO
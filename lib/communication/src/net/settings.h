@@ -9,6 +9,7 @@
 
 #include "nvmconfig/persistent.h"
 
+#include "carrier/calibration_cache.h"
 #include "net/auth.h"
 #include "net/ethernet.h"
 #include "nvmconfig/user.h"
@@ -22,6 +23,7 @@
 // auth:      net::auth::UserPasswordAuthentification
 // user:      user-defined space irrelevant for the firmware
 //            do not confuse this with the users dictionary in the auth!
+// calibration: platform::CalibrationCache settings and persistent entries
 
 namespace net {
 /**
@@ -37,6 +39,7 @@ inline void register_settings() {
   subsystems.push_back(&nvmconfig::PermanentUserDefinedStuff::get());
   subsystems.push_back(&net::StartupConfig::get());
   subsystems.push_back(&net::auth::Gatekeeper::get());
+  subsystems.push_back(&platform::CalibrationCacheSettings::get());
 
   persistent_settings.read_from_eeprom();
 }
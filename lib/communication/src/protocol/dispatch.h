@@ -0,0 +1,88 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+namespace msg {
+
+namespace handlers {
+
+template <class Value> struct DispatchEntry {
+  std::string_view msg_type;
+  Value value;
+};
+
+/**
+ * A fixed table mapping message types to some value, sorted by message type at compile time.
+ * Lookups are a binary search without any allocation or copy of the message type.
+ *
+ * Build it with make_dispatch_table, which sorts the entries, for instance
+ *
+ *   constexpr auto table = make_dispatch_table<int>({{"ping", 1}, {"help", 2}});
+ *   static_assert(table.is_unique());
+ **/
+template <class Value, std::size_t N> class DispatchTable {
+  std::array<DispatchEntry<Value>, N> entries;
+
+public:
+  constexpr explicit DispatchTable(const DispatchEntry<Value> (&unsorted)[N]) : entries{} {
+    // Insertion sort, std::sort is not constexpr before C++20
+    for (std::size_t idx = 0; idx < N; idx++) {
+      entries[idx] = unsorted[idx];
+      for (std::size_t pos = idx; pos > 0 and entries[pos].msg_type < entries[pos - 1].msg_type; pos--) {
+        auto tmp = entries[pos];
+        entries[pos] = entries[pos - 1];
+        entries[pos - 1] = tmp;
+      }
+    }
+  }
+
+  static constexpr std::size_t NOT_FOUND = N;
+
+  constexpr std::size_t size() const { return N; }
+
+  /// Whether no message type appears twice, which should be static_assert'ed.
+  constexpr bool is_unique() const {
+    for (std::size_t idx = 1; idx < N; idx++)
+      if (entries[idx].msg_type == entries[idx - 1].msg_type)
+        return false;
+    return true;
+  }
+
+  /// Returns the position of msg_type in the table, which stays the same for the lifetime of the table.
+  constexpr std::size_t index_of(std::string_view msg_type) const {
+    std::size_t low = 0, high = N;
+    while (low < high) {
+      std::size_t mid = low + (high - low) / 2;
+      if (entries[mid].msg_type < msg_type)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    return (low < N and entries[low].msg_type == msg_type) ? low : NOT_FOUND;
+  }
+
+  /// Returns nullptr if msg_type is not in the table.
+  constexpr const Value *find(std::string_view msg_type) const {
+    auto idx = index_of(msg_type);
+    return idx == NOT_FOUND ? nullptr : &entries[idx].value;
+  }
+
+  constexpr const DispatchEntry<Value> &operator[](std::size_t idx) const { return entries[idx]; }
+  constexpr const DispatchEntry<Value> *begin() const { return entries.data(); }
+  constexpr const DispatchEntry<Value> *end() const { return entries.data() + N; }
+};
+
+template <class Value, std::size_t N>
+constexpr DispatchTable<Value, N> make_dispatch_table(const DispatchEntry<Value> (&entries)[N]) {
+  return DispatchTable<Value, N>(entries);
+}
+
+} // namespace handlers
+
+} // namespace msg
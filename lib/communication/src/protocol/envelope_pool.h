@@ -0,0 +1,172 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <ArduinoJson.h>
+
+namespace msg {
+
+//! The kinds of connections, each of which draws its envelopes from a shard of the EnvelopePool sized for it.
+enum class EnvelopeKind : uint8_t { Serial, TCP, Web, Broadcast };
+
+/// A JsonDocument on memory it does not own, like a StaticJsonDocument whose buffer lives in an arena.
+class ArenaJsonDocument : public JsonDocument {
+public:
+  ArenaJsonDocument(char *buffer, size_t capacity) : JsonDocument(buffer, capacity) {}
+};
+
+/// The documents a message is parsed into and its response is built in.
+struct Envelopes {
+  ArenaJsonDocument in, out;
+  const EnvelopeKind kind;
+  bool used = false;
+
+  Envelopes(char *in_buffer, size_t in_size, char *out_buffer, size_t out_size, EnvelopeKind kind)
+      : in(in_buffer, in_size), out(out_buffer, out_size), kind(kind) {}
+};
+
+/**
+ * The JSON envelopes of all connections, which are allocated from a single arena once at startup,
+ * so that handling messages neither allocates nor fragments the heap.
+ *
+ * The pool is sharded by the kind of connection, as each kind has its own message sizes and concurrency.
+ * Envelopes are held by an EnvelopeLease, for as long as a connection handles its messages.
+ * If all envelopes of a shard are in use, acquiring one fails instead of sharing an envelope in use.
+ **/
+class EnvelopePool {
+public:
+  static constexpr size_t NUM_KINDS = 4;
+
+  struct Shard {
+    size_t slots;
+    size_t in_size, out_size; ///< Capacity of the documents in bytes
+  };
+
+  struct Statistics {
+    size_t in_use = 0, peak = 0;
+    size_t exhausted = 0; ///< Number of times no envelope was free
+  };
+
+protected:
+  char *arena = nullptr;
+  size_t arena_size = 0;
+  Envelopes *slots = nullptr;
+  size_t num_slots = 0;
+  Shard shards[NUM_KINDS]{};
+  Statistics statistics[NUM_KINDS];
+
+  // Every buffer starts where a StaticJsonDocument's would be aligned
+  static constexpr size_t align(size_t size) {
+    return (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+  }
+
+  void deallocate() {
+    for (size_t idx = 0; idx < num_slots; idx++)
+      slots[idx].~Envelopes();
+    delete[] arena;
+    arena = nullptr;
+    slots = nullptr;
+    arena_size = num_slots = 0;
+  }
+
+public:
+  EnvelopePool() = default;
+  EnvelopePool(const EnvelopePool &) = delete;
+  EnvelopePool &operator=(const EnvelopePool &) = delete;
+  ~EnvelopePool() { deallocate(); }
+
+  /// Allocates the arena for all shards, indexed by EnvelopeKind. Meant to be called once, at startup.
+  void init(const Shard (&shards_)[NUM_KINDS]) {
+    deallocate();
+    size_t buffers_size = 0;
+    for (size_t kind = 0; kind < NUM_KINDS; kind++) {
+      shards[kind] = {shards_[kind].slots, align(shards_[kind].in_size), align(shards_[kind].out_size)};
+      statistics[kind] = Statistics();
+      num_slots += shards[kind].slots;
+      buffers_size += shards[kind].slots * (shards[kind].in_size + shards[kind].out_size);
+    }
+
+    auto slots_size = align(num_slots * sizeof(Envelopes));
+    arena_size = slots_size + buffers_size;
+    arena = new char[arena_size];
+    slots = reinterpret_cast<Envelopes *>(arena);
+    char *buffer = arena + slots_size;
+    size_t idx = 0;
+    for (size_t kind = 0; kind < NUM_KINDS; kind++) {
+      auto &shard = shards[kind];
+      for (size_t slot = 0; slot < shard.slots; slot++, idx++) {
+        new (slots + idx) Envelopes(buffer, shard.in_size, buffer + shard.in_size, shard.out_size,
+                                    static_cast<EnvelopeKind>(kind));
+        buffer += shard.in_size + shard.out_size;
+      }
+    }
+  }
+
+  /// Takes a free envelope of the given kind, returns nullptr if all of them are in use.
+  Envelopes *acquire(EnvelopeKind kind) {
+    auto &stats = statistics[static_cast<size_t>(kind)];
+    for (size_t idx = 0; idx < num_slots; idx++) {
+      if (slots[idx].kind == kind and !slots[idx].used) {
+        slots[idx].used = true;
+        if (++stats.in_use > stats.peak)
+          stats.peak = stats.in_use;
+        return slots + idx;
+      }
+    }
+    stats.exhausted++;
+    return nullptr;
+  }
+
+  void release(Envelopes *envelopes) {
+    if (!envelopes or !envelopes->used)
+      return;
+    envelopes->used = false;
+    // Strings of the last message may point into buffers which are gone by now
+    envelopes->in.clear();
+    envelopes->out.clear();
+    statistics[static_cast<size_t>(envelopes->kind)].in_use--;
+  }
+
+  size_t size() const { return arena_size; }
+  const Shard &get_shard(EnvelopeKind kind) const { return shards[static_cast<size_t>(kind)]; }
+  const Statistics &get_statistics(EnvelopeKind kind) const { return statistics[static_cast<size_t>(kind)]; }
+
+  /// Occupancy and peak usage of each shard, as in the sys_stats message.
+  void to_json(JsonObject target) const {
+    static const char *const names[NUM_KINDS] = {"serial", "tcp", "web", "broadcast"};
+    target["arena_size"] = arena_size;
+    for (size_t kind = 0; kind < NUM_KINDS; kind++) {
+      auto shard = target.createNestedObject(names[kind]);
+      shard["slots"] = shards[kind].slots;
+      shard["in_size"] = shards[kind].in_size;
+      shard["out_size"] = shards[kind].out_size;
+      shard["in_use"] = statistics[kind].in_use;
+      shard["peak"] = statistics[kind].peak;
+      shard["exhausted"] = statistics[kind].exhausted;
+    }
+  }
+};
+
+/// Holds envelopes of an EnvelopePool while it is in scope. Check whether it got any before use.
+class EnvelopeLease {
+  EnvelopePool &pool;
+  Envelopes *envelopes;
+
+public:
+  EnvelopeLease(EnvelopePool &pool, EnvelopeKind kind) : pool(pool), envelopes(pool.acquire(kind)) {}
+  EnvelopeLease(const EnvelopeLease &) = delete;
+  EnvelopeLease &operator=(const EnvelopeLease &) = delete;
+  ~EnvelopeLease() { pool.release(envelopes); }
+
+  explicit operator bool() const { return envelopes; }
+  Envelopes &operator*() const { return *envelopes; }
+  Envelopes *operator->() const { return envelopes; }
+};
+
+} // namespace msg
@@ -17,13 +17,6 @@ FLASHMEM void msg::JsonlServer::loop() {
   net::EthernetClient client_socket = server.accept();
 
   if (client_socket) {
-    // note that the following code copies "socket" object multiple times. When using pointers into
-    // the struct, do not use the pointer to the wrong version.
-    // TODO: Clean up code.
-    Client client;
-    client.socket = client_socket;
-    client.user_context.set_remote_identifier(net::auth::RemoteIdentifier{client_socket.remoteIP()});
-
     // note there is also net::EthernetClient::maxSockets(), which is dominated by basic system constraints.
     // This limit here is rather dominated by application level constraints and can probably be a counter
     // measure against ddos attacks.
@@ -32,8 +25,12 @@ FLASHMEM void msg::JsonlServer::loop() {
            net::StartupConfig::get().max_connections, ") already reached.");
       client_socket.stop();
     } else {
-      clients.push_back(client);
-      msg::JsonLinesProtocol::get().broadcast.add(&(std::prev(clients.end())->socket));
+      // The client is constructed in place, as it holds its line buffer.
+      // When using pointers into the struct, only use the one in the list.
+      auto &client = clients.emplace_back();
+      client.socket = client_socket;
+      client.user_context.set_remote_identifier(net::auth::RemoteIdentifier{client_socket.remoteIP()});
+      msg::JsonLinesProtocol::get().broadcast.add(&client.socket);
       LOG4("Client ", clients.size() - 1, " connected from ", client_socket.remoteIP());
     }
   }
@@ -43,8 +40,8 @@ FLASHMEM void msg::JsonlServer::loop() {
   for (auto client = clients.begin(); client != clients.end(); client++) {
     const auto client_idx = std::distance(clients.begin(), client);
     if (client->socket.connected()) {
-      if (client->socket.available() > 0) {
-        msg::JsonLinesProtocol::get().process_tcp_input(client->socket, client->user_context);
+      if (client->socket.available() > 0 or client->line_buffer.has_line()) {
+        msg::JsonLinesProtocol::get().process_tcp_input(client->socket, client->line_buffer, client->user_context);
         client->last_contact.reset();
       } else if (client->last_contact.expired(net::StartupConfig::get().connection_timeout_ms)) {
         LOG5("Client ", client_idx, ", timed out after ", net::StartupConfig::get().connection_timeout_ms,
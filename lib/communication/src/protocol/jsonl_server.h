@@ -9,6 +9,7 @@
 
 #include "net/auth.h"
 #include "net/ethernet.h"
+#include "protocol/protocol.h"
 #include "utils/durations.h"
 #include "utils/singleton.h"
 #include <list>
@@ -37,6 +38,9 @@ struct JsonlServer : public utils::HeapSingleton<JsonlServer> {
 
     net::EthernetClient socket;
     net::auth::AuthentificationContext user_context;
+
+    /// Incoming data is collected here until a line is complete, which is then parsed in place.
+    JsonLinesProtocol::LineBuffer line_buffer;
   };
 
   std::list<Client> clients;
@@ -0,0 +1,90 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <Arduino.h> // Print, micros
+
+#include "utils/line_buffer.h"
+
+namespace msg {
+
+/**
+ * Collects the responses written to a connection and sends them in as few TCP segments as possible.
+ * Data is passed on in chunks of SIZE bytes, which defaults to the TCP maximum segment size on Ethernet,
+ * and the rest is sent when calling send().
+ *
+ * The Connection needs `writeFully(const uint8_t*, size_t)` and `flush()`, as the QNEthernet client has.
+ **/
+template <class Connection, size_t SIZE = 1460> class CoalescingWriter : public Print {
+  Connection &connection;
+  uint8_t buffer[SIZE];
+  size_t length = 0;
+  bool failed = false;
+
+  void write_buffer() {
+    if (length and !failed)
+      failed = connection.writeFully(buffer, length) != length;
+    length = 0;
+  }
+
+public:
+  explicit CoalescingWriter(Connection &connection) : connection(connection) {}
+
+  size_t write(uint8_t c) override {
+    if (length == SIZE)
+      write_buffer();
+    buffer[length++] = c;
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t size) override {
+    for (size_t left = size; left;) {
+      if (length == SIZE)
+        write_buffer();
+      auto count = std::min(left, SIZE - length);
+      memcpy(buffer + length, data, count);
+      length += count;
+      data += count;
+      left -= count;
+    }
+    return size;
+  }
+
+  /// Sends everything written so far. Returns false if the connection failed at any time.
+  bool send() {
+    write_buffer();
+    if (!failed)
+      connection.flush();
+    return !failed;
+  }
+};
+
+/**
+ * Handles the complete lines received on a connection, which is pipelining of messages when a client sends
+ * several of them without waiting for the responses. Lines are handled until none is left or the time budget
+ * is used up, remaining ones are handled in the next call. At least one line is handled per call.
+ *
+ * The responses written by handle_line(char *line, Print &output) are coalesced and sent at the end.
+ * @returns false if writing to the connection failed.
+ **/
+template <class Connection, size_t LINE_SIZE, class LineHandler>
+bool process_lines(Connection &connection, utils::LineBuffer<LINE_SIZE> &line_buffer, uint32_t budget_us,
+                   LineHandler handle_line) {
+  CoalescingWriter<Connection> output(connection);
+  auto start_us = micros();
+  while (char *line = line_buffer.read_line(connection)) {
+    handle_line(line, output);
+    if (micros() - start_us >= budget_us)
+      break;
+  }
+  return output.send();
+}
+
+} // namespace msg
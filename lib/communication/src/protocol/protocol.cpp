@@ -5,19 +5,15 @@
 
 #include "protocol.h"
 
-#ifdef ARDUINO
-
+#include "protocol/pipeline.h"
 #include "protocol/registry.h"
 
 #include "utils/StringPrint.h"
 #include "utils/durations.h"
 #include "utils/logging.h"
-#include "utils/serial_lines.h"
 
 #include "net/auth.h"
-#include "net/settings.h"
 
-#include "handlers/login_lock.h"
 #include "protocol/protocol.h"
 #include "protocol/protocol_oob.h"
 
@@ -47,18 +43,25 @@ FLASHMEM void trim(char *str) {
   }
 }
 
-FLASHMEM void msg::JsonLinesProtocol::init(size_t envelope_size) {
-  envelope_in = new DynamicJsonDocument(envelope_size);
-  envelope_out = new DynamicJsonDocument(envelope_size);
+FLASHMEM void msg::JsonLinesProtocol::init() {
+  // Messages are handled one after another, even those of different TCP/IP connections, so one envelope
+  // per connection type suffices. That is about 40KiB in total, see sys_stats.
+  envelopes.init({
+      /* Serial    */ {1, MAX_SERIAL_MESSAGE_SIZE, MAX_LINE_LENGTH},
+      /* TCP       */ {1, MAX_TCP_MESSAGE_SIZE, MAX_LINE_LENGTH},
+      /* Web       */ {1, MAX_WEB_MESSAGE_SIZE, MAX_LINE_LENGTH},
+      /* Broadcast */ {1, 0, 512},
+  });
 }
 
-FLASHMEM void msg::JsonLinesProtocol::handleMessage(net::auth::AuthentificationContext &user_context, Print &output) {
-  auto envelope_out = this->envelope_out->to<JsonObject>();
-  auto envelope_in = this->envelope_in->as<JsonObjectConst>();
+FLASHMEM void msg::JsonLinesProtocol::handleMessage(Envelopes &envelopes,
+                                                    net::auth::AuthentificationContext &user_context, Print &output) {
+  auto envelope_out = envelopes.out.to<JsonObject>();
+  auto envelope_in = envelopes.in.as<JsonObjectConst>();
 
-  // Unpack metadata from envelope
-  std::string msg_id = envelope_in["id"];
-  std::string msg_type = envelope_in["type"];
+  // Unpack metadata from envelope. The strings are not copied, they stay in the input buffer.
+  const char *msg_id = envelope_in["id"] | "";
+  const char *msg_type = envelope_in["type"] | "";
   bool perf_trace = envelope_in["perf_trace"] | false;
   elapsedMicros handle_message_time_us;
 
@@ -69,13 +72,13 @@ FLASHMEM void msg::JsonLinesProtocol::handleMessage(net::auth::AuthentificationC
   auto msg_out = envelope_out.createNestedObject("msg");
 
   // Select message handler
-  auto msg_handler = msg::handlers::Registry::get().lookup(msg_type);
-  auto requiredClearance = msg::handlers::Registry::get().requiredClearance(msg_type);
+  auto registry_entry = msg::handlers::Registry::get().find(msg_type);
+  auto msg_handler = registry_entry.handler;
   int return_code = 0;
   if (!msg_handler) {
     return_code = -10; // No handler for message known
     msg_out["error"] = "Unknown message type. Try this message: {'type':'help'}.";
-  } else if (!user_context.can_do(requiredClearance)) {
+  } else if (!user_context.can_do(registry_entry.clearance)) {
     return_code = -20;
     msg_out["error"] = "User is not authorized for action";
   } else {
@@ -128,6 +131,10 @@ FLASHMEM void msg::JsonLinesProtocol::handleMessage(net::auth::AuthentificationC
   // notice we don't send a NL here, has to be done by the callee!
 }
 
+#ifdef ARDUINO
+
+#include "utils/serial_lines.h"
+
 utils::SerialLineReader serial_line_reader;
 
 FLASHMEM void msg::JsonLinesProtocol::process_serial_input(net::auth::AuthentificationContext &user_context) {
@@ -135,39 +142,57 @@ FLASHMEM void msg::JsonLinesProtocol::process_serial_input(net::auth::Authentifi
   if (!line)
     return;
 
-  auto error = deserializeJson(*envelope_in, line);
+  EnvelopeLease envelopes(this->envelopes, EnvelopeKind::Serial);
+  if (!envelopes) {
+    LOG_ALWAYS("Dropped serial line input, no envelope is free.");
+    return;
+  }
+  auto error = deserializeJson(envelopes->in, line);
   if (error == DeserializationError::Code::EmptyInput) {
     // do nothing, just ignore empty input.
   } else if (error) {
     trim(line); // for not-destroying the output
     LOG4("Malformed serial line input. Expecting JSON-Lines. Error: ", error.c_str(), ". Input was: ", line);
   } else {
-    handleMessage(user_context, Serial);
+    handleMessage(*envelopes, user_context, Serial);
     Serial.println();
   }
 }
 
-FLASHMEM bool msg::JsonLinesProtocol::process_tcp_input(net::EthernetClient &connection,
+#endif // ARDUINO
+
+FLASHMEM bool msg::JsonLinesProtocol::process_tcp_input(net::EthernetClient &connection, LineBuffer &line_buffer,
                                                net::auth::AuthentificationContext &user_context) {
-  auto error = deserializeJson(*envelope_in, connection);
-  if (error == DeserializationError::Code::EmptyInput) {
-    //Serial.print(".");
-  } else if (error) {
-    LOG2("Malformed TCP/IP input. Expecting JSON Lines. Error: ", error.c_str());
-  } else {
-    handleMessage(user_context, connection);
-    // serializeJson(envelope_out->as<JsonObject>(), Serial);
-    // serializeJson(envelope_out->as<JsonObject>(), connection);
-    if (!connection.writeFully("\n"))
-      return true; // break;
-  }
-  return false;
+  // Without a free envelope, the lines stay in the line buffer until the next call
+  EnvelopeLease envelopes(this->envelopes, EnvelopeKind::TCP);
+  if (!envelopes)
+    return false;
+  bool ok = process_lines(connection, line_buffer, TCP_INPUT_BUDGET_US, [&](char *line, Print &output) {
+    // Passing a char* selects the zero-copy mode of ArduinoJson
+    auto error = deserializeJson(envelopes->in, line);
+    if (error == DeserializationError::Code::EmptyInput) {
+      //Serial.print(".");
+    } else if (error) {
+      LOG2("Malformed TCP/IP input. Expecting JSON Lines. Error: ", error.c_str());
+    } else {
+      handleMessage(*envelopes, user_context, output);
+      output.write('\n');
+    }
+  });
+  if (line_buffer.overflowed())
+    LOG3("Dropped TCP/IP input line, it is longer than ", MAX_LINE_LENGTH, " bytes.");
+  return !ok; // break;
 }
 
 FLASHMEM void msg::JsonLinesProtocol::process_string_input(const std::string &envelope_in_str,
                                                   std::string &envelope_out_str,
                                                   net::auth::AuthentificationContext &user_context) {
-  auto error = deserializeJson(*envelope_in, envelope_in_str);
+  EnvelopeLease envelopes(this->envelopes, EnvelopeKind::Web);
+  if (!envelopes) {
+    envelope_out_str = "{'error':'No envelope is free, try again later'}\n";
+    return;
+  }
+  auto error = deserializeJson(envelopes->in, envelope_in_str);
   if (error == DeserializationError::Code::EmptyInput) {
     //Serial.print(".");
   } else if (error) {
@@ -176,27 +201,52 @@ FLASHMEM void msg::JsonLinesProtocol::process_string_input(const std::string &en
     envelope_out_str += "'}\n";
   } else {
     utils::StringPrint s;
-    handleMessage(user_context, s);
+    handleMessage(*envelopes, user_context, s);
     envelope_out_str = s.str();
     // serializeJson(envelope_out->as<JsonObject>(), Serial);
     // serializeJson(envelope_out->as<JsonObject>(), envelope_out_str);
   }
 }
 
-FLASHMEM void msg::JsonLinesProtocol::process_out_of_band_handlers(carrier::Carrier &carrier_) {
+FLASHMEM void msg::JsonLinesProtocol::process_out_of_band_handlers(carrier::Carrier &carrier_, RunExecutor run_next) {
   if (!run::RunManager::get().queue.empty()) {
+    EnvelopeLease envelopes(this->envelopes, EnvelopeKind::Broadcast);
+    if (!envelopes)
+      return;
     // Currently, the following prints to all connected clients.
-    client::RunStateChangeNotificationHandler run_state_change_handler{broadcast, *envelope_out};
-    client::RunDataNotificationHandler run_data_handler{carrier_, broadcast};
-    client::StreamingRunDataNotificationHandler alternative_run_data_handler{carrier_, broadcast};
+    client::RunStateChangeNotificationHandler run_state_change_handler{broadcast, envelopes->out};
+    client::RunDataNotificationHandler json_run_data_handler{carrier_, broadcast};
+    client::BinaryRunDataNotificationHandler binary_run_data_handler{carrier_, broadcast};
+
+    auto &next_run = run::RunManager::get().queue.front();
+    auto &daq_config = next_run.daq_config;
+    run::RunDataHandler *run_data_handler = &json_run_data_handler;
+    if (daq_config.get_data_format() == daq::DataFormat::BINARY)
+      run_data_handler = &binary_run_data_handler;
+    auto reduction = next_run.sweep ? next_run.sweep->get_reduction() : daq::ReductionMode::NONE;
+    daq::ReducingRunDataHandler reducing_run_data_handler{reduction, run_data_handler};
+    if (reduction != daq::ReductionMode::NONE)
+      run_data_handler = &reducing_run_data_handler;
+    daq::DecimatingRunDataHandler decimating_run_data_handler{run_data_handler};
+    if (daq_config.get_decimation_mode() != daq::DecimationMode::NONE)
+      run_data_handler = &decimating_run_data_handler;
+#ifdef ARDUINO
+    daq::TriggeredRunDataHandler triggered_run_data_handler{run_data_handler};
+    if (daq_config.get_trigger().mode != daq::TriggerMode::NONE)
+      run_data_handler = &triggered_run_data_handler;
+#else
+    // The pre-trigger history is kept in the DMA ring buffer, which only exists on the hardware
+    if (daq_config.get_trigger().mode != daq::TriggerMode::NONE)
+      LOG_ALWAYS("Triggers are not supported without hardware, sampling all of OP.");
+#endif
 
     // TODO: Remove after debugging
     // LOGMEV("Protocol OOB RunManager now broadcasting to %d targets\n", broadcast.size());
     // broadcast.println("{'TEST':'TEST'}");
-    run::RunManager::get().run_next(carrier_, &run_state_change_handler, &run_data_handler,
-                                    &alternative_run_data_handler);
+    if (run_next)
+      run_next(carrier_, &run_state_change_handler, run_data_handler);
+    else
+      run::RunManager::get().run_next(carrier_, &run_state_change_handler, run_data_handler);
   }
 }
 
-#endif // ARDUINO
-
@@ -4,16 +4,16 @@
 
 #pragma once
 
-#ifdef ARDUINO
-
 #include <ArduinoJson.h>
 #include <Print.h>
 #include <list>
 
 #include "net/auth.h"
 #include "net/ethernet.h"
+#include "protocol/envelope_pool.h"
 #include "protocol/handler.h"
 #include "utils/durations.h"
+#include "utils/line_buffer.h"
 #include "utils/print-multiplexer.h"
 #include "utils/singleton.h"
 
@@ -21,6 +21,11 @@ namespace carrier {
 class Carrier;
 }
 
+namespace run {
+class RunStateChangeHandler;
+class RunDataHandler;
+} // namespace run
+
 namespace msg {
 
 /**
@@ -35,30 +40,67 @@ namespace msg {
  **/
 class JsonLinesProtocol : public utils::HeapSingleton<JsonLinesProtocol> {
 public:
-  DynamicJsonDocument *envelope_in, *envelope_out;
+  /// The envelopes of all connections, each connection type has a shard of its own.
+  EnvelopePool envelopes;
   utils::PrintMultiplexer broadcast;
 
   JsonLinesProtocol() { broadcast.add_Serial(); }
 
-  void init(size_t envelope_size); ///< Allocates storage
+  void init(); ///< Allocates the arena of the envelopes
 
   /**
-   * Handles the JSON document currently stored in `envelope_in` and
-   * stores the answer in the `envelope_out` accordingly.
+   * Handles the JSON document currently stored in `envelopes.in` and
+   * stores the answer in `envelopes.out` accordingly.
    *
    * Note that some out-of-band messages don't run throught this method,
    * for examle @see client::RunStateChangeNotificationHandler::handle().
    **/
-  void handleMessage(net::auth::AuthentificationContext &user_context, Print &output);
+  void handleMessage(Envelopes &envelopes, net::auth::AuthentificationContext &user_context, Print &output);
 
+  /// Longest accepted message line on a TCP/IP connection. Parsed, it fits into the input envelope.
+  static constexpr size_t MAX_LINE_LENGTH = 4096;
+
+  /**
+   * Capacity of the input envelopes in bytes, i.e. how large a message of each connection type may be once
+   * parsed. Larger messages are rejected with NoMemory. Each value takes one variant slot (16 bytes on the
+   * Teensy), so a TCP/IP message may have up to about 1000 values, which is plenty for any circuit. Messages
+   * from the web interface and typed into the serial console are expected to be smaller.
+   **/
+  static constexpr size_t MAX_TCP_MESSAGE_SIZE = 16384;
+  static constexpr size_t MAX_WEB_MESSAGE_SIZE = 8192;
+  static constexpr size_t MAX_SERIAL_MESSAGE_SIZE = 4096;
+  using LineBuffer = utils::LineBuffer<MAX_LINE_LENGTH>;
+
+#ifdef ARDUINO
   void process_serial_input(net::auth::AuthentificationContext &user_context);
-  bool process_tcp_input(net::EthernetClient &stream, net::auth::AuthentificationContext &user_context);
+#endif
+
+  /// Time after which process_tcp_input() stops handling pipelined messages, to let others have their turn.
+  static constexpr uint32_t TCP_INPUT_BUDGET_US = 10000;
+
+  /**
+   * Handles the complete lines received on a connection, which are collected in its line_buffer.
+   * The lines are parsed in place, such that strings in the input envelope point into the line buffer
+   * and handling a message does not need any heap allocation.
+   *
+   * All pipelined messages are handled within TCP_INPUT_BUDGET_US and their responses are sent together,
+   * @see process_lines(). Returns true if the connection failed.
+   **/
+  bool process_tcp_input(net::EthernetClient &stream, LineBuffer &line_buffer,
+                         net::auth::AuthentificationContext &user_context);
   void process_string_input(const std::string &envelope_in, std::string &envelope_out,
                             net::auth::AuthentificationContext &user_context);
 
-  void process_out_of_band_handlers(carrier::Carrier &carrier);
+  /// Does the next run in the queue on a carrier, like run::RunManager::run_next().
+  using RunExecutor = void (*)(carrier::Carrier &carrier, run::RunStateChangeHandler *state_change_handler,
+                               run::RunDataHandler *run_data_handler);
+
+  /**
+   * Does the next run of the run::RunManager queue, if there is any, and sends its state changes and
+   * data to all clients in broadcast. The run is done by run::RunManager::run_next() unless another
+   * run_next is given, such as the one of the simulation in native builds.
+   **/
+  void process_out_of_band_handlers(carrier::Carrier &carrier, RunExecutor run_next = nullptr);
 };
 
 } // namespace msg
-
-#endif // ARDUINO
@@ -4,14 +4,13 @@
 
 #include "protocol/protocol_oob.h"
 
-#ifdef ARDUINO
-
+#include <algorithm>
 #include <bitset>
 
 #include "daq/daq.h"
 #include "run/run.h"
+#include "run/sweep.h"
 #include "utils/logging.h"
-#include "utils/streaming_json.h"
 #include "protocol_oob.h"
 
 FLASHMEM void client::RunStateChangeNotificationHandler::handle(const run::RunStateChange change, const run::Run &run) {
@@ -22,12 +21,15 @@ FLASHMEM void client::RunStateChangeNotificationHandler::handle(const run::RunSt
   msg["t"] = change.t;
   msg["old"] = run::RunStateNames[static_cast<size_t>(change.old)];
   msg["new"] = run::RunStateNames[static_cast<size_t>(change.new_)];
+  if (run.sweep)
+    msg["point"] = run.sweep->get_point();
   serializeJson(envelope_out, target);
   target.write("\n"); // note EthernetClient::writeFully("\n") is probably
   target.flush();
 }
 
-FLASHMEM client::RunDataNotificationHandler::RunDataNotificationHandler(carrier::Carrier &carrier, Print &target)
+FLASHMEM client::RunDataNotificationHandler::RunDataNotificationHandler(carrier::Carrier &carrier,
+                                                                       utils::PrintMultiplexer &target)
     : carrier(carrier), target(target) {}
 
 FLASHMEM void client::RunDataNotificationHandler::handle(volatile uint32_t *data, size_t outer_count,
@@ -76,7 +78,9 @@ FLASHMEM void client::RunDataNotificationHandler::handle(volatile uint32_t *data
   // digitalWriteFast(LED_BUILTIN, LOW);
 
   // digitalWriteFast(18, HIGH);
-  target.write(str_buffer, actual_buffer_length);
+  // A slow client must not stall draining the DMA ring buffer, so it rather misses this chunk.
+  if (target.write_or_drop(reinterpret_cast<const uint8_t *>(str_buffer), actual_buffer_length))
+    overflowed = true;
   target.flush();
   // digitalWriteFast(18, LOW);
 }
@@ -86,13 +90,23 @@ FLASHMEM void client::RunDataNotificationHandler::stream(volatile uint32_t *buff
 }
 
 FLASHMEM void client::RunDataNotificationHandler::prepare(run::Run &run) {
+  overflowed = false;
   memcpy(str_buffer, MESSAGE_START, strlen(MESSAGE_START));
   memcpy(str_buffer + BUFFER_IDX_ENTITY_ID, carrier.get_entity_id().c_str(), BUFFER_LENGTH_ENTITY_ID);
+  if (run.sweep) {
+    char point[BUFFER_LENGTH_POINT + 1];
+    auto length = snprintf(point, sizeof(point), "%u", static_cast<unsigned int>(run.sweep->get_point()));
+    memset(str_buffer + BUFFER_IDX_POINT, ' ', BUFFER_LENGTH_POINT);
+    memcpy(str_buffer + BUFFER_IDX_POINT, point, length);
+  }
 
   size_t inner_count = run.daq_config.get_num_channels();
-  // We always stream half the buffer
-  // TODO: Do not access daq::dma::BUFFER_SIZE directly, probably make it a template parameter.
-  size_t outer_count = daq::dma::BUFFER_SIZE / inner_count / 2;
+  // Runs without channels have no data, see run::RunManager, which does not prepare for them
+  if (!inner_count)
+    return;
+  // We always stream one block of the DMA ring buffer
+  // TODO: Do not access daq::dma::BLOCK_SIZE directly, probably make it a template parameter.
+  size_t outer_count = daq::dma::BLOCK_SIZE / inner_count;
 
   actual_buffer_length = calculate_total_buffer_length(outer_count, inner_count);
   memset(str_buffer + BUFFER_LENGTH_STATIC, '-', actual_buffer_length - BUFFER_LENGTH_STATIC);
@@ -131,45 +145,30 @@ FLASHMEM size_t client::RunDataNotificationHandler::calculate_total_buffer_lengt
          sizeof(MESSAGE_END) - sizeof('\0' /* null byte in MESSAGE_END */) + sizeof('\n' /* newline */);
 }
 
-FLASHMEM void client::StreamingRunDataNotificationHandler::handle(uint16_t *data, size_t outer_count,
-                                                         size_t inner_count, const run::Run &run) {
-  utils::StreamingJson doc(target);
-  doc.begin_dict(); // envelope
-  doc.kv("type", "run_data");
-  doc.key("msg");
-  doc.begin_dict(); // msg
-  doc.kv("id", run.id);
-
-  doc.key("entity");
-  doc.begin_list();
-  doc.val(carrier.get_entity_id());
-  doc.val("0"); // cluster
-  doc.end_list();
-
-  doc.key("data");
-  doc.begin_list(); // data
-  for(size_t outer = 0; outer < outer_count; outer++) {
-    doc.begin_list(); // outer
-    for(size_t inner = 0; inner < inner_count; inner++) {
-      //doc.val(data[outer * inner_count + inner]);
-      const uint32_t number = data[outer * inner_count + inner];
-      const char *float_repr = nullptr; // daq::BaseDAQ::raw_to_str(number); //<- is just buggy! cf #168
-      if(float_repr) {
-        doc.json(float_repr);
-      } else {
-        doc.check_comma();
-        target.printf("% 1.3f", daq::BaseDAQ::raw_to_float(number));
-        doc.needs_comma();
-      }
-    }
-    doc.end_list(); // outer
-    if(outer != outer_count-1) doc.check_comma();
-  }
-  doc.end_list(); // data
+FLASHMEM client::BinaryRunDataNotificationHandler::BinaryRunDataNotificationHandler(
+    carrier::Carrier &carrier, utils::PrintMultiplexer &target)
+    : carrier(carrier), target(target) {}
+
+FLASHMEM void client::BinaryRunDataNotificationHandler::prepare(run::Run &run) {
+  // Everything but the sample count and the sequence number stays the same during a run
+  daq::binary::write_header(frame_buffer, run.id.c_str(), run.daq_config.get_num_channels());
+  sequence = 0;
+  overflowed = false;
+}
 
-  doc.end_dict(); // msg
-  doc.end_dict(); // envelope
-  doc.endln();
+// NOT FLASHMEM
+void client::BinaryRunDataNotificationHandler::handle(volatile uint32_t *data, size_t outer_count,
+                                                      size_t inner_count, const run::Run &run) {
+  auto length = daq::binary::frame_size(outer_count, inner_count);
+  if (length > BUFFER_LENGTH) {
+    LOG_ERROR("BinaryRunDataNotificationHandler::handle got more data than fits into one frame.")
+    return;
+  }
+  daq::binary::update_header(frame_buffer, outer_count, sequence++);
+  daq::binary::encode_samples(frame_buffer + daq::binary::HEADER_SIZE, data, outer_count * inner_count);
+  if (target.write_or_drop(frame_buffer, length))
+    overflowed = true;
+  target.flush();
 }
 
-#endif // ARDUINO
\ No newline at end of file
+FLASHMEM void client::BinaryRunDataNotificationHandler::stream(volatile uint32_t *buffer, run::Run &run) {}
\ No newline at end of file
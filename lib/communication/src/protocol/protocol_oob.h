@@ -4,14 +4,13 @@
 
 #pragma once
 
-#ifdef ARDUINO
-
 #include <ArduinoJson.h>
-#include <QNEthernetClient.h>
 
 #include "carrier/carrier.h"
+#include "daq/binary_frame.h"
 #include "daq/daq.h"
 #include "run/run.h"
+#include "utils/print-multiplexer.h"
 
 namespace client {
 
@@ -21,10 +20,10 @@ public:
   // TODO: This can become invalid on disconnects
   // TODO: Possibly needs locking/synchronizing with other writes
   Print &target; // net::EthernetClient &client;
-  DynamicJsonDocument &envelope_out;
+  JsonDocument &envelope_out;
 
 public:
-  RunStateChangeNotificationHandler(Print &target, DynamicJsonDocument &envelopeOut)
+  RunStateChangeNotificationHandler(Print &target, JsonDocument &envelopeOut)
       : target(target), envelope_out(envelopeOut) {}
 
   void handle(run::RunStateChange change, const run::Run &run) override;
@@ -43,29 +42,31 @@ public:
  **/
 class RunDataNotificationHandler : public run::RunDataHandler {
 public:
-  // TODO: This can become invalid on disconnects
   // TODO: Possibly needs locking/synchronizing with other writes
   carrier::Carrier &carrier;
-  Print &target; // net::EthernetClient &client;
+  utils::PrintMultiplexer &target;
 
 private:
   // TODO: At least de-duplicate some strings, so it doesn't explode the second someone touches it.
   static constexpr decltype(auto) MESSAGE_START =
-      R"({ "type": "run_data", "msg": { "id": "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx", "entity": ["XX-XX-XX-XX-XX-XX", "0"], "data": [)";
+      R"({ "type": "run_data", "msg": { "id": "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx", "entity": ["XX-XX-XX-XX-XX-XX", "0"], "point": null      , "data": [)";
   static constexpr decltype(auto) MESSAGE_END = "]}}";
   static constexpr size_t BUFFER_LENGTH_STATIC = sizeof(MESSAGE_START) - sizeof('\0');
   static constexpr size_t BUFFER_IDX_RUN_ID = 38;
   static constexpr size_t BUFFER_LENGTH_RUN_ID = 32 + 4;
   static constexpr size_t BUFFER_IDX_ENTITY_ID = 89;
   static constexpr size_t BUFFER_LENGTH_ENTITY_ID = 12 + 5;
+  // Index of the point of a sweep, padded with spaces, null for other runs
+  static constexpr size_t BUFFER_IDX_POINT = 124;
+  static constexpr size_t BUFFER_LENGTH_POINT = 10;
   static constexpr size_t BUFFER_LENGTH =
-      BUFFER_LENGTH_STATIC + daq::dma::BUFFER_SIZE / 2 * sizeof("[sD.FFF]") + sizeof(MESSAGE_END);
+      BUFFER_LENGTH_STATIC + daq::dma::BLOCK_SIZE * sizeof("[sD.FFF]") + sizeof(MESSAGE_END);
   char str_buffer[BUFFER_LENGTH]{};
 
   size_t actual_buffer_length = BUFFER_LENGTH;
 
 public:
-  RunDataNotificationHandler(carrier::Carrier &carrier, Print &target);
+  RunDataNotificationHandler(carrier::Carrier &carrier, utils::PrintMultiplexer &target);
 
   static size_t calculate_inner_buffer_length(size_t inner_count);
   static size_t calculate_outer_buffer_position(size_t outer_count, size_t inner_count);
@@ -77,17 +78,29 @@ public:
 };
 
 /**
- * Variant of RunDataNotificationHandler using utils::StreamingJson.
- * Thus, it is not bound to a fixed length string buffer (BUFFER_LENGTH).
- * Since the method signature change, we do not inherit of the run::RunDataHandler.
+ * Binary variant of RunDataNotificationHandler, selected per run with
+ * the DAQConfig key "data_format": "binary".
+ *
+ * Instead of expanding each sample into a text slot, the raw samples are packed
+ * as little-endian uint16 behind a small header, see daq/binary_frame.h for the
+ * frame layout. This needs two bytes per sample instead of seven.
  **/
-struct StreamingRunDataNotificationHandler {
+class BinaryRunDataNotificationHandler : public run::RunDataHandler {
+public:
   carrier::Carrier &carrier;
-  Print &target;
+  utils::PrintMultiplexer &target;
+
+private:
+  static constexpr size_t BUFFER_LENGTH = daq::binary::frame_size(daq::dma::BLOCK_SIZE, 1);
+  uint8_t frame_buffer[BUFFER_LENGTH]{};
+  uint32_t sequence = 0;
 
-  void handle(uint16_t* data, size_t outer_count, size_t inner_count, const run::Run &run);
+public:
+  BinaryRunDataNotificationHandler(carrier::Carrier &carrier, utils::PrintMultiplexer &target);
+
+  void prepare(run::Run &run) override;
+  void handle(volatile uint32_t *data, size_t outer_count, size_t inner_count, const run::Run &run) override;
+  void stream(volatile uint32_t *buffer, run::Run &run) override;
 };
 
 } // namespace client
-
-#endif // ARDUINO
@@ -4,93 +4,180 @@
 
 #include "protocol/registry.h"
 
-#ifdef ARDUINO
-
 #include "utils/logging.h"
 
+#include <algorithm>
+
 #include "handlers/carrier.h"
-#include "handlers/daq.h"
 #include "handlers/help.h"
+#include "handlers/ping.h"
+#include "handlers/run_manager.h"
+
+#ifdef ARDUINO
+#include "handlers/daq.h"
 #include "handlers/loader_flasher.h"
 #include "handlers/loader_plugin.h"
 #include "handlers/login_lock.h"
 #include "handlers/mode_manual.h"
 #include "handlers/net_settings.h"
-#include "handlers/ping.h"
-#include "handlers/run_manager.h"
 #include "handlers/sys.h"
+#endif
+
+namespace {
+
+using msg::handlers::DynamicRegistry;
+using net::auth::SecurityLevel;
+
+// All built-in message types with their result code prefix and required clearance.
+// The order does not matter, the table is sorted at compile time. Native builds have
+// the same table, but only register the handlers which do not need the hardware.
+constexpr auto builtin_table = msg::handlers::make_dispatch_table<DynamicRegistry::BuiltinEntry>({
+    // Stateless protocol basics
+    {"ping", {100, SecurityLevel::RequiresNothing}},
+    {"help", {200, SecurityLevel::RequiresNothing}},
+
+    // Carrier and RunManager things
+    {"reset_circuit", {300, SecurityLevel::RequiresLogin}},
+    {"set_circuit", {400, SecurityLevel::RequiresLogin}},
+    {"get_circuit", {500, SecurityLevel::RequiresLogin}},
+    {"get_entities", {600, SecurityLevel::RequiresLogin}},
+    {"start_run", {700, SecurityLevel::RequiresLogin}},
+    {"start_sweep", {750, SecurityLevel::RequiresLogin}},
+    {"stop_run", {780, SecurityLevel::RequiresLogin}},
+
+    // manual hardware access
+    {"one_shot_daq", {800, SecurityLevel::RequiresNothing}},
+    {"manual_mode", {900, SecurityLevel::RequiresNothing}},
+    {"overload_status", {1000, SecurityLevel::RequiresLogin}},
+
+    {"net_get", {6000, SecurityLevel::RequiresAdmin}},
+    {"net_set", {6100, SecurityLevel::RequiresAdmin}},
+    {"net_reset", {6200, SecurityLevel::RequiresAdmin}},
+    {"net_status", {6300, SecurityLevel::RequiresNothing}},
+    // ^ this net_status won't contain sensitive information...
+
+    // {"status", {3000, SecurityLevel::RequiresNothing}},
+    {"login", {3100, SecurityLevel::RequiresNothing}},
+    {"lock_acquire", {3200, SecurityLevel::RequiresLogin}},
+    {"lock_release", {3300, SecurityLevel::RequiresLogin}},
+
+    {"sys_ident", {3400, SecurityLevel::RequiresNothing}},
+    {"sys_reboot", {3500, SecurityLevel::RequiresAdmin}},
+    {"sys_log", {3600, SecurityLevel::RequiresLogin}},
+    {"sys_stats", {3700, SecurityLevel::RequiresLogin}},
+
+#ifdef ANABRID_WRITE_EEPROM
+    // these calls allow full client access to the MCU EEPROM (vendor stuff) and entitiy EEPROMs
+    {"sys_read_permanent", {3700, SecurityLevel::RequiresAdmin}},
+    {"sys_reset_permanent", {3800, SecurityLevel::RequiresAdmin}},
+    {"sys_write_permanent", {3900, SecurityLevel::RequiresAdmin}},
+#endif
+
+    {"load_plugin", {4100, SecurityLevel::RequiresAdmin}},
+    {"unload_plugin", {4200, SecurityLevel::RequiresAdmin}},
+
+    {"ota_update_init", {5000, SecurityLevel::RequiresAdmin}},
+    {"ota_update_stream", {5100, SecurityLevel::RequiresAdmin}},
+    {"ota_update_abort", {5200, SecurityLevel::RequiresAdmin}},
+    {"ota_update_complete", {5300, SecurityLevel::RequiresAdmin}},
+});
+
+static_assert(builtin_table.is_unique(), "Built-in message types must be unique.");
+static_assert(builtin_table.size() <= DynamicRegistry::MAX_BUILTIN_HANDLERS, "Increase MAX_BUILTIN_HANDLERS.");
+
+} // namespace
+
+FLASHMEM msg::handlers::detail::BuiltinTable msg::handlers::detail::get_builtin_table() {
+  return {builtin_table.begin(), builtin_table.end()};
+}
 
 FLASHMEM void msg::handlers::DynamicRegistry::init(carrier::Carrier &c) {
-  using namespace net::auth;
   using namespace msg::handlers;
 
-  // Stateless protocol basics
-  set("ping", 100, new PingRequestHandler{}, SecurityLevel::RequiresNothing);
-  set("help", 200, new HelpHandler(), SecurityLevel::RequiresNothing);
-
-  // Carrier and RunManager things
-  set("reset_circuit", 300, new ResetRequestHandler(c), SecurityLevel::RequiresLogin);
-  set("set_circuit", 400, new SetConfigMessageHandler(c), SecurityLevel::RequiresLogin);
-  set("get_circuit", 500, new GetConfigMessageHandler(c), SecurityLevel::RequiresLogin);
-  set("get_entities", 600, new GetEntitiesRequestHandler(c), SecurityLevel::RequiresLogin);
-  set("start_run", 700, new StartRunRequestHandler(), SecurityLevel::RequiresLogin);
-  set("stop_run", 780, new StopRunRequestHandler(), SecurityLevel::RequiresLogin);
-
-  // manual hardware access
-  set("one_shot_daq", 800, new OneshotDAQHandler(), SecurityLevel::RequiresNothing);
-  set("manual_mode", 900, new ManualControlHandler(), SecurityLevel::RequiresNothing);
-  set("overload_status", 1000, new GetOverloadStatusHandler(c), SecurityLevel::RequiresLogin);
-
-  set("net_get", 6000, new GetNetworkSettingsHandler(), SecurityLevel::RequiresAdmin);
-  set("net_set", 6100, new SetNetworkSettingsHandler(), SecurityLevel::RequiresAdmin);
-  set("net_reset", 6200, new ResetNetworkSettingsHandler(), SecurityLevel::RequiresAdmin);
-  set("net_status", 6300, new NetworkStatusHandler(), SecurityLevel::RequiresNothing);
-  // ^ this net_status won't contain sensitive information...
-
-  // set("status",            3000, new GetSystemStatus(), SecurityLevel::RequiresNothing);
-  set("login", 3100, new LoginHandler(), SecurityLevel::RequiresNothing);
-  set("lock_acquire", 3200, new LockAcquire(), SecurityLevel::RequiresLogin);
-  set("lock_release", 3300, new LockRelease(), SecurityLevel::RequiresLogin);
-
-  set("sys_ident", 3400, new GetSystemIdent(), SecurityLevel::RequiresNothing);
-  set("sys_reboot", 3500, new RebootHandler(), SecurityLevel::RequiresAdmin);
-  set("sys_log", 3600, new SyslogHandler(), SecurityLevel::RequiresLogin);
-  set("sys_stats", 3700, new SystemStats(), SecurityLevel::RequiresLogin);
+  set_builtin("ping", new PingRequestHandler{});
+  set_builtin("help", new HelpHandler());
+
+  set_builtin("reset_circuit", new ResetRequestHandler(c));
+  set_builtin("set_circuit", new SetConfigMessageHandler(c));
+  set_builtin("get_circuit", new GetConfigMessageHandler(c));
+  set_builtin("get_entities", new GetEntitiesRequestHandler(c));
+  set_builtin("start_run", new StartRunRequestHandler());
+  set_builtin("start_sweep", new StartSweepRequestHandler(c));
+  set_builtin("stop_run", new StopRunRequestHandler());
+  set_builtin("overload_status", new GetOverloadStatusHandler(c));
+
+#ifdef ARDUINO
+  set_builtin("one_shot_daq", new OneshotDAQHandler());
+  set_builtin("manual_mode", new ManualControlHandler());
+
+  set_builtin("net_get", new GetNetworkSettingsHandler());
+  set_builtin("net_set", new SetNetworkSettingsHandler());
+  set_builtin("net_reset", new ResetNetworkSettingsHandler());
+  set_builtin("net_status", new NetworkStatusHandler());
+
+  // set_builtin("status", new GetSystemStatus());
+  set_builtin("login", new LoginHandler());
+  set_builtin("lock_acquire", new LockAcquire());
+  set_builtin("lock_release", new LockRelease());
+
+  set_builtin("sys_ident", new GetSystemIdent());
+  set_builtin("sys_reboot", new RebootHandler());
+  set_builtin("sys_log", new SyslogHandler());
+  set_builtin("sys_stats", new SystemStats());
 
   #ifdef ANABRID_WRITE_EEPROM
-  // these calls allow full client access to the MCU EEPROM (vendor stuff) and entitiy EEPROMs
-  set("sys_read_permanent",  3700, new ReadSystemIdent(), SecurityLevel::RequiresAdmin);
-  set("sys_reset_permanent", 3800, new ResetSystemIdent(), SecurityLevel::RequiresAdmin);
-  set("sys_write_permanent", 3900, new WriteSystemIdent(), SecurityLevel::RequiresAdmin);
+  set_builtin("sys_read_permanent", new ReadSystemIdent());
+  set_builtin("sys_reset_permanent", new ResetSystemIdent());
+  set_builtin("sys_write_permanent", new WriteSystemIdent());
   #endif
 
-  set("load_plugin", 4100, new LoadPluginHandler(), SecurityLevel::RequiresAdmin);
-  set("unload_plugin", 4200, new UnloadPluginHandler(), SecurityLevel::RequiresAdmin);
+  set_builtin("load_plugin", new LoadPluginHandler());
+  set_builtin("unload_plugin", new UnloadPluginHandler());
 
-  set("ota_update_init", 5000, new FlasherInitHandler(), SecurityLevel::RequiresAdmin);
-  set("ota_update_stream", 5100, new FlasherDataHandler(), SecurityLevel::RequiresAdmin);
-  set("ota_update_abort", 5200, new FlasherAbortHandler(), SecurityLevel::RequiresAdmin);
-  set("ota_update_complete", 5300, new FlasherCompleteHandler(), SecurityLevel::RequiresAdmin);
+  set_builtin("ota_update_init", new FlasherInitHandler());
+  set_builtin("ota_update_stream", new FlasherDataHandler());
+  set_builtin("ota_update_abort", new FlasherAbortHandler());
+  set_builtin("ota_update_complete", new FlasherCompleteHandler());
+#endif // ARDUINO
+
+  // Handlers registered later on continue after the built-in result codes
+  for (auto &entry : builtin_table)
+    result_code_counter = std::max(result_code_counter, entry.value.result_code_prefix + result_code_increment);
+}
+
+FLASHMEM bool msg::handlers::DynamicRegistry::set_builtin(std::string_view msg_type, MessageHandler *handler) {
+  auto idx = builtin_table.index_of(msg_type);
+  if (idx == builtin_table.NOT_FOUND) {
+    LOG_ERROR("Message type is missing in the built-in dispatch table.");
+    return false;
+  }
+  builtin_handlers[idx] = handler;
+  handler->result_prefix = builtin_table[idx].value.result_code_prefix;
+  return true;
+}
+
+// NOT FLASHMEM
+msg::handlers::DynamicRegistry::RegistryEntry
+msg::handlers::DynamicRegistry::find(std::string_view msg_type) const {
+  auto idx = builtin_table.index_of(msg_type);
+  if (idx != builtin_table.NOT_FOUND)
+    return {builtin_handlers[idx], builtin_table[idx].value.clearance};
+  if (!entries.empty()) {
+    auto found = entries.find(msg_type);
+    if (found != entries.end())
+      return found->second;
+  }
+  return {nullptr, net::auth::SecurityLevel::RequiresNothing};
 }
 
 FLASHMEM
 msg::handlers::MessageHandler *msg::handlers::DynamicRegistry::lookup(const std::string &msg_type) {
-  auto found = entries.find(msg_type);
-  if (found != entries.end()) {
-    return found->second.handler;
-  } else {
-    return nullptr;
-  }
+  return find(msg_type).handler;
 }
 
 FLASHMEM
 net::auth::SecurityLevel msg::handlers::DynamicRegistry::requiredClearance(const std::string &msg_type) {
-  auto found = entries.find(msg_type);
-  if (found != entries.end()) {
-    return found->second.clearance;
-  } else {
-    return net::auth::SecurityLevel::RequiresNothing;
-  }
+  return find(msg_type).clearance;
 }
 
 FLASHMEM
@@ -103,6 +190,8 @@ FLASHMEM
 bool msg::handlers::DynamicRegistry::set(const std::string &msg_type, int result_code_prefix,
                                          msg::handlers::MessageHandler *handler,
                                          net::auth::SecurityLevel minimumClearance) {
+  if (builtin_table.index_of(msg_type) != builtin_table.NOT_FOUND)
+    return false;
   auto found = entries.find(msg_type);
   if (found != entries.end()) {
     return false;
@@ -116,6 +205,12 @@ bool msg::handlers::DynamicRegistry::set(const std::string &msg_type, int result
 
 FLASHMEM void msg::handlers::DynamicRegistry::dump() {
   Serial.print("Registered message handlers (msg::handlers::DynamicRegistry): ");
+  for (size_t idx = 0; idx < builtin_table.size(); idx++) {
+    Serial.print(builtin_table[idx].msg_type.data());
+    if (!builtin_handlers[idx])
+      Serial.print("(NULLPTR!)");
+    Serial.print(" ");
+  }
   for (auto const &kv : entries) {
     Serial.print(kv.first.c_str());
     if (!kv.second.handler)
@@ -124,6 +219,12 @@ FLASHMEM void msg::handlers::DynamicRegistry::dump() {
   }
   Serial.println("");
   Serial.println("Registry clearance levels:");
+  for (auto const &entry : builtin_table) {
+    Serial.print(entry.msg_type.data());
+    Serial.print(":");
+    Serial.print((int)(entry.value.clearance));
+    Serial.print(" ");
+  }
   for (auto const &kv : entries) {
     Serial.print(kv.first.c_str());
     Serial.print(":");
@@ -134,10 +235,12 @@ FLASHMEM void msg::handlers::DynamicRegistry::dump() {
 }
 
 FLASHMEM void msg::handlers::DynamicRegistry::write_handler_names_to(JsonArray &target) {
+  for (size_t idx = 0; idx < builtin_table.size(); idx++) {
+    if (builtin_handlers[idx])
+      target.add(builtin_table[idx].msg_type.data());
+  }
   for (auto const &kv : entries) {
     if (kv.second.handler)
       target.add(kv.first);
   }
 }
-
-#endif // ARDUINO
@@ -4,15 +4,16 @@
 
 #pragma once
 
-#ifdef ARDUINO
-
 #include <ArduinoJson.h>
+#include <array>
 #include <map>
 #include <string>
+#include <string_view>
 
 #include "carrier/carrier.h"
 #include "handler.h"
 #include "net/auth.h"
+#include "protocol/dispatch.h"
 #include "utils/singleton.h"
 
 namespace msg {
@@ -22,25 +23,44 @@ namespace handlers {
 /**
  * The Message Registry holds the list of all known message types.
  *
- * The DynamicRegistry implementation uses an heap-allocated std::map as well as
- * Handlers which can be null pointers.
+ * The built-in message types are known at compile time and looked up in a sorted
+ * DispatchTable, which also holds their result code prefix and required clearance.
+ * Only message types registered at runtime, for instance by plugins, go into a
+ * heap-allocated std::map. Handlers can be null pointers.
  *
  * \ingroup Singletons
  **/
 class DynamicRegistry : public utils::HeapSingleton<DynamicRegistry> {
+public:
   struct RegistryEntry { // "named tuple"
     MessageHandler *handler;
     net::auth::SecurityLevel clearance;
   };
 
-  std::map<std::string, RegistryEntry> entries;
+  /// What is known about a built-in handler at compile time
+  struct BuiltinEntry {
+    int result_code_prefix;
+    net::auth::SecurityLevel clearance;
+  };
+
+  static constexpr size_t MAX_BUILTIN_HANDLERS = 48;
+
+private:
+  std::array<MessageHandler *, MAX_BUILTIN_HANDLERS> builtin_handlers{}; ///< Same order as the dispatch table
+  std::map<std::string, RegistryEntry, std::less<>> entries;            ///< Registered at runtime
 
   int result_code_counter = 1, result_code_increment = 100;
 
+  bool set_builtin(std::string_view msg_type, MessageHandler *handler);
+
 public:
+  /// Returns handler and required clearance in one go. The handler is nullptr if msg_type is not known.
+  RegistryEntry find(std::string_view msg_type) const;
+
   MessageHandler *lookup(const std::string &msg_type); ///< Returns nullptr if not found
   net::auth::SecurityLevel requiredClearance(const std::string &msg_type);
 
+  /// Registers a handler at runtime. Built-in message types can not be replaced.
   bool set(const std::string &msg_type, MessageHandler *handler, net::auth::SecurityLevel minimumClearance);
   bool set(const std::string &msg_type, int result_code_prefix, MessageHandler *handler,
            net::auth::SecurityLevel minimumClearance);
@@ -53,8 +73,21 @@ public:
 
 using Registry = DynamicRegistry;
 
+namespace detail {
+
+/// The sorted dispatch table of the built-in message types in registry.cpp, for tests and diagnostics
+struct BuiltinTable {
+  const DispatchEntry<DynamicRegistry::BuiltinEntry> *first, *last;
+
+  const DispatchEntry<DynamicRegistry::BuiltinEntry> *begin() const { return first; }
+  const DispatchEntry<DynamicRegistry::BuiltinEntry> *end() const { return last; }
+  size_t size() const { return last - first; }
+};
+
+BuiltinTable get_builtin_table();
+
+} // namespace detail
+
 } // namespace handlers
 
 } // namespace msg
-
-#endif // ARDUINO
@@ -6,6 +6,7 @@
 
 #include <cstdint> // uint32_t
 #include <stddef.h> // size_t
+#include <stdio.h> // snprintf
 #include <string.h> // strcmp
 
 namespace web {
@@ -36,17 +37,57 @@ namespace web {
     const uint8_t *start; ///< begin of content in memory, determined by linker symbol
     const uint32_t size;  ///< size in bytes; determined by linker symbol
 
-    static constexpr int max_headers = 10;
-    /// up to 10 (unstructured) HTTP Headers, for instance
-    /// Content-Type, Content-Encoding, ETag, etc.
-    struct HttpHeader {
-      const char* name;
-      const char* value;
-    } headers[max_headers];
+    /// Prefabricated HTTP header lines of a 200 response, each terminated by CRLF, for instance
+    /// Content-Type, Content-Encoding, ETag, etc. Content-Length is not part of them, see write_static_response().
+    const char *http_headers;
+    /// The subset of http_headers which is repeated in a 304 response (Cache-Control, ETag, ...)
+    const char *http_validators;
+    const char *etag; ///< quoted entity tag, derived from a hash of the content
 
     const uint32_t lastmod; ///< C Unix timestamp for cache control
+
+    /// Whether the value of an If-None-Match request header names this version of the file.
+    /// Uses the weak comparison of RFC 7232, so W/"..." and lists of entity tags match as well.
+    bool matches(const char *if_none_match) const {
+      if (!if_none_match || !etag)
+        return false;
+      return 0 == strcmp(if_none_match, "*") || strstr(if_none_match, etag) != NULL;
+    }
   };
 
+  /**
+   * Writes the response to a request of file to res, which is an awot::Response or anything with its interface.
+   *
+   * The header lines are prefabricated by the asset build step and printed in one piece, instead of copying
+   * them into aWOT's header table and printing them one by one. Only Content-Length goes through the table,
+   * since aWOT has to know about it, or it would delimit the body by itself.
+   **/
+  template <class Response>
+  void write_static_response(Response &res, const StaticFile &file, bool not_modified, const char *server) {
+    char content_length[11]; // Digits of an uint32_t
+    res.status(not_modified ? 304 : 200);
+    res.set("Server", server);
+    // Only /api requests keep the connection alive, see LucidacWebServer::process_http_input
+    res.set("Connection", "close");
+    if (!not_modified) {
+      snprintf(content_length, sizeof(content_length), "%lu", static_cast<unsigned long>(file.size));
+      res.set("Content-Length", content_length);
+    }
+    res.beginHeaders();
+    res.printP(not_modified ? file.http_validators : file.http_headers);
+    res.endHeaders();
+
+    if (!not_modified) {
+      // The whole body in one go, which the socket sends in full segments.
+      // The folling line requires anabrid/aWOT@3.5.1 as upstream aWOT 3.5.0
+      // has a severe bug. Fix is sketched in
+      // https://github.com/lasselukkari/aWOT/compare/master...lfarrand:aWOT:master
+      // and adopted by us.
+      res.write(const_cast<uint8_t *>(file.start), file.size);
+    }
+    res.flush();
+  }
+
   // Get access to a table of static files, as defined by a proper implementation
   // in assetsp.cpp
   struct StaticAttic {
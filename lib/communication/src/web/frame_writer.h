@@ -0,0 +1,79 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <Arduino.h> // Print
+
+#include "websockets/data_frame.h"
+
+namespace web {
+
+/**
+ * Writes what is printed to it as the payload of an unmasked WebSocket message, as a server sends it,
+ * straight into a frame buffer which leaves room for the header in front of the payload.
+ *
+ * Messages longer than SIZE bytes are sent as several fragments of SIZE bytes each, so there is no limit on the
+ * size of a message. The default fills one TCP segment on Ethernet with a frame of a 4 byte header.
+ *
+ * The Connection needs `writeFully(const uint8_t*, size_t)`, which gets each frame in one piece.
+ **/
+template <class Connection, size_t SIZE = 1460 - 4> class WebsocketFrameWriter : public Print {
+  static constexpr size_t HEADER_ROOM = websockets::internals::MAX_HEADER_SIZE;
+
+  Connection &connection;
+  uint8_t buffer[HEADER_ROOM + SIZE];
+  size_t length = 0;
+  uint8_t opcode;
+  bool failed = false;
+
+  void write_frame(bool fin) {
+    uint8_t header[HEADER_ROOM];
+    auto header_size = websockets::internals::WriteHeader(header, length, opcode, fin);
+    auto frame = buffer + HEADER_ROOM - header_size;
+    memcpy(frame, header, header_size);
+    if (!failed)
+      failed = connection.writeFully(frame, header_size + length) != header_size + length;
+    opcode = websockets::internals::ContentType::Continuation;
+    length = 0;
+  }
+
+public:
+  explicit WebsocketFrameWriter(Connection &connection,
+                                uint8_t opcode = websockets::internals::ContentType::Text)
+      : connection(connection), opcode(opcode) {}
+
+  size_t write(uint8_t c) override {
+    if (length == SIZE)
+      write_frame(false);
+    buffer[HEADER_ROOM + length++] = c;
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t size) override {
+    for (size_t left = size; left;) {
+      if (length == SIZE)
+        write_frame(false);
+      auto count = std::min(left, SIZE - length);
+      memcpy(buffer + HEADER_ROOM + length, data, count);
+      length += count;
+      data += count;
+      left -= count;
+    }
+    return size;
+  }
+
+  /// Sends the last frame of the message. Returns false if the connection failed at any time.
+  bool send() {
+    write_frame(true);
+    return !failed;
+  }
+};
+
+} // namespace web
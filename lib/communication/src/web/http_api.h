@@ -0,0 +1,463 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <Arduino.h> // Print, micros
+
+#include "protocol/pipeline.h"
+
+namespace web {
+
+/**
+ * The parts of an HTTP request head which the API endpoint needs. The path points into the buffer of the
+ * HttpRequestReader and is only valid until its next read(), while the rest stays valid for the whole request.
+ **/
+struct HttpRequest {
+  //! The method, which is empty if it is longer than any the endpoint answers.
+  char method[8] = "";
+  //! The path without a query string.
+  const char *path = nullptr;
+  size_t path_length = 0;
+  uint8_t minor_version = 1;
+  size_t content_length = 0;
+  //! HTTP/1.1 connections persist unless the client sends `Connection: close`.
+  bool keep_alive = false;
+  //! The body is JSON Lines, with one envelope per line, instead of a single JSON envelope.
+  bool batch = false;
+
+  bool is_method(const char *name) const { return !strcmp(method, name); }
+  bool is_path(const char *name) const { return strlen(name) == path_length and !memcmp(path, name, path_length); }
+};
+
+//! What HttpRequestReader::read() found on the stream.
+enum class HttpReadResult { None, Head, Part, End, BadRequest, TooLarge };
+
+/**
+ * Reads the HTTP requests a client sends on a persistent connection, without blocking and without any heap
+ * allocation. Requests may be pipelined, i.e. follow each other without waiting for the responses.
+ *
+ * Each request is read as its head, then the parts of its body and then its end. The body is delimited by
+ * Content-Length. It is a single part, which has to fit into the buffer of SIZE bytes, or, in batch mode,
+ * one part per line, where only each line has to fit. Longer lines are dropped. Parts are handed out as
+ * mutable strings inside the buffer, such that they can be parsed in place with ArduinoJson's zero-copy mode.
+ *
+ * The head is parsed where it is, so as long as its body has not been read, the request can be handed to
+ * another HTTP implementation as it was received, see unread_data().
+ **/
+template <size_t SIZE> class HttpRequestReader {
+public:
+  using Result = HttpReadResult;
+
+protected:
+  char buffer[SIZE];
+  size_t begin = 0, end = 0, head_begin = 0;
+  bool in_body = false, dropping = false;
+  size_t body_left = 0, dropped_lines = 0;
+  HttpRequest current;
+  char *part = nullptr;
+  size_t part_length = 0;
+  Result failed = Result::None;
+
+  Result fail(Result error) {
+    failed = error;
+    return error;
+  }
+
+  /// Moves the unread data to the front and appends what is available. Returns false if nothing was read.
+  template <class Stream> bool fill(Stream &stream) {
+    if (begin) {
+      memmove(buffer, buffer + begin, end - begin);
+      end -= begin;
+      head_begin = begin = 0;
+    }
+    size_t before = end;
+    while (end < SIZE and stream.available() > 0) {
+      int count = stream.read(reinterpret_cast<uint8_t *>(buffer + end), SIZE - end);
+      if (count <= 0)
+        break;
+      end += count;
+    }
+    return end != before;
+  }
+
+  static bool equals_ignore_case(const char *text, size_t length, const char *name) {
+    if (strlen(name) != length)
+      return false;
+    for (size_t i = 0; i < length; i++)
+      if (tolower(static_cast<unsigned char>(text[i])) != name[i])
+        return false;
+    return true;
+  }
+
+  /// Whether a comma separated header value, like the one of Connection, has the given token.
+  static bool has_token(const char *value, size_t length, const char *token) {
+    for (size_t pos = 0; pos < length;) {
+      while (pos < length and (value[pos] == ' ' or value[pos] == ','))
+        pos++;
+      size_t start = pos;
+      while (pos < length and value[pos] != ',' and value[pos] != ' ')
+        pos++;
+      if (equals_ignore_case(value + start, pos - start, token))
+        return true;
+    }
+    return false;
+  }
+
+  static bool has_prefix_ignore_case(const char *value, size_t length, const char *prefix) {
+    return length >= strlen(prefix) and equals_ignore_case(value, strlen(prefix), prefix);
+  }
+
+  /// Parses the request line, which ends at line_end.
+  bool parse_request_line(const char *line, const char *line_end) {
+    auto method_end = static_cast<const char *>(memchr(line, ' ', line_end - line));
+    if (!method_end or method_end == line)
+      return false;
+    auto target = method_end + 1;
+    auto target_end = static_cast<const char *>(memchr(target, ' ', line_end - target));
+    if (!target_end or target_end == target)
+      return false;
+    auto version = target_end + 1;
+    if (line_end - version != 8 or memcmp(version, "HTTP/1.", 7) or version[7] < '0' or version[7] > '9')
+      return false;
+
+    size_t method_length = method_end - line;
+    if (method_length < sizeof(current.method)) {
+      memcpy(current.method, line, method_length);
+      current.method[method_length] = '\0';
+    }
+    current.path = target;
+    auto query = static_cast<const char *>(memchr(target, '?', target_end - target));
+    current.path_length = (query ? query : target_end) - target;
+    current.minor_version = version[7] - '0';
+    return true;
+  }
+
+  /// Takes the fields of interest from a header line, which ends at line_end.
+  bool parse_header_line(const char *line, const char *line_end) {
+    auto colon = static_cast<const char *>(memchr(line, ':', line_end - line));
+    if (!colon)
+      return false;
+    auto value = colon + 1;
+    while (value < line_end and (*value == ' ' or *value == '\t'))
+      value++;
+    auto value_end = line_end;
+    while (value_end > value and (value_end[-1] == ' ' or value_end[-1] == '\t'))
+      value_end--;
+    size_t name_length = colon - line, value_length = value_end - value;
+
+    if (equals_ignore_case(line, name_length, "content-length")) {
+      if (!value_length)
+        return false;
+      current.content_length = 0;
+      for (auto digit = value; digit < value_end; digit++) {
+        if (*digit < '0' or *digit > '9' or current.content_length > SIZE_MAX / 10 - 1)
+          return false;
+        current.content_length = current.content_length * 10 + (*digit - '0');
+      }
+    } else if (equals_ignore_case(line, name_length, "connection")) {
+      if (has_token(value, value_length, "close"))
+        current.keep_alive = false;
+    } else if (equals_ignore_case(line, name_length, "content-type")) {
+      current.batch = has_prefix_ignore_case(value, value_length, "application/x-ndjson") or
+                      has_prefix_ignore_case(value, value_length, "application/jsonl");
+    } else if (equals_ignore_case(line, name_length, "transfer-encoding")) {
+      // Bodies must have a Content-Length, chunked requests are not supported
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Looks for a complete head in the unread data and parses it.
+   * @returns Result::Head, Result::BadRequest or Result::None if the head is not complete yet.
+   **/
+  Result parse_head() {
+    // Empty lines in front of a request are ignored, see RFC 9112, section 2.2
+    while (begin < end and (buffer[begin] == '\r' or buffer[begin] == '\n'))
+      begin++;
+    head_begin = begin;
+
+    current = HttpRequest();
+    for (size_t pos = begin, line_number = 0; pos < end; line_number++) {
+      auto line = buffer + pos;
+      auto newline = static_cast<char *>(memchr(line, '\n', end - pos));
+      if (!newline)
+        break;
+      auto line_end = newline > line and newline[-1] == '\r' ? newline - 1 : newline;
+      pos = newline - buffer + 1;
+
+      if (line_number == 0) {
+        if (!parse_request_line(line, line_end))
+          return fail(Result::BadRequest);
+        // Only HTTP/1.1 can delimit the responses of a persistent connection
+        current.keep_alive = current.minor_version >= 1;
+      } else if (line == line_end) {
+        begin = pos;
+        in_body = true;
+        body_left = current.content_length;
+        if (!current.batch and current.content_length > SIZE)
+          return fail(Result::TooLarge);
+        return Result::Head;
+      } else if (!parse_header_line(line, line_end)) {
+        return fail(Result::BadRequest);
+      }
+    }
+    return Result::None;
+  }
+
+  /// Looks for the next part of the body in the unread data. @returns Result::None if it is not complete yet.
+  Result next_part() {
+    while (true) {
+      if (!body_left) {
+        in_body = false;
+        return Result::End;
+      }
+      size_t available = std::min(end - begin, body_left);
+      char *data = buffer + begin;
+      char *newline = current.batch ? static_cast<char *>(memchr(data, '\n', available)) : nullptr;
+      if (!newline and available < body_left) {
+        if (current.batch and end - begin == SIZE) {
+          // The line does not fit, the rest of it is skipped
+          if (!dropping)
+            dropped_lines++;
+          dropping = true;
+          begin += available;
+          body_left -= available;
+          continue;
+        }
+        return Result::None;
+      }
+
+      size_t consumed = newline ? newline - data + 1 : available;
+      begin += consumed;
+      body_left -= consumed;
+      if (dropping) {
+        dropping = false;
+        continue;
+      }
+      part = data;
+      part_length = consumed;
+      if (current.batch) {
+        while (part_length and isspace(static_cast<unsigned char>(part[part_length - 1])))
+          part_length--;
+        // Blank lines, like a trailing newline, are no envelopes
+        if (std::all_of(part, part + part_length, [](unsigned char c) { return isspace(c); }))
+          continue;
+      }
+      return Result::Part;
+    }
+  }
+
+public:
+  static constexpr size_t size() { return SIZE; }
+
+  /**
+   * Reads what is available from the stream, which needs `available()` and `read(uint8_t*, size_t)`,
+   * until the next head, part or end of a request is complete. @returns Result::None if there is none yet.
+   * After Result::BadRequest or Result::TooLarge, the reader stops reading and the connection is to be closed.
+   **/
+  template <class Stream> Result read(Stream &stream) {
+    if (failed != Result::None)
+      return failed;
+    while (true) {
+      auto result = in_body ? next_part() : parse_head();
+      if (result != Result::None)
+        return result;
+      if (!in_body and end - begin == SIZE)
+        return fail(Result::TooLarge); // A head which does not fit into the buffer
+      if (!fill(stream))
+        return Result::None;
+    }
+  }
+
+  /// The request whose head was read last.
+  const HttpRequest &request() const { return current; }
+
+  /// The part of the body which read() returned.
+  char *data() { return part; }
+  size_t length() const { return part_length; }
+
+  /// The number of lines of batch bodies which have been dropped because they are longer than SIZE.
+  size_t dropped() const { return dropped_lines; }
+
+  /// Everything received but not read, starting with the last head as long as nothing of its body has been read.
+  const char *unread_data() const { return buffer + head_begin; }
+  size_t unread_length() const { return end - head_begin; }
+
+  /// Forgets about any partial request and errors, for instance when a connection is closed.
+  void clear() {
+    begin = end = head_begin = body_left = 0;
+    in_body = dropping = false;
+    failed = Result::None;
+  }
+};
+
+/**
+ * Writes the body of an HTTP response with the chunked transfer coding, such that persistent connections can
+ * carry responses whose length is not known in advance. Data is collected into chunks of up to SIZE bytes.
+ * For HTTP/1.0 clients, the body is written as it is, to be delimited by closing the connection.
+ **/
+template <size_t SIZE = 1024> class HttpChunkedWriter : public Print {
+  Print &output;
+  bool chunked;
+  uint8_t buffer[SIZE];
+  size_t length = 0;
+
+public:
+  HttpChunkedWriter(Print &output, bool chunked) : output(output), chunked(chunked) {}
+
+  void set_chunked(bool value) { chunked = value; }
+
+  size_t write(uint8_t c) override {
+    if (length == SIZE)
+      flush_chunk();
+    buffer[length++] = c;
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t size) override {
+    for (size_t left = size; left;) {
+      if (length == SIZE)
+        flush_chunk();
+      auto count = std::min(left, SIZE - length);
+      memcpy(buffer + length, data, count);
+      length += count;
+      data += count;
+      left -= count;
+    }
+    return size;
+  }
+
+  /// Writes what is collected as a chunk of its own.
+  void flush_chunk() {
+    if (!length)
+      return;
+    if (chunked) {
+      // The chunk size in hex digits, followed by CRLF
+      char size_line[sizeof(size_t) * 2 + 2];
+      size_t pos = sizeof(size_line) - 2;
+      for (size_t value = length; value; value >>= 4)
+        size_line[--pos] = "0123456789ABCDEF"[value & 0xF];
+      memcpy(size_line + sizeof(size_line) - 2, "\r\n", 2);
+      output.write(reinterpret_cast<const uint8_t *>(size_line + pos), sizeof(size_line) - pos);
+    }
+    output.write(buffer, length);
+    if (chunked)
+      output.write(reinterpret_cast<const uint8_t *>("\r\n"), 2);
+    length = 0;
+  }
+
+  /// Ends the body with the last, empty chunk.
+  void end() {
+    flush_chunk();
+    if (chunked)
+      output.write(reinterpret_cast<const uint8_t *>("0\r\n\r\n"), 5);
+  }
+};
+
+//! What process_http_requests() wants to happen with the connection.
+enum class HttpResult {
+  KeepAlive, ///< Wait for further requests.
+  Close,     ///< The last request was answered and the client wants no more, or failed.
+  Other      ///< The next request is not for the API, see HttpRequestReader::unread_data().
+};
+
+/**
+ * Answers the HTTP requests received on a persistent connection, like process_lines() does for JSON Lines.
+ * Pipelined requests are handled until none is left or the time budget is used up. Their responses are
+ * coalesced and sent at the end. Bodies of batch requests are handled line by line as they arrive, so
+ * their response may span several calls.
+ *
+ * A single envelope is answered with a JSON response, a batch with one line per envelope. The Api needs
+ *   - `bool accepts(const HttpRequest&)`, whether a request is for the API at all,
+ *   - `void print_headers(Print&)`, which prints additional header lines, like the ones for CORS,
+ *   - `bool parse(char *data, size_t length)`, which parses an envelope and tells whether it is valid,
+ *   - `void reply(Print&)`, which writes the response to the envelope or the error of parsing it.
+ **/
+template <class Connection, size_t SIZE, class Api>
+HttpResult process_http_requests(Connection &connection, HttpRequestReader<SIZE> &reader, uint32_t budget_us,
+                                 Api &api) {
+  using Result = HttpReadResult;
+  msg::CoalescingWriter<Connection> output(connection);
+  HttpChunkedWriter<> body(output, reader.request().minor_version >= 1);
+
+  auto write_head = [&](const HttpRequest &request, const char *status, const char *content_type) {
+    output.print("HTTP/1.1 ");
+    output.print(status);
+    output.print("\r\n");
+    api.print_headers(output);
+    if (content_type) {
+      output.print("Content-Type: ");
+      output.print(content_type);
+      output.print("\r\n");
+      if (request.minor_version >= 1)
+        output.print("Transfer-Encoding: chunked\r\n");
+    } else {
+      output.print("Content-Length: 0\r\n");
+    }
+    output.print(request.keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+  };
+
+  auto result = HttpResult::KeepAlive;
+  auto start_us = micros();
+  while (result == HttpResult::KeepAlive) {
+    auto event = reader.read(connection);
+    auto &request = reader.request();
+    bool has_body = request.is_method("GET") or request.is_method("POST");
+
+    if (event == Result::None) {
+      break;
+    } else if (event == Result::Head) {
+      if (!api.accepts(request)) {
+        result = HttpResult::Other;
+      } else if (has_body and request.batch) {
+        body.set_chunked(request.minor_version >= 1);
+        write_head(request, "200 OK", "application/x-ndjson");
+      }
+    } else if (event == Result::Part and has_body) {
+      bool valid = api.parse(reader.data(), reader.length());
+      if (!request.batch) {
+        body.set_chunked(request.minor_version >= 1);
+        write_head(request, valid ? "200 OK" : "400 Bad Request", "application/json");
+      }
+      api.reply(body);
+      if (request.batch)
+        body.write('\n');
+    } else if (event == Result::End) {
+      if (has_body and !request.batch and !request.content_length) {
+        // An empty body is no envelope, which is answered like any other invalid one
+        body.set_chunked(request.minor_version >= 1);
+        write_head(request, api.parse(nullptr, 0) ? "200 OK" : "400 Bad Request", "application/json");
+        api.reply(body);
+      }
+      if (has_body)
+        body.end();
+      else
+        write_head(request, request.is_method("OPTIONS") ? "204 No Content" : "405 Method Not Allowed", nullptr);
+      if (!request.keep_alive)
+        result = HttpResult::Close;
+    } else if (event == Result::BadRequest or event == Result::TooLarge) {
+      output.print(event == Result::BadRequest ? "HTTP/1.1 400 Bad Request\r\n"
+                                               : "HTTP/1.1 413 Content Too Large\r\n");
+      output.print("Content-Length: 0\r\nConnection: close\r\n\r\n");
+      result = HttpResult::Close;
+    }
+    if (micros() - start_us >= budget_us)
+      break;
+  }
+
+  body.flush_chunk();
+  if (!output.send())
+    return HttpResult::Close;
+  return result;
+}
+
+} // namespace web
@@ -0,0 +1,206 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "websockets/data_frame.h"
+
+namespace web {
+
+//! What WebsocketMessageReader::read() found on the stream.
+enum class WebsocketReadResult { None, Message, Ping, Pong, Close, MessageTooBig, ProtocolError };
+
+/**
+ * Reads the WebSocket messages a client sends, frame by frame and as far as the socket has data,
+ * without blocking and without any heap allocation.
+ *
+ * Payloads are unmasked right into a fixed arena of SIZE bytes, where fragmented messages are put together.
+ * A complete message is handed out as a mutable, null-terminated string inside the arena, such that it can be
+ * parsed in place with ArduinoJson's zero-copy mode. It stays valid until the next call to read().
+ * Control frames, which may arrive between the fragments of a message, use a buffer of their own.
+ *
+ * Messages larger than SIZE are refused before their payload is read. After such an error, or a protocol
+ * error, the reader stops reading and the connection is to be closed.
+ **/
+template <size_t SIZE> class WebsocketMessageReader {
+public:
+  using Result = WebsocketReadResult;
+
+  //! Control frames must not be longer than this, see RFC 6455, section 5.5.
+  static constexpr size_t MAX_CONTROL_SIZE = 125;
+
+protected:
+  char arena[SIZE + 1];
+  char control[MAX_CONTROL_SIZE + 1];
+
+  uint8_t header[websockets::internals::MAX_HEADER_SIZE];
+  size_t header_length = 0;
+  bool in_payload = false;
+
+  // The current frame
+  bool fin = false;
+  uint8_t opcode = 0;
+  uint8_t mask[4];
+  uint64_t frame_length = 0, frame_pos = 0;
+
+  // The current message, which may consist of several frames
+  bool in_message = false;
+  uint8_t message_opcode = 0;
+  size_t message_length = 0, control_length = 0;
+
+  Result failed = Result::None, last = Result::None;
+
+  static bool is_control(uint8_t opcode) { return opcode & 0x08; }
+
+  size_t header_size() const {
+    size_t size = 2;
+    if (header_length >= 2) {
+      auto length = header[1] & 0x7F;
+      size += (length == 126 ? 2 : length == 127 ? 8 : 0) + (header[1] & 0x80 ? 4 : 0);
+    }
+    return size;
+  }
+
+  Result fail(Result error) {
+    failed = error;
+    return error;
+  }
+
+  /// Checks the header, once it is complete, and prepares to read the payload.
+  Result begin_frame() {
+    fin = header[0] & 0x80;
+    opcode = header[0] & 0x0F;
+    frame_length = header[1] & 0x7F;
+    size_t pos = 2;
+    if (frame_length == 126) {
+      frame_length = (header[2] << 8) | header[3];
+      pos += 2;
+    } else if (frame_length == 127) {
+      frame_length = 0;
+      for (size_t i = 0; i < 8; i++)
+        frame_length = (frame_length << 8) | header[2 + i];
+      pos += 8;
+    }
+    // Clients must mask their frames and no extensions are negotiated
+    if (!(header[1] & 0x80) or (header[0] & 0x70))
+      return fail(Result::ProtocolError);
+    for (size_t i = 0; i < 4; i++)
+      mask[i] = header[pos + i];
+
+    using namespace websockets::internals;
+    if (is_control(opcode)) {
+      if (!fin or frame_length > MAX_CONTROL_SIZE or opcode > ContentType::Pong)
+        return fail(Result::ProtocolError);
+      control_length = 0;
+    } else if (opcode == ContentType::Continuation) {
+      if (!in_message)
+        return fail(Result::ProtocolError);
+    } else if (opcode == ContentType::Text or opcode == ContentType::Binary) {
+      if (in_message)
+        return fail(Result::ProtocolError);
+      in_message = true;
+      message_opcode = opcode;
+      message_length = 0;
+    } else {
+      return fail(Result::ProtocolError);
+    }
+    if (!is_control(opcode) and frame_length > SIZE - message_length)
+      return fail(Result::MessageTooBig);
+
+    frame_pos = 0;
+    in_payload = true;
+    return Result::None;
+  }
+
+  /// Finishes a frame whose payload has been read completely.
+  Result end_frame() {
+    in_payload = false;
+    header_length = 0;
+    if (is_control(opcode)) {
+      control[control_length] = '\0';
+      using namespace websockets::internals;
+      if (opcode == ContentType::Ping)
+        return Result::Ping;
+      return opcode == ContentType::Pong ? Result::Pong : Result::Close;
+    }
+    if (!fin)
+      return Result::None;
+    in_message = false;
+    arena[message_length] = '\0';
+    return Result::Message;
+  }
+
+public:
+  static constexpr size_t size() { return SIZE; }
+
+  /**
+   * Reads what is available from the stream, which needs `available()` and `read(uint8_t*, size_t)`,
+   * until a complete message or control frame has arrived. @returns Result::None if there is none yet.
+   **/
+  template <class Stream> Result read(Stream &stream) {
+    last = Result::None;
+    if (failed != Result::None)
+      return failed;
+
+    while (true) {
+      if (!in_payload) {
+        // The header is read in as few pieces as possible, but never beyond its end
+        size_t needed;
+        while (header_length < (needed = header_size())) {
+          if (stream.available() <= 0)
+            return Result::None;
+          int count = stream.read(header + header_length, needed - header_length);
+          if (count <= 0)
+            return Result::None;
+          header_length += count;
+        }
+        if (begin_frame() != Result::None)
+          return failed;
+      }
+
+      char *payload = is_control(opcode) ? control + control_length : arena + message_length;
+      while (frame_pos < frame_length) {
+        if (stream.available() <= 0)
+          return Result::None;
+        int count = stream.read(reinterpret_cast<uint8_t *>(payload), frame_length - frame_pos);
+        if (count <= 0)
+          return Result::None;
+        for (int i = 0; i < count; i++)
+          payload[i] ^= mask[(frame_pos + i) % 4];
+        payload += count;
+        frame_pos += count;
+        (is_control(opcode) ? control_length : message_length) += count;
+      }
+
+      last = end_frame();
+      if (last != Result::None)
+        return last;
+    }
+  }
+
+  /// The payload of what the last call to read() returned, a message or a control frame.
+  char *data() { return last == Result::Message ? arena : control; }
+  size_t length() const { return last == Result::Message ? message_length : control_length; }
+  //! Whether the last message is a text or binary one.
+  uint8_t message_type() const { return message_opcode; }
+
+  /// The status code of a close frame, or CloseReason_NoStatusRcvd if it has none.
+  uint16_t close_code() const {
+    if (control_length < 2)
+      return 1005;
+    return (static_cast<uint8_t>(control[0]) << 8) | static_cast<uint8_t>(control[1]);
+  }
+
+  /// Forgets about any partial message and errors, for instance when a connection is closed.
+  void clear() {
+    header_length = message_length = control_length = 0;
+    in_payload = in_message = false;
+    failed = last = Result::None;
+  }
+};
+
+} // namespace web
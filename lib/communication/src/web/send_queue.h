@@ -0,0 +1,153 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "websockets/data_frame.h"
+
+namespace web {
+
+/**
+ * Bounded queue of the bytes to be sent to one WebSocket client.
+ *
+ * As long as the queue is empty, frames go to the socket directly, with the header written in place
+ * and the payload sent from where it is. Only what the socket can not take right away is copied into
+ * the queue and sent by later calls to drain(). A frame which does not fit anymore is dropped as a
+ * whole, such that one slow client can neither stall the run loop nor receive a broken frame.
+ *
+ * The Socket type needs availableForWrite() and write(const uint8_t*, size_t), like an EthernetClient.
+ * It is expected to take everything availableForWrite() announced.
+ **/
+class WebsocketSendQueue {
+public:
+  static constexpr size_t CAPACITY = 8 * 1024;
+
+  struct Statistics {
+    uint32_t frames = 0, dropped_frames = 0;
+    uint32_t bytes_written = 0; ///< to the socket
+    uint32_t bytes_copied = 0;  ///< into the queue, because the socket had no room for them
+  };
+
+protected:
+  uint8_t buffer[CAPACITY];
+  size_t head = 0, size_ = 0;
+  bool broken = false;
+  Statistics statistics;
+
+  template <class Socket> static size_t room(Socket &socket) {
+    auto available = socket.availableForWrite();
+    return available > 0 ? static_cast<size_t>(available) : 0;
+  }
+
+  void enqueue(const uint8_t *data, size_t length) {
+    if (length > CAPACITY - size_) {
+      // Only if the socket took less than it announced, the frame is broken now
+      broken = true;
+      length = CAPACITY - size_;
+    }
+    size_t tail = (head + size_) % CAPACITY;
+    size_t first = length < CAPACITY - tail ? length : CAPACITY - tail;
+    memcpy(buffer + tail, data, first);
+    memcpy(buffer, data + first, length - first);
+    size_ += length;
+    statistics.bytes_copied += length;
+  }
+
+  /// Writes up to direct bytes to the socket and queues the rest.
+  template <class Socket> void put(Socket &socket, const uint8_t *data, size_t length, size_t &direct) {
+    size_t written = 0;
+    if (direct) {
+      size_t attempted = length < direct ? length : direct;
+      written = socket.write(data, attempted);
+      direct = written == attempted ? direct - written : 0;
+      statistics.bytes_written += written;
+    }
+    if (written < length)
+      enqueue(data + written, length - written);
+  }
+
+public:
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t available() const { return CAPACITY - size_; }
+  //! Whether the socket took less than announced once, so the stream can not be trusted anymore.
+  bool is_broken() const { return broken; }
+  //! Gives up on the stream, for instance if the client did not take its data for too long.
+  void mark_broken() { broken = true; }
+  const Statistics &get_statistics() const { return statistics; }
+
+  /// Sends as much of the queue as the socket can take right now, @returns the number of bytes sent.
+  template <class Socket> size_t drain(Socket &socket) {
+    size_t sent = 0;
+    while (size_) {
+      size_t contiguous = size_ < CAPACITY - head ? size_ : CAPACITY - head;
+      size_t length = room(socket);
+      if (!length)
+        break;
+      length = socket.write(buffer + head, contiguous < length ? contiguous : length);
+      if (!length)
+        break;
+      head = (head + length) % CAPACITY;
+      size_ -= length;
+      sent += length;
+    }
+    if (!size_)
+      head = 0;
+    statistics.bytes_written += sent;
+    return sent;
+  }
+
+  /**
+   * Writes bytes which must not be split or dropped, e.g. a frame header or payload of the websockets
+   * library, if they fit into the socket and the queue right now.
+   * @returns false if there is no room for them, try again after some drain().
+   **/
+  template <class Socket> bool write(Socket &socket, const uint8_t *data, size_t length) {
+    if (broken)
+      return false;
+    drain(socket);
+    size_t direct = empty() ? room(socket) : 0;
+    if (length > direct + available())
+      return false;
+    put(socket, data, length, direct);
+    return true;
+  }
+
+  /**
+   * Sends an unmasked frame, as a server does, or drops it if there is no room for it.
+   * Without fin, the frame is the fragment of a message which continues in further frames.
+   * @returns false if the frame was dropped
+   **/
+  template <class Socket>
+  bool send_frame(Socket &socket, uint8_t opcode, const uint8_t *payload, size_t length, bool fin = true) {
+    uint8_t header[websockets::internals::MAX_HEADER_SIZE];
+    size_t header_size = websockets::internals::WriteHeader(header, length, opcode, fin);
+
+    if (broken) {
+      statistics.dropped_frames++;
+      return false;
+    }
+    drain(socket);
+    size_t direct = empty() ? room(socket) : 0;
+    if (header_size + length > direct + available()) {
+      statistics.dropped_frames++;
+      return false;
+    }
+    put(socket, header, header_size, direct);
+    put(socket, payload, length, direct);
+    statistics.frames++;
+    return true;
+  }
+
+  void clear() {
+    head = size_ = 0;
+    broken = false;
+  }
+};
+
+} // namespace web
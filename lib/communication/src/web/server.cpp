@@ -7,11 +7,14 @@
 #ifdef ARDUINO
 
 #include "build/distributor.h"
+#include "daq/binary_frame.h"
 #include "net/auth.h"
 #include "net/ethernet.h"
 #include "protocol/protocol.h"
 #include "utils/logging.h"
 #include "web/assets.h"
+#include "web/frame_writer.h"
+#include "web/websocket_api.h"
 #include "web/websockets.h"
 
 #define ENABLE_AWOT_NAMESPACE
@@ -58,6 +61,7 @@ FLASHMEM void allocate_interesting_headers(awot::Application &app) {
   app.header("Upgrade", header[i++], maxval);
   app.header("Sec-WebSocket-Version", header[i++], maxval);
   app.header("Sec-Websocket-Key", header[i++], maxval);
+  app.header("If-None-Match", header[i++], maxval);
 
   // programmer, please ensure at this line i < max_allocated_headers.
 }
@@ -72,29 +76,12 @@ FLASHMEM void notfound(awot::Request &req, awot::Response &res) {
   res.println("<hr><p><i>" SERVER_VERSION "</i>");
 }
 
-FLASHMEM void serve_static(const web::StaticFile &file, awot::Response &res) {
-  LOGMEV("Serving static file %s with %d bytes\n", file.filename, file.size);
-  res.status(200);
-  // copying the headers (dumb!)
-  for (int i = 0; i < file.max_headers; i++) {
-    if (file.headers[i].name)
-      res.set(file.headers[i].name, file.headers[i].value);
-  }
-  // this would have been smarter but aWOT is not very smart
-  // res.print(file.prefab_http_headers);
-  // res.endHeaders();
-  // // Note on the note: This use case is possible with the aWOT API, cf.
-  // // https://awot.net/en/3x/api.html#res-beginHeaders
-  for (uint32_t written = 0; written != file.size;) {
-    // The folling line requires anabrid/aWOT@3.5.1 as upstream aWOT 3.5.0
-    // has a severe bug. Fix is sketched in
-    // https://github.com/lasselukkari/aWOT/compare/master...lfarrand:aWOT:master
-    // and adopted by us.
-    uint32_t singleshot = res.write((uint8_t *)file.start + written, file.size - written);
-    // LOGMEV("Written %d, plus %d", written, singleshot);
-    written += singleshot;
-  }
-  res.flush();
+FLASHMEM void serve_static(const web::StaticFile &file, awot::Request &req, awot::Response &res) {
+  // The browser already has this version of the file, it only needs to know.
+  bool not_modified = file.matches(req.get("If-None-Match"));
+  LOGMEV("Serving static file %s with %d bytes%s\n", file.filename, file.size, not_modified ? " (not modified)" : "");
+
+  web::write_static_response(res, file, not_modified, SERVER_VERSION);
 }
 
 FLASHMEM void serve_static(awot::Request &req, awot::Response &res) {
@@ -109,7 +96,7 @@ FLASHMEM void serve_static(awot::Request &req, awot::Response &res) {
   const char *path_without_leading_slash = req.path() + 1;
   const StaticFile *file = StaticAttic().get_by_filename(path_without_leading_slash);
   if (file) {
-    serve_static(*file, res);
+    serve_static(*file, req, res);
     res.end();
   } else {
     LOGMEV("No suitable static file found for path %s\n", req.path());
@@ -120,8 +107,7 @@ FLASHMEM void serve_static(awot::Request &req, awot::Response &res) {
 FLASHMEM void index(awot::Request &req, awot::Response &res) {
   const StaticFile *file = StaticAttic().get_by_filename("index.html");
   if (file) {
-    res.status(200);
-    serve_static(*file, res);
+    serve_static(*file, req, res);
   } else {
     res.status(501);
     res.set("Content-Type", "text/html");
@@ -142,6 +128,7 @@ void convertToJson(const StaticFile &file, JsonVariant serialized) {
   auto j = serialized.to<JsonObject>();
   j["filename"] = file.filename;
   j["lastmod"] = file.lastmod;
+  j["etag"] = file.etag;
   j["size"] = (int)file.size;
   j["start_in_memory"] = (int)file.start;
 }
@@ -189,29 +176,82 @@ FLASHMEM void api_preflight(awot::Request &req, awot::Response &res) {
   set_cors(req, res);
 }
 
-FLASHMEM void api(awot::Request &req, awot::Response &res) {
-  set_cors(req, res);
+/**
+ * The /api endpoint, which process_http_requests() calls for the requests on a persistent connection.
+ * Envelopes are parsed in place from the buffer of the request reader into the leased input envelope.
+ **/
+struct HttpApi {
+  msg::Envelopes &envelopes;
+  net::auth::AuthentificationContext &user_context;
+  DeserializationError error;
+
+  HttpApi(msg::Envelopes &envelopes, net::auth::AuthentificationContext &user_context)
+      : envelopes(envelopes), user_context(user_context) {}
+
+  bool accepts(const HttpRequest &request) { return request.is_path("/api"); }
+
+  void print_headers(Print &output) {
+    output.print("Server: " SERVER_VERSION "\r\n"
+                 "Keep-Alive: timeout=");
+    output.print(LucidacHttpClient::KEEP_ALIVE_TIMEOUT_MS / 1000);
+    output.print("\r\nAccess-Control-Allow-Origin: ");
+    output.print(net::auth::Gatekeeper::get().access_control_allow_origin.c_str());
+    output.print("\r\n"
+                 "Access-Control-Allow-Credentials: true\r\n"
+                 "Access-Control-Allow-Methods: POST, GET, OPTIONS\r\n"
+                 "Access-Control-Allow-Headers: Origin, Cookie, Set-Cookie, Content-Type, Server\r\n");
+  }
 
-  // the following mimics the function
-  // msg::JsonLinesProtocol::get().process_tcp_input(req, net::auth::AuthentificationContext());
-  // which does not work because it assumes input stream = output sream.
-
-  auto error = deserializeJson(*msg::JsonLinesProtocol().get().envelope_in, req);
-  if (error == DeserializationError::Code::EmptyInput) {
-    res.status(400);
-    res.println("{'type':'error', 'msg':'Empty input. Expecting a Lucidac query in JSON fomat'}");
-  } else if (error) {
-    res.status(400);
-    res.println("{'type':'error', 'msg': 'Error parsing JSON'}");
-    // Serial.println(error.c_str());
-  } else {
-    res.status(200);
-    static net::auth::AuthentificationContext c;
-    msg::JsonLinesProtocol().get().handleMessage(c, res);
-    // serializeJson(msg::JsonLinesProtocol().get().envelope_out->as<JsonObject>(), Serial);
-    // serializeJson(msg::JsonLinesProtocol().get().envelope_out->as<JsonObject>(), res);
+  bool parse(char *data, size_t length) {
+    // Passing a char* selects the zero-copy mode of ArduinoJson
+    error = deserializeJson(envelopes.in, data, length);
+    return !error;
   }
-}
+
+  void reply(Print &output) {
+    if (error == DeserializationError::Code::EmptyInput) {
+      output.print("{'type':'error', 'msg':'Empty input. Expecting a Lucidac query in JSON fomat'}");
+    } else if (error) {
+      output.print("{'type':'error', 'msg': 'Error parsing JSON'}");
+    } else {
+      msg::JsonLinesProtocol::get().handleMessage(envelopes, user_context, output);
+    }
+  }
+};
+
+/**
+ * A copy of a client socket which first yields the bytes the HttpRequestReader read ahead,
+ * such that aWOT gets a request as it was received. Writes go to the socket directly.
+ **/
+class ReplayingClient : public net::EthernetClient {
+  const uint8_t *replay;
+  size_t replay_left;
+
+public:
+  ReplayingClient(const net::EthernetClient &socket, const char *data, size_t length)
+      : net::EthernetClient(socket), replay(reinterpret_cast<const uint8_t *>(data)), replay_left(length) {}
+
+  int available() override { return replay_left + net::EthernetClient::available(); }
+
+  int read() override {
+    if (!replay_left)
+      return net::EthernetClient::read();
+    replay_left--;
+    return *replay++;
+  }
+
+  int read(uint8_t *buffer, size_t size) override {
+    if (!replay_left)
+      return net::EthernetClient::read(buffer, size);
+    size = std::min(size, replay_left);
+    memcpy(buffer, replay, size);
+    replay += size;
+    replay_left -= size;
+    return size;
+  }
+
+  int peek() override { return replay_left ? *replay : net::EthernetClient::peek(); }
+};
 
 #define ERR(msg)                                                                                              \
   {                                                                                                           \
@@ -280,9 +320,7 @@ FLASHMEM void web::LucidacWebServer::begin() {
 
   webapp.get("/", &index);
 
-  webapp.get("/api", &api);
-  webapp.post("/api", &api);
-  webapp.options("/api", &api_preflight);
+  // Requests for /api never reach aWOT, see HttpApi
 
   if (net::StartupConfig::get().enable_websockets) {
     webapp.get("/websocket", &websocket_upgrade);
@@ -314,90 +352,180 @@ FLASHMEM web::LucidacWebsocketsClient::LucidacWebsocketsClient(const net::Ethern
   user_context.set_remote_identifier(net::auth::RemoteIdentifier{socket.remoteIP()});
 }
 
-/*
-  Note that this data handling is *REALLY* not performant, as it requires a websocket message to be completely
-  read into a string, then passed over to the JSON parser which again parses it into its buffer (note that
-  ArduinoJSON is *actually* streamlined for reading things from/to buffers) and then all the way back.
-  However: It works, at least.
-
-  Potential caveat: Users sending really large messages. Check if there is some safety net for that in
-      our websockets library.
-*/
-FLASHMEM void onWebsocketMessageCallback(websockets::WebsocketsClient &wsclient, websockets::WebsocketsMessage msg) {
-  LOGMEV("ws Role=%d, data=%s", msg.role(), msg.data().c_str());
-  if (!msg.isComplete()) {
-    LOG_ALWAYS("webSockets: Ignoring incomplete message");
-    return;
-  }
-  if (!msg.isText()) {
-    LOG_ALWAYS("webSockets: Ignoring non-text message");
-    return;
+// NOT FLASHMEM
+void web::LucidacWebsocketsClient::send_line(bool fin) {
+  using websockets::internals::ContentType;
+  auto payload = reinterpret_cast<const uint8_t *>(line);
+  if (line_state == LineState::Start) {
+    // A line is dropped as a whole if its first frame finds no room
+    line_state = send_queue.send_frame(socket, ContentType::Text, payload, line_length, fin) ? LineState::Sent
+                                                                                          : LineState::Dropped;
+  } else if (line_state == LineState::Sent) {
+    // Once a message is begun, the client needs all of its fragments
+    uint8_t header[websockets::internals::MAX_HEADER_SIZE];
+    auto header_size = websockets::internals::WriteHeader(header, line_length, ContentType::Continuation, fin);
+    if (writeFully(header, header_size) == header_size)
+      writeFully(payload, line_length);
   }
+  if (fin)
+    line_state = LineState::Start;
+  line_length = 0;
+}
 
-  std::string envelope_out_str;
-  msg::JsonLinesProtocol::get().process_string_input(msg.data(), envelope_out_str,
-                                                     wsclient.client()->context->user_context);
-  wsclient.send(envelope_out_str);
+// NOT FLASHMEM
+size_t web::LucidacWebsocketsClient::write(uint8_t b) {
+  line[line_length++] = static_cast<char>(b);
+  if (b == '\n' or line_length == MAX_LINE_LENGTH)
+    send_line(b == '\n');
+  return 1;
 }
 
-FLASHMEM void web::LucidacWebServer::loop() {
-  net::EthernetClient client_socket = ethserver.accept();
+// NOT FLASHMEM
+size_t web::LucidacWebsocketsClient::write(const uint8_t *buffer, size_t size) {
+  // Chunks which are complete messages are framed where they are, see utils::PrintMultiplexer::write_or_drop
+  if (!line_length and line_state == LineState::Start and size) {
+    if (size >= sizeof(daq::binary::MAGIC) and !memcmp(buffer, daq::binary::MAGIC, sizeof(daq::binary::MAGIC))) {
+      send_queue.send_frame(socket, websockets::internals::ContentType::Binary, buffer, size);
+      return size;
+    }
+    if (buffer[size - 1] == '\n') {
+      send_queue.send_frame(socket, websockets::internals::ContentType::Text, buffer, size);
+      return size;
+    }
+  }
+  for (size_t idx = 0; idx < size; idx++)
+    write(buffer[idx]);
+  return size;
+}
 
-  // Warning: This probably allows also to deadlock the device by opening a connection
-  //          but not sending anything.
+// NOT FLASHMEM
+size_t web::LucidacWebsocketsClient::writeFully(const uint8_t *buffer, size_t size) {
+  // Unlike queued broadcasts, these bytes are not dropped, but wait for the client to take the queue.
+  elapsedMillis waiting_ms;
+  while (!send_queue.write(socket, buffer, size)) {
+    if (send_queue.is_broken() or !socket.connected())
+      return 0;
+    if (send_queue.empty())
+      return socket.writeFully(buffer, size); // too large to be queued, but nothing to wait for
+    if (waiting_ms > WRITE_TIMEOUT_MS) {
+      LOG3("webSockets: Closing connection, the client did not take its data for ", WRITE_TIMEOUT_MS, " ms");
+      send_queue.mark_broken();
+      return 0;
+    }
+    yield();
+  }
+  return size;
+}
 
-  if (client_socket) {
-    // incoming new HTTP client.
-    LOG4("Web Client request from ", client_socket.remoteIP(), ":", client_socket.remotePort());
+/// Handles the messages a websocket client sent, see web::process_websocket_input() in web/websocket_api.h
+FLASHMEM void process_websocket_input(LucidacWebsocketsClient &client) {
+  if (auto close_code = web::process_websocket_input(client.socket, client, client.reader, client.user_context))
+    client.ws.close(websockets::GetCloseReason(close_code));
+}
+
+FLASHMEM web::LucidacHttpClient::LucidacHttpClient(const net::EthernetClient &other) : socket(other) {
+  user_context.set_remote_identifier(net::auth::RemoteIdentifier{socket.remoteIP()});
+}
 
+FLASHMEM bool web::LucidacWebServer::process_http_input(LucidacHttpClient &client) {
+  // Without a free envelope, the requests stay on the socket until the next call
+  msg::EnvelopeLease envelopes(msg::JsonLinesProtocol::get().envelopes, msg::EnvelopeKind::Web);
+  if (!envelopes)
+    return true;
+  HttpApi api(*envelopes, client.user_context);
+  auto result =
+      process_http_requests(client.socket, client.reader, msg::JsonLinesProtocol::TCP_INPUT_BUDGET_US, api);
+  if (client.reader.dropped())
+    LOG3("Dropped HTTP batch lines, they are longer than ", LucidacHttpClient::MAX_REQUEST_SIZE, " bytes.");
+  if (result == HttpResult::KeepAlive)
+    return true;
+
+  if (result == HttpResult::Other) {
+    // Anything but the API, like static files and the websocket upgrade, is left to aWOT
+    ReplayingClient replaying_socket(client.socket, client.reader.unread_data(), client.reader.unread_length());
     HTTPContext ctx;
     ctx.server = this;
-    ctx.client = &client_socket;
+    ctx.client = &client.socket;
     ctx.convert_to_websocket = false;
 
-    webapp.process(&client_socket, &ctx);
+    webapp.process(&replaying_socket, &ctx);
 
     if (ctx.convert_to_websocket) {
-      LOG_ALWAYS("Accepting Websocket connection.");
+      accept_websocket(client.socket);
+      return false;
+    }
+  }
+  // aWOT does not support keep-alive, so browsers would wait for more data
+  client.socket.close();
+  return false;
+}
 
-      // we use emplace + a constructor because we have to be super careful about having pointers
-      // referencing to the correct socket.
-      clients.emplace_back(client_socket);
-      auto &client = clients.back();
+FLASHMEM void web::LucidacWebServer::accept_websocket(const net::EthernetClient &socket) {
+  LOG_ALWAYS("Accepting Websocket connection.");
 
-      LOG_ALWAYS("Pushed to clients list.");
+  // we use emplace + a constructor because we have to be super careful about having pointers
+  // referencing to the correct socket.
+  clients.emplace_back(socket);
+  auto &client = clients.back();
 
-      // Don't use masking from server to client (according to RFC)
-      client.ws.setUseMasking(false);
+  LOG_ALWAYS("Pushed to clients list.");
 
-      // register callback for receiving messages.
-      client.ws.onMessage(onWebsocketMessageCallback);
+  // Don't use masking from server to client (according to RFC)
+  client.ws.setUseMasking(false);
 
-      // Send a hello world or so
-      client.ws.send("{'hello':'client'}\n");
+  // Messages are received by process_websocket_input(), not by the callbacks of the websockets library.
 
-      // TODO: Consider adding to JsonLinesProtocol::get().broadcast,
-      //       however would require some callback because message needs to be wrapped
-      //       into websocket protocol.
+  // Send a hello world or so
+  client.ws.send("{'hello':'client'}\n");
 
-      LOG_ALWAYS("Done accepting Websocket connection.");
-    } else {
-      // As we currently do not support keep-alive, we need to close the
-      // connection, otherwise browser wait for more data.
-      client_socket.close();
+  // Receive run data and state changes like the TCP/IP clients
+  msg::JsonLinesProtocol::get().broadcast.add(&client);
+
+  LOG_ALWAYS("Done accepting Websocket connection.");
+}
+
+FLASHMEM void web::LucidacWebServer::loop() {
+  net::EthernetClient client_socket = ethserver.accept();
+
+  if (client_socket) {
+    // incoming new HTTP client.
+    LOG4("Web Client request from ", client_socket.remoteIP(), ":", client_socket.remotePort());
+    if (http_clients.size() == net::StartupConfig::get().max_connections) {
+      LOG3("Closing the oldest persistent HTTP connection because the maximum number of connections (",
+           net::StartupConfig::get().max_connections, ") is reached.");
+      http_clients.front().socket.close();
+      http_clients.pop_front();
+    }
+    http_clients.emplace_back(client_socket);
+  }
+
+  // Requests are answered as far as they arrived, so a client opening a connection without
+  // sending anything does not block the device, but times out.
+  for (auto client = http_clients.begin(); client != http_clients.end();) {
+    bool keep = true;
+    if (client->socket.available() > 0) {
+      client->last_contact.reset();
+      keep = process_http_input(*client);
+    } else if (!client->socket.connected()) {
+      client->socket.close();
+      keep = false;
+    } else if (client->last_contact.expired(LucidacHttpClient::KEEP_ALIVE_TIMEOUT_MS)) {
+      LOG5("Web client ", client->socket.remoteIP(), " timed out after ", LucidacHttpClient::KEEP_ALIVE_TIMEOUT_MS,
+           " ms of idling");
+      client->socket.close();
+      keep = false;
     }
+    client = keep ? std::next(client) : http_clients.erase(client);
   }
 
   // using iterator instead range-based loop because EthernetClient lacks == operator
   // so we use list::erase instead of list::remove.
   for (auto client = clients.begin(); client != clients.end(); client++) {
     const auto client_idx = std::distance(clients.begin(), client);
-    if (client->socket.connected()) {
-      if (client->ws.available()) {
-        // msg::JsonLinesProtocol::get().process_tcp_input(client->socket, client->user_context);
-        // webapp.process(&client->socket);
-        client->ws.poll();
-        // note that actual message handling is done via the onWebsocketMessageCallback.
+    if (client->socket.connected() and !client->send_queue.is_broken()) {
+      client->send_queue.drain(client->socket);
+      if (client->socket.available() > 0) {
+        process_websocket_input(*client);
         client->last_contact.reset();
       } else if (!client->socket.connected()) {
         client->socket.stop();
@@ -410,8 +538,11 @@ FLASHMEM void web::LucidacWebServer::loop() {
       }
     } else {
       LOG5("Websocket Client ", client_idx, ", was ", client->socket.remoteIP(), ", disconnected");
+      if (client->send_queue.get_statistics().dropped_frames)
+        LOG5("Websocket Client ", client_idx, " missed ", client->send_queue.get_statistics().dropped_frames,
+             " frames");
       client->socket.close();
-      // JsonLinesProtocol::get().broadcast.remove(&client->socket);
+      msg::JsonLinesProtocol::get().broadcast.remove(&*client);
       clients.erase(client);
       return; // iterator invalidated, better start loop() freshly.
     }
@@ -8,11 +8,16 @@
 
 #include <ArduinoJson.h>
 #include <list>
+#include <string>
 
 #include "QNEthernet.h"
 #include "net/auth.h"
 #include "net/ethernet.h"
+#include "protocol/protocol.h"
 #include "utils/durations.h"
+#include "web/http_api.h"
+#include "web/message_reader.h"
+#include "web/send_queue.h"
 #include "websockets/client.h"
 #include "utils/singleton.h"
 
@@ -20,13 +25,67 @@ namespace web {
 /**
  * This structure collects all relevant context about a running Websocket
  * connection.
+ *
+ * It is also a target of the JsonLinesProtocol::broadcast, which turns what is printed into frames:
+ * Text is sent line by line, while the chunks of the run data handlers are frames of their own,
+ * binary ones if they start with daq::binary::MAGIC. Everything goes through the send queue, which
+ * drops broadcast frames instead of waiting for a slow client.
+ *
+ * Incoming messages are read into the fixed arena of the reader and parsed from there, so they are
+ * limited to MAX_MESSAGE_SIZE. Larger ones close the connection.
  **/
-struct LucidacWebsocketsClient {
+struct LucidacWebsocketsClient : public Print {
+  //! Text lines are sent in frames of at most this length, longer ones are continued in further frames.
+  static constexpr size_t MAX_LINE_LENGTH = 2048;
+  static constexpr size_t MAX_MESSAGE_SIZE = msg::JsonLinesProtocol::MAX_LINE_LENGTH;
+  //! Time writeFully() waits for a client to take its data, before the connection is given up.
+  static constexpr uint32_t WRITE_TIMEOUT_MS = 2000;
+
   utils::duration last_contact; ///< Tracking lifetime with millis() to time-out a connection.
   net::auth::AuthentificationContext user_context;
   net::EthernetClient socket;
+  WebsocketSendQueue send_queue;
   websockets::WebsocketsClient ws;
+  char line[MAX_LINE_LENGTH]; ///< Text printed since the last newline or the last frame of a long line
+  size_t line_length = 0;
+  //! Whether the frames of the current line were sent or dropped so far, or none was sent yet.
+  enum class LineState : uint8_t { Start, Sent, Dropped } line_state = LineState::Start;
+  WebsocketMessageReader<MAX_MESSAGE_SIZE> reader;
   LucidacWebsocketsClient(const net::EthernetClient &other);
+
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+
+  /**
+   * Sends bytes which must not be dropped, like responses, behind what is queued already.
+   * Waits for room in the send queue, returns less than size if the connection failed.
+   * If the client does not take its data within WRITE_TIMEOUT_MS, the send queue is marked
+   * broken, which closes the connection.
+   **/
+  size_t writeFully(const uint8_t *buffer, size_t size);
+
+protected:
+  /// Sends the collected text as a frame, which ends the message if fin is set.
+  void send_line(bool fin);
+};
+
+/**
+ * A persistent HTTP connection, on which requests for the /api endpoint are answered without aWOT.
+ * Any other request is handed over to aWOT, which closes the connection afterwards or turns it into a
+ * LucidacWebsocketsClient.
+ **/
+struct LucidacHttpClient {
+  //! A JSON envelope and the head of its request
+  static constexpr size_t MAX_REQUEST_SIZE = msg::JsonLinesProtocol::MAX_LINE_LENGTH + 1024;
+  //! Idling persistent connections are closed after this time, see also the Keep-Alive response header.
+  static constexpr uint32_t KEEP_ALIVE_TIMEOUT_MS = 10 * 1000;
+
+  utils::duration last_contact;
+  net::auth::AuthentificationContext user_context;
+  net::EthernetClient socket;
+  HttpRequestReader<MAX_REQUEST_SIZE> reader;
+  LucidacHttpClient(const net::EthernetClient &other);
 };
 
 /**
@@ -46,10 +105,15 @@ struct LucidacWebsocketsClient {
  **/
 struct LucidacWebServer : public utils::HeapSingleton<LucidacWebServer> {
   std::list<LucidacWebsocketsClient> clients;
+  std::list<LucidacHttpClient> http_clients;
   net::EthernetServer ethserver;
 
   void begin();
   void loop();
+
+  /// Handles what an HTTP client sent. Returns false if the connection is done with.
+  bool process_http_input(LucidacHttpClient &client);
+  void accept_websocket(const net::EthernetClient &socket);
 };
 } // namespace web
 
@@ -0,0 +1,81 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h> // elapsedMicros
+
+#include "net/auth.h"
+#include "protocol/protocol.h"
+#include "utils/logging.h"
+#include "web/frame_writer.h"
+#include "web/message_reader.h"
+
+namespace web {
+
+/**
+ * Handles the messages a websocket client sent, like JsonLinesProtocol::process_tcp_input() does for lines.
+ * Each message is parsed in place from the arena of the reader and the response is written into frames
+ * right away, so neither needs a std::string. Pipelined messages are handled within TCP_INPUT_BUDGET_US.
+ *
+ * Messages are read from the socket, while responses and pongs go to the connection, which needs
+ * `writeFully(const uint8_t*, size_t)`, see WebsocketFrameWriter.
+ *
+ * Returns the status code the connection is to be closed with, see RFC 6455, section 7.4, or 0 if it stays open.
+ **/
+template <class Socket, class Connection, size_t SIZE>
+uint16_t process_websocket_input(Socket &socket, Connection &connection, WebsocketMessageReader<SIZE> &reader,
+                                 net::auth::AuthentificationContext &user_context) {
+  using websockets::internals::ContentType;
+  using Result = WebsocketReadResult;
+  auto &protocol = msg::JsonLinesProtocol::get();
+  // Without a free envelope, the messages stay on the socket until the next call
+  msg::EnvelopeLease envelopes(protocol.envelopes, msg::EnvelopeKind::Web);
+  if (!envelopes)
+    return 0;
+
+  elapsedMicros handling_time_us;
+  while (handling_time_us < msg::JsonLinesProtocol::TCP_INPUT_BUDGET_US) {
+    auto result = reader.read(socket);
+    if (result == Result::None) {
+      return 0;
+    } else if (result == Result::Message) {
+      if (reader.message_type() != ContentType::Text) {
+        LOG_ALWAYS("webSockets: Ignoring non-text message");
+        continue;
+      }
+      // Passing a char* selects the zero-copy mode of ArduinoJson
+      auto error = deserializeJson(envelopes->in, reader.data(), reader.length());
+      if (error == DeserializationError::Code::EmptyInput)
+        continue;
+      WebsocketFrameWriter<Connection> output(connection);
+      if (error) {
+        output.print("{'error':'Error while parsing JSON, error message: ");
+        output.print(error.c_str());
+        output.print("'}\n");
+      } else {
+        protocol.handleMessage(*envelopes, user_context, output);
+      }
+      output.send();
+    } else if (result == Result::Ping) {
+      WebsocketFrameWriter<Connection> pong(connection, ContentType::Pong);
+      pong.write(reinterpret_cast<const uint8_t *>(reader.data()), reader.length());
+      pong.send();
+    } else if (result == Result::Close) {
+      return reader.close_code();
+    } else if (result == Result::MessageTooBig) {
+      LOG3("webSockets: Closing connection, message is longer than ", SIZE, " bytes");
+      return 1009; // Message Too Big
+    } else if (result == Result::ProtocolError) {
+      LOG_ALWAYS("webSockets: Closing connection after protocol error");
+      return 1002; // Protocol Error
+    }
+  }
+  return 0;
+}
+
+} // namespace web
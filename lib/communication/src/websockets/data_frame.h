@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+
 #include "websockets/common.h"
 
 namespace websockets { namespace internals {
@@ -71,6 +74,38 @@ namespace websockets { namespace internals {
     return header;
   }
 
+  //! Largest frame header, with a 64 bit extended payload length and a masking key.
+  constexpr size_t MAX_HEADER_SIZE = 2 + 8 + 4;
+
+  /**
+   * Writes a frame header in place, in network byte order, and returns its size.
+   * The masking key follows the payload length if one is given.
+   **/
+  inline size_t WriteHeader(uint8_t *dst, uint64_t len, uint8_t opcode, bool fin,
+                            const char *maskingKey = nullptr) {
+    size_t size = 2;
+    dst[0] = (fin ? 0x80 : 0x00) | (opcode & 0x0F);
+    const uint8_t maskBit = maskingKey ? 0x80 : 0x00;
+    if (len < 126) {
+      dst[1] = maskBit | static_cast<uint8_t>(len);
+    } else if (len < 65536) {
+      dst[1] = maskBit | 126;
+      dst[2] = (len >> 8) & 0xFF;
+      dst[3] = len & 0xFF;
+      size += 2;
+    } else {
+      dst[1] = maskBit | 127;
+      for (size_t i = 0; i < 8; i++)
+        dst[2 + i] = (len >> (56 - 8 * i)) & 0xFF;
+      size += 8;
+    }
+    if (maskingKey) {
+      memcpy(dst + size, maskingKey, 4);
+      size += 4;
+    }
+    return size;
+  }
+
   struct Header {
     uint8_t opcode : 4;
     uint8_t flags : 3;
@@ -355,35 +355,6 @@ bool WebsocketsEndpoint::send(const std::string &data, const uint8_t opcode, con
   return send(data.c_str(), data.size(), opcode, fin, mask, maskingKey);
 }
 
-FLASHMEM
-std::string WebsocketsEndpoint::getHeader(uint64_t len, uint8_t opcode, bool fin, bool mask) {
-  std::string header_data;
-
-  if (len < 126) {
-    auto header = MakeHeader<Header>(len, opcode, fin, mask);
-    header_data = std::string(reinterpret_cast<char *>(&header), 2 + 0);
-  } else if (len < 65536) {
-    auto header = MakeHeader<HeaderWithExtended16>(len, opcode, fin, mask);
-    header.extendedPayload = (len << 8) | (len >> 8);
-    header_data = std::string(reinterpret_cast<char *>(&header), 2 + 2);
-  } else {
-    auto header = MakeHeader<HeaderWithExtended64>(len, opcode, fin, mask);
-    // header.extendedPayload = swapEndianess(len);
-    header.extendedPayload = swapEndianess(len);
-
-    header_data = std::string(reinterpret_cast<char *>(&header), 2);
-    header_data += std::string(reinterpret_cast<char *>(&header.extendedPayload), 8);
-  }
-
-  return header_data;
-}
-
-void remaskData(std::string &data, const char *const maskingKey, size_t first, size_t len) {
-  for (size_t i = first; i < first + len; i++) {
-    data[i] = data[i] ^ maskingKey[i % 4];
-  }
-}
-
 bool WebsocketsEndpoint::send(const char *data, const size_t len, const uint8_t opcode, const bool fin,
                               const bool mask, const char *maskingKey) {
 
@@ -392,22 +363,26 @@ bool WebsocketsEndpoint::send(const char *data, const size_t len, const uint8_t
     return false;
   }
 #endif
-  // send the header
-  std::string message_data = getHeader(len, opcode, fin, mask);
-
-  if (mask) {
-    message_data += std::string(maskingKey, 4);
-  }
-
-  size_t data_start = message_data.size();
-  message_data += std::string(data, len);
+  // The header is written in place and the payload is sent from where it is, without joining them
+  uint8_t header[MAX_HEADER_SIZE];
+  size_t headerSize = WriteHeader(header, len, opcode, fin, mask ? maskingKey : nullptr);
+  if (!this->_client->send(header, headerSize))
+    return false;
 
-  if (mask && memcmp(maskingKey, __TINY_WS_INTERNAL_DEFAULT_MASK, 4) != 0) {
-    remaskData(message_data, maskingKey, data_start, len);
+  if (!mask || memcmp(maskingKey, __TINY_WS_INTERNAL_DEFAULT_MASK, 4) == 0)
+    return len == 0 || this->_client->send(reinterpret_cast<const uint8_t *>(data), len);
+
+  // Only a client masks with a random key, which needs a copy of the payload in small pieces
+  uint8_t masked[64];
+  for (size_t done = 0; done < len;) {
+    size_t chunk = len - done < sizeof(masked) ? len - done : sizeof(masked);
+    for (size_t i = 0; i < chunk; i++)
+      masked[i] = data[done + i] ^ maskingKey[(done + i) % 4];
+    if (!this->_client->send(masked, chunk))
+      return false;
+    done += chunk;
   }
-
-  this->_client->send(message_data);
-  return true; // TODO dont assume success
+  return true;
 }
 
 void WebsocketsEndpoint::close(CloseReason reason) {
@@ -86,8 +86,6 @@ private:
 
   WebsocketsMessage handleFrameInStreamingMode(WebsocketsFrame &frame);
   WebsocketsMessage handleFrameInStandardMode(WebsocketsFrame &frame);
-
-  std::string getHeader(uint64_t len, uint8_t opcode, bool fin, bool mask);
 };
 } // namespace internals
 } // namespace websockets
@@ -9,4 +9,13 @@ using web::LucidacWebsocketsClient;
 websockets::network::TcpClient::TcpClient(LucidacWebsocketsClient *context)
     : context(context), client(&context->socket) {}
 
+bool websockets::network::TcpClient::send(const uint8_t *data, uint32_t len) {
+  if (!client)
+    return false;
+  if (!context)
+    return client->writeFully(data, len) == len;
+  // Frames of the websockets library must not interleave with or overtake the queued ones
+  return context->writeFully(data, len) == len;
+}
+
 #endif // ARDUINO
@@ -17,8 +17,8 @@ using qindesign::network::EthernetServer;
 using web::LucidacWebsocketsClient;
 
 struct TcpClient {
-  LucidacWebsocketsClient *context;
-  EthernetClient *client;
+  LucidacWebsocketsClient *context = nullptr;
+  EthernetClient *client = nullptr;
 
   // Formerly, this was a kind-of-socket
   // TcpClient(EthernetClient* client) : client(client) {}
@@ -38,11 +38,10 @@ struct TcpClient {
     return (bool)client; // Returns whether connected (at least in QNEthernet).
   }
 
-  void send(std::string data) {
-    client && client->writeFully(reinterpret_cast<uint8_t *>(const_cast<char *>(data.c_str())), data.size());
-  }
+  bool send(const std::string &data) { return send(reinterpret_cast<const uint8_t *>(data.data()), data.size()); }
 
-  void send(uint8_t *data, uint32_t len) { client && client->writeFully(data, len); }
+  //! Goes through the send queue of the context, waiting for room in it, see LucidacWebsocketsClient::writeFully.
+  bool send(const uint8_t *data, uint32_t len);
 
   std::string readLine() {
     int val;
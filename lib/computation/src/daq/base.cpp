@@ -27,6 +27,48 @@ FLASHMEM daq::DAQConfig daq::DAQConfig::from_json(JsonObjectConst &&json) {
   auto sample_op_end = json["sample_op_end"];
   if (!sample_op_end.isNull() and sample_op_end.is<bool>())
     daq_config.sample_op_end = sample_op_end;
+  auto data_format = json["data_format"];
+  if (!data_format.isNull() and data_format.is<const char *>())
+    daq_config.data_format = (data_format == "binary") ? DataFormat::BINARY : DataFormat::JSON;
+  auto decimation = json["decimation"];
+  if (!decimation.isNull() and decimation.is<JsonObjectConst>()) {
+    auto mode = decimation["mode"];
+    if (mode == "boxcar")
+      daq_config.decimation_mode = DecimationMode::BOXCAR;
+    else if (mode == "cic")
+      daq_config.decimation_mode = DecimationMode::CIC;
+    else if (mode == "minmax")
+      daq_config.decimation_mode = DecimationMode::MINMAX;
+    auto factor = decimation["factor"];
+    if (!factor.isNull() and factor.is<uint16_t>())
+      daq_config.decimation_factor = factor;
+  }
+  auto trigger = json["trigger"];
+  if (!trigger.isNull() and trigger.is<JsonObjectConst>()) {
+    auto mode = trigger["mode"];
+    if (mode == "above")
+      daq_config.trigger.mode = TriggerMode::ABOVE;
+    else if (mode == "below")
+      daq_config.trigger.mode = TriggerMode::BELOW;
+    else if (mode == "rising")
+      daq_config.trigger.mode = TriggerMode::RISING;
+    else if (mode == "falling")
+      daq_config.trigger.mode = TriggerMode::FALLING;
+    else if (mode == "overload")
+      daq_config.trigger.mode = TriggerMode::OVERLOAD;
+    auto channel = trigger["channel"];
+    if (!channel.isNull() and channel.is<uint8_t>())
+      daq_config.trigger.channel = channel;
+    auto level = trigger["level"];
+    if (!level.isNull() and level.is<float>())
+      daq_config.trigger.level_raw = BaseDAQ::float_to_raw(level);
+    auto pre = trigger["pre"];
+    if (!pre.isNull() and pre.is<uint32_t>())
+      daq_config.trigger.pre = pre;
+    auto post = trigger["post"];
+    if (!post.isNull() and post.is<uint32_t>())
+      daq_config.trigger.post = post;
+  }
   return daq_config;
 }
 
@@ -38,6 +80,14 @@ bool daq::DAQConfig::should_sample_op() const { return sample_op; }
 
 bool daq::DAQConfig::should_sample_op_end() const { return sample_op_end; }
 
+daq::DataFormat daq::DAQConfig::get_data_format() const { return data_format; }
+
+daq::DecimationMode daq::DAQConfig::get_decimation_mode() const { return decimation_mode; }
+
+uint16_t daq::DAQConfig::get_decimation_factor() const { return decimation_factor; }
+
+const daq::TriggerConfig &daq::DAQConfig::get_trigger() const { return trigger; }
+
 FLASHMEM bool daq::DAQConfig::is_valid() const {
   // Total effective samples per seconds is limited due to streaming speed
   if (sample_rate * num_channels > 1'000'000 or sample_rate < 32)
@@ -45,6 +95,13 @@ FLASHMEM bool daq::DAQConfig::is_valid() const {
   // Number of channels must be power-of-two
   if ((num_channels > 0) and ((num_channels & (num_channels - 1)) != 0))
     return false;
+  // The CIC filter works on 32bit integers with a gain of factor^2
+  if (decimation_factor < 1 or (decimation_mode == DecimationMode::CIC and decimation_factor > 256))
+    return false;
+  // Level and edge triggers need a channel which is actually sampled
+  if (trigger.mode != TriggerMode::NONE and trigger.mode != TriggerMode::OVERLOAD and
+      trigger.channel >= num_channels)
+    return false;
   return true;
 }
 
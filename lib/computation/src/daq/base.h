@@ -5,6 +5,7 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
 #include <ArduinoJson.h>
@@ -21,11 +22,37 @@ constexpr unsigned int DEFAULT_SAMPLE_RATE = 400'000;
 
 typedef std::array<float, NUM_CHANNELS> data_vec_t;
 
+/// Wire format of the run_data out-of-band messages, see also daq/binary_frame.h
+enum class DataFormat { JSON, BINARY };
+
+/// On-device data reduction before streaming, see daq/decimation.h
+enum class DecimationMode { NONE, BOXCAR, CIC, MINMAX };
+
+/// Condition which starts a triggered capture, see daq/trigger.h
+enum class TriggerMode { NONE, ABOVE, BELOW, RISING, FALLING, OVERLOAD };
+
+/**
+ * Triggered capture of a streaming run: Only a window of pre samples before and post
+ * samples after (and including) the trigger event is transmitted. The level is given
+ * in machine units and stored as raw ADC value, see BaseDAQ::float_to_raw.
+ **/
+struct TriggerConfig {
+  TriggerMode mode = TriggerMode::NONE;
+  uint8_t channel = 0;
+  uint16_t level_raw = 8192;
+  uint32_t pre = 0;    ///< Number of data vectors before the trigger event
+  uint32_t post = 128; ///< Number of data vectors starting at the trigger event
+};
+
 class DAQConfig {
   uint8_t num_channels = NUM_CHANNELS;
   unsigned int sample_rate = DEFAULT_SAMPLE_RATE;
   bool sample_op = true;
   bool sample_op_end = true;
+  DataFormat data_format = DataFormat::JSON;
+  DecimationMode decimation_mode = DecimationMode::NONE;
+  uint16_t decimation_factor = 1;
+  TriggerConfig trigger;
 
 public:
   DAQConfig() = default;
@@ -35,6 +62,10 @@ public:
   unsigned int get_sample_rate() const;
   bool should_sample_op() const;
   bool should_sample_op_end() const;
+  DataFormat get_data_format() const;
+  DecimationMode get_decimation_mode() const;
+  uint16_t get_decimation_factor() const;
+  const TriggerConfig &get_trigger() const;
 
   bool is_valid() const;
 
@@ -54,6 +85,7 @@ public:
   virtual bool init(unsigned int sample_rate) = 0;
 
   static float raw_to_float(uint16_t raw);
+  static uint16_t float_to_raw(float value);
   static size_t raw_to_normalized(uint16_t raw);
   static const char *raw_to_str(uint16_t raw);
 
@@ -0,0 +1,116 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace daq {
+
+/**
+ * Binary framing for run_data, as an alternative to the JSON run_data messages.
+ *
+ * Each chunk of DAQ data is sent as one frame, consisting of a fixed size header
+ * followed by the packed raw ADC samples. All multi-byte fields are little-endian.
+ *
+ *   offset  size  field
+ *   0       4     MAGIC, "\0RDF". The NUL byte never shows up in a JSON line,
+ *                 which allows clients to tell frames and JSON messages apart.
+ *   4       1     VERSION
+ *   5       1     number of channels (inner count)
+ *   6       2     number of sample vectors (outer count)
+ *   8       4     chunk sequence number, starting at 0 for each run
+ *   12      36    run id (UUID string, not NUL terminated)
+ *   48      ...   outer count * inner count raw samples, uint16 each
+ *
+ * The raw samples are the 14 bit ADC words as found in the DMA buffer and can be
+ * converted with @see daq::BaseDAQ::raw_to_float.
+ **/
+namespace binary {
+
+constexpr char MAGIC[4] = {'\0', 'R', 'D', 'F'};
+constexpr uint8_t VERSION = 1;
+
+constexpr size_t HEADER_IDX_VERSION = 4;
+constexpr size_t HEADER_IDX_CHANNELS = 5;
+constexpr size_t HEADER_IDX_SAMPLES = 6;
+constexpr size_t HEADER_IDX_SEQUENCE = 8;
+constexpr size_t HEADER_IDX_RUN_ID = 12;
+constexpr size_t HEADER_LENGTH_RUN_ID = 32 + 4;
+constexpr size_t HEADER_SIZE = HEADER_IDX_RUN_ID + HEADER_LENGTH_RUN_ID;
+
+struct FrameHeader {
+  uint8_t num_channels;
+  uint16_t num_samples;
+  uint32_t sequence;
+  char run_id[HEADER_LENGTH_RUN_ID];
+};
+
+inline void write_u16(uint8_t *dst, uint16_t value) {
+  dst[0] = value & 0xFF;
+  dst[1] = value >> 8;
+}
+
+inline void write_u32(uint8_t *dst, uint32_t value) {
+  dst[0] = value & 0xFF;
+  dst[1] = (value >> 8) & 0xFF;
+  dst[2] = (value >> 16) & 0xFF;
+  dst[3] = value >> 24;
+}
+
+inline uint16_t read_u16(const uint8_t *src) { return src[0] | (src[1] << 8); }
+
+inline uint32_t read_u32(const uint8_t *src) {
+  return static_cast<uint32_t>(src[0]) | (static_cast<uint32_t>(src[1]) << 8) |
+         (static_cast<uint32_t>(src[2]) << 16) | (static_cast<uint32_t>(src[3]) << 24);
+}
+
+inline constexpr size_t frame_size(size_t outer_count, size_t inner_count) {
+  return HEADER_SIZE + outer_count * inner_count * sizeof(uint16_t);
+}
+
+/// Writes the static part of the header, which does not change between chunks of one run.
+inline void write_header(uint8_t *dst, const char *run_id, uint8_t num_channels) {
+  memcpy(dst, MAGIC, sizeof(MAGIC));
+  dst[HEADER_IDX_VERSION] = VERSION;
+  dst[HEADER_IDX_CHANNELS] = num_channels;
+  memcpy(dst + HEADER_IDX_RUN_ID, run_id, HEADER_LENGTH_RUN_ID);
+}
+
+/// Updates the per-chunk fields of a header previously written with @see write_header.
+inline void update_header(uint8_t *dst, uint16_t num_samples, uint32_t sequence) {
+  write_u16(dst + HEADER_IDX_SAMPLES, num_samples);
+  write_u32(dst + HEADER_IDX_SEQUENCE, sequence);
+}
+
+/**
+ * Packs count raw samples into dst. Works on the 32bit DMA words as well as on
+ * plain uint16_t buffers. Only the lower 16 bits of each word are kept.
+ **/
+template <typename T> inline void encode_samples(uint8_t *dst, T *data, size_t count) {
+  for (size_t i = 0; i < count; i++)
+    write_u16(dst + 2 * i, static_cast<uint16_t>(data[i]));
+}
+
+/// Parses a header, returns false if the buffer does not start with a valid frame header.
+inline bool decode_header(const uint8_t *src, size_t length, FrameHeader &header) {
+  if (length < HEADER_SIZE or memcmp(src, MAGIC, sizeof(MAGIC)) != 0 or src[HEADER_IDX_VERSION] != VERSION)
+    return false;
+  header.num_channels = src[HEADER_IDX_CHANNELS];
+  header.num_samples = read_u16(src + HEADER_IDX_SAMPLES);
+  header.sequence = read_u32(src + HEADER_IDX_SEQUENCE);
+  memcpy(header.run_id, src + HEADER_IDX_RUN_ID, HEADER_LENGTH_RUN_ID);
+  return length >= frame_size(header.num_samples, header.num_channels);
+}
+
+/// Returns the raw sample at index (outer_i * num_channels + inner_i) of a frame.
+inline uint16_t decode_sample(const uint8_t *frame, size_t index) {
+  return read_u16(frame + HEADER_SIZE + 2 * index);
+}
+
+} // namespace binary
+
+} // namespace daq
@@ -0,0 +1,117 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace daq {
+
+/**
+ * Lock-free single-producer/single-consumer ring of equally sized data blocks.
+ *
+ * The producer is the DMA interrupt, which calls publish() whenever the DMA finished
+ * writing one block. The producer can not be stopped or delayed, it always continues
+ * with the next block in the ring. The consumer (the main loop streaming out data)
+ * drains published blocks at its own pace with front() and pop().
+ *
+ * Every block carries a sequence number, which is simply the count of blocks published
+ * before it. A block is lost if the producer laps the consumer, i.e. if it starts to
+ * overwrite the block before (or while) the consumer processes it. This is detected per
+ * block: pop() tells whether the block was still intact after processing it.
+ *
+ * The ring does not own the memory, since for DMA it needs a specific alignment.
+ **/
+template <typename T, size_t NUM_BLOCKS, size_t BLOCK_SIZE> class BlockRing {
+  static_assert(NUM_BLOCKS >= 2, "BlockRing needs at least two blocks");
+  static_assert((NUM_BLOCKS & (NUM_BLOCKS - 1)) == 0, "NUM_BLOCKS must be a power of two");
+
+  T *const storage;
+  std::atomic<uint32_t> head{0}; ///< number of blocks published, only written by the producer
+  uint32_t tail = 0;             ///< number of blocks consumed, only written by the consumer
+  uint32_t lost = 0;             ///< number of blocks the consumer lost to the producer
+  uint32_t high_water = 0;       ///< maximum number of blocks ever waiting for the consumer
+
+public:
+  static constexpr size_t num_blocks = NUM_BLOCKS;
+  static constexpr size_t block_size = BLOCK_SIZE;
+
+  explicit BlockRing(T *storage) : storage(storage) {}
+
+  /// Resets the ring, but keeps the high-water mark. Must not be called while the producer is active.
+  void reset() {
+    head.store(0, std::memory_order_relaxed);
+    tail = 0;
+    lost = 0;
+  }
+
+  // Producer side
+
+  /// Marks the block the producer has been writing to as complete.
+  void publish() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  /// Block the producer is currently writing to (or will write to next).
+  T *producer_block() const { return block(head.load(std::memory_order_acquire)); }
+
+  // Consumer side
+
+  T *block(uint32_t sequence) const { return storage + (sequence % NUM_BLOCKS) * BLOCK_SIZE; }
+
+  /// Number of published but not yet consumed blocks, including lost ones.
+  uint32_t available() const { return head.load(std::memory_order_acquire) - tail; }
+
+  /// Whether the block with the given sequence number has been (partially) overwritten already.
+  bool is_overwritten(uint32_t sequence) const {
+    // The producer is writing into block head, which shares its slot with head - NUM_BLOCKS.
+    return head.load(std::memory_order_acquire) - sequence >= NUM_BLOCKS;
+  }
+
+  /**
+   * Returns the oldest published block which has not been consumed or nullptr if there is none.
+   * Its sequence number is written to sequence.
+   **/
+  T *front(uint32_t &sequence) {
+    auto waiting = available();
+    if (waiting > high_water)
+      high_water = waiting;
+    if (!waiting)
+      return nullptr;
+    sequence = tail;
+    return block(tail);
+  }
+
+  /**
+   * Consumes the block returned by front(). Returns false if the block was overwritten by
+   * the producer before this call, in which case whatever was read from it is garbage.
+   **/
+  bool pop() {
+    // Reading the block must have happened before checking whether the producer got there
+    std::atomic_thread_fence(std::memory_order_acquire);
+    bool intact = !is_overwritten(tail);
+    if (!intact)
+      lost++;
+    tail++;
+    return intact;
+  }
+
+  /// Skips all blocks which are overwritten already, returns the number of blocks skipped.
+  uint32_t skip_overwritten() {
+    uint32_t skipped = 0;
+    while (available() and is_overwritten(tail)) {
+      tail++;
+      skipped++;
+    }
+    lost += skipped;
+    return skipped;
+  }
+
+  uint32_t get_lost() const { return lost; }
+  uint32_t get_high_water() const { return high_water; }
+  uint32_t get_published() const { return head.load(std::memory_order_acquire); }
+  uint32_t get_consumed() const { return tail; }
+};
+
+} // namespace daq
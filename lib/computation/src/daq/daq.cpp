@@ -31,6 +31,17 @@ float daq::BaseDAQ::raw_to_float(const uint16_t raw) {
          1.25f;
 }
 
+uint16_t daq::BaseDAQ::float_to_raw(float value) {
+  // Inverse of raw_to_float, clamped to the ADC range
+  float raw = (1.25f - value) / 2.5f * (RAW_PLUS_ONE_POINT_TWO_FIVE - RAW_MINUS_ONE_POINT_TWO_FIVE) +
+              RAW_MINUS_ONE_POINT_TWO_FIVE;
+  if (raw <= RAW_MINUS_ONE_POINT_TWO_FIVE)
+    return RAW_MINUS_ONE_POINT_TWO_FIVE;
+  if (raw >= RAW_PLUS_ONE_POINT_TWO_FIVE)
+    return RAW_PLUS_ONE_POINT_TWO_FIVE;
+  return static_cast<uint16_t>(raw + 0.5f);
+}
+
 FLASHMEM
 std::array<float, daq::NUM_CHANNELS> daq::BaseDAQ::sample_avg(size_t samples, unsigned int delay_us) {
   utils::RunningAverage<std::array<float, daq::NUM_CHANNELS>> avg;
@@ -101,6 +112,78 @@ std::array<uint16_t, daq::NUM_CHANNELS> daq::OneshotDAQ::sample_avg_raw(size_t s
   return utils::convert<uint16_t>(avg.get_average());
 }
 
+FLASHMEM void daq::DecimatingRunDataHandler::init() { next->init(); }
+
+FLASHMEM void daq::DecimatingRunDataHandler::prepare(run::Run &run) {
+  inner_count = run.daq_config.get_num_channels();
+  decimator = Decimator(run.daq_config.get_decimation_mode(), run.daq_config.get_decimation_factor(),
+                        inner_count);
+  buffered_outer_count = 0;
+  // Round down to full windows, for MINMAX a window yields two vectors
+  capacity_outer_count = dma::BLOCK_SIZE / inner_count;
+  capacity_outer_count -= capacity_outer_count % decimator.outputs_per_window();
+  overflowed = false;
+  next->prepare(run);
+}
+
+// NOT FLASHMEM
+void daq::DecimatingRunDataHandler::pass_on(const run::Run &run) {
+  if (!buffered_outer_count)
+    return;
+  next->handle(buffer.data(), buffered_outer_count, inner_count, run);
+  overflowed |= next->overflowed;
+  buffered_outer_count = 0;
+}
+
+// NOT FLASHMEM
+void daq::DecimatingRunDataHandler::handle(volatile uint32_t *data, size_t outer_count, size_t inner_count,
+                                           const run::Run &run) {
+  size_t offset = 0;
+  while (offset < outer_count) {
+    // Feed at most up to the end of the current window
+    size_t n = std::min(outer_count - offset, decimator.remaining_in_window());
+    buffered_outer_count +=
+        decimator.process(data + offset * inner_count, n, buffer.data() + buffered_outer_count * inner_count);
+    offset += n;
+    if (buffered_outer_count + decimator.outputs_per_window() > capacity_outer_count)
+      pass_on(run);
+  }
+}
+
+FLASHMEM void daq::DecimatingRunDataHandler::stream(volatile uint32_t *buffer, run::Run &run) {}
+
+FLASHMEM void daq::DecimatingRunDataHandler::finish(const run::Run &run) {
+  buffered_outer_count += decimator.flush(buffer.data() + buffered_outer_count * inner_count);
+  pass_on(run);
+  next->finish(run);
+}
+
+FLASHMEM void daq::ReducingRunDataHandler::init() { next->init(); }
+
+FLASHMEM void daq::ReducingRunDataHandler::prepare(run::Run &run) {
+  inner_count = run.daq_config.get_num_channels();
+  reducer = Reducer(mode, inner_count);
+  overflowed = false;
+  next->prepare(run);
+}
+
+// NOT FLASHMEM
+void daq::ReducingRunDataHandler::handle(volatile uint32_t *data, size_t outer_count, size_t inner_count,
+                                         const run::Run &run) {
+  reducer.process(data, outer_count);
+}
+
+FLASHMEM void daq::ReducingRunDataHandler::stream(volatile uint32_t *buffer, run::Run &run) {}
+
+FLASHMEM void daq::ReducingRunDataHandler::finish(const run::Run &run) {
+  auto outer_count = reducer.result(buffer.data());
+  if (outer_count) {
+    next->handle(buffer.data(), outer_count, inner_count, run);
+    overflowed |= next->overflowed;
+  }
+  next->finish(run);
+}
+
 #ifdef ARDUINO
 
 namespace daq {
@@ -112,28 +195,25 @@ namespace dma {
 // The DMA implements ring buffer by restricting the N lower bits of the destination address to change.
 // That means the memory segment must start at a memory address with enough lower bits being zero,
 // see manual "data queues [with] power-of-2 size bytes, [...] should start at a 0-modulo-size address".
-// One can put this into DMAMEM for increased performance, but that did not work for me right away.
-// *MUST* be at least 2*NUM_CHANNELS, otherwise some math later does not work.
-__attribute__((aligned(BUFFER_SIZE * 4))) std::array<volatile uint32_t, BUFFER_SIZE> buffer = {0};
+// *MUST* consist of at least two blocks, otherwise some math later does not work.
+// The buffer lives in DMAMEM (OCRAM), which leaves the tightly coupled memory to the code and is
+// large enough for tens of kilobytes. In contrast to the TCM, it is cached by the CPU, so each block
+// has to be invalidated in the data cache before reading what the DMA wrote, see ContinuousDAQ::stream.
+// DMAMEM is not initialized at startup, FlexIODAQ::reset takes care of this.
+DMAMEM __attribute__((aligned(BUFFER_SIZE * 4))) std::array<volatile uint32_t, BUFFER_SIZE> buffer;
+
+// The DMA interrupt publishes each completed block into this ring, which is drained by ContinuousDAQ::stream.
+BlockRing<volatile uint32_t, NUM_BLOCKS, BLOCK_SIZE> ring{buffer.data()};
 
 DMAChannel channel(false);
 run::Run *run = nullptr;
 run::RunDataHandler *run_data_handler = nullptr;
-volatile bool first_data = false;
-volatile bool last_data = false;
-volatile bool overflow_data = false;
 
 // NOT FLASHMEM
 void interrupt() {
   // Serial.println(__PRETTY_FUNCTION__);
-  auto is_half = (channel.TCD->CITER != channel.TCD->BITER);
-  if (is_half) {
-    overflow_data |= first_data;
-    first_data = true;
-  } else {
-    overflow_data |= last_data;
-    last_data = true;
-  }
+  // One major loop is exactly one block
+  ring.publish();
 
   // Clear interrupt
   channel.clearInterrupt();
@@ -143,10 +223,103 @@ void interrupt() {
 #endif
 }
 
-std::array<volatile uint32_t, BUFFER_SIZE> get_buffer() { return buffer; }
+volatile uint32_t *get_buffer() { return buffer.data(); }
+
+FLASHMEM void to_json(JsonObject target) {
+  target["buffer_bytes"] = BUFFER_SIZE * sizeof(uint32_t);
+  target["block_bytes"] = BLOCK_SIZE * sizeof(uint32_t);
+  target["high_water_blocks"] = ring.get_high_water();
+  target["high_water_bytes"] = ring.get_high_water() * BLOCK_SIZE * sizeof(uint32_t);
+}
+
+/// Drops whatever the data cache holds for this part of the buffer, so the next read sees what the DMA wrote.
+inline void invalidate_cache(volatile uint32_t *block, size_t words) {
+  arm_dcache_delete(const_cast<uint32_t *>(block), words * sizeof(uint32_t));
+}
 
 } // namespace dma
 
+FLASHMEM void TriggeredRunDataHandler::init() { next->init(); }
+
+FLASHMEM void TriggeredRunDataHandler::prepare(run::Run &run) {
+  inner_count = run.daq_config.get_num_channels();
+  // The block being streamed out and the one the DMA writes to can not serve as history
+  capture = TriggerCapture(run.daq_config.get_trigger(), inner_count, dma::get_buffer(), dma::BUFFER_SIZE,
+                           2 * dma::BLOCK_SIZE / inner_count);
+  if (capture.get_pre() < run.daq_config.get_trigger().pre)
+    LOGMEV("Pre-trigger window limited to %u by the DMA buffer size.", capture.get_pre());
+  buffered_outer_count = 0;
+  capacity_outer_count = dma::BLOCK_SIZE / inner_count;
+  overflowed = false;
+  next->prepare(run);
+}
+
+// NOT FLASHMEM
+void TriggeredRunDataHandler::pass_on(const run::Run &run) {
+  if (!buffered_outer_count)
+    return;
+  next->handle(buffer.data(), buffered_outer_count, inner_count, run);
+  overflowed |= next->overflowed;
+  buffered_outer_count = 0;
+}
+
+// NOT FLASHMEM
+void TriggeredRunDataHandler::append(const volatile uint32_t *data, size_t outer_count, const run::Run &run) {
+  while (outer_count) {
+    size_t n = std::min(outer_count, capacity_outer_count - buffered_outer_count);
+    std::copy(data, data + n * inner_count, buffer.data() + buffered_outer_count * inner_count);
+    buffered_outer_count += n;
+    data += n * inner_count;
+    outer_count -= n;
+    if (buffered_outer_count == capacity_outer_count)
+      pass_on(run);
+  }
+}
+
+// NOT FLASHMEM
+void TriggeredRunDataHandler::handle(volatile uint32_t *data, size_t outer_count, size_t inner_count,
+                                     const run::Run &run) {
+  if (capture.get_state() == TriggerCapture::State::DONE)
+    return;
+  bool armed = capture.get_state() == TriggerCapture::State::ARMED;
+
+  // The blocks before this one are history as long as the DMA did not get to them again,
+  // except for the oldest one, which it writes to next
+  const uint32_t sequence = dma::ring.get_consumed(), published = dma::ring.get_published();
+  const uint32_t oldest_intact = published + 2 > dma::NUM_BLOCKS ? published + 2 - dma::NUM_BLOCKS : 0;
+  const size_t intact_history =
+      sequence > oldest_intact ? (sequence - oldest_intact) * (dma::BLOCK_SIZE / this->inner_count) : 0;
+
+  bool history_overwritten = false;
+  capture.feed(
+      data, outer_count, mode::is_global_overload_active(),
+      [&](const volatile uint32_t *segment, size_t segment_outer_count) {
+        append(segment, segment_outer_count, run);
+        // The DMA may have gotten to a block of history while it was copied
+        uint32_t slot = (segment - dma::get_buffer()) / dma::BLOCK_SIZE;
+        uint32_t age = (sequence + dma::NUM_BLOCKS - slot) % dma::NUM_BLOCKS;
+        history_overwritten |= age and dma::ring.is_overwritten(sequence - age);
+      },
+      intact_history);
+
+  if (armed and capture.is_history_lost())
+    LOG_ALWAYS("Pre-trigger window cut short, DMA blocks of its history were overwritten already.");
+  if (history_overwritten) {
+    LOG_ALWAYS("Pre-trigger history was overwritten by the DMA while copying it, the run is marked overflowed.");
+    overflowed = true;
+  }
+  // Send out the complete window right away instead of waiting for the end of the run
+  if (capture.get_state() == TriggerCapture::State::DONE)
+    pass_on(run);
+}
+
+FLASHMEM void TriggeredRunDataHandler::stream(volatile uint32_t *buffer, run::Run &run) {}
+
+FLASHMEM void TriggeredRunDataHandler::finish(const run::Run &run) {
+  pass_on(run);
+  next->finish(run);
+}
+
 ContinuousDAQ::ContinuousDAQ(run::Run &run, const daq::DAQConfig &daq_config,
                              run::RunDataHandler *run_data_handler)
     : run(run), daq_config(daq_config), run_data_handler(run_data_handler) {}
@@ -158,51 +331,39 @@ unsigned int ContinuousDAQ::get_number_of_data_vectors_in_buffer() {
 
 // NOT FLASHMEM
 bool ContinuousDAQ::stream(bool partial) {
-  // Pointer to the part of the buffer which (may) contain partial data at end of acquisition time
-  static auto partial_buffer_part = dma::buffer.data();
-
   if (!daq_config)
     return true;
-  if (dma::overflow_data)
-    return false;
 
-  // Default values for streaming
-  volatile uint32_t *active_buffer_part;
-  size_t outer_count = dma::BUFFER_SIZE / daq_config.get_num_channels() / 2;
-
-  // Change streaming parameters depending on whether the first or second half of buffer is streamed
-  if (dma::first_data) {
-    active_buffer_part = dma::buffer.data();
-    partial_buffer_part = dma::buffer.data() + dma::BUFFER_SIZE / 2;
-    dma::first_data = false;
-  } else if (dma::last_data) {
-    active_buffer_part = dma::buffer.data() + dma::BUFFER_SIZE / 2;
-    partial_buffer_part = dma::buffer.data();
-    dma::last_data = false;
-  } else if (partial) {
-    // Stream the remaining partially filled part of the buffer.
-    // This should be done exactly once, after the data acquisition stopped.
-    active_buffer_part = partial_buffer_part;
-    if (partial_buffer_part == dma::buffer.data())
-      // If we have streamed out the second part the last time,
-      // the partial data is in the first part of the buffer
-      // and get_number_of_data_vectors_in_buffer returns only
-      // the number of partial data vectors to stream.
-      outer_count = get_number_of_data_vectors_in_buffer();
-    else
-      // If we have streamed out the first part the last time,
-      // the partial data is in the second half,
-      // and get_number_of_data_vectors_in_buffer does not consider this
-      // and returns number of vectors in first_half plus number of partials
-      // in second half, and we have to subtract the number in the first half.
-      outer_count = get_number_of_data_vectors_in_buffer() - outer_count;
-    if (!outer_count) {
-      return true;
+  const size_t outer_count = dma::BLOCK_SIZE / daq_config.get_num_channels();
+
+  // Drain all completed blocks, we may be late by up to NUM_BLOCKS-1 blocks.
+  uint32_t sequence;
+  while (auto block = dma::ring.front(sequence)) {
+    if (dma::ring.is_overwritten(sequence)) {
+      LOGMEV("DMA block %u was overwritten before streaming it out.", sequence);
+      dma::ring.skip_overwritten();
+      return false;
     }
-  } else
-    return true;
+    dma::invalidate_cache(block, dma::BLOCK_SIZE);
+    run_data_handler->handle(block, outer_count, daq_config.get_num_channels(), run);
+    // The handler may take long enough for the DMA to catch up with the block it was reading
+    if (!dma::ring.pop()) {
+      LOGMEV("DMA block %u was overwritten while streaming it out.", sequence);
+      return false;
+    }
+  }
 
-  run_data_handler->handle(active_buffer_part, outer_count, daq_config.get_num_channels(), run);
+  if (partial) {
+    // Stream the remaining partially filled block.
+    // This should be done exactly once, after the data acquisition stopped.
+    auto partial_outer_count = get_number_of_partial_data_vectors();
+    if (partial_outer_count) {
+      auto block = dma::ring.producer_block();
+      dma::invalidate_cache(block, dma::BLOCK_SIZE);
+      run_data_handler->handle(block, partial_outer_count, daq_config.get_num_channels(), run);
+    }
+    run_data_handler->finish(run);
+  }
   return true;
 }
 
@@ -221,6 +382,8 @@ daq::FlexIODAQ::FlexIODAQ(run::Run &run, DAQConfig &daq_config, run::RunDataHand
 // NOT FLASHMEM
 bool daq::FlexIODAQ::init(unsigned int) {
   LOG_ANABRID_DEBUG_DAQ(__PRETTY_FUNCTION__);
+  if (!daq_config)
+    return true;
   if (!daq_config.is_valid()) {
     LOG_ERROR("Invalid DAQ config.")
     return false;
@@ -332,10 +495,12 @@ bool daq::FlexIODAQ::init(unsigned int) {
 
   // BITER "beginning iteration count" is the number of major loops.
   // Each major loop fills part (see TCD->NBYTES) of the ring buffer.
-  dma::channel.TCD->BITER = dma::buffer.size() / daq_config.get_num_channels();
+  // We let one full major iteration fill one block of the ring buffer, so the completion interrupt
+  // can publish it, while the destination address just carries on into the next block.
+  dma::channel.TCD->BITER = dma::BLOCK_SIZE / daq_config.get_num_channels();
   // CITER "current major loop iteration count" is the current number of major loops left to perform.
-  // It can be used to check progress of the process. It's reset to BITER whe we filled the buffer once.
-  dma::channel.TCD->CITER = dma::buffer.size() / daq_config.get_num_channels();
+  // It can be used to check progress of the process. It's reset to BITER when we filled one block.
+  dma::channel.TCD->CITER = dma::BLOCK_SIZE / daq_config.get_num_channels();
 
   // Configure source address and its adjustments.
   // We want to circularly copy from SHIFTBUFBIS.
@@ -392,7 +557,6 @@ bool daq::FlexIODAQ::init(unsigned int) {
   // Call an interrupt when done
   dma::channel.attachInterrupt(dma::interrupt);
   dma::channel.interruptAtCompletion();
-  dma::channel.interruptAtHalf();
   // Trigger from "shifter full" DMA event
   dma::channel.triggerAtHardwareEvent(flexio->shiftersDMAChannel(shifter_dma_idx));
   // Enable dma channel
@@ -428,7 +592,9 @@ void daq::FlexIODAQ::reset() {
   // TODO: REMOVE!
   for (auto &data : dma::buffer)
     data = 0;
-  dma::first_data = dma::last_data = dma::overflow_data = false;
+  // Write the zeros back now, a dirty cache line evicted later would overwrite DMA data
+  arm_dcache_flush_delete(const_cast<uint32_t *>(dma::buffer.data()), sizeof(dma::buffer));
+  dma::ring.reset();
 }
 
 bool daq::FlexIODAQ::finalize() {
@@ -462,14 +628,111 @@ bool daq::FlexIODAQ::finalize() {
     LOG_ERROR("DAQ SHIFTERR error.");
     return false;
   }
-  if (dma::overflow_data) {
-    LOG_ERROR("DAQ overflow.");
+  if (dma::ring.get_lost()) {
+    LOGMEV("DAQ overflow, lost %u of %u blocks.", dma::ring.get_lost(), dma::ring.get_published());
     return false;
   }
 
   return true;
 }
 
+namespace daq {
+
+namespace timer {
+
+IntervalTimer interval_timer;
+OneshotDAQ *oneshot = nullptr;
+uint8_t num_channels = 0;
+size_t block_outer_count = 0;
+/// Number of data vectors already written to the block the interrupt currently writes to
+volatile size_t position = 0;
+
+// NOT FLASHMEM
+void interrupt() {
+  std::array<uint16_t, NUM_CHANNELS> data;
+  oneshot->sample_raw(data.data());
+  auto block = dma::ring.producer_block();
+  auto dst = block + position * num_channels;
+  for (size_t i = 0; i < num_channels; i++)
+    dst[i] = data[i];
+  if (++position == block_outer_count) {
+    // ContinuousDAQ::stream invalidates the cache before reading a block, which would
+    // throw away what the CPU wrote here. Write it back before publishing the block.
+    arm_dcache_flush(const_cast<uint32_t *>(block), dma::BLOCK_SIZE * sizeof(uint32_t));
+    position = 0;
+    dma::ring.publish();
+  }
+}
+
+} // namespace timer
+
+FLASHMEM TimerDAQ::TimerDAQ(run::Run &run, const DAQConfig &daq_config, run::RunDataHandler *run_data_handler)
+    : ContinuousDAQ(run, daq_config, run_data_handler) {}
+
+FLASHMEM bool TimerDAQ::init(unsigned int) {
+  LOG_ANABRID_DEBUG_DAQ(__PRETTY_FUNCTION__);
+  if (!daq_config)
+    return true;
+  if (!daq_config.is_valid()) {
+    LOG_ERROR("Invalid DAQ config.")
+    return false;
+  }
+  oneshot.init(0);
+
+  // Measure how long a single capture takes, which is right now around 15us.
+  // The interrupt should not take more than half of the CPU time, so streaming can keep up.
+  elapsedMicros capture_time_us;
+  oneshot.sample_raw();
+  max_sample_rate = 1'000'000 / (2 * std::max<unsigned int>(capture_time_us, 1));
+  sample_rate = std::min(daq_config.get_sample_rate(), max_sample_rate);
+  if (sample_rate < daq_config.get_sample_rate())
+    LOGMEV("Sample rate limited to %u/s for runs without streaming.", sample_rate);
+
+  timer::oneshot = &oneshot;
+  timer::num_channels = daq_config.get_num_channels();
+  timer::block_outer_count = dma::BLOCK_SIZE / daq_config.get_num_channels();
+  timer::position = 0;
+  dma::ring.reset();
+  return true;
+}
+
+FLASHMEM bool TimerDAQ::enable() {
+  if (!daq_config)
+    return true;
+  // Sampling should happen at exactly the requested times, independent of other interrupts
+  timer::interval_timer.priority(32);
+  return timer::interval_timer.begin(timer::interrupt, 1'000'000.0f / sample_rate);
+}
+
+FLASHMEM void TimerDAQ::disable() {
+  if (!daq_config)
+    return;
+  timer::interval_timer.end();
+  // Write back the partial block, see timer::interrupt
+  arm_dcache_flush(const_cast<uint32_t *>(dma::ring.producer_block()), dma::BLOCK_SIZE * sizeof(uint32_t));
+}
+
+FLASHMEM bool TimerDAQ::finalize() {
+  timer::oneshot = nullptr;
+  if (!daq_config)
+    return true;
+  if (dma::ring.get_lost()) {
+    LOGMEV("DAQ overflow, lost %u of %u blocks.", dma::ring.get_lost(), dma::ring.get_published());
+    return false;
+  }
+  return true;
+}
+
+unsigned int TimerDAQ::get_number_of_partial_data_vectors() { return timer::position; }
+
+std::array<uint16_t, NUM_CHANNELS> TimerDAQ::sample_raw() { return oneshot.sample_raw(); }
+
+std::array<float, NUM_CHANNELS> TimerDAQ::sample() { return oneshot.sample(); }
+
+float TimerDAQ::sample(uint8_t index) { return oneshot.sample(index); }
+
+} // namespace daq
+
 #endif
 
 FLASHMEM int daq::OneshotDAQ::sample(JsonObjectConst msg_in, JsonObject &msg_out) {
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 
 #include <ArduinoJson.h>
@@ -11,9 +12,14 @@
 #ifdef ARDUINO
 #include <DMAChannel.h>
 #include <FlexIO_t4.h>
+#include <IntervalTimer.h>
 #endif
 
 #include "daq/base.h"
+#include "daq/block_ring.h"
+#include "daq/decimation.h"
+#include "daq/reduction.h"
+#include "daq/trigger.h"
 #include "run/run.h"
 
 /// @brief Routines for Data Aquisition (DAQ) / Analog2Digital converters (ADCs)
@@ -21,10 +27,36 @@ namespace daq {
 
 namespace dma {
 
+#ifndef ANABRID_DAQ_DMA_BUFFER_KB
+#define ANABRID_DAQ_DMA_BUFFER_KB 16
+#endif
+
+// The DMA buffer is a ring of NUM_BLOCKS blocks, see BlockRing.
+// Each block of BLOCK_SIZE words is handed to the RunDataHandler as one chunk,
+// after the DMA finished writing it.
+constexpr size_t BLOCK_SIZE = 16 * NUM_CHANNELS;
 // BUFFER_SIZE *must* be a power-of-two number of bytes
-constexpr size_t BUFFER_SIZE = 32 * NUM_CHANNELS;
+constexpr size_t BUFFER_SIZE = ANABRID_DAQ_DMA_BUFFER_KB * 1024 / sizeof(uint32_t);
+constexpr size_t NUM_BLOCKS = BUFFER_SIZE / BLOCK_SIZE;
+
+static_assert((BUFFER_SIZE & (BUFFER_SIZE - 1)) == 0, "ANABRID_DAQ_DMA_BUFFER_KB must be a power of two");
+static_assert(NUM_BLOCKS >= 2, "ANABRID_DAQ_DMA_BUFFER_KB is too small for two blocks");
+
+volatile uint32_t *get_buffer();
+
+/**
+ * Time the DMA takes to fill all but one block of the ring buffer at the sample rate of daq_config.
+ * This is how long the main loop may be busy between two calls of ContinuousDAQ::stream.
+ **/
+inline uint32_t get_headroom_us(const DAQConfig &daq_config) {
+  if (!daq_config or !daq_config.get_sample_rate())
+    return UINT32_MAX;
+  const uint64_t data_vectors = (NUM_BLOCKS - 1) * (BLOCK_SIZE / daq_config.get_num_channels());
+  return std::min<uint64_t>(data_vectors * 1'000'000 / daq_config.get_sample_rate(), UINT32_MAX);
+}
 
-std::array<volatile uint32_t, BUFFER_SIZE> get_buffer();
+/// Writes buffer size and usage (high-water mark) of the DMA ring buffer.
+void to_json(JsonObject target);
 
 } // namespace dma
 
@@ -37,11 +69,91 @@ protected:
 public:
   ContinuousDAQ(run::Run &run, const DAQConfig &daq_config, run::RunDataHandler *run_data_handler);
 
+  /// Number of data vectors in the block the DMA currently writes to
   static unsigned int get_number_of_data_vectors_in_buffer();
 
+  /// Number of data vectors in the partially filled block streamed out at the end
+  virtual unsigned int get_number_of_partial_data_vectors() { return get_number_of_data_vectors_in_buffer(); }
+
   bool stream(bool partial = false);
 };
 
+/**
+ * Pipeline stage between the ContinuousDAQ and the actual RunDataHandler, which reduces
+ * the data according to the run's DAQConfig decimation settings (see Decimator).
+ * The reduced data is collected into chunks of up to one DMA block and then passed on,
+ * so the next handler sees the same kind of chunks as without decimation.
+ **/
+class DecimatingRunDataHandler : public run::RunDataHandler {
+  run::RunDataHandler *next;
+  Decimator decimator;
+  std::array<uint32_t, dma::BLOCK_SIZE> buffer{};
+  size_t buffered_outer_count = 0;
+  size_t capacity_outer_count = 0;
+  uint8_t inner_count = NUM_CHANNELS;
+
+  void pass_on(const run::Run &run);
+
+public:
+  explicit DecimatingRunDataHandler(run::RunDataHandler *next) : next(next) {}
+
+  void init() override;
+  void prepare(run::Run &run) override;
+  void handle(volatile uint32_t *data, size_t outer_count, size_t inner_count, const run::Run &run) override;
+  void stream(volatile uint32_t *buffer, run::Run &run) override;
+  void finish(const run::Run &run) override;
+};
+
+/**
+ * Pipeline stage which reduces all data of a run to a few vectors (see Reducer),
+ * which are passed on as a single chunk when the run is finished.
+ **/
+class ReducingRunDataHandler : public run::RunDataHandler {
+  run::RunDataHandler *next;
+  Reducer reducer;
+  ReductionMode mode;
+  std::array<uint32_t, 2 * NUM_CHANNELS> buffer{};
+  uint8_t inner_count = NUM_CHANNELS;
+
+public:
+  ReducingRunDataHandler(ReductionMode mode, run::RunDataHandler *next) : next(next), mode(mode) {}
+
+  void init() override;
+  void prepare(run::Run &run) override;
+  void handle(volatile uint32_t *data, size_t outer_count, size_t inner_count, const run::Run &run) override;
+  void stream(volatile uint32_t *buffer, run::Run &run) override;
+  void finish(const run::Run &run) override;
+};
+
+/**
+ * Pipeline stage for triggered captures, see TriggerCapture. Uses the DMA ring buffer
+ * as pre-trigger history, so the pre window is limited by its size. Only the pre/post
+ * window around the trigger event is passed on, in chunks of up to one DMA block.
+ *
+ * The overload line is checked whenever a chunk is handled, so an OVERLOAD trigger
+ * fires at the beginning of the chunk streamed out right after the overload happened.
+ **/
+class TriggeredRunDataHandler : public run::RunDataHandler {
+  run::RunDataHandler *next;
+  TriggerCapture capture;
+  std::array<uint32_t, dma::BLOCK_SIZE> buffer{};
+  size_t buffered_outer_count = 0;
+  size_t capacity_outer_count = 0;
+  uint8_t inner_count = NUM_CHANNELS;
+
+  void append(const volatile uint32_t *data, size_t outer_count, const run::Run &run);
+  void pass_on(const run::Run &run);
+
+public:
+  explicit TriggeredRunDataHandler(run::RunDataHandler *next) : next(next) {}
+
+  void init() override;
+  void prepare(run::Run &run) override;
+  void handle(volatile uint32_t *data, size_t outer_count, size_t inner_count, const run::Run &run) override;
+  void stream(volatile uint32_t *buffer, run::Run &run) override;
+  void finish(const run::Run &run) override;
+};
+
 class FlexIODAQ : public ContinuousDAQ {
 private:
   FlexIOHandler *flexio;
@@ -89,4 +201,40 @@ public:
   int sample(JsonObjectConst msg_in, JsonObject &msg_out);
 };
 
+/**
+ * Timer driven data acquisition for traditional (non-FlexIO) runs.
+ *
+ * A periodic timer interrupt (PIT, via Teensy's IntervalTimer) captures all channels
+ * with the OneshotDAQ routine and writes the data vectors into the same block ring the
+ * DMA uses, publishing each block when it is full. Thus the sample timing does not depend
+ * on what the main loop does, and the data is streamed out by ContinuousDAQ::stream while
+ * the run is going on, without any limit on the number of samples.
+ *
+ * Since one capture takes about 15usec, the sample rate is limited such that the
+ * interrupt takes at most half of the CPU time, see get_max_sample_rate.
+ **/
+class TimerDAQ : public ContinuousDAQ {
+  OneshotDAQ oneshot;
+  unsigned int sample_rate = 0;
+  unsigned int max_sample_rate = 0;
+
+public:
+  TimerDAQ(run::Run &run, const DAQConfig &daq_config, run::RunDataHandler *run_data_handler);
+
+  bool init(unsigned int) override;
+  /// Starts the periodic sampling
+  bool enable();
+  /// Stops the periodic sampling, the remaining partial block can be streamed out afterwards
+  void disable();
+  bool finalize();
+
+  unsigned int get_sample_rate() const { return sample_rate; }
+  unsigned int get_max_sample_rate() const { return max_sample_rate; }
+  unsigned int get_number_of_partial_data_vectors() override;
+
+  std::array<uint16_t, NUM_CHANNELS> sample_raw() override;
+  std::array<float, NUM_CHANNELS> sample() override;
+  float sample(uint8_t index) override;
+};
+
 } // namespace daq
@@ -0,0 +1,114 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "daq/decimation.h"
+
+#include <Arduino.h>
+
+FLASHMEM daq::Decimator::Decimator(DecimationMode mode, uint16_t factor, uint8_t num_channels)
+    : mode(mode), factor(mode == DecimationMode::NONE ? 1 : factor), num_channels(num_channels) {
+  reset();
+}
+
+FLASHMEM void daq::Decimator::reset() {
+  sum.fill(0);
+  integral.fill(0);
+  comb1.fill(0);
+  comb2.fill(0);
+  start_window();
+}
+
+// NOT FLASHMEM
+void daq::Decimator::start_window() {
+  count = 0;
+  switch (mode) {
+  case DecimationMode::NONE:
+  case DecimationMode::BOXCAR:
+    sum.fill(0);
+    break;
+  case DecimationMode::MINMAX:
+    min.fill(UINT16_MAX);
+    max.fill(0);
+    break;
+  case DecimationMode::CIC:
+    // Integrators run continuously
+    break;
+  }
+}
+
+// NOT FLASHMEM
+size_t daq::Decimator::process(const volatile uint32_t *in, size_t outer_count, uint32_t *out) {
+  const size_t nc = num_channels;
+  switch (mode) {
+  case DecimationMode::NONE:
+  case DecimationMode::BOXCAR:
+    for (size_t i = 0; i < outer_count; i++)
+      for (size_t c = 0; c < nc; c++)
+        sum[c] += in[i * nc + c] & 0xFFFF;
+    break;
+  case DecimationMode::CIC:
+    // Arithmetic is modulo 2^32, which is fine for CIC filters as long as the output fits.
+    for (size_t i = 0; i < outer_count; i++)
+      for (size_t c = 0; c < nc; c++) {
+        sum[c] += in[i * nc + c] & 0xFFFF;
+        integral[c] += sum[c];
+      }
+    break;
+  case DecimationMode::MINMAX:
+    for (size_t i = 0; i < outer_count; i++)
+      for (size_t c = 0; c < nc; c++) {
+        uint16_t x = in[i * nc + c] & 0xFFFF;
+        if (x < min[c])
+          min[c] = x;
+        if (x > max[c])
+          max[c] = x;
+      }
+    break;
+  }
+
+  count += outer_count;
+  if (count < factor)
+    return 0;
+  write_window(out, factor);
+  start_window();
+  return outputs_per_window();
+}
+
+// NOT FLASHMEM
+void daq::Decimator::write_window(uint32_t *out, uint16_t window_length) {
+  const size_t nc = num_channels;
+  switch (mode) {
+  case DecimationMode::NONE:
+  case DecimationMode::BOXCAR:
+    for (size_t c = 0; c < nc; c++)
+      out[c] = (sum[c] + window_length / 2) / window_length;
+    break;
+  case DecimationMode::CIC: {
+    const uint32_t gain = static_cast<uint32_t>(window_length) * window_length;
+    for (size_t c = 0; c < nc; c++) {
+      uint32_t y = integral[c] - comb1[c];
+      comb1[c] = integral[c];
+      uint32_t z = y - comb2[c];
+      comb2[c] = y;
+      out[c] = (z + gain / 2) / gain;
+    }
+    break;
+  }
+  case DecimationMode::MINMAX:
+    for (size_t c = 0; c < nc; c++) {
+      out[c] = min[c];
+      out[nc + c] = max[c];
+    }
+    break;
+  }
+}
+
+// NOT FLASHMEM
+size_t daq::Decimator::flush(uint32_t *out) {
+  if (!count or mode == DecimationMode::CIC)
+    return 0;
+  write_window(out, count);
+  start_window();
+  return outputs_per_window();
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "daq/base.h"
+
+namespace daq {
+
+/**
+ * Integer-only decimation kernels, which reduce the raw ADC data by a factor N
+ * before it is streamed out. The input are the raw DMA words, of which only the
+ * lower 16 bits are used. The output are raw samples again, so they can be
+ * handled exactly like non-decimated data (e.g. by BaseDAQ::raw_to_float).
+ *
+ * Supported modes:
+ *
+ * - BOXCAR: One vector per window of N input vectors, the rounded mean of the window.
+ * - CIC: One vector per window, output of a second order cascaded integrator-comb filter,
+ *   normalized by its gain N^2. It has a better anti-aliasing than the boxcar, at the price
+ *   of a transient response for the first two windows. The factor is limited to 256.
+ * - MINMAX: Two vectors per window, first the minimum and then the maximum of each channel
+ *   within the window. This is the envelope of the signal, as displayed by an oscilloscope.
+ *
+ * Input is processed window by window, see remaining_in_window().
+ **/
+class Decimator {
+  DecimationMode mode = DecimationMode::NONE;
+  uint16_t factor = 1;
+  uint8_t num_channels = NUM_CHANNELS;
+  uint16_t count = 0; ///< Number of input vectors in the current window
+
+  std::array<uint32_t, NUM_CHANNELS> sum{};      ///< Boxcar sum or first CIC integrator
+  std::array<uint32_t, NUM_CHANNELS> integral{}; ///< Second CIC integrator
+  std::array<uint32_t, NUM_CHANNELS> comb1{};    ///< Delay elements of the CIC combs
+  std::array<uint32_t, NUM_CHANNELS> comb2{};
+  std::array<uint16_t, NUM_CHANNELS> min{};
+  std::array<uint16_t, NUM_CHANNELS> max{};
+
+  void start_window();
+  void write_window(uint32_t *out, uint16_t window_length);
+
+public:
+  Decimator() = default;
+  Decimator(DecimationMode mode, uint16_t factor, uint8_t num_channels);
+
+  void reset();
+
+  DecimationMode get_mode() const { return mode; }
+  uint16_t get_factor() const { return factor; }
+
+  /// Number of output vectors each completed window yields
+  size_t outputs_per_window() const { return mode == DecimationMode::MINMAX ? 2 : 1; }
+
+  /// Number of input vectors which are needed to complete the current window
+  size_t remaining_in_window() const { return factor - count; }
+
+  /**
+   * Feeds outer_count input vectors of num_channels words each, where outer_count must
+   * not exceed remaining_in_window(). If this completes the window, outputs_per_window()
+   * vectors are written to out and the number of them is returned. Otherwise returns 0.
+   **/
+  size_t process(const volatile uint32_t *in, size_t outer_count, uint32_t *out);
+
+  /**
+   * Writes out the incomplete last window, if there is one and the mode allows for it.
+   * The CIC output is not defined for incomplete windows, so it is dropped.
+   **/
+  size_t flush(uint32_t *out);
+};
+
+} // namespace daq
@@ -0,0 +1,65 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "daq/reduction.h"
+
+#include <Arduino.h>
+
+FLASHMEM daq::Reducer::Reducer(ReductionMode mode, uint8_t num_channels)
+    : mode(mode), num_channels(num_channels) {
+  reset();
+}
+
+FLASHMEM void daq::Reducer::reset() {
+  has_data = false;
+  last.fill(0);
+  min.fill(UINT16_MAX);
+  max.fill(0);
+}
+
+// NOT FLASHMEM
+void daq::Reducer::process(const volatile uint32_t *in, size_t outer_count) {
+  if (!outer_count)
+    return;
+  const size_t nc = num_channels;
+  switch (mode) {
+  case ReductionMode::NONE:
+  case ReductionMode::FINAL:
+    break;
+  case ReductionMode::MINMAX:
+    for (size_t i = 0; i < outer_count; i++)
+      for (size_t c = 0; c < nc; c++) {
+        uint16_t x = in[i * nc + c] & 0xFFFF;
+        if (x < min[c])
+          min[c] = x;
+        if (x > max[c])
+          max[c] = x;
+      }
+    break;
+  }
+  for (size_t c = 0; c < nc; c++)
+    last[c] = in[(outer_count - 1) * nc + c] & 0xFFFF;
+  has_data = true;
+}
+
+// NOT FLASHMEM
+size_t daq::Reducer::result(uint32_t *out) const {
+  if (!has_data)
+    return 0;
+  const size_t nc = num_channels;
+  switch (mode) {
+  case ReductionMode::NONE:
+  case ReductionMode::FINAL:
+    for (size_t c = 0; c < nc; c++)
+      out[c] = last[c];
+    return 1;
+  case ReductionMode::MINMAX:
+    for (size_t c = 0; c < nc; c++) {
+      out[c] = min[c];
+      out[nc + c] = max[c];
+    }
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "daq/base.h"
+
+namespace daq {
+
+/// Reduction of all data of a run to a few data vectors, see Reducer
+enum class ReductionMode { NONE, FINAL, MINMAX };
+
+/**
+ * Reduces the raw ADC data of a whole run, e.g. for each point of a parameter sweep.
+ * Like the Decimator, it works on the lower 16 bits of the raw DMA words and yields
+ * raw samples again.
+ *
+ * - NONE: Nothing is reduced, the data passes through.
+ * - FINAL: One vector, the last data vector of the run.
+ * - MINMAX: Two vectors, first the minimum and then the maximum of each channel.
+ **/
+class Reducer {
+  ReductionMode mode = ReductionMode::NONE;
+  uint8_t num_channels = NUM_CHANNELS;
+  bool has_data = false;
+
+  std::array<uint16_t, NUM_CHANNELS> last{};
+  std::array<uint16_t, NUM_CHANNELS> min{};
+  std::array<uint16_t, NUM_CHANNELS> max{};
+
+public:
+  Reducer() = default;
+  Reducer(ReductionMode mode, uint8_t num_channels);
+
+  void reset();
+
+  ReductionMode get_mode() const { return mode; }
+
+  /// Maximum number of vectors result() writes
+  size_t outputs() const { return mode == ReductionMode::MINMAX ? 2 : 1; }
+
+  /// Feeds outer_count input vectors of num_channels words each.
+  void process(const volatile uint32_t *in, size_t outer_count);
+
+  /// Writes the reduced vectors to out and returns their number, which is zero if there was no data.
+  size_t result(uint32_t *out) const;
+};
+
+} // namespace daq
@@ -0,0 +1,57 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "daq/trigger.h"
+
+#include <Arduino.h>
+
+FLASHMEM daq::TriggerEvaluator::TriggerEvaluator(const TriggerConfig &config, uint8_t inner_count)
+    : config(config), inner_count(inner_count) {}
+
+FLASHMEM void daq::TriggerEvaluator::reset() { has_previous = false; }
+
+// NOT FLASHMEM
+int daq::TriggerEvaluator::find(const volatile uint32_t *data, size_t outer_count, bool overload) {
+  const volatile uint32_t *channel_data = data + config.channel;
+  switch (config.mode) {
+  case TriggerMode::NONE:
+    return outer_count ? 0 : NOT_FOUND;
+  case TriggerMode::OVERLOAD:
+    return (overload and outer_count) ? 0 : NOT_FOUND;
+  case TriggerMode::ABOVE:
+    for (size_t i = 0; i < outer_count; i++)
+      if (is_above(channel_data[i * inner_count]))
+        return i;
+    return NOT_FOUND;
+  case TriggerMode::BELOW:
+    for (size_t i = 0; i < outer_count; i++)
+      if (!is_above(channel_data[i * inner_count]))
+        return i;
+    return NOT_FOUND;
+  case TriggerMode::RISING:
+  case TriggerMode::FALLING: {
+    const bool rising = config.mode == TriggerMode::RISING;
+    for (size_t i = 0; i < outer_count; i++) {
+      bool above = is_above(channel_data[i * inner_count]);
+      bool fired = has_previous and (above != previous_above) and (above == rising);
+      previous_above = above;
+      has_previous = true;
+      if (fired)
+        return i;
+    }
+    return NOT_FOUND;
+  }
+  }
+  return NOT_FOUND;
+}
+
+FLASHMEM daq::TriggerCapture::TriggerCapture(const TriggerConfig &config, uint8_t inner_count,
+                                             const volatile uint32_t *history, size_t history_size,
+                                             size_t max_in_flight)
+    : evaluator(config, inner_count), pre(config.pre), post(config.post), inner_count(inner_count),
+      history(history), history_outer_count(history_size / inner_count) {
+  size_t max_pre = history_outer_count > max_in_flight ? history_outer_count - max_in_flight : 0;
+  if (pre > max_pre)
+    pre = max_pre;
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "daq/base.h"
+
+namespace daq {
+
+/**
+ * Evaluates a TriggerConfig on a stream of raw data chunks.
+ *
+ * Note that the raw ADC values are inverted with respect to machine units
+ * (see BaseDAQ::raw_to_float), so "above a level" means "raw value below level_raw".
+ * Edges are detected across chunk boundaries.
+ **/
+class TriggerEvaluator {
+  TriggerConfig config;
+  uint8_t inner_count = NUM_CHANNELS;
+  bool has_previous = false;
+  bool previous_above = false;
+
+  bool is_above(uint32_t word) const { return (word & 0xFFFF) <= config.level_raw; }
+
+public:
+  static constexpr int NOT_FOUND = -1;
+
+  TriggerEvaluator() = default;
+  TriggerEvaluator(const TriggerConfig &config, uint8_t inner_count);
+
+  void reset();
+
+  /**
+   * Returns the index of the first data vector in the chunk which fulfills the trigger
+   * condition, or NOT_FOUND. Overload is the state of the overload line while the
+   * chunk was sampled, which is all the OVERLOAD mode looks at.
+   **/
+  int find(const volatile uint32_t *data, size_t outer_count, bool overload);
+};
+
+/**
+ * Triggered capture on top of a circular history buffer, which on the device is the
+ * DMA ring buffer itself. All chunks fed in must lie within this history buffer, as
+ * the DMA blocks do. Before the trigger event, nothing is emitted. When it happens,
+ * up to pre vectors of history plus post vectors starting at the event are emitted,
+ * then the capture is done and ignores everything else.
+ *
+ * Emitting happens through a callback emit(const volatile uint32_t *data, size_t outer_count)
+ * with contiguous segments of the history buffer.
+ **/
+class TriggerCapture {
+public:
+  enum class State { ARMED, CAPTURING, DONE };
+
+private:
+  TriggerEvaluator evaluator;
+  uint32_t pre = 0, post = 0;
+  uint8_t inner_count = NUM_CHANNELS;
+  const volatile uint32_t *history = nullptr;
+  size_t history_outer_count = 0; ///< Size of the history buffer in data vectors
+  State state = State::ARMED;
+  uint32_t remaining_post = 0;
+  uint32_t seen = 0; ///< Data vectors fed in so far, limits how much history is valid
+  bool history_lost = false;
+
+  template <typename Emit>
+  void emit_history(const volatile uint32_t *trigger_vector, size_t intact_history, Emit &&emit) {
+    size_t count = std::min<size_t>(pre, seen);
+    if (count > intact_history) {
+      count = intact_history;
+      history_lost = true;
+    }
+    if (!count)
+      return;
+    size_t trigger_position = (trigger_vector - history) / inner_count;
+    size_t start = (trigger_position + history_outer_count - count) % history_outer_count;
+    size_t first = std::min(count, history_outer_count - start);
+    emit(history + start * inner_count, first);
+    if (first < count)
+      emit(history, count - first);
+  }
+
+public:
+  TriggerCapture() = default;
+  /// Pre is limited to the history buffer size minus max_in_flight vectors, which the producer may be ahead.
+  TriggerCapture(const TriggerConfig &config, uint8_t inner_count, const volatile uint32_t *history,
+                 size_t history_size, size_t max_in_flight = 0);
+
+  State get_state() const { return state; }
+  uint32_t get_pre() const { return pre; }
+  /// Whether the pre-trigger window was cut short, because part of the history was overwritten already.
+  bool is_history_lost() const { return history_lost; }
+
+  /**
+   * Feeds in the next chunk of data. Intact_history is the number of data vectors right before the chunk
+   * which are still valid in the history buffer. On the device, the DMA may have overwritten older ones already.
+   * History beyond is not emitted, see is_history_lost().
+   **/
+  template <typename Emit>
+  void feed(const volatile uint32_t *data, size_t outer_count, bool overload, Emit &&emit,
+            size_t intact_history = SIZE_MAX) {
+    size_t begin = 0;
+    if (state == State::ARMED) {
+      int idx = evaluator.find(data, outer_count, overload);
+      if (idx == TriggerEvaluator::NOT_FOUND) {
+        seen += outer_count;
+        return;
+      }
+      begin = idx;
+      seen += begin;
+      emit_history(data + begin * inner_count, std::min(intact_history, SIZE_MAX - begin) + begin, emit);
+      state = State::CAPTURING;
+      remaining_post = post;
+      seen += outer_count - begin;
+    } else {
+      seen += outer_count;
+    }
+    if (state == State::CAPTURING) {
+      size_t count = std::min<size_t>(remaining_post, outer_count - begin);
+      if (count)
+        emit(data + begin * inner_count, count);
+      remaining_post -= count;
+      if (!remaining_post)
+        state = State::DONE;
+    }
+  }
+};
+
+} // namespace daq
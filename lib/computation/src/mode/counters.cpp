@@ -4,6 +4,9 @@ FLASHMEM void mode::PerformanceCounter::reset() {
     total_op_time_us = 0;
     total_ic_time_us = 0;
     total_number_of_runs = 0;
+    throughput_window = 0;
+    runs_in_window = 0;
+    runs_per_second = 0;
 }
 
 #define FROMTO(A,B) cur_mode == mode::Mode::A && new_mode == mode::Mode::B
@@ -30,6 +33,17 @@ FLASHMEM void mode::PerformanceCounter::add(mode::Mode some_mode, uint32_t us) {
 
 FLASHMEM void mode::PerformanceCounter::increase_run() {
     total_number_of_runs++;
+    runs_in_window++;
+    update_throughput();
+}
+
+FLASHMEM void mode::PerformanceCounter::update_throughput() {
+    // Windows of at least a second, which also decays the rate to zero when idle
+    uint32_t window_ms = throughput_window;
+    if(window_ms < 1000) return;
+    runs_per_second = runs_in_window * 1000.0f / window_ms;
+    runs_in_window = 0;
+    throughput_window = 0;
 }
 
 FLASHMEM void mode::PerformanceCounter::to_json(JsonObject target) {
@@ -37,4 +51,6 @@ FLASHMEM void mode::PerformanceCounter::to_json(JsonObject target) {
     target["total_op_time_us"] = total_op_time_us;
     target["total_halt_time_us"] = total_halt_time_us;
     target["total_number_of_runs"] = total_number_of_runs;
+    update_throughput();
+    target["runs_per_second"] = runs_per_second;
 }
\ No newline at end of file
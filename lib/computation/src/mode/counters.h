@@ -28,6 +28,12 @@ class PerformanceCounter : public utils::HeapSingleton<PerformanceCounter> {
         total_halt_time_us, ///< Total tracked HALT time in microseconds
         total_number_of_runs;
 
+    elapsedMillis throughput_window; ///< Time since the current run throughput window started
+    uint32_t runs_in_window;         ///< Runs finished within the current throughput window
+    float runs_per_second;           ///< Run throughput of the last completed window
+
+    void update_throughput();
+
 public:
     PerformanceCounter() { reset(); }
     void reset();
@@ -71,7 +71,26 @@ run::Run run::Run::from_json(JsonObjectConst &json) {
   if (id.size() != 32 + 4) {
     id = "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx";
   }
-  return {id, run_config, daq_config};
+  run::Run run{id, run_config, daq_config};
+
+  // The optional circuit configuration is kept in its own document, since msg_in does not outlive this call.
+  // Messages are parsed in place, so their strings point into the line buffer of the connection, which the
+  // next message overwrites. JsonDocument::set() would keep these links, so the circuit is copied by
+  // deserializing its text from a std::string, from which ArduinoJson duplicates every string.
+  auto circuit = json["circuit"];
+  if (!circuit.isNull() and circuit.is<JsonObjectConst>()) {
+    std::string text;
+    serializeJson(circuit, text);
+    run.circuit = std::make_shared<DynamicJsonDocument>(circuit.memoryUsage() + text.size() + JSON_OBJECT_SIZE(2));
+    auto error = deserializeJson(*run.circuit, text);
+    if (error) {
+      // An empty configuration fails when applied, which makes the run end in ERROR
+      LOGMEV("Circuit configuration of run could not be copied: %s", error.c_str());
+      run.circuit->clear();
+    }
+    run.circuit->shrinkToFit();
+  }
+  return run;
 }
 
 FLASHMEM
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <ArduinoJson.h>
+#include <memory>
 #include <queue>
 #include <string>
 
@@ -13,6 +14,8 @@
 
 namespace run {
 
+class Sweep;
+
 enum class RunState { NEW, ERROR, DONE, QUEUED, TAKE_OFF, IC, OP, OP_END, TMP_HALT, _COUNT __attribute__((unused))
 };
 
@@ -50,6 +53,11 @@ public:
   RunConfig config;               ///< (User-provided) timing requests
   RunState state = RunState::NEW; ///< (System-steered)
   daq::DAQConfig daq_config;      ///< (User-provided) Data Aquisition request
+  /// (User-provided, optional) set_circuit style message which is applied before the run
+  std::shared_ptr<DynamicJsonDocument> circuit;
+  bool circuit_staged = false;    ///< (System-steered) Whether circuit was applied to the in-memory configuration already
+  bool circuit_staging_failed = false; ///< (System-steered) Whether staging failed or was skipped, the circuit is then applied when the run is up
+  std::shared_ptr<Sweep> sweep;   ///< (User-provided, optional) Parameter sweep, the run is repeated for each point
 
 protected:
   std::queue<RunStateChange, std::array<RunStateChange, 7>> history;
@@ -72,10 +80,15 @@ class RunDataHandler {
 public:
   volatile bool first_data = false;
   volatile bool last_data = false;
+  /// Set when data could not be delivered without blocking, e.g. to a slow client.
+  /// The run is then finished as overflowed (ERROR) instead of stalling the DMA.
+  bool overflowed = false;
   virtual void init() {};
   virtual void handle(volatile uint32_t *data, size_t outer_count, size_t inner_count, const run::Run &run) = 0;
   virtual void stream(volatile uint32_t *buffer, run::Run &run) = 0;
   virtual void prepare(Run& run) = 0;
+  /// Called once after the last handle() of a run, e.g. to send out buffered data.
+  virtual void finish(const run::Run &run) {};
 };
 
 } // namespace run
\ No newline at end of file
@@ -5,25 +5,36 @@
 #include "mode/counters.h"
 #include "run/run_manager.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cmath>
 #include <Arduino.h>
 
+#include "carrier/carrier.h"
 #include "daq/daq.h"
+#include "run/sweep.h"
 #include "utils/logging.h"
 
-// This is an interim hacky solution to introduce another kind of RunDataHandler
-#include "protocol/protocol_oob.h"
-
 run::RunManager run::RunManager::_instance{};
 
 FLASHMEM
 void run::RunManager::run_next(carrier::Carrier &carrier_, run::RunStateChangeHandler *state_change_handler,
-                               run::RunDataHandler *run_data_handler,
-                               client::StreamingRunDataNotificationHandler *alt_run_data_handler) {
+                               run::RunDataHandler *run_data_handler) {
   // TODO: Improve handling of queue, especially the queue.pop() later.
   auto run = queue.front();
 
+  if (!apply_circuit(carrier_, run)) {
+    auto change = run.to(RunState::ERROR, 0);
+    state_change_handler->handle(change, run);
+    queue.pop_front();
+    return;
+  }
+  // The hardware keeps the circuit for repetitions of this run
+  queue.front().circuit.reset();
+  // A sweep calibrates for its first point only
+  if (run.sweep)
+    queue.front().config.calibrate = false;
+
   if(run.config.calibrate) {
     // TODO: In principle, we could do this slightly more efficient when we initialize the DAQ
     //       for the runs anyway, but the FlexIODAQ currently does not support a simple sample().
@@ -34,97 +45,186 @@ void run::RunManager::run_next(carrier::Carrier &carrier_, run::RunStateChangeHa
       LOG_ERROR("Error during self-calibration. Machine will continue with reduced accuracy.");
   }
 
+  if (run.sweep) {
+    run_next_sweep_point(carrier_, run, state_change_handler, run_data_handler);
+    if (run.sweep->is_done())
+      queue.pop_front();
+    return;
+  }
+
+  staging_carrier = &carrier_;
   if(run.config.streaming)
     run_next_flexio(run, state_change_handler, run_data_handler);
   else
-    run_next_traditional(run, state_change_handler, run_data_handler, alt_run_data_handler);
+    run_next_traditional(run, state_change_handler, run_data_handler);
+  staging_carrier = nullptr;
+  // The next run applies its circuit itself, after whatever made this one fail
+  if (run.state == RunState::ERROR)
+    unstage_circuit();
 
   if(!run.config.repetitive)
-    queue.pop();
+    queue.pop_front();
 }
 
-// NOT FLASHMEM
-void run::RunManager::run_next_traditional(run::Run &run, RunStateChangeHandler *state_change_handler, RunDataHandler *run_data_handler, client::StreamingRunDataNotificationHandler *alt_run_data_handler) {
-  //run_data_handler->prepare(run);
-
-  daq::OneshotDAQ daq;
-
-
-  // here, one sample is one data aquisition which always yields all channels.
-  constexpr uint32_t max_num_samples = 16'384;
-  const int num_channels = run.daq_config.get_num_channels();
-  const uint32_t optime_us = run.config.op_time / 1000;
-
-  uint32_t sampling_time_us = 0;
-  if(num_channels) {
-    daq.init(0);
-
-    // measure how long an single ADC sampling takes with the current implementation.
-    // This is right now around 15us.
-    elapsedMicros sampling_time_us_counter; // class from teensy elpasedMillis.h
-    daq.sample_raw();
-    sampling_time_us = sampling_time_us_counter;
-    // TODO: There is a slight dither around 15us -- 16us, could do the averaging call to
-    //       improve the statistics.
+namespace {
+
+/// Keeps the state changes of the single points of a sweep to itself
+class SweepPointStateChangeHandler : public run::RunStateChangeHandler {
+public:
+  run::RunState last = run::RunState::NEW;
+
+  void handle(run::RunStateChange change, const run::Run &run) override { last = change.new_; }
+};
+
+} // namespace
+
+FLASHMEM void run::RunManager::run_next_sweep_point(carrier::Carrier &carrier_, run::Run &run,
+                                                    RunStateChangeHandler *state_change_handler,
+                                                    RunDataHandler *run_data_handler) {
+  auto &sweep = *run.sweep;
+  bool error = false;
+  if (!sweep.is_done()) {
+    // Entity paths are resolved now, the entities present at start_sweep may be gone
+    auto res = sweep.apply_next_point(carrier_);
+    if (!res) {
+      LOGMEV("Sweep point %u: %s", sweep.get_point(), res.msg.c_str());
+      error = true;
+    } else {
+      SweepPointStateChangeHandler point_state_change_handler;
+      run.config.write_run_state_changes = true;
+      if (run.config.streaming)
+        run_next_flexio(run, &point_state_change_handler, run_data_handler);
+      else
+        run_next_traditional(run, &point_state_change_handler, run_data_handler);
+      error = point_state_change_handler.last == RunState::ERROR;
+    }
   }
 
-  /*
-    The guiding principle of the following math is this:
+  if (error)
+    sweep.abort();
+  if (sweep.is_done() and queue.front().config.write_run_state_changes) {
+    auto change = run.to(error ? RunState::ERROR : RunState::DONE, 0);
+    state_change_handler->handle(change, run);
+  }
+}
 
-       sampling_total_us == sampling_time_us + sampling_sleep_us // for up to full 8 channels
-       optime_us == num_samples*num_channels*sampling_total_us
+FLASHMEM bool run::RunManager::apply_circuit(carrier::Carrier &carrier_, run::Run &run) {
+  if (!run.circuit)
+    return true;
+  if (!run.circuit_staged) {
+    auto res = carrier_.stage_config(run.circuit->as<JsonObjectConst>());
+    if (!res) {
+      LOGMEV("Could not apply circuit of run: %s", res.msg.c_str());
+      return false;
+    }
+  }
+  // From here on, the in-memory configuration is the one to go to the hardware
+  staged_carrier = nullptr;
+  staging_snapshot.reset();
+  auto res = carrier_.write_to_hardware();
+  if (!res) {
+    LOGMEV("Could not write circuit of run: %s", res.msg.c_str());
+    // It is unknown how much of it made it, so the next write does all of it
+    carrier_.mark_dirty();
+    return false;
+  }
+  return true;
+}
 
-    We precompute all busy waits (sleeps) in order to match the requested optime as precise
-    as possible, with this means. Without interrupts.
+FLASHMEM bool run::RunManager::stage_next_circuit() {
+  // A repetitive run is started again, so the next one is not up yet.
+  // Sweeps do not stage at all (staging_carrier is not set), since their points change the configuration.
+  if (!staging_carrier or queue.size() < 2 or queue.front().config.repetitive)
+    return false;
+  auto &next = queue[1];
+  if (!next.circuit or next.circuit_staged or next.circuit_staging_failed)
+    return false;
+
+  // The DMA buffer must not overflow while staging, otherwise the next circuit is applied between the runs
+  auto staging_budget_us = 2 * std::max(staging_time_us, STAGING_TIME_ESTIMATE_US);
+  if (staging_budget_us > daq::dma::get_headroom_us(queue.front().daq_config)) {
+    next.circuit_staging_failed = true;
+    return false;
+  }
+  return stage_next_circuit(*staging_carrier);
+}
 
-    We ignore run.daq_config.get_sample_rate() because it is much simpler to just always
-    fill up the buffer. Furthermore the manual DAQ is pretty slow (about 15us per sample).
+FLASHMEM bool run::RunManager::stage_next_circuit(carrier::Carrier &carrier_) {
+  if (queue.size() < 2 or staged_carrier)
+    return false;
+  auto &next = queue[1];
+  if (!next.circuit or next.circuit_staged)
+    return false;
+  elapsedMicros staging_timer;
+
+  // Keep the configuration the hardware has, in case the staged circuit is not written after all
+  staging_snapshot = std::make_unique<DynamicJsonDocument>(STAGING_SNAPSHOT_SIZE);
+  auto snapshot = staging_snapshot->to<JsonObject>();
+  carrier_.config_to_json(snapshot);
+  if (staging_snapshot->overflowed()) {
+    LOG_ALWAYS("Configuration does not fit into the staging snapshot, next circuit is applied between the runs.");
+    staging_snapshot.reset();
+    next.circuit_staging_failed = true;
+    return false;
+  }
 
-    There are two main scenarios:
+  // On failure, apply_circuit tries again and reports the error when it is the next run's turn
+  staged_carrier = &carrier_;
+  next.circuit_staged = static_cast<bool>(carrier_.stage_config(next.circuit->as<JsonObjectConst>()));
+  if (!next.circuit_staged) {
+    // The circuit may have been applied partially
+    unstage_circuit();
+    next.circuit_staging_failed = true;
+  }
+  staging_time_us = std::max<uint32_t>(staging_time_us, staging_timer);
+  return next.circuit_staged;
+}
 
-    - asked for fast sampling = short runtime. This is where sampling_time_us dominates.
-      This code does it's job when optime_us > sampling_time_us but it's not great, of
-      course.
-    - asked for slow sampling = long runtime. This is where this code shines, because there
-      is no limit in runtime or similar, compared to the FlexIO code.
+FLASHMEM void run::RunManager::unstage_circuit() {
+  if (!staged_carrier)
+    return;
+  for (auto &run : queue)
+    run.circuit_staged = false;
+  auto res = staged_carrier->config_from_json(staging_snapshot->as<JsonObjectConst>());
+  if (!res) {
+    LOGMEV("Could not restore configuration from before staging: %s", res.msg.c_str());
+    // The next write then brings the hardware in line with whatever the configuration is now
+    staged_carrier->mark_dirty();
+  }
+  staged_carrier = nullptr;
+  staging_snapshot.reset();
+}
 
-    Of course, the overall code is still an order of magnitude simpler then the FlexIO/DMA
-    code. And in the same way less precise for short runtimes and fast sampling times.
+#ifdef ARDUINO
 
-    Given the unit of time basically measured in sampling_time_us, there is no need to
-    compute in nanoseconds here. Therefore the code computes in microseconds.
+// NOT FLASHMEM
+void run::RunManager::run_next_traditional(run::Run &run, RunStateChangeHandler *state_change_handler,
+                                           RunDataHandler *run_data_handler) {
+  /*
+    The IC/OP/HALT sequence is controlled manually, while the data acquisition is
+    driven by a timer interrupt (see daq::TimerDAQ) at the requested sample rate.
+    Each captured block is streamed out while the run goes on, so there is no limit
+    on the number of samples, which makes this the right choice for long and slow runs.
+    Compared to the FlexIO code, the OP time is only as precise as the main loop
+    polls it between streaming out blocks.
   */
+  const uint32_t optime_us = run.config.op_time / 1000;
+  bool daq_error = false;
 
-  uint32_t sampling_total_us = optime_us / max_num_samples;
-
-  // either no sleep at all or sleep the difference between total time and aquisition time.
-  uint32_t sampling_sleep_us = (sampling_total_us < sampling_time_us) ? 0 : (sampling_total_us - sampling_time_us);
-
-  uint32_t num_samples       = optime_us / (sampling_sleep_us + sampling_time_us);
-  uint32_t optime_left_us    = optime_us % (sampling_sleep_us + sampling_time_us);
-
-  // This situation actually should not happen at all.
-  if(num_samples > max_num_samples) num_samples = max_num_samples;
-
-  const int num_buffer_entries = num_samples * num_channels;
-  if(num_channels)
-    LOGMEV("optime_us=%d, sampling_time_us=%d, sampling_sleep_us=%d, num_samples=%d, num_channels=%d", optime_us, sampling_time_us, sampling_sleep_us, num_samples, num_channels);
-
-  // just to be able to use daq.sample_raw(uint16_t*) instead of copying over to an intermediate buffer
-  // of size std::vector, we add a bit safety padding to the right for the last datum obtained.
-  // Actually needed only if num_samples < daq::NUM_CHANNELS = 8.
-  constexpr int padding = daq::NUM_CHANNELS;
-
-  // we use malloc because new[] raises an exception if allocation fails but we cannot catch it with -fno-exception.
-  // we don't use the stack because we expect the heap to have more memory left...
-  uint16_t *buffer = nullptr;
-  if(num_channels) {
-    // allocate only if any data aquisition was asked for
-    buffer = (uint16_t*) malloc((num_buffer_entries + padding) * sizeof(uint16_t));
-    if(!buffer) {
-      LOG_ERROR("Could not allocated a large run buffer for a traditional Run.");
-    }
+  // Without anything to sample, there is no data to stream, and no layout of it for zero channels
+  if (run.daq_config)
+    run_data_handler->prepare(run);
+  daq::TimerDAQ daq_{run, run.daq_config, run_data_handler};
+  if (!daq_.init(0)) {
+    LOG_ERROR("Error while initializing daq for run.")
+    auto change = run.to(RunState::ERROR, 0);
+    state_change_handler->handle(change, run);
+    return;
   }
+  if (run.daq_config)
+    LOGMEV("optime_us=%d, sample_rate=%d, num_channels=%d", optime_us, daq_.get_sample_rate(),
+           run.daq_config.get_num_channels());
+  run_data_handler->init();
 
   mode::RealManualControl::enable();
 
@@ -143,15 +243,26 @@ void run::RunManager::run_next_traditional(run::Run &run, RunStateChangeHandler
   mode::RealManualControl::to_op();
   elapsedMicros actual_op_time_timer;
 
-  if(buffer) {
-    for(uint32_t sample=0; sample < num_samples; sample++) {
-      // Assumption: Passing the next line requires the amount of time "sampling_time_us"
-      daq.sample_raw(buffer + sample*num_channels);
-      if(sampling_sleep_us)
-        delayMicroseconds(sampling_sleep_us);
+  if(run.daq_config) {
+    if (!daq_.enable()) {
+      LOG_ERROR("Could not start the sampling timer.");
+      daq_error = true;
+    }
+    bool staged = false;
+    while (!daq_error and actual_op_time_timer < optime_us) {
+      if (!daq_.stream()) {
+        LOG_ERROR("Streaming error, most likely data overflow.");
+        if (staged)
+          LOGMEV("Staging the next circuit took %u us, the DMA buffer lasts %u us at this sample rate.",
+                 static_cast<unsigned int>(staging_time_us),
+                 static_cast<unsigned int>(daq::dma::get_headroom_us(run.daq_config)));
+        daq_error = true;
+      }
+      // OP ends when this loop notices, so only stage with enough time left
+      staged = actual_op_time_timer + 100'000 < optime_us and stage_next_circuit();
     }
-    if(optime_left_us)
-      delayMicroseconds(optime_left_us);
+    while (actual_op_time_timer < optime_us)
+      ;
   } else {
     if(run.config.op_time > 100'000'000) // 100ms
       delay(run.config.op_time / 1'000'000); // millisecond resolution sleep
@@ -163,21 +274,32 @@ void run::RunManager::run_next_traditional(run::Run &run, RunStateChangeHandler
 
   uint32_t actual_op_time_us = actual_op_time_timer;
   mode::RealManualControl::to_halt();
-  
-  if(buffer) {
-    alt_run_data_handler->handle(buffer, num_samples, num_channels, run);
-    free(buffer);
+  daq_.disable();
+  mode::PerformanceCounter::get().increase_run();
+
+  // Stream out remaining blocks, including the partially filled one
+  if (!daq_.stream(true)) {
+    LOG_ERROR("Streaming error during final partial stream.");
+    daq_error = true;
+  }
+  if (!daq_.finalize()) {
+    LOG_ERROR("Error while finalizing data acquisition.")
+    daq_error = true;
+  }
+  if (run_data_handler->overflowed) {
+    LOG_ERROR("Streaming error, some client could not keep up with the data rate.");
+    daq_error = true;
   }
 
-  auto res = (num_channels && !buffer) ? RunState::ERROR : RunState::DONE;
-  auto result = run.to(res, actual_op_time_us*1000);
+  auto result = run.to(daq_error ? RunState::ERROR : RunState::DONE, actual_op_time_us*1000);
   if(run.config.write_run_state_changes)
     state_change_handler->handle(result, run);
 }
 
 // NOT FLASHMEM
 void run::RunManager::run_next_flexio(run::Run &run, RunStateChangeHandler *state_change_handler, RunDataHandler *run_data_handler) {
-  run_data_handler->prepare(run);
+  if (run.daq_config)
+    run_data_handler->prepare(run);
   bool daq_error = false;
 
   daq::FlexIODAQ daq_{run, run.daq_config, run_data_handler};
@@ -199,12 +321,19 @@ void run::RunManager::run_next_flexio(run::Run &run, RunStateChangeHandler *stat
   mode::FlexIOControl::force_start();
   delayMicroseconds(1);
 
+  bool staged = false;
   while (!mode::FlexIOControl::is_done()) {
     if (!daq_.stream()) {
       LOG_ERROR("Streaming error, most likely data overflow.");
+      if (staged)
+        LOGMEV("Staging the next circuit took %u us, the DMA buffer lasts %u us at this sample rate.",
+               static_cast<unsigned int>(staging_time_us),
+               static_cast<unsigned int>(daq::dma::get_headroom_us(run.daq_config)));
       daq_error = true;
       break;
     }
+    // Right after draining the DMA buffer, there is the most time for this
+    staged = stage_next_circuit();
   }
   mode::FlexIOControl::to_end();
 
@@ -233,6 +362,11 @@ void run::RunManager::run_next_flexio(run::Run &run, RunStateChangeHandler *stat
     daq_error = true;
   }
 
+  if (run_data_handler->overflowed) {
+    LOG_ERROR("Streaming error, some client could not keep up with the data rate.");
+    daq_error = true;
+  }
+
   if (daq_error) {
     auto change = run.to(RunState::ERROR, actual_op_time);
     state_change_handler->handle(change, run);
@@ -244,6 +378,23 @@ void run::RunManager::run_next_flexio(run::Run &run, RunStateChangeHandler *stat
   state_change_handler->handle(change, run);
 }
 
+#else
+
+// The DAQs and the IC/OP control need the hardware, natively runs are done by simulation::run_next
+FLASHMEM void run::RunManager::run_next_traditional(run::Run &run, RunStateChangeHandler *state_change_handler,
+                                                    RunDataHandler *run_data_handler) {
+  LOG_ERROR("Runs are not available without hardware.");
+  auto change = run.to(RunState::ERROR, 0);
+  state_change_handler->handle(change, run);
+}
+
+FLASHMEM void run::RunManager::run_next_flexio(run::Run &run, RunStateChangeHandler *state_change_handler,
+                                               RunDataHandler *run_data_handler) {
+  run_next_traditional(run, state_change_handler, run_data_handler);
+}
+
+#endif // ARDUINO
+
 int run::RunManager::start_run(JsonObjectConst msg_in, JsonObject &msg_out) {
   if (!msg_in.containsKey("id") or !msg_in["id"].is<std::string>())
     return 1;
@@ -258,6 +409,24 @@ int run::RunManager::start_run(JsonObjectConst msg_in, JsonObject &msg_out) {
 
   // Create run and put it into queue
   auto run = run::Run::from_json(msg_in);
-  queue.push(std::move(run));
+  queue.push_back(std::move(run));
+  return 0 /* success */;
+}
+
+FLASHMEM int run::RunManager::start_sweep(JsonObjectConst msg_in, JsonObject &msg_out, entities::Entity &root) {
+  if (!msg_in.containsKey("id") or !msg_in["id"].is<std::string>())
+    return 1;
+
+  auto sweep = std::make_shared<Sweep>();
+  auto res = sweep->from_json(msg_in, root);
+  if (!res) {
+    msg_out["error"] = res.msg;
+    return 2;
+  }
+  msg_out["points"] = sweep->get_num_points();
+
+  auto run = run::Run::from_json(msg_in);
+  run.sweep = std::move(sweep);
+  queue.push_back(std::move(run));
   return 0 /* success */;
 }
@@ -4,27 +4,51 @@
 
 #pragma once
 
-#include "run/run.h"
+#include <deque>
+#include <memory>
 
-namespace client {
-  class StreamingRunDataNotificationHandler;
-} // namespace client
+#include "run/run.h"
+#include "run/sweep.h"
 
 namespace carrier {
   class Carrier;
 }
 
+namespace entities {
+  class Entity;
+}
+
 namespace run {
 
 class RunManager {
 private:
   static RunManager _instance;
 
+  /// Carrier to stage the next run's circuit on, only set while a run is going on
+  carrier::Carrier *staging_carrier = nullptr;
+  /// Carrier whose in-memory configuration holds a staged circuit which is not written to hardware yet
+  carrier::Carrier *staged_carrier = nullptr;
+  /// Configuration of staged_carrier from before staging, which is what its hardware still has.
+  /// Only allocated while a circuit is staged.
+  std::unique_ptr<DynamicJsonDocument> staging_snapshot;
+  /// Longest time staging a circuit took so far
+  uint32_t staging_time_us = 0;
+
+  /// Restores the configuration from before staging, if the staged circuit is not going to be written.
+  void unstage_circuit();
+
+  /// Applies and writes the circuit coming with the run, unless there is none. Returns false on error.
+  bool apply_circuit(carrier::Carrier &carrier_, run::Run &run);
+
+  /// Runs the next point of the run's sweep, the state change is only reported after the last one.
+  void run_next_sweep_point(carrier::Carrier &carrier_, run::Run &run, run::RunStateChangeHandler *state_change_handler,
+                            run::RunDataHandler *run_data_handler);
+
 protected:
   RunManager() = default;
 
 public:
-  std::queue<run::Run> queue;
+  std::deque<run::Run> queue;
 
   RunManager(RunManager &other) = delete;
   void operator=(const RunManager &other) = delete;
@@ -35,6 +59,8 @@ public:
   bool end_repetitive_runs() {
     if (!queue.empty()) {
       queue.front().config.repetitive = false;
+      if (queue.front().sweep)
+        queue.front().sweep->abort();
       return true;
     }
     return false;
@@ -42,19 +68,54 @@ public:
 
   /// Clears the run queue
   void clear_queue() {
+    unstage_circuit();
     queue = {};
     // if this does not work, try while(!Q.empty()) Q.pop();
   }
 
+  /// Size of the snapshot of the configuration taken before staging
+  static constexpr size_t STAGING_SNAPSHOT_SIZE = 8192;
+  /// Assumed time staging a circuit takes, as long as no staging took longer
+  static constexpr uint32_t STAGING_TIME_ESTIMATE_US = 5'000;
+
+  /**
+   * Pipelining for queued runs which carry their circuit configuration: While a run is
+   * streaming out its data, the circuit of the next run is applied to the in-memory entity
+   * configuration, which acts as shadow state. Thus only the write to hardware is left
+   * between the runs. Meant to be called from the acquisition loops right after draining
+   * the DMA buffer, does nothing if there is nothing (more) to stage.
+   *
+   * Staging must not take longer than the DMA buffer takes to fill up at the current run's
+   * sample rate (see daq::dma::get_headroom_us). If twice the longest time staging took so far,
+   * but at least STAGING_TIME_ESTIMATE_US, does not fit, the next circuit is applied between the runs.
+   *
+   * The configuration from before is kept as a snapshot. It is restored if the staged circuit
+   * is not written after all, i.e. if the queue is cleared or the current run fails, such that
+   * the in-memory configuration keeps matching the hardware.
+   *
+   * @returns whether a circuit was staged
+   **/
+  bool stage_next_circuit();
+
+  /// Stages the circuit of the next run in the queue on carrier_ right away, however long it takes.
+  /// Returns whether a circuit was staged.
+  bool stage_next_circuit(carrier::Carrier &carrier_);
+
+  /// Longest time staging a circuit took so far, zero if nothing was staged yet
+  uint32_t get_staging_time_us() const { return staging_time_us; }
+
   void run_next(carrier::Carrier &carrier_, run::RunStateChangeHandler *state_change_handler,
-                run::RunDataHandler *run_data_handler,
-                client::StreamingRunDataNotificationHandler *alt_run_data_handler);
+                run::RunDataHandler *run_data_handler);
 
   void run_next_flexio(run::Run &run, run::RunStateChangeHandler *state_change_handler, run::RunDataHandler *run_data_handler);
-  void run_next_traditional(run::Run &run, run::RunStateChangeHandler *state_change_handler, run::RunDataHandler *run_data_handler, client::StreamingRunDataNotificationHandler *alt_run_data_handler);
+  void run_next_traditional(run::Run &run, run::RunStateChangeHandler *state_change_handler, run::RunDataHandler *run_data_handler);
 
   ///@ingroup User-Functions
   int start_run(JsonObjectConst msg_in, JsonObject &msg_out);
+
+  /// Queues a run with a parameter sweep, see run::Sweep. Entity paths are resolved relative to root.
+  ///@ingroup User-Functions
+  int start_sweep(JsonObjectConst msg_in, JsonObject &msg_out, entities::Entity &root);
 };
 
 } // namespace run
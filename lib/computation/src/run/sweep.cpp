@@ -0,0 +1,166 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "run/sweep.h"
+
+#include "block/cblock.h"
+#include "block/mblock.h"
+#include "entity/base.h"
+
+namespace {
+
+blocks::CBlock *as_cblock(entities::Entity *entity) {
+  if (!entity or !entity->is_entity_class(entities::EntityClass::C_BLOCK))
+    return nullptr;
+  return static_cast<blocks::CBlock *>(entity);
+}
+
+blocks::MIntBlock *as_mintblock(entities::Entity *entity) {
+  if (!entity or !entity->is_entity_class(entities::EntityClass::M_BLOCK) or
+      !static_cast<blocks::MBlock *>(entity)->is_entity_type(blocks::MIntBlock::TYPE))
+    return nullptr;
+  return static_cast<blocks::MIntBlock *>(entity);
+}
+
+/// Checks whether element and value are valid for the entity, without changing anything
+utils::status check(entities::Entity *entity, uint8_t element, float value) {
+  if (as_cblock(entity)) {
+    if (element >= blocks::CBlock::NUM_COEFF)
+      return utils::status("Sweep: C-Block element %d does not exist", element);
+    if (value < blocks::CBlock::MIN_FACTOR or value > blocks::CBlock::MAX_FACTOR)
+      return utils::status("Sweep: Coefficient %f is out of range", value);
+    return utils::status::success();
+  }
+  if (as_mintblock(entity)) {
+    if (element >= blocks::MIntBlock::NUM_INTEGRATORS)
+      return utils::status("Sweep: Integrator %d does not exist", element);
+    if (value < -1.0f or value > 1.0f)
+      return utils::status("Sweep: Initial condition %f is out of range", value);
+    return utils::status::success();
+  }
+  return utils::status("Sweep: Only C-Block coefficients and M-Int-Block initial conditions can be swept");
+}
+
+} // namespace
+
+FLASHMEM entities::Entity *run::SweepMutation::resolve(entities::Entity &root) const {
+  auto entity = &root;
+  for (auto &child_id : path) {
+    entity = entity->get_child_entity(child_id);
+    if (!entity)
+      return nullptr;
+  }
+  return entity;
+}
+
+FLASHMEM utils::status run::SweepMutation::apply(size_t point, entities::Entity &root) const {
+  auto entity = resolve(root);
+  if (!entity)
+    return utils::status("Sweep: Could not resolve entity path");
+  auto new_value = value(point);
+  if (auto cblock = as_cblock(entity)) {
+    if (cblock->get_factor(element) == new_value)
+      return utils::status::success();
+    if (!cblock->set_factor(element, new_value))
+      return utils::status("Sweep: Invalid coefficient %f", new_value);
+    return cblock->write_factor_to_hardware(element);
+  }
+  if (auto mintblock = as_mintblock(entity)) {
+    if (mintblock->get_ic_value(element) == new_value)
+      return utils::status::success();
+    if (!mintblock->set_ic_value(element, new_value))
+      return utils::status("Sweep: Invalid initial condition %f", new_value);
+    return mintblock->write_ic_to_hardware(element);
+  }
+  return utils::status("Sweep: Entity can not be swept");
+}
+
+FLASHMEM utils::status run::Sweep::from_json(JsonObjectConst json, entities::Entity &root) {
+  mutations.clear();
+  num_points = 0;
+  next_point = 0;
+  point = 0;
+
+  auto reduction_json = json["reduction"];
+  if (reduction_json.isNull() or reduction_json == "final")
+    reduction = daq::ReductionMode::FINAL;
+  else if (reduction_json == "minmax")
+    reduction = daq::ReductionMode::MINMAX;
+  else if (reduction_json == "trace")
+    reduction = daq::ReductionMode::NONE;
+  else
+    return utils::status("Sweep: Unknown reduction");
+
+  auto mutations_json = json["mutations"];
+  if (!mutations_json.is<JsonArrayConst>() or !mutations_json.size())
+    return utils::status("Sweep: Expecting a non-empty list of mutations");
+
+  for (JsonObjectConst mutation_json : mutations_json.as<JsonArrayConst>()) {
+    SweepMutation mutation;
+
+    auto path = mutation_json["entity"];
+    if (!path.is<JsonArrayConst>() or !path.size() or path[0].as<std::string>() != root.get_entity_id())
+      return utils::status("Sweep: Invalid entity path");
+    auto path_begin = path.as<JsonArrayConst>().begin();
+    for (++path_begin; path_begin != path.as<JsonArrayConst>().end(); ++path_begin) {
+      if (!(*path_begin).is<const char *>())
+        return utils::status("Sweep: Invalid entity path");
+      mutation.path.emplace_back((*path_begin).as<const char *>());
+    }
+    auto entity = mutation.resolve(root);
+    if (!entity)
+      return utils::status("Sweep: Could not resolve entity path");
+
+    auto element = mutation_json["element"];
+    if (!element.is<uint8_t>())
+      return utils::status("Sweep: Expecting an element index");
+    mutation.element = element.as<uint8_t>();
+
+    auto values = mutation_json["values"];
+    auto range = mutation_json["range"];
+    if (values.is<JsonArrayConst>()) {
+      for (JsonVariantConst value : values.as<JsonArrayConst>()) {
+        if (!value.is<float>())
+          return utils::status("Sweep: Values must be numbers");
+        mutation.values.push_back(value.as<float>());
+      }
+    } else if (range.is<JsonObjectConst>()) {
+      if (!range["from"].is<float>() or !range["to"].is<float>() or !range["steps"].is<uint32_t>())
+        return utils::status("Sweep: Range needs from, to and steps");
+      mutation.from = range["from"].as<float>();
+      mutation.to = range["to"].as<float>();
+      mutation.count = range["steps"].as<uint32_t>();
+    } else {
+      return utils::status("Sweep: Expecting either values or range");
+    }
+
+    if (!mutation.size())
+      return utils::status("Sweep: Mutation has no values");
+    if (num_points and mutation.size() != num_points)
+      return utils::status("Sweep: All mutations must have the same number of values");
+    num_points = mutation.size();
+
+    // Check all values now instead of failing in the middle of the sweep
+    for (size_t point = 0; point < mutation.size(); point++) {
+      auto res = check(entity, mutation.element, mutation.value(point));
+      if (!res)
+        return res;
+    }
+    mutations.push_back(std::move(mutation));
+  }
+  return utils::status::success();
+}
+
+FLASHMEM utils::status run::Sweep::apply_next_point(entities::Entity &root) {
+  if (is_done())
+    return utils::status("Sweep: No points left");
+  point = next_point;
+  for (auto &mutation : mutations) {
+    auto res = mutation.apply(point, root);
+    if (!res)
+      return res;
+  }
+  next_point++;
+  return utils::status::success();
+}
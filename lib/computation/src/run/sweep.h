@@ -0,0 +1,96 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <ArduinoJson.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "daq/reduction.h"
+#include "utils/error.h"
+
+namespace entities {
+class Entity;
+}
+
+namespace run {
+
+/**
+ * A single element changed in each point of a Sweep, which is either a coefficient
+ * of a C-Block or an initial condition of an M-Int-Block. The values are either given
+ * as a list or as an equidistant range.
+ *
+ * The entity is kept as its path and resolved whenever the mutation is applied, as
+ * entities may be replaced, e.g. by a reinitialization, while the sweep is queued.
+ **/
+struct SweepMutation {
+  std::vector<std::string> path; ///< Path of the entity below the root of the sweep
+  uint8_t element = 0;
+  std::vector<float> values; ///< Explicit values, if empty the range is used
+  float from = 0, to = 0;     ///< Range including both ends
+  size_t count = 0;
+
+  size_t size() const { return values.empty() ? count : values.size(); }
+  float value(size_t point) const {
+    if (!values.empty())
+      return values[point];
+    // The last point hits the end exactly, for ranges up to the limits of an element
+    return point + 1 >= count ? (count > 1 ? to : from) : from + (to - from) * point / (count - 1);
+  }
+
+  /// Returns the entity at path below root, or nullptr if there is none
+  entities::Entity *resolve(entities::Entity &root) const;
+
+  /// Changes the in-memory configuration and writes the element to hardware, unless it is unchanged.
+  utils::status apply(size_t point, entities::Entity &root) const;
+};
+
+/**
+ * Parameter sweep executed entirely on the device, started with the start_sweep message.
+ * It is run as a sequence of runs with the same RunConfig and DAQConfig, one for each point.
+ * Before each point, all mutations are applied, which only writes the changed elements to
+ * hardware instead of the full circuit. The data of each point is reduced according to the
+ * reduction mode (see daq::Reducer) and streamed out as usual, i.e. as one run_data message
+ * per point unless the reduction is NONE ("trace"). The run_data messages and the final
+ * run_state_change message carry the index of their point as "point".
+ *
+ * The JSON format is
+ *
+ * ```
+ * {"mutations": [{"entity": ["<carrier>", "0", "C"], "element": 3, "values": [0.1, 0.2, 0.3]},
+ *                {"entity": ["<carrier>", "0", "M0"], "element": 0, "range": {"from": -1, "to": 1, "steps": 3}}],
+ *  "reduction": "final"}
+ * ```
+ *
+ * All mutations must have the same number of points, the n-th point uses the n-th value of each.
+ * The reduction is one of "final" (default), "minmax" or "trace".
+ **/
+class Sweep {
+  std::vector<SweepMutation> mutations;
+  daq::ReductionMode reduction = daq::ReductionMode::FINAL;
+  size_t num_points = 0;
+  size_t next_point = 0;
+  size_t point = 0;
+
+public:
+  /// Parses the sweep and checks it against the entities at the paths relative to root
+  utils::status from_json(JsonObjectConst json, entities::Entity &root);
+
+  daq::ReductionMode get_reduction() const { return reduction; }
+  size_t get_num_points() const { return num_points; }
+  size_t get_next_point() const { return next_point; }
+  /// Index of the point applied last, i.e. the one which is run or failed
+  size_t get_point() const { return point; }
+  bool is_done() const { return next_point >= num_points; }
+
+  /// Applies all mutations for the next point to the entities below root and advances to it
+  utils::status apply_next_point(entities::Entity &root);
+  /// Skips all remaining points, e.g. after an error
+  void abort() { next_point = num_points; }
+};
+
+} // namespace run
@@ -97,8 +97,8 @@ public:
   /// Class instances cast to bool where true means success and false means failure.
   operator bool() const { return is_ok(); }
 
-  /// Syntactic sugar for success
-  static status success() { return status(0); }
+  /// Syntactic sugar for success. Its message is short enough to not need a heap allocation.
+  static status success() { return status(); }
 
   /// Syntactic sugar for failure
   static status failure() { return status(-1); }
@@ -5,9 +5,18 @@
 
 #include "is_number.h"
 
+#include <cctype>
+
 bool utils::is_number(const std::string::const_iterator &start, const std::string::const_iterator &end) {
   std::string::const_iterator it = start;
-  while (it != end && std::isdigit(*it))
+  while (it != end && std::isdigit(static_cast<unsigned char>(*it)))
     ++it;
   return it == end;
 }
+
+bool utils::is_number(std::string_view str) {
+  for (auto c : str)
+    if (!std::isdigit(static_cast<unsigned char>(c)))
+      return false;
+  return true;
+}
@@ -5,7 +5,9 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace utils {
     bool is_number(const std::string::const_iterator &start, const std::string::const_iterator &end);
+    bool is_number(std::string_view str);
 }
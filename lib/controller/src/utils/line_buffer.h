@@ -0,0 +1,110 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace utils {
+
+/**
+ * A fixed size buffer collecting the input of a stream until a complete line is available,
+ * without blocking and without any heap allocation.
+ *
+ * Lines are handed out as mutable, null-terminated strings inside the buffer, such that they
+ * can be parsed in place, for instance with ArduinoJson's zero-copy mode (`deserializeJson(doc, char*)`).
+ * A line stays valid until the next call to read_line(). Data following a line is kept for the next call,
+ * so several lines arriving in one packet are all handled.
+ *
+ * Lines which do not fit into the buffer are dropped entirely, which is reported by overflowed().
+ **/
+template <size_t SIZE> class LineBuffer {
+  char buffer[SIZE];
+  size_t begin = 0, end = 0;
+  bool discarding = false, dropped = false;
+
+  char *next_line() {
+    auto newline = static_cast<char *>(memchr(buffer + begin, '\n', end - begin));
+    if (!newline)
+      return nullptr;
+    *newline = '\0';
+    char *line = buffer + begin;
+    begin = newline - buffer + 1;
+    if (begin == end)
+      begin = end = 0;
+    return line;
+  }
+
+public:
+  static constexpr size_t size() { return SIZE; }
+
+  /// Whether a complete line is buffered already, such that read_line() returns it without reading.
+  bool has_line() const { return memchr(buffer + begin, '\n', end - begin) != nullptr; }
+
+  /// Returns true once after a line was dropped because it did not fit into the buffer.
+  bool overflowed() {
+    bool ret = dropped;
+    dropped = false;
+    return ret;
+  }
+
+  /// Forgets about any buffered input, for instance when a connection is closed.
+  void clear() {
+    begin = end = 0;
+    discarding = dropped = false;
+  }
+
+  /**
+   * Returns the next complete line without its line ending or nullptr if there is none yet.
+   * Only reads what is available from the stream, which needs `available()` and `read(uint8_t*, size_t)`.
+   **/
+  template <class Stream> char *read_line(Stream &stream) {
+    if (auto line = next_line())
+      return line;
+
+    // Make room for further input
+    if (begin) {
+      memmove(buffer, buffer + begin, end - begin);
+      end -= begin;
+      begin = 0;
+    }
+
+    while (stream.available() > 0) {
+      int count = stream.read(reinterpret_cast<uint8_t *>(buffer + end), SIZE - end);
+      if (count <= 0)
+        break;
+      end += count;
+
+      if (discarding) {
+        // Skip the rest of an overlong line
+        auto newline = static_cast<char *>(memchr(buffer, '\n', end));
+        if (!newline) {
+          end = 0;
+          continue;
+        }
+        discarding = false;
+        begin = newline - buffer + 1;
+      }
+
+      if (auto line = next_line())
+        return line;
+
+      if (begin) {
+        memmove(buffer, buffer + begin, end - begin);
+        end -= begin;
+        begin = 0;
+      }
+      if (end == SIZE) {
+        // Line does not fit, drop what we have and skip until its end
+        dropped = discarding = true;
+        end = 0;
+      }
+    }
+    return nullptr;
+  }
+};
+
+} // namespace utils
@@ -6,18 +6,38 @@
 
 #include <Arduino.h>
 
-#ifdef ARDUINO
-
 #include <algorithm>
 #include <list>
 #include <vector>
+
+#ifdef ARDUINO
 #include <QNEthernetClient.h>
 
 #include "util/PrintUtils.h" // QNEthernet
+#else
+#include "net/posix_client.h"
+#endif
 
 namespace utils {
 
+#ifdef ARDUINO
 using qindesign::network::EthernetClient;
+using qindesign::network::util::writeFully;
+#else
+using EthernetClient = net::PosixClient;
+
+/// Counterpart of QNEthernet's util::writeFully, which stops as soon as the target does not take any data
+inline size_t writeFully(Print &target, const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+  while (written < size) {
+    auto count = target.write(buffer + written, size - written);
+    if (!count)
+      break;
+    written += count;
+  }
+  return written;
+}
+#endif
 
 /**
  * A "multiplexer" for Print targets.
@@ -40,8 +60,18 @@ class PrintMultiplexer : public Print {
   std::list<Print *> print_targets;
   std::list<EthernetClient*> eth_targets;
 
+  /// The serial port if it was added and takes data. Native builds have none.
+  Print *serial_target() {
+#ifdef ARDUINO
+    if (serial && Serial.availableForWrite())
+      return &Serial;
+#endif
+    return nullptr;
+  }
+
 public:
   bool optimistic = false; ///< whether you prefer to send too much or too few
+  size_t dropped_writes = 0; ///< number of chunks write_or_drop() could not hand to some client
 
   void add(Print *target) { print_targets.push_back(target); }
   void add(EthernetClient *target) { eth_targets.push_back(target); }
@@ -55,7 +85,7 @@ public:
   /// Printables which go to all clients
   virtual size_t write(uint8_t b) override {
     bool success = true;
-    if(serial && Serial.availableForWrite())       success &= Serial.write(b) == 1;
+    if(auto port = serial_target())                success &= port->write(b) == 1;
     for (auto &target : print_targets) if (target) success &= target->write(b) == 1;
     for (auto &target :   eth_targets) if (target) success &= target->writeFully(b) == 1;
     return success ? 1 : (optimistic ? 1 : 0);
@@ -63,8 +93,8 @@ public:
 
   size_t write(const uint8_t *buffer, size_t size) override {
     bool success = true;
-    if(serial && Serial.availableForWrite())       success &= Serial.write(buffer,size) == size; // do not use writeFully
-    for (auto &target : print_targets) if (target) success &= qindesign::network::util::writeFully(*target, buffer, size) == size;
+    if(auto port = serial_target())                success &= port->write(buffer,size) == size; // do not use writeFully
+    for (auto &target : print_targets) if (target) success &= utils::writeFully(*target, buffer, size) == size;
     for (auto &target :   eth_targets) if (target) success &= target->writeFully(buffer, size) == size;
     // so do all this extra work of print_targets + eth_targets just to exploit that
     // EthernetClient::write_fully internally does a "still connected" check and if
@@ -73,13 +103,44 @@ public:
     return success ? size : (optimistic ? size : 0);
   }
 
+  /**
+   * Non-blocking variant of write(buffer, size), meant for streaming data where
+   * stalling is worse than losing data. The serial port and each network client
+   * get the whole chunk in a single write if their send buffer has room for it,
+   * otherwise the chunk is dropped for them. Other Print targets are written as
+   * usual, but a short write counts as a drop as well.
+   *
+   * @returns the number of targets which did not receive the chunk
+   **/
+  size_t write_or_drop(const uint8_t *buffer, size_t size) {
+    size_t dropped = 0;
+#ifdef ARDUINO
+    // Serial.write blocks until the USB host took the data, which a slow host may delay for long
+    if (serial) {
+      if (static_cast<size_t>(Serial.availableForWrite()) < size || Serial.write(buffer, size) != size)
+        dropped++;
+    }
+#endif
+    for (auto &target : print_targets)
+      if (target and target->write(buffer, size) != size)
+        dropped++;
+    for (auto &target : eth_targets) {
+      if (!target) continue;
+      if (static_cast<size_t>(target->availableForWrite()) >= size && target->write(buffer, size) == size)
+        continue;
+      dropped++;
+    }
+    dropped_writes += dropped;
+    return dropped;
+  }
+
   virtual void flush() override {
+#ifdef ARDUINO
     if(serial && Serial) Serial.flush();
+#endif
     for (auto &target : print_targets) if (target) target->flush();
     for (auto &target :   eth_targets) if (target) target->flush();
   }
 };
 
 } // namespace utils
-
-#endif // ARDUINO
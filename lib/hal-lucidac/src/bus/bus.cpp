@@ -3,11 +3,14 @@
 // SPDX-License-Identifier: MIT OR GPL-2.0-or-later
 
 #include "bus/bus.h"
+#include "bus/queue.h"
 
 #include "utils/logging.h"
 
 SPIClass &bus::spi = BUS_SPI_INTERFACE;
 
+const SPISettings bus::ADDRESS_SPI_SETTINGS{4'000'000, MSBFIRST, SPI_MODE2};
+
 FLASHMEM void bus::init() {
   LOG(ANABRID_DEBUG_INIT, __PRETTY_FUNCTION__);
 
@@ -32,7 +35,10 @@ void bus::address_function(uint8_t maddr, uint8_t faddr) {
 }
 
 void bus::address_function(bus::addr_t address) {
-  bus::spi.beginTransaction(SPISettings(4'000'000, MSBFIRST, SPI_MODE2));
+  // Anything queued before must happen before this
+  if (queue.is_pending())
+    queue.flush();
+  bus::spi.beginTransaction(ADDRESS_SPI_SETTINGS);
   delayNanoseconds(200);
   digitalWriteFast(PIN_ADDR_CS, LOW);
   delayNanoseconds(200);
@@ -23,6 +23,9 @@ namespace bus {
 
 extern SPIClass &spi;
 
+/// Settings for shifting out the address, which the address decoding logic expects.
+extern const SPISettings ADDRESS_SPI_SETTINGS;
+
 // MSBFIRST [16bit] = ADDR_[xx543210] + MADDR_[xxx43210]
 using addr_t = uint16_t;
 
@@ -109,6 +112,10 @@ void address_function(uint8_t cluster_idx, uint8_t block_idx, uint8_t func_idx);
 
 void address_function(uint8_t maddr, uint8_t faddr);
 
+/**
+ * Address a function given by its full address.
+ * Bus operations queued in an open CommandBatch (see bus/queue.h) are executed first.
+ */
 void address_function(addr_t address);
 
 void activate_address();
@@ -3,10 +3,15 @@
 // SPDX-License-Identifier: MIT OR GPL-2.0-or-later
 
 #include "bus/functions.h"
+#include "bus/queue.h"
 
 functions::Function::Function(const bus::addr_t address) : address(address) {}
 
 void functions::TriggerFunction::trigger() const {
+  if (bus::queue.is_active()) {
+    bus::queue.add_trigger(address);
+    return;
+  }
   bus::address_function(address);
   bus::activate_address();
   delayNanoseconds(2 * 42);
@@ -54,4 +59,27 @@ uint32_t functions::DataFunction::transfer32(uint32_t data_in) const {
   return ret;
 }
 
+void functions::DataFunction::write(const void *data, size_t count, uint16_t setup_ns) const {
+  if (bus::queue.is_active() and bus::queue.add_write(address, spi_settings, data, count, setup_ns))
+    return;
+  begin_communication();
+  if (setup_ns)
+    delayNanoseconds(setup_ns);
+  bus::spi.transfer(data, nullptr, count);
+  end_communication();
+}
+
+void functions::DataFunction::write8(uint8_t data, uint16_t setup_ns) const { write(&data, 1, setup_ns); }
+
+void functions::DataFunction::write16(uint16_t data, uint16_t setup_ns) const {
+  uint8_t buffer[2] = {static_cast<uint8_t>(data >> 8), static_cast<uint8_t>(data)};
+  write(buffer, sizeof(buffer), setup_ns);
+}
+
+void functions::DataFunction::write32(uint32_t data, uint16_t setup_ns) const {
+  uint8_t buffer[4] = {static_cast<uint8_t>(data >> 24), static_cast<uint8_t>(data >> 16),
+                       static_cast<uint8_t>(data >> 8), static_cast<uint8_t>(data)};
+  write(buffer, sizeof(buffer), setup_ns);
+}
+
 SPIClass &functions::DataFunction::get_raw_spi() { return bus::spi; }
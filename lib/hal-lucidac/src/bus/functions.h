@@ -32,6 +32,7 @@ public:
  **/
 class TriggerFunction : public Function {
 public:
+  /// Triggers the action, which is queued if a bus::CommandBatch is open.
   void trigger() const;
 
   using Function::Function;
@@ -70,6 +71,16 @@ protected:
   uint8_t transfer8(uint8_t data_in) const;
   uint16_t transfer16(uint16_t data_in) const;
   uint32_t transfer32(uint32_t data_in) const;
+
+  /*
+   * Write-only counterparts of the transfer functions, which are queued if a bus::CommandBatch is open.
+   * Multi-byte values are sent most significant byte first, as with transfer16 and transfer32.
+   * The setup_ns delay is inserted between activating the address and sending data.
+   */
+  void write(const void *data, size_t count, uint16_t setup_ns = 0) const;
+  void write8(uint8_t data, uint16_t setup_ns = 0) const;
+  void write16(uint16_t data, uint16_t setup_ns = 0) const;
+  void write32(uint32_t data, uint16_t setup_ns = 0) const;
 };
 
 } // namespace functions
\ No newline at end of file
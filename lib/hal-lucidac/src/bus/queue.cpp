@@ -0,0 +1,141 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "bus/queue.h"
+
+#include <cstring>
+
+namespace {
+bus::HardwareExecutor hardware_executor;
+}
+
+bus::CommandQueue bus::queue{&hardware_executor};
+
+// NOT FLASHMEM
+bool bus::HardwareExecutor::use_settings(const SPISettings *settings) {
+  if (same_settings(settings, current_settings))
+    return false;
+  if (current_settings)
+    spi.endTransaction();
+  spi.beginTransaction(*settings);
+  current_settings = settings;
+  return true;
+}
+
+// NOT FLASHMEM
+void bus::HardwareExecutor::select(addr_t address) {
+  // Clock polarity may have changed, like bus::address_function does
+  if (use_settings(&ADDRESS_SPI_SETTINGS))
+    delayNanoseconds(SETTLE_NS);
+  digitalWriteFast(PIN_ADDR_CS, LOW);
+  delayNanoseconds(SETTLE_NS);
+  spi.transfer16(address);
+  delayNanoseconds(SETTLE_NS);
+  digitalWriteFast(PIN_ADDR_CS, HIGH);
+  delayNanoseconds(SETTLE_NS);
+}
+
+// NOT FLASHMEM
+void bus::HardwareExecutor::latch() {
+  digitalWriteFast(PIN_ADDR_LATCH, HIGH);
+  delayNanoseconds(SETTLE_NS);
+  digitalWriteFast(PIN_ADDR_LATCH, LOW);
+}
+
+// NOT FLASHMEM
+void bus::HardwareExecutor::release() {
+  digitalWriteFast(PIN_ADDR_RESET, LOW);
+  delayNanoseconds(SETTLE_NS);
+  latch();
+  delayNanoseconds(SETTLE_NS);
+  digitalWriteFast(PIN_ADDR_RESET, HIGH);
+}
+
+// NOT FLASHMEM
+void bus::HardwareExecutor::execute(const Command *commands, size_t count, const uint8_t *payload) {
+  for (size_t idx = 0; idx < count; idx++) {
+    const auto &command = commands[idx];
+    switch (command.type) {
+    case Command::Type::DELAY:
+      delayNanoseconds(command.delay_ns);
+      break;
+    case Command::Type::TRIGGER:
+      select(command.address);
+      latch();
+      delayNanoseconds(TRIGGER_PULSE_NS);
+      release();
+      break;
+    case Command::Type::WRITE:
+      select(command.address);
+      // The latch gives the clock polarity time to settle, as for the immediate bus functions
+      use_settings(command.settings);
+      latch();
+      if (command.delay_ns)
+        delayNanoseconds(command.delay_ns);
+      spi.transfer(payload + command.offset, nullptr, command.size);
+      release();
+      break;
+    }
+  }
+  if (current_settings) {
+    spi.endTransaction();
+    current_settings = nullptr;
+  }
+}
+
+FLASHMEM bus::CommandQueue::CommandQueue(CommandExecutor *executor) : executor(executor) {}
+
+FLASHMEM void bus::CommandQueue::set_executor(CommandExecutor *executor_) {
+  flush();
+  executor = executor_;
+}
+
+void bus::CommandQueue::begin() { depth++; }
+
+void bus::CommandQueue::end() {
+  if (depth and !--depth)
+    flush();
+}
+
+void bus::CommandQueue::add_trigger(addr_t address) {
+  if (num_commands == MAX_COMMANDS)
+    flush();
+  commands[num_commands++] = {Command::Type::TRIGGER, address, 0, nullptr, 0, 0};
+}
+
+bool bus::CommandQueue::add_write(addr_t address, const SPISettings &settings, const void *data, size_t count,
+                                  uint16_t setup_ns) {
+  if (count > MAX_PAYLOAD)
+    return false;
+  if (num_commands == MAX_COMMANDS or payload_size + count > MAX_PAYLOAD)
+    flush();
+  memcpy(payload.data() + payload_size, data, count);
+  commands[num_commands++] = {Command::Type::WRITE, address, setup_ns, &settings,
+                              static_cast<uint16_t>(payload_size), static_cast<uint16_t>(count)};
+  payload_size += count;
+  return true;
+}
+
+void bus::CommandQueue::add_delay(uint16_t ns) {
+  if (num_commands == MAX_COMMANDS)
+    flush();
+  commands[num_commands++] = {Command::Type::DELAY, NULL_ADDRESS, ns, nullptr, 0, 0};
+}
+
+void bus::CommandQueue::flush() {
+  if (!num_commands)
+    return;
+  // Reset before executing, the executor only reads what was recorded
+  auto count = num_commands;
+  num_commands = 0;
+  payload_size = 0;
+  executor->execute(commands.data(), count, payload.data());
+}
+
+void bus::wait_nanoseconds(uint16_t ns) {
+  if (queue.is_active())
+    queue.add_delay(ns);
+  else
+    delayNanoseconds(ns);
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "bus/bus.h"
+
+namespace bus {
+
+/// Time between edges of CS, LATCH and RESET in a batch, in nanoseconds, the same as for the immediate bus functions.
+constexpr uint16_t SETTLE_NS = 200;
+
+/// Pulse length of a trigger, the same as for an immediate TriggerFunction::trigger().
+constexpr uint16_t TRIGGER_PULSE_NS = 2 * 42;
+
+/**
+ * A single recorded bus operation.
+ *
+ * WRITE commands refer to their payload in the byte pool of the CommandQueue,
+ * which is stored in the order it goes over the wire (most significant byte first).
+ **/
+struct Command {
+  enum class Type : uint8_t { TRIGGER, WRITE, DELAY };
+
+  Type type;
+  addr_t address;
+  /// WRITE: delay between activating the address and sending data. DELAY: its duration.
+  uint16_t delay_ns;
+  const SPISettings *settings;
+  uint16_t offset, size;
+};
+
+/**
+ * Whether two SPI settings configure the bus the same way, even if they are different objects,
+ * such as the ones of chips using the same mode and clock as the address. SPISettings only holds
+ * the values for the registers of the SPI peripheral.
+ **/
+inline bool same_settings(const SPISettings *a, const SPISettings *b) {
+  return a == b or (a and b and !memcmp(a, b, sizeof(SPISettings)));
+}
+
+/**
+ * Executes a sequence of commands on some backend.
+ * On the device, this is the bus itself (see HardwareExecutor),
+ * in tests it can be a recorder checking what would have been sent.
+ **/
+class CommandExecutor {
+public:
+  virtual void execute(const Command *commands, size_t count, const uint8_t *payload) = 0;
+};
+
+/**
+ * Executes commands on the digital bus back-to-back.
+ *
+ * Compared to the immediate bus functions, the SPI transaction is kept open
+ * over the whole sequence and only reconfigured when the settings change,
+ * i.e. not for writes to chips using the same settings as the address.
+ **/
+class HardwareExecutor : public CommandExecutor {
+  const SPISettings *current_settings = nullptr;
+
+  /// Returns whether the settings had to be changed
+  bool use_settings(const SPISettings *settings);
+  void select(addr_t address);
+  static void latch();
+  static void release();
+
+public:
+  void execute(const Command *commands, size_t count, const uint8_t *payload) override;
+};
+
+/**
+ * Records bus operations of a whole configuration write and executes them in one go.
+ *
+ * Only operations which do not read anything back can be queued.
+ * Any immediate bus access (see address_function) flushes the queue first,
+ * so the order of operations on the bus is always the one of the calls.
+ * Use CommandBatch to open and close a batch.
+ **/
+class CommandQueue {
+public:
+  static constexpr size_t MAX_COMMANDS = 256;
+  static constexpr size_t MAX_PAYLOAD = 1024;
+
+private:
+  std::array<Command, MAX_COMMANDS> commands{};
+  std::array<uint8_t, MAX_PAYLOAD> payload{};
+  size_t num_commands = 0;
+  size_t payload_size = 0;
+  unsigned int depth = 0;
+  CommandExecutor *executor;
+
+public:
+  explicit CommandQueue(CommandExecutor *executor);
+
+  CommandExecutor *get_executor() const { return executor; }
+  /// Replaces the backend, flushing everything pending to the old one.
+  void set_executor(CommandExecutor *executor_);
+
+  /// Whether a batch is open and operations should be queued.
+  bool is_active() const { return depth; }
+  /// Whether there are operations waiting to be executed.
+  bool is_pending() const { return num_commands; }
+  size_t size() const { return num_commands; }
+
+  void begin();
+  void end();
+
+  void add_trigger(addr_t address);
+  /// Returns false if count is too large to ever be queued, in which case nothing is added.
+  bool add_write(addr_t address, const SPISettings &settings, const void *data, size_t count,
+                 uint16_t setup_ns = 0);
+  void add_delay(uint16_t ns);
+
+  void flush();
+};
+
+extern CommandQueue queue;
+
+/**
+ * Scope guard batching all bus writes until it is destroyed.
+ * Batches can be nested, in which case the outermost one executes everything.
+ **/
+class CommandBatch {
+public:
+  CommandBatch() { queue.begin(); }
+  ~CommandBatch() { queue.end(); }
+
+  CommandBatch(const CommandBatch &) = delete;
+  CommandBatch &operator=(const CommandBatch &) = delete;
+};
+
+/// Waits for some time between bus operations, which is queued as well if a batch is open.
+void wait_nanoseconds(uint16_t ns);
+
+} // namespace bus
@@ -0,0 +1,101 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bus/queue.h"
+
+namespace bus {
+
+/**
+ * Command backend which records what would have been sent, for tests on the host.
+ *
+ * Next to the sequence of commands, it accounts the time the bus would be busy,
+ * both for the batched execution and as if every command was executed by the
+ * immediate bus functions. The model assumes the 4MHz clock all bus functions use
+ * and ignores CPU time, so it is a lower bound of the real timing.
+ **/
+class RecordingExecutor : public CommandExecutor {
+public:
+  struct Record {
+    Command::Type type;
+    addr_t address;
+    uint16_t delay_ns;
+    const SPISettings *settings;
+    std::vector<uint8_t> data;
+  };
+
+  static constexpr uint32_t NS_PER_BIT = 1'000'000'000 / 4'000'000;
+  static constexpr uint32_t IMMEDIATE_SETTLE_NS = 200;
+
+  std::vector<Record> records;
+  unsigned int executions = 0;
+  /// Number of times the SPI settings would have been changed within a batch
+  unsigned int settings_changes = 0;
+  uint64_t batched_ns = 0;
+  uint64_t immediate_ns = 0;
+
+private:
+  const SPISettings *current_settings = nullptr;
+
+  bool use_settings(const SPISettings *settings) {
+    if (same_settings(settings, current_settings))
+      return false;
+    // Beginning the transaction is not a change
+    if (current_settings)
+      settings_changes++;
+    current_settings = settings;
+    return true;
+  }
+
+  static constexpr uint32_t address_ns(uint32_t settle_ns) { return 3 * settle_ns + 16 * NS_PER_BIT; }
+  static constexpr uint32_t release_ns(uint32_t settle_ns) { return 3 * settle_ns; }
+
+public:
+  void execute(const Command *commands, size_t count, const uint8_t *payload) override {
+    executions++;
+    for (size_t idx = 0; idx < count; idx++) {
+      const auto &command = commands[idx];
+      Record record{command.type, command.address, command.delay_ns, command.settings, {}};
+      switch (command.type) {
+      case Command::Type::DELAY:
+        batched_ns += command.delay_ns;
+        immediate_ns += command.delay_ns;
+        break;
+      case Command::Type::TRIGGER:
+        if (use_settings(&ADDRESS_SPI_SETTINGS))
+          batched_ns += SETTLE_NS;
+        batched_ns += address_ns(SETTLE_NS) + SETTLE_NS + TRIGGER_PULSE_NS + release_ns(SETTLE_NS);
+        immediate_ns += IMMEDIATE_SETTLE_NS + address_ns(IMMEDIATE_SETTLE_NS) + IMMEDIATE_SETTLE_NS +
+                        TRIGGER_PULSE_NS + release_ns(IMMEDIATE_SETTLE_NS);
+        break;
+      case Command::Type::WRITE: {
+        record.data.assign(payload + command.offset, payload + command.offset + command.size);
+        uint32_t data_ns = command.delay_ns + 8 * command.size * NS_PER_BIT;
+        if (use_settings(&ADDRESS_SPI_SETTINGS))
+          batched_ns += SETTLE_NS;
+        use_settings(command.settings);
+        batched_ns += address_ns(SETTLE_NS) + SETTLE_NS + data_ns + release_ns(SETTLE_NS);
+        immediate_ns += IMMEDIATE_SETTLE_NS + address_ns(IMMEDIATE_SETTLE_NS) + IMMEDIATE_SETTLE_NS + data_ns +
+                        release_ns(IMMEDIATE_SETTLE_NS);
+        break;
+      }
+      }
+      records.push_back(std::move(record));
+    }
+    current_settings = nullptr;
+  }
+
+  void clear() {
+    records.clear();
+    executions = settings_changes = 0;
+    batched_ns = immediate_ns = 0;
+  }
+};
+
+} // namespace bus
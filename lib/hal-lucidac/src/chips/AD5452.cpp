@@ -24,11 +24,8 @@ float functions::AD5452::raw_to_float(uint16_t raw) {
 }
 
 void functions::AD5452::set_scale(uint16_t scale_raw) const {
-  begin_communication();
   // AD5452 expects at least 13ns delay between chip select and data
-  delayNanoseconds(15);
-  bus::spi.transfer16(scale_raw);
-  end_communication();
+  write16(scale_raw, 15);
 }
 
 void functions::AD5452::set_scale(float scale) const {
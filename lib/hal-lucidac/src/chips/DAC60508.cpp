@@ -19,10 +19,9 @@ uint16_t functions::DAC60508::read_register(uint8_t address) const {
 }
 
 bool functions::DAC60508::write_register(uint8_t address, uint16_t data) const {
-  begin_communication();
-  get_raw_spi().transfer(address & 0b0'000'1111);
-  get_raw_spi().transfer16(data);
-  end_communication();
+  uint8_t buffer[3] = {static_cast<uint8_t>(address & 0b0'000'1111), static_cast<uint8_t>(data >> 8),
+                       static_cast<uint8_t>(data)};
+  write(buffer, sizeof(buffer));
 
 #ifdef ANABRID_PEDANTIC
   return data == read_register(address);
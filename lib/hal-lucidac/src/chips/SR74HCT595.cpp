@@ -17,6 +17,10 @@ functions::SR74HCT595::SR74HCT595(bus::addr_t address, bool shift_clock)
 
 bool functions::SR74HCT595::transfer8(uint8_t data_in, uint8_t *data_out) const {
 #ifndef ANABRID_PEDANTIC
+  if (!data_out) {
+    DataFunction::write8(data_in);
+    return true;
+  }
   uint8_t ret = DataFunction::transfer8(data_in);
   if (data_out)
     *data_out = ret;
@@ -35,6 +39,10 @@ bool functions::SR74HCT595::transfer8(uint8_t data_in, uint8_t *data_out) const
 
 bool functions::SR74HCT595::transfer16(uint16_t data_in, uint16_t *data_out) const {
 #ifndef ANABRID_PEDANTIC
+  if (!data_out) {
+    DataFunction::write16(data_in);
+    return true;
+  }
   uint16_t ret = DataFunction::transfer16(data_in);
   if (data_out)
     *data_out = ret;
@@ -53,6 +61,10 @@ bool functions::SR74HCT595::transfer16(uint16_t data_in, uint16_t *data_out) con
 
 bool functions::SR74HCT595::transfer32(uint32_t data_in, uint32_t *data_out) const {
 #ifndef ANABRID_PEDANTIC
+  if (!data_out) {
+    DataFunction::write32(data_in);
+    return true;
+  }
   uint32_t ret = DataFunction::transfer32(data_in);
   if (data_out)
     *data_out = ret;
@@ -31,8 +31,14 @@ public:
   FunctionBlock(std::string entity_id, const bus::addr_t block_address)
       : entities::Entity(std::move(entity_id)), block_address(block_address) {}
 
+  bool init() override {
+    // Whatever the hardware holds after initialization, it is not our configuration
+    mark_dirty();
+    return entities::Entity::init();
+  }
+
   virtual std::array<uint8_t, 8> get_entity_eui() const override {
-    return metadata::MetadataEditor(block_address).read_eui();
+    return metadata::cache.get_eui(block_address);
   }
 
   std::vector<Entity *> get_child_entities() override {
@@ -43,7 +49,7 @@ public:
     return {};
   }
 
-  Entity *get_child_entity(const std::string &child_id) override {
+  Entity *get_child_entity(std::string_view child_id) override {
     // FunctionBlocks do not give direct access to their children
     return nullptr;
   }
@@ -7,7 +7,10 @@
 #include "utils/logging.h"
 
 FLASHMEM blocks::CBlock::CBlock(const bus::addr_t block_address, CBlockHAL *hardware)
-    : FunctionBlock("C", block_address), hardware(hardware) {}
+    : FunctionBlock("C", block_address), hardware(hardware) {
+  factors_to_raw(factors_, gain_corrections_, raw_factors_);
+  dirty_.set();
+}
 
 FLASHMEM blocks::CBlock::CBlock() : CBlock(bus::NULL_ADDRESS, new CBlockHALDummy()) {}
 
@@ -27,11 +30,33 @@ FLASHMEM bool blocks::CBlock::set_factor(uint8_t idx, float factor) {
   if (factor > MAX_FACTOR or factor < MIN_FACTOR)
     return false;
 
-  factors_[idx] = factor;
+  if (factors_[idx] != factor) {
+    factors_[idx] = factor;
+    raw_factors_[idx] = factor_to_raw(factor, gain_corrections_[idx]);
+    dirty_.set(idx);
+  }
   return true;
 }
 
-FLASHMEM void blocks::CBlock::set_factors(const std::array<float, NUM_COEFF> &factors) { factors_ = factors; }
+FLASHMEM void blocks::CBlock::set_factors(const std::array<float, NUM_COEFF> &factors) {
+  bool changed = false;
+  for (size_t i = 0; i < NUM_COEFF; i++)
+    if (factors_[i] != factors[i]) {
+      factors_[i] = factors[i];
+      dirty_.set(i);
+      changed = true;
+    }
+  if (changed)
+    factors_to_raw(factors_, gain_corrections_, raw_factors_);
+}
+
+// NOT FLASHMEM
+void blocks::CBlock::factors_to_raw(const std::array<float, NUM_COEFF> &factors,
+                                    const std::array<float, NUM_COEFF> &gain_corrections,
+                                    std::array<uint16_t, NUM_COEFF> &raw) {
+  for (size_t i = 0; i < NUM_COEFF; i++)
+    raw[i] = factor_to_raw(factors[i], gain_corrections[i]);
+}
 
 FLASHMEM utils::status blocks::CBlock::write_to_hardware() {
   if (!write_factors_to_hardware()) {
@@ -41,14 +66,32 @@ FLASHMEM utils::status blocks::CBlock::write_to_hardware() {
   return utils::status::success();
 }
 
+FLASHMEM utils::status blocks::CBlock::write_factor_to_hardware(uint8_t idx) {
+  if (idx >= NUM_COEFF)
+    return utils::status("CBlock coefficient index out of range");
+  if (!hardware->write_factor(idx, raw_factors_[idx])) {
+    LOG(ANABRID_PEDANTIC, __PRETTY_FUNCTION__);
+    return utils::status::failure();
+  }
+  dirty_.reset(idx);
+  return utils::status::success();
+}
+
 FLASHMEM bool blocks::CBlock::write_factors_to_hardware() {
+  if (dirty_.none())
+    return true;
   for (size_t i = 0; i < factors_.size(); i++) {
-    if (!hardware->write_factor(i, factors_[i] * gain_corrections_[i]))
+    if (!dirty_.test(i))
+      continue;
+    if (!hardware->write_factor(i, raw_factors_[i]))
       return false;
+    dirty_.reset(i);
   }
   return true;
 }
 
+FLASHMEM void blocks::CBlock::mark_dirty() { dirty_.set(); }
+
 FLASHMEM void blocks::CBlock::reset(entities::ResetAction action) {
   FunctionBlock::reset(action);
 
@@ -71,20 +114,34 @@ FLASHMEM const std::array<float, blocks::CBlock::NUM_COEFF> &blocks::CBlock::get
 }
 
 FLASHMEM void blocks::CBlock::reset_gain_corrections() {
-  std::fill(gain_corrections_.begin(), gain_corrections_.end(), 1.0f);
+  std::array<float, NUM_COEFF> corrections;
+  corrections.fill(1.0f);
+  set_gain_corrections(corrections);
 }
 
 FLASHMEM void blocks::CBlock::set_gain_corrections(const std::array<float, NUM_COEFF> &corrections) {
-  gain_corrections_ = corrections;
+  bool changed = false;
+  for (size_t i = 0; i < NUM_COEFF; i++)
+    if (gain_corrections_[i] != corrections[i]) {
+      gain_corrections_[i] = corrections[i];
+      dirty_.set(i);
+      changed = true;
+    }
+  if (changed)
+    factors_to_raw(factors_, gain_corrections_, raw_factors_);
 };
 
 FLASHMEM bool blocks::CBlock::set_gain_correction(const uint8_t coeff_idx, const float correction) {
-  if (coeff_idx > NUM_COEFF)
+  if (coeff_idx >= NUM_COEFF)
     return false;
   // Gain correction must be positive and close to 1
   if (fabs(1.0f - correction) > MAX_GAIN_CORRECTION_ABS)
     return false;
-  gain_corrections_[coeff_idx] = correction;
+  if (gain_corrections_[coeff_idx] != correction) {
+    gain_corrections_[coeff_idx] = correction;
+    raw_factors_[coeff_idx] = factor_to_raw(factors_[coeff_idx], correction);
+    dirty_.set(coeff_idx);
+  }
   return true;
 };
 
@@ -207,11 +264,11 @@ FLASHMEM blocks::CBlockHAL_Common::CBlockHAL_Common(bus::addr_t block_address,
                                                     std::array<const uint8_t, 32> f_coeffs_cs)
     : f_coeffs(make_f_coeffs(block_address, f_coeffs_cs)) {}
 
-FLASHMEM bool blocks::CBlockHAL_Common::write_factor(uint8_t idx, float value) {
+FLASHMEM bool blocks::CBlockHAL_Common::write_factor(uint8_t idx, uint16_t raw) {
   if (idx >= 32)
     return false;
   // NOTE: The current hardware does not allow any error detection here.
-  f_coeffs[idx].set_scale(value);
+  f_coeffs[idx].set_scale(raw);
   return true;
 }
 
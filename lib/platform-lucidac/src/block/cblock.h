@@ -5,6 +5,7 @@
 #pragma once
 
 #include <array>
+#include <bitset>
 #include <cstdint>
 
 #include "block/base.h"
@@ -26,12 +27,13 @@ namespace blocks {
 
 class CBlockHAL : public FunctionBlockHAL {
 public:
-  virtual bool write_factor(uint8_t idx, float value) = 0;
+  //! Writes the raw AD5452 code of a coefficient, @see CBlock::factor_to_raw.
+  virtual bool write_factor(uint8_t idx, uint16_t raw) = 0;
 };
 
 class CBlockHALDummy : public CBlockHAL {
 public:
-  bool write_factor(uint8_t idx, float value) override { return true; }
+  bool write_factor(uint8_t idx, uint16_t raw) override { return true; }
 };
 
 class CBlockHAL_Common : public CBlockHAL {
@@ -44,7 +46,7 @@ public:
 
   CBlockHAL_Common(bus::addr_t block_address, std::array<const uint8_t, 32> f_coeffs_cs);
 
-  bool write_factor(uint8_t idx, float value) override;
+  bool write_factor(uint8_t idx, uint16_t raw) override;
 };
 
 class CBlockHAL_V_1_1_X : public CBlockHAL_Common {
@@ -105,6 +107,25 @@ public:
   static constexpr float MAX_FACTOR = +1.01f;
   static constexpr float MAX_GAIN_CORRECTION_ABS = 0.1f;
 
+  /**
+   * Converts a factor with its gain correction to the nearest AD5452 code.
+   * Unlike functions::AD5452::float_to_raw, this rounds instead of truncating.
+   **/
+  static uint16_t factor_to_raw(float factor, float gain_correction) {
+    float raw = factor * gain_correction * functions::AD5452::RAW_DELTA_ONE + functions::AD5452::RAW_ZERO + 0.5f;
+    raw = raw < functions::AD5452::RAW_MIN ? functions::AD5452::RAW_MIN : raw;
+    raw = raw > functions::AD5452::RAW_MAX ? functions::AD5452::RAW_MAX : raw;
+    return static_cast<uint16_t>(raw);
+  }
+
+  /**
+   * Converts all factors at once, with the same result as factor_to_raw.
+   * The loop has no branches, such that the compiler can vectorize it.
+   **/
+  static void factors_to_raw(const std::array<float, NUM_COEFF> &factors,
+                             const std::array<float, NUM_COEFF> &gain_corrections,
+                             std::array<uint16_t, NUM_COEFF> &raw);
+
 protected:
   CBlockHAL *hardware;
 
@@ -115,6 +136,11 @@ protected:
       {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
        1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}};
 
+  /// AD5452 codes of the factors with their gain corrections applied, as written to the hardware.
+  std::array<uint16_t, NUM_COEFF> raw_factors_;
+  /// Coefficients whose factor or gain correction changed since they were last written.
+  std::bitset<NUM_COEFF> dirty_;
+
   [[nodiscard]] bool write_factors_to_hardware();
 
 public:
@@ -155,7 +181,14 @@ public:
 
   void reset_gain_corrections();
 
+  //! The codes written by write_to_hardware(), updated whenever a factor or gain correction changes.
+  const std::array<uint16_t, NUM_COEFF> &get_raw_factors() const { return raw_factors_; }
+
+  /// Writes the coefficients which changed since they were last written.
   [[nodiscard]] utils::status write_to_hardware() override;
+  /// Writes a single coefficient only, e.g. after changing it with set_factor().
+  [[nodiscard]] utils::status write_factor_to_hardware(uint8_t idx);
+  void mark_dirty() override;
   void reset(entities::ResetAction action) override;
 
   utils::status config_self_from_json(JsonObjectConst cfg) override;
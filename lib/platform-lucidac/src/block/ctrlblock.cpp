@@ -52,9 +52,16 @@ FLASHMEM utils::status blocks::CTRLBlock::config_self_from_json(JsonObjectConst
 }
 
 FLASHMEM utils::status blocks::CTRLBlock::write_to_hardware() {
-  return utils::status(hardware->write_adc_bus_muxers(adc_bus));
+  if (!adc_bus_dirty)
+    return utils::status::success();
+  if (!hardware->write_adc_bus_muxers(adc_bus))
+    return utils::status::failure();
+  adc_bus_dirty = false;
+  return utils::status::success();
 }
 
+FLASHMEM void blocks::CTRLBlock::mark_dirty() { adc_bus_dirty = true; }
+
 FLASHMEM bool blocks::CTRLBlock::init() {
   // Hardware defaults are not very good, e.g. adc bus is by default on CL0_GAIN.
   // That's why we write more sane defaults on init.
@@ -63,9 +70,14 @@ FLASHMEM bool blocks::CTRLBlock::init() {
 
 blocks::CTRLBlock::ADCBus blocks::CTRLBlock::get_adc_bus() const { return adc_bus; }
 
-FLASHMEM void blocks::CTRLBlock::set_adc_bus(blocks::CTRLBlock::ADCBus adc_bus_) { adc_bus = adc_bus_; }
+FLASHMEM void blocks::CTRLBlock::set_adc_bus(blocks::CTRLBlock::ADCBus adc_bus_) {
+  if (adc_bus != adc_bus_) {
+    adc_bus = adc_bus_;
+    adc_bus_dirty = true;
+  }
+}
 
-FLASHMEM void blocks::CTRLBlock::reset_adc_bus() { adc_bus = ADCBus::ADC; }
+FLASHMEM void blocks::CTRLBlock::reset_adc_bus() { set_adc_bus(ADCBus::ADC); }
 
 FLASHMEM bool blocks::CTRLBlock::set_adc_bus_to_cluster_gain(uint8_t cluster_idx) {
   if (cluster_idx >= 3)
@@ -64,6 +64,7 @@ public:
 
 protected:
   ADCBus adc_bus = ADCBus::ADC;
+  bool adc_bus_dirty = true;
   CTRLBlockHALBase *hardware;
 
 public:
@@ -76,6 +77,7 @@ public:
   void reset(entities::ResetAction action) override;
 
   [[nodiscard]] utils::status write_to_hardware() override;
+  void mark_dirty() override;
 
   ADCBus get_adc_bus() const;
   void set_adc_bus(ADCBus adc_bus_);
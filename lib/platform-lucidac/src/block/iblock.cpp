@@ -4,7 +4,10 @@
 
 #include "block/iblock.h"
 
+#include <charconv>
+
 #include "bus/functions.h"
+#include "bus/queue.h"
 #include "utils/logging.h"
 
 const SPISettings functions::ICommandRegisterFunction::DEFAULT_SPI_SETTINGS{
@@ -19,7 +22,22 @@ uint8_t functions::ICommandRegisterFunction::chip_cmd_word(uint8_t chip_input_id
 }
 
 FLASHMEM utils::status blocks::IBlock::write_to_hardware() {
-  return utils::status(hardware->write_upscaling(scaling_factors) and hardware->write_outputs(outputs));
+  if (upscaling_dirty) {
+    if (!hardware->write_upscaling(scaling_factors))
+      return utils::status::failure();
+    upscaling_dirty = false;
+  }
+  if (outputs_dirty) {
+    if (!hardware->write_outputs(outputs))
+      return utils::status::failure();
+    outputs_dirty = false;
+  }
+  return utils::status::success();
+}
+
+FLASHMEM void blocks::IBlock::mark_dirty() {
+  outputs_dirty = true;
+  upscaling_dirty = true;
 }
 
 FLASHMEM bool blocks::IBlock::init() {
@@ -39,6 +57,13 @@ FLASHMEM bool blocks::IBlock::_is_connected(uint8_t input, uint8_t output) const
 
 FLASHMEM bool blocks::IBlock::_is_output_connected(uint8_t output) const { return outputs[output]; }
 
+FLASHMEM void blocks::IBlock::_set_output(uint8_t output, uint32_t inputs) {
+  if (outputs[output] != inputs) {
+    outputs[output] = inputs;
+    outputs_dirty = true;
+  }
+}
+
 FLASHMEM bool blocks::IBlock::is_connected(uint8_t input, uint8_t output) const {
   if (output >= NUM_OUTPUTS or input >= NUM_INPUTS)
     return false;
@@ -69,16 +94,15 @@ FLASHMEM bool blocks::IBlock::connect(uint8_t input, uint8_t output, bool exclus
   }
 
   if (exclusive)
-    outputs[output] = INPUT_BITMASK(input);
+    _set_output(output, INPUT_BITMASK(input));
   else
-    outputs[output] |= INPUT_BITMASK(input);
+    _set_output(output, outputs[output] | INPUT_BITMASK(input));
   return true;
 }
 
 FLASHMEM void blocks::IBlock::reset_outputs() {
-  for (auto &output : outputs) {
-    output = 0;
-  }
+  for (auto output : OUTPUT_IDX_RANGE())
+    _set_output(output, 0);
 }
 
 FLASHMEM void blocks::IBlock::reset(entities::ResetAction action) {
@@ -96,9 +120,15 @@ FLASHMEM utils::status blocks::IBlock::config_self_from_json(JsonObjectConst cfg
 #endif
   for (auto cfgItr = cfg.begin(); cfgItr != cfg.end(); ++cfgItr) {
     if (cfgItr->key() == "outputs") {
+      // Outputs are cleared before they are set, so re-applying unchanged outputs
+      // must not make the matrix dirty
+      auto previous_outputs = outputs;
+      auto was_dirty = outputs_dirty;
       auto res = _config_outputs_from_json(cfgItr->value());
       if (!res)
         return res;
+      if (outputs == previous_outputs)
+        outputs_dirty = was_dirty;
     } else if (cfgItr->key() == "upscaling") {
       auto res = _config_upscaling_from_json(cfgItr->value());
       if (!res)
@@ -116,16 +146,16 @@ FLASHMEM utils::status blocks::IBlock::_config_outputs_from_json(const JsonVaria
   if (cfg.is<JsonObjectConst>()) {
     for (JsonPairConst keyval : cfg.as<JsonObjectConst>()) {
       // Key defines output
-      // TODO: Check conversion from string to number
-
-      std::string output_str = keyval.key().c_str();
-      if (!utils::is_number(output_str.begin(), output_str.end()))
-        return utils::status("IBlock: Expected number but key is '%s'", output_str.c_str());
+      auto output_str = keyval.key().c_str();
+      auto output_str_end = output_str + keyval.key().size();
+      unsigned long output;
+      auto [end, error] = std::from_chars(output_str, output_str_end, output);
+      if (error != std::errc() or end != output_str_end)
+        return utils::status("IBlock: Expected number but key is '%s'", output_str);
 
-      auto output = std::stoul(output_str);
       // Disconnect also sanity checks output index for us
-      if (!disconnect(output))
-        return utils::status("IBlock: Could not disconnect output '%d', probably out of range", output);
+      if (output > UINT8_MAX or !disconnect(output))
+        return utils::status("IBlock: Could not disconnect output '%lu', probably out of range", output);
       // Input may be given as list or as a single number
       auto res = _connect_from_json(keyval.value(), output);
       if (!res)
@@ -159,7 +189,12 @@ FLASHMEM utils::status blocks::IBlock::_config_upscaling_from_json(const JsonVar
       if (!keyval.value().is<bool>())
         return utils::status("IBlock upscaling must be boolean");
 
-      auto input = std::stoul(keyval.key().c_str());
+      auto input_str = keyval.key().c_str();
+      auto input_str_end = input_str + keyval.key().size();
+      unsigned long input;
+      auto [end, error] = std::from_chars(input_str, input_str_end, input);
+      if (error != std::errc() or end != input_str_end)
+        return utils::status("IBlock: Expected number but key is '%s'", input_str);
       if (input > NUM_INPUTS)
         return utils::status("IBlock upscaling too many values");
 
@@ -204,27 +239,35 @@ FLASHMEM bool blocks::IBlock::disconnect(uint8_t input, uint8_t output) {
   // Fail if input was not connected
   if (!is_connected(input, output))
     return false;
-  outputs[output] &= ~INPUT_BITMASK(input);
+  _set_output(output, outputs[output] & ~INPUT_BITMASK(input));
   return true;
 }
 
 FLASHMEM bool blocks::IBlock::disconnect(uint8_t output) {
   if (output >= NUM_OUTPUTS)
     return false;
-  outputs[output] = 0;
+  _set_output(output, 0);
   return true;
 }
 
 FLASHMEM bool blocks::IBlock::set_upscaling(uint8_t input, bool upscale) {
   if (input >= NUM_INPUTS)
     return false;
-  scaling_factors[input] = upscale;
+  if (scaling_factors[input] != upscale) {
+    scaling_factors[input] = upscale;
+    upscaling_dirty = true;
+  }
   return true;
 }
 
-FLASHMEM void blocks::IBlock::set_upscaling(std::bitset<NUM_INPUTS> scales) { scaling_factors = scales; }
+FLASHMEM void blocks::IBlock::set_upscaling(std::bitset<NUM_INPUTS> scales) {
+  if (scaling_factors != scales) {
+    scaling_factors = scales;
+    upscaling_dirty = true;
+  }
+}
 
-FLASHMEM void blocks::IBlock::reset_upscaling() { scaling_factors.reset(); }
+FLASHMEM void blocks::IBlock::reset_upscaling() { set_upscaling(std::bitset<NUM_INPUTS>{}); }
 
 FLASHMEM bool blocks::IBlock::get_upscaling(uint8_t output) const {
   if (output > 32)
@@ -278,7 +321,8 @@ FLASHMEM const std::array<uint32_t, blocks::IBlock::NUM_OUTPUTS> &blocks::IBlock
 }
 
 FLASHMEM void blocks::IBlock::set_outputs(const std::array<uint32_t, NUM_OUTPUTS> &outputs_) {
-  outputs = outputs_;
+  for (auto output : OUTPUT_IDX_RANGE())
+    _set_output(output, outputs_[output]);
 }
 
 FLASHMEM blocks::IBlockHAL_V_1_2_X::IBlockHAL_V_1_2_X(bus::addr_t block_address)
@@ -290,7 +334,7 @@ FLASHMEM blocks::IBlockHAL_V_1_2_X::IBlockHAL_V_1_2_X(bus::addr_t block_address)
 
 FLASHMEM bool blocks::IBlockHAL_V_1_2_X::write_outputs(const std::array<uint32_t, 16> &outputs) {
   f_imatrix_reset.trigger();
-  delayNanoseconds(420);
+  bus::wait_nanoseconds(420);
 
   // TODO: This can be further improved by not naively iterating over the output indizes.
   // For each output, send the corresponding 32bit commands.
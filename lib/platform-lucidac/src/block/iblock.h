@@ -127,19 +127,27 @@ protected:
 
   bool _is_connected(uint8_t input, uint8_t output) const;
   bool _is_output_connected(uint8_t output) const;
+  //! Sets the input bitmask of an output, without sanity checks.
+  void _set_output(uint8_t output, uint32_t inputs);
 
   IBlockHAL *hardware;
 
   std::array<uint32_t, NUM_OUTPUTS> outputs;
   std::bitset<NUM_INPUTS> scaling_factors = 0;
 
+  // What changed since it was last written. The matrix can only be written as a whole.
+  bool outputs_dirty = true;
+  bool upscaling_dirty = true;
+
 public:
   explicit IBlock(const bus::addr_t block_address, IBlockHAL *hardware)
       : FunctionBlock("I", block_address), hardware(hardware), outputs{0} {}
 
   IBlock() : IBlock(bus::NULL_ADDRESS, new IBlockHALDummy(bus::NULL_ADDRESS)) {}
 
+  /// Writes the matrix and upscaling, if they changed since they were last written.
   [[nodiscard]] utils::status write_to_hardware() override;
+  void mark_dirty() override;
 
   bool init() override;
 
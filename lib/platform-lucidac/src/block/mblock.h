@@ -14,6 +14,7 @@
 #include "daq/base.h"
 
 namespace platform {
+class CalibrationCache;
 class Cluster;
 }
 
@@ -122,6 +123,10 @@ public:
 
   // M Blocks generaly can't calibrate themselfs on their own, so they need the cluster they are installed in.
   virtual bool calibrate(daq::BaseDAQ *daq_, platform::Cluster *cluster) { return true; }
+  //! Applies a calibration from the cache instead of calibrating, returns false if there is none.
+  virtual bool restore_calibration(platform::CalibrationCache &cache) { return false; }
+  //! Keeps the result of the last calibration in the cache.
+  virtual void store_calibration(platform::CalibrationCache &cache) const {}
 
   void overload_flags_to_json(JsonArray msg_out);
 };
@@ -145,13 +150,18 @@ protected:
 
 class MIntBlockHAL : public MBlockHAL {
 public:
-  virtual bool write_ic(uint8_t idx, float ic) = 0;
+  //! Converts an IC value to the DAC60508 code setting it, @see MIntBlockHAL_V_1_0_X::write_ic.
+  static uint16_t ic_to_raw(float ic);
+  static float raw_to_ic(uint16_t raw);
+
+  //! Writes the raw DAC code of an IC value, as converted by ic_to_raw.
+  virtual bool write_ic(uint8_t idx, uint16_t raw) = 0;
   virtual bool write_time_factor_switches(std::bitset<8> switches) = 0;
 };
 
 class MIntBlockHAL_Dummy : public MIntBlockHAL {
 public:
-  bool write_ic(uint8_t idx, float ic) override { return true; }
+  bool write_ic(uint8_t idx, uint16_t raw) override { return true; }
 
   bool write_time_factor_switches(std::bitset<8> switches) override { return true; }
 
@@ -175,7 +185,7 @@ public:
 
   bool init() override;
 
-  bool write_ic(uint8_t idx, float ic) override;
+  bool write_ic(uint8_t idx, uint16_t raw) override;
   bool write_time_factor_switches(std::bitset<8> switches) override;
 
   std::bitset<8> read_overload_flags() override;
@@ -207,8 +217,14 @@ protected:
   MIntBlockHAL *hardware;
 
   std::array<float, NUM_INTEGRATORS> ic_values;
+  //! DAC codes of the IC values, as written to the hardware.
+  std::array<uint16_t, NUM_INTEGRATORS> raw_ic_values;
   std::array<unsigned int, NUM_INTEGRATORS> time_factors;
 
+  // What changed since it was last written. The time factor switches are a single register.
+  std::bitset<NUM_INTEGRATORS> ic_values_dirty;
+  bool time_factors_dirty = true;
+
   utils::status _config_elements_from_json(const JsonVariantConst &cfg);
 
 public:
@@ -241,7 +257,11 @@ public:
   bool set_time_factor(uint8_t int_idx, unsigned int k);
   void reset_time_factors();
 
+  /// Writes the IC values and time factors which changed since they were last written.
   [[nodiscard]] utils::status write_to_hardware() override;
+  /// Writes a single IC value only, e.g. after changing it with set_ic_value().
+  [[nodiscard]] utils::status write_ic_to_hardware(uint8_t idx);
+  void mark_dirty() override;
 
   utils::status config_self_from_json(JsonObjectConst cfg) override;
 
@@ -298,6 +318,13 @@ struct __attribute__((packed)) MultiplierCalibration {
   float offset_x = 0.0f, offset_y = 0.0f, offset_z = 0.0f;
 };
 
+/**
+ * Output of a multiplier which remains after calibrating the offset of each input, ideally zero.
+ **/
+struct MultiplierCalibrationResidual {
+  float x = 0.0f, y = 0.0f;
+};
+
 struct __attribute__((packed)) ManualMultiplierCalibrationMetadata {
   MultiplierCalibration cal[4];
   uint8_t checksum;
@@ -333,6 +360,8 @@ protected:
   MMulBlockHAL *hardware;
 
   std::array<MultiplierCalibration, NUM_MULTIPLIERS> calibration{};
+  std::array<MultiplierCalibrationResidual, NUM_MULTIPLIERS> residuals{};
+  bool has_residuals = false; ///< Whether calibrate() measured the residuals
 
 public:
   using MBlock::MBlock;
@@ -347,6 +376,8 @@ public:
   [[nodiscard]] utils::status write_to_hardware() override;
 
   bool calibrate(daq::BaseDAQ *daq_, platform::Cluster *cluster) override;
+  bool restore_calibration(platform::CalibrationCache &cache) override;
+  void store_calibration(platform::CalibrationCache &cache) const override;
 
   utils::status read_calibration_from_eeprom(); ///< does not write_to_hardware
   utils::status write_calibration_to_eeprom();
@@ -355,6 +386,9 @@ public:
 
   [[nodiscard]] const std::array<MultiplierCalibration, NUM_MULTIPLIERS> &get_calibration() const;
   [[nodiscard]] blocks::MultiplierCalibration get_calibration(uint8_t mul_idx) const;
+  [[nodiscard]] const std::array<MultiplierCalibrationResidual, NUM_MULTIPLIERS> &get_residuals() const {
+    return residuals;
+  }
   utils::status write_calibration_to_hardware();
 
 protected:
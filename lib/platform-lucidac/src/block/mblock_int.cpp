@@ -9,9 +9,12 @@
 #include "mode/mode.h"
 
 FLASHMEM blocks::MIntBlock::MIntBlock(bus::addr_t block_address, MIntBlockHAL *hardware)
-    : blocks::MBlock{block_address, hardware}, hardware(hardware), ic_values{}, time_factors{} {
+    : blocks::MBlock{block_address, hardware}, hardware(hardware), ic_values{}, raw_ic_values{}, time_factors{} {
+  // Values are only converted when they change, which the reset to zero does not
+  raw_ic_values.fill(MIntBlockHAL::ic_to_raw(0.0f));
   reset_ic_values();
   reset_time_factors();
+  mark_dirty();
 }
 
 FLASHMEM bool blocks::MIntBlock::init() {
@@ -49,11 +52,15 @@ FLASHMEM bool blocks::MIntBlock::set_ic_value(uint8_t idx, float value) {
     return false;
   if (value > 1.0f or value < -1.0f)
     return false;
-  ic_values[idx] = value;
+  if (ic_values[idx] != value) {
+    ic_values[idx] = value;
+    raw_ic_values[idx] = MIntBlockHAL::ic_to_raw(value);
+    ic_values_dirty.set(idx);
+  }
   return true;
 }
 
-FLASHMEM void blocks::MIntBlock::reset_ic_values() { std::fill(ic_values.begin(), ic_values.end(), 0.0f); }
+FLASHMEM void blocks::MIntBlock::reset_ic_values() { (void)set_ic_values(0.0f); }
 
 FLASHMEM const std::array<unsigned int, 8> &blocks::MIntBlock::get_time_factors() const {
   return time_factors;
@@ -84,24 +91,43 @@ FLASHMEM bool blocks::MIntBlock::set_time_factor(uint8_t int_idx, unsigned int k
     return false;
   if (int_idx >= NUM_INTEGRATORS)
     return false;
-  time_factors[int_idx] = k;
+  if (time_factors[int_idx] != k) {
+    time_factors[int_idx] = k;
+    time_factors_dirty = true;
+  }
   return true;
 }
 
 FLASHMEM void blocks::MIntBlock::reset_time_factors() {
   // Copying solves a strange linker issue "relocation against ... in read-only section `.text'"
   auto default_ = DEFAULT_TIME_FACTOR;
-  std::fill(std::begin(time_factors), std::end(time_factors), default_);
+  (void)set_time_factors(default_);
+}
+
+FLASHMEM utils::status blocks::MIntBlock::write_ic_to_hardware(uint8_t idx) {
+  if (idx >= ic_values.size())
+    return utils::status("MIntBlock IC index out of range");
+  if (!hardware->write_ic(idx, raw_ic_values[idx])) {
+    LOG(ANABRID_PEDANTIC, __PRETTY_FUNCTION__);
+    return utils::status::failure();
+  }
+  ic_values_dirty.reset(idx);
+  return utils::status::success();
 }
 
 FLASHMEM utils::status blocks::MIntBlock::write_to_hardware() {
-  // Write IC values one channel at a time
+  // Write changed IC values one channel at a time
   for (decltype(ic_values.size()) i = 0; i < ic_values.size(); i++) {
-    if (!hardware->write_ic(i, ic_values[i])) {
+    if (!ic_values_dirty.test(i))
+      continue;
+    if (!hardware->write_ic(i, raw_ic_values[i])) {
       LOG(ANABRID_PEDANTIC, __PRETTY_FUNCTION__);
       return utils::status::failure();
     }
+    ic_values_dirty.reset(i);
   }
+  if (!time_factors_dirty)
+    return utils::status::success();
   // Write time factor switches by converting to bitset
   std::bitset<NUM_INTEGRATORS> time_factor_switches{};
   for (auto idx = 0u; idx < time_factors.size(); idx++)
@@ -109,9 +135,15 @@ FLASHMEM utils::status blocks::MIntBlock::write_to_hardware() {
       time_factor_switches.set(idx);
   if (!hardware->write_time_factor_switches(time_factor_switches))
     return utils::status::failure();
+  time_factors_dirty = false;
   return utils::status::success();
 }
 
+FLASHMEM void blocks::MIntBlock::mark_dirty() {
+  ic_values_dirty.set();
+  time_factors_dirty = true;
+}
+
 FLASHMEM void blocks::MIntBlock::reset(entities::ResetAction action) {
   FunctionBlock::reset(action);
 
@@ -235,16 +267,24 @@ FLASHMEM bool blocks::MIntBlockHAL_V_1_0_X::init() {
   return f_ic_dac.init() and f_ic_dac.set_external_reference(true) and f_ic_dac.set_double_gain(true);
 }
 
-FLASHMEM bool blocks::MIntBlockHAL_V_1_0_X::write_ic(uint8_t idx, float ic) {
-  if (idx >= MIntBlock::NUM_INTEGRATORS)
-    return false;
+FLASHMEM uint16_t blocks::MIntBlockHAL::ic_to_raw(float ic) {
   // Note: The DAC60508 implementation converts values assuming a 2.5V reference,
   //       but we use a 2V external reference here (resulting in the 1.25 factor).
   //       The output is also level-shifted, such that IC = 2V - output.
   //       And 2V equals a 1, since the output is halved after the integrators.
   //       Since we enabled gain=2, we don't need to halve/double here.
   //       Resulting in a shift of -1 and the inversion.
-  return f_ic_dac.set_channel(idx, (ic + 1.0f) * 1.25f);
+  return functions::DAC60508::float_to_raw((ic + 1.0f) * 1.25f);
+}
+
+FLASHMEM float blocks::MIntBlockHAL::raw_to_ic(uint16_t raw) {
+  return functions::DAC60508::raw_to_float(raw) / 1.25f - 1.0f;
+}
+
+FLASHMEM bool blocks::MIntBlockHAL_V_1_0_X::write_ic(uint8_t idx, uint16_t raw) {
+  if (idx >= MIntBlock::NUM_INTEGRATORS)
+    return false;
+  return f_ic_dac.set_channel_raw(idx, raw);
 }
 
 FLASHMEM bool blocks::MIntBlockHAL_V_1_0_X::write_time_factor_switches(std::bitset<8> switches) {
@@ -3,11 +3,13 @@
 // SPDX-License-Identifier: MIT OR GPL-2.0-or-later
 
 #include "block/mblock.h"
+#include "block/multiplier_calibration.h"
 #include "utils/logging.h"
 
 #include "entity/entity.h"
 #include "etl/crc.h"
 
+#include "carrier/calibration_cache.h"
 #include "carrier/cluster.h"
 
 FLASHMEM utils::status blocks::MMulBlock::config_self_from_json(JsonObjectConst cfg) {
@@ -94,6 +96,15 @@ FLASHMEM void blocks::MMulBlock::config_self_to_json(JsonObject &cfg) {
     offset_y.add(calibration[i].offset_y);
     offset_z.add(calibration[i].offset_z);
   }
+
+  if (has_residuals) {
+    auto residual_x = json_calibration.createNestedArray("residual_x");
+    auto residual_y = json_calibration.createNestedArray("residual_y");
+    for (auto &residual : residuals) {
+      residual_x.add(residual.x);
+      residual_y.add(residual.y);
+    }
+  }
 }
 
 FLASHMEM blocks::MMulBlock *blocks::MMulBlock::from_entity_classifier(entities::EntityClassifier classifier,
@@ -130,6 +141,7 @@ FLASHMEM void blocks::MMulBlock::reset(entities::ResetAction action) {
       calibration[idx].offset_y = 0;
       calibration[idx].offset_z = 0;
     }
+    has_residuals = false;
   }
 
   if (action.has(entities::ResetAction::OVERLOAD_RESET)) {
@@ -207,20 +219,11 @@ FLASHMEM bool blocks::MMulBlock::calibrate(daq::BaseDAQ *daq_, platform::Cluster
 
   delay(100);
 
-  // Start with a negative input offset and increase until we hit/cross zero
-  for (auto mul_idx = 0u; mul_idx < NUM_MULTIPLIERS; mul_idx++) {
-    if (!hardware->write_calibration_input_offsets(mul_idx, -0.1f, 0.0f))
-      success = false;
-    calibration[mul_idx].offset_x = -0.1f;
-    while (daq_->sample(mul_idx) < 0.0f) {
-      if (!hardware->write_calibration_input_offsets(mul_idx, calibration[mul_idx].offset_x, 0.0f)) {
-        success = false;
-        break;
-      }
-      calibration[mul_idx].offset_x += 0.01f;
-      delay(7);
-    }
-  }
+  // Search the input offsets of all multipliers at once
+  MMulBlockCalibrationHAL calibration_hal(hardware, daq_);
+  MultiplierOffsetSearch::Results results_x, results_y;
+  if (!MultiplierOffsetSearch::run(calibration_hal, MultiplierOffsetSearch::Input::X, calibration, results_x))
+    return false; // fatal error
 
   // Set other inputs to one
   LOG(ANABRID_DEBUG_CALIBRATION, "Calibrating input y offsets...");
@@ -237,25 +240,42 @@ FLASHMEM bool blocks::MMulBlock::calibrate(daq::BaseDAQ *daq_, platform::Cluster
     return false; // fatal error
   delay(100);
 
-  // Start with a negative input offset and increase until we hit/cross zero
-  for (auto mul_idx = 0u; mul_idx < NUM_MULTIPLIERS; mul_idx++) {
-    if (!hardware->write_calibration_input_offsets(mul_idx, calibration[mul_idx].offset_x, -0.1f))
-      success = false;
-    calibration[mul_idx].offset_y = -0.1f;
-    while (daq_->sample(mul_idx) < 0.0f) {
-      if (!hardware->write_calibration_input_offsets(mul_idx, calibration[mul_idx].offset_x,
-                                                     calibration[mul_idx].offset_y)) {
-        success = false;
-        break;
-      }
-      calibration[mul_idx].offset_y += 0.01f;
-      delay(7);
-    }
+  if (!MultiplierOffsetSearch::run(calibration_hal, MultiplierOffsetSearch::Input::Y, calibration, results_y))
+    return false; // fatal error
+
+  for (auto idx = 0u; idx < NUM_MULTIPLIERS; idx++) {
+    residuals[idx] = {results_x[idx].residual, results_y[idx].residual};
+    LOG_ANABRID_DEBUG_CALIBRATION(residuals[idx].x);
+    LOG_ANABRID_DEBUG_CALIBRATION(residuals[idx].y);
+    // Without a zero crossing, the offset is at the end of its range
+    if (!results_x[idx].bracketed or !results_y[idx].bracketed)
+      LOG(ANABRID_DEBUG_CALIBRATION, "Multiplier offset out of calibration range.");
   }
+  has_residuals = true;
 
   return success;
 }
 
+FLASHMEM bool blocks::MMulBlock::restore_calibration(platform::CalibrationCache &cache) {
+  auto eui = get_entity_eui();
+  std::array<MultiplierCalibration, NUM_MULTIPLIERS> cached;
+  for (auto idx = 0u; idx < NUM_MULTIPLIERS; idx++) {
+    auto values = cache.lookup(eui, platform::CalibrationCache::Kind::MULTIPLIER_OFFSETS, idx);
+    if (!values)
+      return false;
+    cached[idx] = {(*values)[0], (*values)[1], (*values)[2]};
+  }
+  calibration = cached;
+  return write_calibration_to_hardware();
+}
+
+FLASHMEM void blocks::MMulBlock::store_calibration(platform::CalibrationCache &cache) const {
+  auto eui = get_entity_eui();
+  for (auto idx = 0u; idx < NUM_MULTIPLIERS; idx++)
+    cache.store(eui, platform::CalibrationCache::Kind::MULTIPLIER_OFFSETS, idx,
+                {calibration[idx].offset_x, calibration[idx].offset_y, calibration[idx].offset_z});
+}
+
 FLASHMEM
 uint8_t blocks::ManualMultiplierCalibrationMetadata::compute_checksum() const {
   etl::crc1 calculator;
@@ -0,0 +1,144 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "block/multiplier_calibration.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+using blocks::MMulBlock;
+using blocks::MultiplierCalibration;
+using blocks::MultiplierOffsetSearch;
+
+using Offsets = std::array<float, MMulBlock::NUM_MULTIPLIERS>;
+
+bool write_and_measure(blocks::MultiplierCalibrationHAL &hal, MultiplierOffsetSearch::Input input,
+                       const std::array<MultiplierCalibration, MMulBlock::NUM_MULTIPLIERS> &calibration,
+                       const Offsets &offsets, Offsets &outputs) {
+  for (uint8_t idx = 0; idx < MMulBlock::NUM_MULTIPLIERS; idx++) {
+    bool is_x = input == MultiplierOffsetSearch::Input::X;
+    if (!hal.write_input_offsets(idx, is_x ? offsets[idx] : calibration[idx].offset_x,
+                                 is_x ? calibration[idx].offset_y : offsets[idx]))
+      return false;
+  }
+  return hal.measure(outputs);
+}
+
+// Zero crossing between a and b, where f(a) and f(b) have different signs
+struct Bracket {
+  float a, fa, b, fb;
+  int8_t retained = 0; // +1 if b was kept in the last step, -1 if a was kept
+  bool done = false;
+};
+
+} // namespace
+
+FLASHMEM bool blocks::MMulBlockCalibrationHAL::write_input_offsets(uint8_t idx, float offset_x, float offset_y) {
+  return hardware->write_calibration_input_offsets(idx, offset_x, offset_y);
+}
+
+FLASHMEM bool blocks::MMulBlockCalibrationHAL::measure(std::array<float, MMulBlock::NUM_MULTIPLIERS> &outputs) {
+  delay(SETTLING_TIME_MS);
+  auto samples = daq->sample();
+  std::copy_n(samples.begin(), outputs.size(), outputs.begin());
+  return true;
+}
+
+FLASHMEM bool blocks::MultiplierOffsetSearch::run(
+    MultiplierCalibrationHAL &hal, Input input,
+    std::array<MultiplierCalibration, MMulBlock::NUM_MULTIPLIERS> &calibration, Results &results) {
+  std::array<Bracket, MMulBlock::NUM_MULTIPLIERS> brackets;
+  Offsets offsets, outputs;
+
+  // Keeps the offset with the smallest output of each multiplier
+  auto update_best = [&]() {
+    for (size_t idx = 0; idx < offsets.size(); idx++)
+      if (std::fabs(outputs[idx]) < std::fabs(results[idx].residual)) {
+        results[idx].offset = offsets[idx];
+        results[idx].residual = outputs[idx];
+      }
+  };
+
+  // Measure both ends of the offset range
+  offsets.fill(MIN_OFFSET);
+  if (!write_and_measure(hal, input, calibration, offsets, outputs))
+    return false;
+  for (size_t idx = 0; idx < offsets.size(); idx++) {
+    results[idx] = {MIN_OFFSET, outputs[idx], false};
+    brackets[idx].a = MIN_OFFSET;
+    brackets[idx].fa = outputs[idx];
+  }
+  offsets.fill(MAX_OFFSET);
+  if (!write_and_measure(hal, input, calibration, offsets, outputs))
+    return false;
+  update_best();
+  for (size_t idx = 0; idx < offsets.size(); idx++) {
+    auto &bracket = brackets[idx];
+    bracket.b = MAX_OFFSET;
+    bracket.fb = outputs[idx];
+    results[idx].bracketed = std::signbit(bracket.fa) != std::signbit(bracket.fb);
+    bracket.done = !results[idx].bracketed or std::fabs(results[idx].residual) <= OUTPUT_TOLERANCE;
+  }
+
+  auto all_done = [&brackets]() {
+    return std::all_of(brackets.begin(), brackets.end(), [](const Bracket &bracket) { return bracket.done; });
+  };
+  for (unsigned int step = 0; step < MAX_STEPS and !all_done(); step++) {
+    for (size_t idx = 0; idx < offsets.size(); idx++) {
+      auto &bracket = brackets[idx];
+      if (bracket.done) {
+        offsets[idx] = results[idx].offset;
+        continue;
+      }
+      // Secant through both ends, falling back to bisection if it does not land inside the bracket
+      auto c = (bracket.a * bracket.fb - bracket.b * bracket.fa) / (bracket.fb - bracket.fa);
+      if (!(c > bracket.a and c < bracket.b))
+        c = (bracket.a + bracket.b) / 2;
+      offsets[idx] = c;
+    }
+
+    if (!write_and_measure(hal, input, calibration, offsets, outputs))
+      return false;
+    update_best();
+
+    for (size_t idx = 0; idx < offsets.size(); idx++) {
+      auto &bracket = brackets[idx];
+      if (bracket.done)
+        continue;
+      auto c = offsets[idx], fc = outputs[idx];
+      if (std::signbit(fc) == std::signbit(bracket.fa)) {
+        bracket.a = c;
+        bracket.fa = fc;
+        // Illinois step: An end kept twice gets half the weight, which avoids creeping towards it
+        if (bracket.retained == 1)
+          bracket.fb /= 2;
+        bracket.retained = 1;
+      } else {
+        bracket.b = c;
+        bracket.fb = fc;
+        if (bracket.retained == -1)
+          bracket.fa /= 2;
+        bracket.retained = -1;
+      }
+      bracket.done = std::fabs(fc) <= OUTPUT_TOLERANCE or bracket.b - bracket.a <= OFFSET_TOLERANCE;
+    }
+  }
+
+  // Apply the best offsets and measure what remains with all multipliers at their final offsets
+  for (size_t idx = 0; idx < offsets.size(); idx++) {
+    offsets[idx] = results[idx].offset;
+    if (input == Input::X)
+      calibration[idx].offset_x = offsets[idx];
+    else
+      calibration[idx].offset_y = offsets[idx];
+  }
+  if (!write_and_measure(hal, input, calibration, offsets, outputs))
+    return false;
+  for (size_t idx = 0; idx < offsets.size(); idx++)
+    results[idx].residual = outputs[idx];
+  return true;
+}
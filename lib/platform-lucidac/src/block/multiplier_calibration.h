@@ -0,0 +1,81 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "block/mblock.h"
+#include "daq/base.h"
+
+namespace blocks {
+
+/**
+ * Access to the multipliers of an MMulBlock during their calibration, with the calibration circuit already
+ * set up and each multiplier output routed to the ADC channel of the same index.
+ **/
+class MultiplierCalibrationHAL {
+public:
+  //! Writes the input offsets of one multiplier, @see MMulBlockHAL::write_calibration_input_offsets.
+  virtual bool write_input_offsets(uint8_t idx, float offset_x, float offset_y) = 0;
+  //! Returns the outputs of all multipliers once they settled after writing.
+  virtual bool measure(std::array<float, MMulBlock::NUM_MULTIPLIERS> &outputs) = 0;
+};
+
+class MMulBlockCalibrationHAL : public MultiplierCalibrationHAL {
+  MMulBlockHAL *hardware;
+  daq::BaseDAQ *daq;
+
+public:
+  static constexpr uint32_t SETTLING_TIME_MS = 7;
+
+  MMulBlockCalibrationHAL(MMulBlockHAL *hardware, daq::BaseDAQ *daq) : hardware(hardware), daq(daq) {}
+
+  bool write_input_offsets(uint8_t idx, float offset_x, float offset_y) override;
+  bool measure(std::array<float, MMulBlock::NUM_MULTIPLIERS> &outputs) override;
+};
+
+/**
+ * Searches the offset of one input of all multipliers at once, at which their outputs are zero.
+ *
+ * Each multiplier output is assumed to change monotonically with the offset in [MIN_OFFSET, MAX_OFFSET].
+ * The zero crossing is bracketed and found by regula falsi in its Illinois variant, which converges like
+ * the secant method for a linear response and never worse than bisection. All multipliers take their
+ * steps together, so each step is one write and one measurement for all of them.
+ **/
+class MultiplierOffsetSearch {
+public:
+  static constexpr float MIN_OFFSET = -0.1f;
+  static constexpr float MAX_OFFSET = 0.1f;
+  //! Outputs within this distance to zero are good enough, which is about the ADC resolution.
+  static constexpr float OUTPUT_TOLERANCE = 0.0005f;
+  //! Brackets narrower than this are not split anymore, which is below the calibration DAC resolution.
+  static constexpr float OFFSET_TOLERANCE = 0.0001f;
+  //! Bisection needs 11 steps from the full range down to OFFSET_TOLERANCE, this leaves room for noise.
+  static constexpr unsigned int MAX_STEPS = 16;
+
+  enum class Input { X, Y };
+
+  struct Result {
+    //! The offset with the smallest output measured.
+    float offset = 0.0f;
+    //! Output at offset, as measured with all multipliers at their final offsets.
+    float residual = 0.0f;
+    //! Whether the output crossed zero in the offset range, otherwise offset is the best of both bounds.
+    bool bracketed = false;
+  };
+
+  using Results = std::array<Result, MMulBlock::NUM_MULTIPLIERS>;
+
+  /**
+   * Searches the offsets of the given input and writes them to the hardware and into calibration.
+   * The offsets of the other input are taken from calibration.
+   * @returns false if writing to or measuring the hardware failed
+   **/
+  static bool run(MultiplierCalibrationHAL &hal, Input input,
+                  std::array<MultiplierCalibration, MMulBlock::NUM_MULTIPLIERS> &calibration, Results &results);
+};
+
+} // namespace blocks
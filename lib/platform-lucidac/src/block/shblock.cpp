@@ -9,16 +9,25 @@ FLASHMEM blocks::SHBlock::SHBlock(const bus::addr_t block_address) : FunctionBlo
 
 FLASHMEM blocks::SHBlock::SHBlock() : SHBlock(bus::BLOCK_BADDR(0, bus::SH_BLOCK_IDX)) {}
 
-FLASHMEM void blocks::SHBlock::set_state(State state_) { state = state_; }
+FLASHMEM void blocks::SHBlock::set_state(State state_) {
+  if (state != state_) {
+    state = state_;
+    state_dirty = true;
+  }
+}
 
 FLASHMEM blocks::SHBlock::State blocks::SHBlock::get_state() const { return state; }
 
 FLASHMEM void blocks::SHBlock::reset(entities::ResetAction action) {
   if (action.has(entities::ResetAction::CIRCUIT_RESET))
-    state = State::INJECT;
+    set_state(State::INJECT);
 }
 
 FLASHMEM utils::status blocks::SHBlock::write_to_hardware() {
+  if (!state_dirty)
+    return utils::status::success();
+  state_dirty = false;
+
   if (state == State::TRACK)
     set_track.trigger();
   else if (state == State::TRACK_AT_IC)
@@ -36,12 +45,15 @@ FLASHMEM utils::status blocks::SHBlock::write_to_hardware() {
   return utils::status::success();
 }
 
+FLASHMEM void blocks::SHBlock::mark_dirty() { state_dirty = true; }
+
 FLASHMEM void blocks::SHBlock::compensate_hardware_offsets(uint32_t track_time, uint32_t inject_time) {
   set_track.trigger();
   delayMicroseconds(track_time);
   set_inject.trigger();
   delayMicroseconds(inject_time);
   state = State::INJECT;
+  state_dirty = false;
 }
 
 FLASHMEM utils::status blocks::SHBlock::config_self_from_json(JsonObjectConst cfg) {
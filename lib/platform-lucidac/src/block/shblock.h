@@ -29,8 +29,9 @@ public:
   //! Resets all internal states. Block is left in inject mode afterwards. Requires write_to_hardware()
   void reset(entities::ResetAction action) override;
 
-  //! Applies current class state to actually hardware
+  //! Applies current class state to actually hardware, if it changed since it was last applied
   [[nodiscard]] utils::status write_to_hardware() override;
+  void mark_dirty() override;
 
   // Automatically does an track and inject sequence. This directly writes to hardware. Delays for track time
   // and inject time can be set optionally in microseconds. Block will be left in inject mode afterwards
@@ -42,6 +43,7 @@ public:
 
 protected:
   State state = State::INJECT;
+  bool state_dirty = true;
 
   // Default state after reset is inject with a potentially random inject current
   const functions::TriggerFunction set_track{bus::address_from_tuple(bus::SH_BLOCK_BADDR(0), 2)};
@@ -37,7 +37,10 @@ FLASHMEM bool blocks::UBlock::_io_sanity_check(const uint8_t input, const uint8_
 }
 
 FLASHMEM void blocks::UBlock::_connect(const uint8_t input, const uint8_t output) {
-  output_input_map[output] = input;
+  if (output_input_map[output] != input) {
+    output_input_map[output] = input;
+    outputs_dirty = true;
+  }
 }
 
 FLASHMEM bool blocks::UBlock::connect(const uint8_t input, const uint8_t output, bool force) {
@@ -128,7 +131,12 @@ FLASHMEM bool blocks::UBlock::connect_alternative(Transmission_Mode signal_mode,
   return true;
 }
 
-FLASHMEM void blocks::UBlock::_disconnect(const uint8_t output) { output_input_map[output] = -1; }
+FLASHMEM void blocks::UBlock::_disconnect(const uint8_t output) {
+  if (output_input_map[output] != -1) {
+    output_input_map[output] = -1;
+    outputs_dirty = true;
+  }
+}
 
 FLASHMEM bool blocks::UBlock::disconnect(const uint8_t input, const uint8_t output) {
   if (!_io_sanity_check(input, output))
@@ -192,11 +200,17 @@ FLASHMEM bool blocks::UBlock::is_anything_connected() const {
 }
 
 FLASHMEM void blocks::UBlock::change_a_side_transmission_mode(const Transmission_Mode mode) {
-  a_side_mode = mode;
+  if (a_side_mode != mode) {
+    a_side_mode = mode;
+    transmission_modes_dirty = true;
+  }
 }
 
 FLASHMEM void blocks::UBlock::change_b_side_transmission_mode(const Transmission_Mode mode) {
-  b_side_mode = mode;
+  if (b_side_mode != mode) {
+    b_side_mode = mode;
+    transmission_modes_dirty = true;
+  }
 }
 
 FLASHMEM void blocks::UBlock::change_all_transmission_modes(const Transmission_Mode mode) {
@@ -220,20 +234,38 @@ FLASHMEM blocks::UBlock::Reference_Magnitude blocks::UBlock::get_reference_magni
 }
 
 FLASHMEM void blocks::UBlock::change_reference_magnitude(blocks::UBlock::Reference_Magnitude ref) {
-  ref_magnitude = ref;
+  if (ref_magnitude != ref) {
+    ref_magnitude = ref;
+    transmission_modes_dirty = true;
+  }
 }
 
 FLASHMEM utils::status blocks::UBlock::write_to_hardware() {
-  if (!hardware->write_outputs(output_input_map) or
-      !hardware->write_transmission_modes_and_ref({a_side_mode, b_side_mode}, ref_magnitude)) {
-    LOG(ANABRID_PEDANTIC, __PRETTY_FUNCTION__);
-    return utils::status::failure();
+  if (outputs_dirty) {
+    if (!hardware->write_outputs(output_input_map)) {
+      LOG(ANABRID_PEDANTIC, __PRETTY_FUNCTION__);
+      return utils::status::failure();
+    }
+    outputs_dirty = false;
+  }
+  if (transmission_modes_dirty) {
+    if (!hardware->write_transmission_modes_and_ref({a_side_mode, b_side_mode}, ref_magnitude)) {
+      LOG(ANABRID_PEDANTIC, __PRETTY_FUNCTION__);
+      return utils::status::failure();
+    }
+    transmission_modes_dirty = false;
   }
   return utils::status::success();
 }
 
+FLASHMEM void blocks::UBlock::mark_dirty() {
+  outputs_dirty = true;
+  transmission_modes_dirty = true;
+}
+
 FLASHMEM void blocks::UBlock::reset_connections() {
-  std::fill(begin(output_input_map), end(output_input_map), -1);
+  for (auto output : OUTPUT_IDX_RANGE())
+    _disconnect(output);
 }
 
 FLASHMEM void blocks::UBlock::reset(entities::ResetAction action) {
@@ -253,9 +285,15 @@ utils::status blocks::UBlock::config_self_from_json(JsonObjectConst cfg) {
 #endif
   for (auto cfgItr = cfg.begin(); cfgItr != cfg.end(); ++cfgItr) {
     if (cfgItr->key() == "outputs") {
+      // Outputs are cleared before they are set, so re-applying unchanged outputs
+      // must not make the matrix dirty
+      auto previous_map = output_input_map;
+      auto was_dirty = outputs_dirty;
       auto ret = _config_outputs_from_json(cfgItr->value());
       if (!ret)
         return ret;
+      if (output_input_map == previous_map)
+        outputs_dirty = was_dirty;
     } else if (cfgItr->key() == "constant") {
       auto ret = _config_constants_from_json(cfgItr->value());
       if (!ret)
@@ -394,7 +432,7 @@ blocks::UBlock *blocks::UBlock::from_entity_classifier(entities::EntityClassifie
   return nullptr;
 }
 
-FLASHMEM void blocks::UBlock::reset_reference_magnitude() { ref_magnitude = Reference_Magnitude::ONE; }
+FLASHMEM void blocks::UBlock::reset_reference_magnitude() { change_reference_magnitude(Reference_Magnitude::ONE); }
 
 // blocks::UBlock_SwappedSR::UBlock_SwappedSR(bus::addr_t block_address)
 //     : FunctionBlock("U", block_address), output_input_map{} {}
@@ -146,6 +146,11 @@ protected:
   Transmission_Mode a_side_mode = Transmission_Mode::ANALOG_INPUT;
   Transmission_Mode b_side_mode = Transmission_Mode::ANALOG_INPUT;
 
+  // What changed since it was last written. Both the matrix and the transmission mode
+  // register are shift register chains, which can only be written as a whole.
+  bool outputs_dirty = true;
+  bool transmission_modes_dirty = true;
+
   // Default sanity checks for input and output indizes
   static bool _i_sanity_check(const uint8_t input);
   static bool _o_sanity_check(const uint8_t output);
@@ -223,7 +228,9 @@ public:
 
   bool is_anything_connected() const;
 
+  /// Writes the matrix and transmission modes, if they changed since they were last written.
   [[nodiscard]] utils::status write_to_hardware() override;
+  void mark_dirty() override;
 
   utils::status config_self_from_json(JsonObjectConst cfg) override;
 
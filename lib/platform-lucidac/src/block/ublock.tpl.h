@@ -54,8 +54,8 @@ template <size_t num_of_outputs>
       utils::shift_5_left(buffer, sizeof(buffer));
   }
 
-  DataFunction::transfer(buffer, nullptr, sizeof(buffer));
-  
+  DataFunction::write(buffer, sizeof(buffer));
+
 #ifdef ANABRID_PEDANTIC
   uint8_t read_buffer[NUM_BYTES] = {};
   DataFunction::transfer(buffer, read_buffer, sizeof(buffer));
@@ -0,0 +1,205 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "carrier/calibration_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#ifndef ARDUINO
+#include <ctime>
+#endif
+
+#include "utils/logging.h"
+
+namespace {
+
+// EUI64 canonical format AA-BB-CC-DD-EE-FF-00-11, as utils::toString
+void eui_to_string(const std::array<uint8_t, 8> &eui, char (&buf)[24]) {
+  snprintf(buf, sizeof(buf), "%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X", eui[0], eui[1], eui[2], eui[3], eui[4],
+           eui[5], eui[6], eui[7]);
+}
+
+bool eui_from_string(const char *str, std::array<uint8_t, 8> &eui) {
+  return str and sscanf(str, "%hhx-%hhx-%hhx-%hhx-%hhx-%hhx-%hhx-%hhx", &eui[0], &eui[1], &eui[2], &eui[3],
+                        &eui[4], &eui[5], &eui[6], &eui[7]) == 8;
+}
+
+} // namespace
+
+FLASHMEM void platform::CalibrationCache::set_temperature(float celsius) {
+  if (std::isnan(celsius))
+    temperature_band = UNKNOWN_TEMPERATURE_BAND;
+  else
+    temperature_band = static_cast<int8_t>(
+        std::clamp(std::floor(celsius / TEMPERATURE_BAND_WIDTH), float(INT8_MIN + 1), float(INT8_MAX)));
+}
+
+FLASHMEM uint32_t platform::CalibrationCache::get_clock_s() const {
+#ifdef ARDUINO
+  return rtc_get();
+#else
+  return static_cast<uint32_t>(time(nullptr));
+#endif
+}
+
+platform::CalibrationCache::Entry *platform::CalibrationCache::find(const Key &key) {
+  auto entry = std::find_if(entries.begin(), entries.end(), [&key](const Entry &e) { return e.key == key; });
+  return entry == entries.end() ? nullptr : &*entry;
+}
+
+FLASHMEM const platform::CalibrationCache::Values *
+platform::CalibrationCache::lookup(const std::array<uint8_t, 8> &eui, Kind kind, uint16_t element) {
+  if (!enabled)
+    return nullptr;
+  auto entry = find({eui, kind, element, temperature_band});
+  if (!entry) {
+    statistics.misses++;
+    return nullptr;
+  }
+  if (millis() - entry->created_ms >= max_age_ms) {
+    statistics.misses++;
+    statistics.stale++;
+    return nullptr;
+  }
+  statistics.hits++;
+  return &entry->values;
+}
+
+FLASHMEM void platform::CalibrationCache::store(const std::array<uint8_t, 8> &eui, Kind kind, uint16_t element,
+                                                const Values &values) {
+  if (!enabled)
+    return;
+  Key key{eui, kind, element, temperature_band};
+  auto entry = find(key);
+  if (!entry) {
+    if (entries.size() == MAX_ENTRIES) {
+      // Replace the oldest entry
+      entry = &*std::max_element(entries.begin(), entries.end(), [now = millis()](const Entry &a, const Entry &b) {
+        return now - a.created_ms < now - b.created_ms;
+      });
+      statistics.evictions++;
+    } else {
+      entry = &entries.emplace_back();
+    }
+    entry->key = key;
+  }
+  entry->values = values;
+  entry->created_ms = millis();
+  if (is_persistent_kind(kind))
+    unsaved = true;
+}
+
+FLASHMEM void platform::CalibrationCache::invalidate(const std::array<uint8_t, 8> &eui) {
+  entries.erase(std::remove_if(entries.begin(), entries.end(), [&eui](const Entry &e) { return e.key.eui == eui; }),
+                entries.end());
+}
+
+FLASHMEM void platform::CalibrationCache::clear() { entries.clear(); }
+
+FLASHMEM void platform::CalibrationCache::to_json(JsonObject target) const {
+  target["enabled"] = enabled;
+  target["entries"] = entries.size();
+  target["hits"] = statistics.hits;
+  target["misses"] = statistics.misses;
+  target["stale"] = statistics.stale;
+  target["evictions"] = statistics.evictions;
+  if (temperature_band != UNKNOWN_TEMPERATURE_BAND)
+    target["temperature_band"] = temperature_band * TEMPERATURE_BAND_WIDTH;
+  if (!entries.empty()) {
+    auto now = millis();
+    uint32_t min_age = UINT32_MAX, max_age = 0;
+    for (auto &entry : entries) {
+      min_age = std::min(min_age, now - entry.created_ms);
+      max_age = std::max(max_age, now - entry.created_ms);
+    }
+    target["newest_age_ms"] = min_age;
+    target["oldest_age_ms"] = max_age;
+  }
+}
+
+FLASHMEM void platform::CalibrationCache::settings_to_json(JsonObject target, bool with_entries) const {
+  target["enabled"] = enabled;
+  target["persistent"] = persistent;
+  target["max_age_s"] = max_age_ms / 1000;
+  if (!with_entries or !persistent)
+    return;
+
+  // Entries are stored as compact arrays [eui, kind, element, temperature band, values..., clock stamp]
+  auto serialized = target.createNestedArray("entries");
+  auto now_ms = millis();
+  auto now_s = get_clock_s();
+  size_t count = 0;
+  for (auto &entry : entries) {
+    if (!is_persistent_kind(entry.key.kind))
+      continue;
+    if (count++ == MAX_PERSISTENT_ENTRIES) {
+      LOG_ALWAYS("CalibrationCache: Too many entries to persist, dropping the remaining ones.");
+      break;
+    }
+    auto item = serialized.createNestedArray();
+    char eui[24];
+    eui_to_string(entry.key.eui, eui);
+    item.add(eui); // copied into the document
+    item.add(static_cast<uint8_t>(entry.key.kind));
+    item.add(entry.key.element);
+    item.add(entry.key.temperature_band);
+    for (auto value : entry.values)
+      item.add(value);
+    item.add(now_s - (now_ms - entry.created_ms) / 1000);
+  }
+}
+
+FLASHMEM void platform::CalibrationCache::settings_from_json(JsonObjectConst src, bool with_entries) {
+  if (src.containsKey("enabled"))
+    enabled = src["enabled"];
+  if (src.containsKey("persistent"))
+    persistent = src["persistent"];
+  if (src.containsKey("max_age_s"))
+    max_age_ms = src["max_age_s"].as<uint32_t>() * 1000;
+  if (!with_entries)
+    return;
+
+  // Restored entries keep their age, as far as the clock tells. Entries stamped in the future were
+  // stamped before the clock started over, and entries of the former format have no stamp at all,
+  // so the age of both is unknown and they are dropped.
+  auto now_ms = millis();
+  auto now_s = get_clock_s();
+  for (JsonArrayConst item : src["entries"].as<JsonArrayConst>()) {
+    Entry entry{};
+    if (item.size() != 5 + MAX_VALUES or !eui_from_string(item[0], entry.key.eui))
+      continue;
+    entry.key.kind = static_cast<Kind>(item[1].as<uint8_t>());
+    entry.key.element = item[2];
+    entry.key.temperature_band = item[3];
+    for (size_t idx = 0; idx < MAX_VALUES; idx++)
+      entry.values[idx] = item[4 + idx];
+    auto created_s = item[4 + MAX_VALUES].as<uint32_t>();
+    if (created_s > now_s or now_s - created_s >= max_age_ms / 1000)
+      continue;
+    entry.created_ms = now_ms - (now_s - created_s) * 1000;
+    if (!is_persistent_kind(entry.key.kind) or find(entry.key) or entries.size() == MAX_ENTRIES)
+      continue;
+    entries.push_back(entry);
+  }
+}
+
+#ifdef ARDUINO
+
+FLASHMEM void platform::CalibrationCacheSettings::reset_defaults() {
+  auto &cache = CalibrationCache::get();
+  cache.enabled = true;
+  cache.persistent = false;
+  cache.max_age_ms = 3'600'000;
+}
+
+FLASHMEM void platform::CalibrationCacheSettings::fromJson(JsonObjectConst src, nvmconfig::Context c) {
+  CalibrationCache::get().settings_from_json(src, c == nvmconfig::Context::Flash);
+}
+
+FLASHMEM void platform::CalibrationCacheSettings::toJson(JsonObject target, nvmconfig::Context c) const {
+  CalibrationCache::get().settings_to_json(target, c == nvmconfig::Context::Flash);
+}
+
+#endif // ARDUINO
@@ -0,0 +1,126 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "utils/singleton.h"
+
+#ifdef ARDUINO
+#include "nvmconfig/persistent.h"
+#endif
+
+namespace platform {
+
+/**
+ * Keeps the results of calibrations, such that they are only repeated for what changed.
+ *
+ * An entry belongs to one element of a block, identified by the EUI of the block and a block specific
+ * number, e.g. a lane of a C-block and the I-block output it was measured at. Entries are only valid
+ * in the temperature band they were measured in and for a maximum age, otherwise they are stale.
+ *
+ * Blocks are only detected at startup, so a changed EUI can only show up in entries persisted
+ * in the EEPROM. Only entries of kinds which are expensive to measure are persisted.
+ * They are stamped with the real-time clock, so their age counts across restarts. After a loss of power,
+ * the clock starts over and the stamps lie in the future, which makes these entries count as stale.
+ *
+ * \ingroup Singletons
+ **/
+class CalibrationCache : public utils::HeapSingleton<CalibrationCache> {
+public:
+  static constexpr size_t MAX_ENTRIES = 128;
+  static constexpr size_t MAX_PERSISTENT_ENTRIES = 8;
+  static constexpr uint8_t MAX_VALUES = 3;
+  static constexpr float TEMPERATURE_BAND_WIDTH = 2.0f; ///< in degree Celsius
+  static constexpr int8_t UNKNOWN_TEMPERATURE_BAND = INT8_MIN;
+
+  enum class Kind : uint8_t {
+    ROUTE_GAIN = 0,        ///< Gain correction of a C-block lane, see Cluster::calibrate_routes
+    MULTIPLIER_OFFSETS = 1 ///< Offsets of a multiplier on an M-block, see blocks::MMulBlock::calibrate
+  };
+
+  using Values = std::array<float, MAX_VALUES>;
+
+  struct Key {
+    std::array<uint8_t, 8> eui;
+    Kind kind;
+    uint16_t element;
+    int8_t temperature_band;
+
+    bool operator==(const Key &other) const {
+      return eui == other.eui and kind == other.kind and element == other.element and
+             temperature_band == other.temperature_band;
+    }
+  };
+
+  struct Entry {
+    Key key;
+    Values values;
+    uint32_t created_ms;
+  };
+
+  struct Statistics {
+    uint32_t hits = 0, misses = 0, stale = 0, evictions = 0;
+  };
+
+  bool enabled = true;
+  bool persistent = false; ///< Whether entries of expensive kinds are kept in the EEPROM
+  uint32_t max_age_ms = 3'600'000; ///< Entries of this age are stale, zero disables reusing them
+
+protected:
+  std::vector<Entry> entries;
+  int8_t temperature_band = UNKNOWN_TEMPERATURE_BAND;
+  bool unsaved = false;
+  Statistics statistics;
+
+  Entry *find(const Key &key);
+
+  //! Seconds of the real-time clock, which keeps running across restarts as long as the device is powered.
+  virtual uint32_t get_clock_s() const;
+
+public:
+  static bool is_persistent_kind(Kind kind) { return kind == Kind::MULTIPLIER_OFFSETS; }
+
+  //! Sets the temperature used for all following lookups and stores, NAN if it is unknown.
+  void set_temperature(float celsius);
+  int8_t get_temperature_band() const { return temperature_band; }
+
+  //! Returns the values of a valid entry, or nullptr if there is none.
+  const Values *lookup(const std::array<uint8_t, 8> &eui, Kind kind, uint16_t element);
+  void store(const std::array<uint8_t, 8> &eui, Kind kind, uint16_t element, const Values &values);
+  //! Removes all entries of a block, e.g. when its calibration was reset.
+  void invalidate(const std::array<uint8_t, 8> &eui);
+  void clear();
+
+  size_t size() const { return entries.size(); }
+  const Statistics &get_statistics() const { return statistics; }
+  //! Whether persistent entries changed since mark_saved() was called.
+  bool has_unsaved_entries() const { return unsaved; }
+  void mark_saved() { unsaved = false; }
+
+  void to_json(JsonObject target) const; ///< statistics, as in the sys_stats message
+  void settings_to_json(JsonObject target, bool with_entries) const;
+  void settings_from_json(JsonObjectConst src, bool with_entries);
+};
+
+#ifdef ARDUINO
+
+/// The settings of the CalibrationCache and its persistent entries in the permanent settings.
+class CalibrationCacheSettings : public nvmconfig::PersistentSettings,
+                                 public utils::HeapSingleton<CalibrationCacheSettings> {
+public:
+  std::string name() const override { return "calibration"; }
+  void reset_defaults() override;
+  void fromJson(JsonObjectConst src, nvmconfig::Context c = nvmconfig::Context::Flash) override;
+  void toJson(JsonObject target, nvmconfig::Context c = nvmconfig::Context::Flash) const override;
+};
+
+#endif // ARDUINO
+
+} // namespace platform
@@ -3,9 +3,13 @@
 // SPDX-License-Identifier: MIT OR GPL-2.0-or-later
 
 #include "carrier.h"
+
+#include <charconv>
+
+#include "bus/queue.h"
+#include "metadata/cache.h"
 #include "daq/daq.h"
 #include "net/settings.h"
-#include "utils/is_number.h"
 
 FLASHMEM entities::EntityClass carrier::Carrier::get_entity_class() const {
   return entities::EntityClass::CARRIER;
@@ -29,6 +33,9 @@ FLASHMEM bool carrier::Carrier::init() {
   if (entity_id.empty())
     return false;
 
+  // Entities may have been replaced since the last detection
+  metadata::cache.invalidate();
+
   // Detect CTRL-block
   ctrl_block = entities::detect<blocks::CTRLBlock>(bus::address_from_tuple(1, 0));
   if (!ctrl_block)
@@ -54,13 +61,12 @@ FLASHMEM std::vector<entities::Entity *> carrier::Carrier::get_child_entities()
   return children;
 }
 
-FLASHMEM entities::Entity *carrier::Carrier::get_child_entity(const std::string &child_id) {
-  if (utils::is_number(child_id.begin(), child_id.end())) {
-    auto cluster_idx = std::stoul(child_id);
-    if (cluster_idx < 0 or clusters.size() < cluster_idx)
-      return nullptr;
-    return &clusters[cluster_idx];
-  }
+FLASHMEM entities::Entity *carrier::Carrier::get_child_entity(std::string_view child_id) {
+  size_t cluster_idx;
+  auto child_id_end = child_id.data() + child_id.size();
+  auto [end, error] = std::from_chars(child_id.data(), child_id_end, cluster_idx);
+  if (error == std::errc() and end == child_id_end)
+    return cluster_idx < clusters.size() ? &clusters[cluster_idx] : nullptr;
   if (child_id == "CTRL")
     return ctrl_block;
   return nullptr;
@@ -72,6 +78,8 @@ FLASHMEM utils::status carrier::Carrier::config_self_from_json(JsonObjectConst c
 }
 
 FLASHMEM utils::status carrier::Carrier::write_to_hardware() {
+  // Everything is sent over the bus in one go when the batch goes out of scope
+  bus::CommandBatch batch;
   utils::status error;
   size_t cluster_index = 0;
   for (auto &cluster : clusters) {
@@ -93,6 +101,8 @@ FLASHMEM utils::status carrier::Carrier::write_to_hardware() {
   return error;
 }
 
+FLASHMEM float carrier::Carrier::read_temperature() { return hardware ? hardware->read_temperature() : NAN; }
+
 FLASHMEM bool carrier::Carrier::calibrate_offset() {
   for (auto &cluster : clusters)
     if (!cluster.calibrate_offsets())
@@ -107,8 +117,10 @@ FLASHMEM bool carrier::Carrier::calibrate_routes_in_cluster(Cluster &cluster, da
   if (!ctrl_block->write_to_hardware())
     return false;
 
-  // Calibrate routes in cluster
-  if (!cluster.calibrate_routes(daq_))
+  // Calibrate routes in cluster, reusing recent calibrations at the current temperature
+  auto &cache = CalibrationCache::get();
+  cache.set_temperature(read_temperature());
+  if (!cluster.calibrate_routes(daq_, &cache))
     return false;
 
   // Restore ADC bus selection
@@ -134,6 +146,14 @@ FLASHMEM bool carrier::Carrier::calibrate_mblock(Cluster &cluster, blocks::MBloc
 
   bool success = true;
 
+  // Offsets measured recently at the current temperature are reused
+  auto &cache = CalibrationCache::get();
+  cache.set_temperature(read_temperature());
+  if (mblock.restore_calibration(cache)) {
+    LOG(ANABRID_DEBUG_CALIBRATION, "Restored M-block calibration from cache.");
+    return true;
+  }
+
   // The calibration for each M-Block is prepared by connecting calibrated signals
   // to all eight of its input. Afterwards, the control is passed to the specific
   // M-Block calibration routine, which might change the value of those signals.
@@ -154,8 +174,7 @@ FLASHMEM bool carrier::Carrier::calibrate_mblock(Cluster &cluster, blocks::MBloc
       return false;
   }
 
-  // Write to hardware
-  // TODO: could be improved to not write every cluster
+  // Write to hardware, which only touches what changed
   if (!write_to_hardware())
     return false;
 
@@ -167,6 +186,8 @@ FLASHMEM bool carrier::Carrier::calibrate_mblock(Cluster &cluster, blocks::MBloc
   // Pass to calibration function
   LOG(ANABRID_DEBUG_CALIBRATION, "Passing control to M-block...");
   success &= mblock.calibrate(daq_, &cluster);
+  if (success)
+    mblock.store_calibration(cache);
 
   LOG(ANABRID_DEBUG_CALIBRATION, "Cleanup ADC connections...");
   cluster.reset(entities::ResetAction::CIRCUIT_RESET);
@@ -174,7 +195,6 @@ FLASHMEM bool carrier::Carrier::calibrate_mblock(Cluster &cluster, blocks::MBloc
   reset_adc_channels();
 
   // Write final clean-up to hardware
-  // TODO: could be improved to not write every cluster
   if (!write_to_hardware())
     return false;
 
@@ -247,6 +267,22 @@ FLASHMEM void carrier::Carrier::reset_adc_channels() {
   std::fill(adc_channels.begin(), adc_channels.end(), ADC_CHANNEL_DISABLED);
 }
 
+FLASHMEM utils::status carrier::Carrier::load_multiplier_calibration() {
+  blocks::MMulBlock *mulblock = nullptr;
+  for (auto &cluster : clusters) {
+    if (cluster.m0block and cluster.m0block->is_entity_type(blocks::MMulBlock::TYPE))
+      mulblock = (blocks::MMulBlock *)cluster.m0block;
+    if (cluster.m1block and cluster.m1block->is_entity_type(blocks::MMulBlock::TYPE))
+      mulblock = (blocks::MMulBlock *)cluster.m1block;
+  }
+  if (!mulblock)
+    return utils::status::success();
+  auto res = mulblock->read_calibration_from_eeprom();
+  if (!res)
+    return res;
+  return mulblock->write_calibration_to_hardware();
+}
+
 FLASHMEM utils::status carrier::Carrier::user_set_extended_config(JsonObjectConst msg_in,
                                                                   JsonObject &msg_out) {
 #ifdef ANABRID_DEBUG_COMMS
@@ -275,17 +311,7 @@ FLASHMEM utils::status carrier::Carrier::user_set_extended_config(JsonObjectCons
   }
 
   if (msg_in["mul_calib_kludge"] | default_mul_calib_kludge) {
-    blocks::MMulBlock *mulblock;
-    for (auto &cluster : clusters) {
-      if (cluster.m0block->is_entity_type(blocks::MMulBlock::TYPE))
-        mulblock = (blocks::MMulBlock *)cluster.m0block;
-      if (cluster.m1block->is_entity_type(blocks::MMulBlock::TYPE))
-        mulblock = (blocks::MMulBlock *)cluster.m1block;
-    }
-    auto res = mulblock->read_calibration_from_eeprom();
-    if (!res)
-      return res.attach("(mul_calib_kludge)");
-    res = mulblock->write_calibration_to_hardware();
+    auto res = load_multiplier_calibration();
     if (!res)
       return res.attach("(mul_calib_kludge)");
   }
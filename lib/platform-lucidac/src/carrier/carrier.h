@@ -24,6 +24,8 @@ class Carrier_HAL {
 public:
   virtual bool write_adc_bus_mux(std::array<int8_t, 8> channels) = 0;
   virtual void reset_adc_bus_mux() = 0;
+  //! Temperature on the carrier board in degree Celsius, NAN if there is no sensor.
+  virtual float read_temperature() { return NAN; }
 };
 
 /**
@@ -58,6 +60,8 @@ public:
 
   virtual bool init();
 
+  float read_temperature();
+
   virtual bool calibrate_offset();
   virtual bool calibrate_routes_in_cluster(Cluster &cluster, daq::BaseDAQ *daq_);
   virtual bool calibrate_routes(daq::BaseDAQ *daq_);
@@ -66,9 +70,12 @@ public:
 
   virtual void reset(entities::ResetAction action);
 
+  //! Loads the multiplier calibration from the EEPROM of the M-block, see user_set_extended_config.
+  virtual utils::status load_multiplier_calibration();
+
   std::vector<Entity *> get_child_entities() override;
 
-  Entity *get_child_entity(const std::string &child_id) override;
+  Entity *get_child_entity(std::string_view child_id) override;
 
   utils::status config_self_from_json(JsonObjectConst cfg) override;
 
@@ -4,6 +4,7 @@
 
 #include "carrier/cluster.h"
 #include "bus/bus.h"
+#include "bus/queue.h"
 #include "utils/logging.h"
 #include "utils/running_avg.h"
 
@@ -90,7 +91,12 @@ FLASHMEM bool platform::Cluster::calibrate_offsets() {
   return true;
 }
 
-FLASHMEM bool platform::Cluster::calibrate_routes(daq::BaseDAQ *daq) {
+FLASHMEM bool platform::Cluster::calibrate_routes(daq::BaseDAQ *daq, CalibrationCache *cache) {
+  ClusterRouteCalibrationHAL hal(*this, daq);
+  return calibrate_routes(hal, cache);
+}
+
+FLASHMEM bool platform::Cluster::calibrate_routes(RouteCalibrationHAL &hal, CalibrationCache *cache) {
   bool success = true;
   // CARE: This function assumes that certain preparations have been made, see Carrier::calibrate.
 
@@ -113,78 +119,79 @@ FLASHMEM bool platform::Cluster::calibrate_routes(daq::BaseDAQ *daq) {
   if (!iblock->write_to_hardware())
     return false; // Fatal error preventing any further regular operation in the system
 
-  // Next, we iterate through all connections on the I-block and calibrate each lane individually.
-  // This is suboptimal, as in principle we could measure 8 gain corrections at the same time.
-  // Iterating over I-block connections is easier than iterating over U-block outputs.
-  for (auto i_out_idx : blocks::IBlock::OUTPUT_IDX_RANGE()) {
-    for (auto i_in_idx : blocks::IBlock::INPUT_IDX_RANGE()) {
-      // Only do something is this lane is used in the original I-block configuration
-      if (!iblock->is_connected(i_in_idx, i_out_idx))
-        continue;
-
-      // If we don't have a complete connection through the u block, we don't need / we can't calibrate this
-      // route from here
-      if (!ublock->is_output_connected(i_in_idx))
-        continue;
-
-      LOG_ANABRID_DEBUG_CALIBRATION("Calibrating connection: ");
-      LOG_ANABRID_DEBUG_CALIBRATION(i_in_idx);
-      LOG_ANABRID_DEBUG_CALIBRATION(i_out_idx);
-
-      // Depending on whether upscaling is enabled for this lane, we apply +1 or +0.1 reference
-      // This is done on all lanes (but no other I-block connection exists, so no other current flows)
-      bool upscaled_channel = iblock->get_upscaling(i_in_idx);
-      ublock->change_all_transmission_modes(blocks::UBlock::Transmission_Mode::POS_REF);
-      ublock->change_reference_magnitude(upscaled_channel ? blocks::UBlock::Reference_Magnitude::ONE_TENTH
-                                                          : blocks::UBlock::Reference_Magnitude::ONE);
-      // Actually write to hardware
-      if (!ublock->write_to_hardware())
-        return false; // Fatal error preventing any further regular operation in the system
-
-      // Allow this connection to go up to full scale. Those values are allways legal so we can ignore the
-      // return value
-      (void)cblock->set_factor(i_in_idx, 1.0f);
-      (void)cblock->set_gain_correction(i_in_idx, 1.0f);
-      // Actually write to hardware
-      if (!cblock->write_to_hardware())
-        return false; // Fatal error preventing any further regular operation in the system
-
-      // Calibrate offsets for this specific route
-      if (!calibrate_offsets())
-        return false; // Fatal error preventing any further regular operation in the system
-
-      // Change SH-block into gain mode and select correct gain channel group
-      if (i_out_idx < 8)
-        shblock->set_state(blocks::SHBlock::State::GAIN_ZERO_TO_SEVEN);
-      else
-        shblock->set_state(blocks::SHBlock::State::GAIN_EIGHT_TO_FIFTEEN);
-      if (!shblock->write_to_hardware())
-        return false; // Fatal error preventing any further regular operation in the system
-
-      // Chill for a bit
-      delay(10);
-
-      // Measure gain output
-      auto m_adc = daq->sample_avg(4, 10)[i_out_idx % 8];
-      LOG_ANABRID_DEBUG_CALIBRATION(m_adc);
+  // Lanes calibrated recently on the same route and at a similar temperature keep their gain correction
+  std::array<uint8_t, 8> cblock_eui{};
+  std::bitset<blocks::IBlock::NUM_INPUTS> cached_lanes;
+  if (cache) {
+    cblock_eui = cblock->get_entity_eui();
+    for (auto &batch : schedule_route_calibration(*ublock, *iblock))
+      for (auto &route : batch) {
+        auto values = cache->lookup(cblock_eui, CalibrationCache::Kind::ROUTE_GAIN, batch.cache_element(route));
+        if (values and cblock->set_gain_correction(route.lane, (*values)[0]))
+          cached_lanes.set(route.lane);
+      }
+  }
+
+  // Next, we calibrate the lanes used in the I-block configuration. Up to eight of them are measured at once,
+  // one on each ADC channel, as long as their signals do not mix on the I-block outputs.
+  // The reference is applied on all lanes, but only the ones in the current batch have a C-block factor.
+  ublock->change_all_transmission_modes(blocks::UBlock::Transmission_Mode::POS_REF);
+  for (auto &batch : schedule_route_calibration(*ublock, *iblock, cached_lanes)) {
+    LOG_ANABRID_DEBUG_CALIBRATION("Calibrating connections: ");
+    for (auto &route : batch) {
+      LOG_ANABRID_DEBUG_CALIBRATION(route.lane);
+      LOG_ANABRID_DEBUG_CALIBRATION(route.i_out);
+    }
+
+    // Depending on whether upscaling is enabled for these lanes, we apply +1 or +0.1 reference
+    ublock->change_reference_magnitude(batch.upscaled ? blocks::UBlock::Reference_Magnitude::ONE_TENTH
+                                                      : blocks::UBlock::Reference_Magnitude::ONE);
+    // Actually write to hardware
+    if (!ublock->write_to_hardware())
+      return false; // Fatal error preventing any further regular operation in the system
+
+    // Allow these connections to go up to full scale. Those values are allways legal so we can ignore the
+    // return value
+    for (auto &route : batch) {
+      (void)cblock->set_factor(route.lane, 1.0f);
+      (void)cblock->set_gain_correction(route.lane, 1.0f);
+    }
+    // Actually write to hardware
+    if (!cblock->write_to_hardware())
+      return false; // Fatal error preventing any further regular operation in the system
+
+    // Calibrate offsets for these specific routes
+    if (!hal.calibrate_offsets())
+      return false; // Fatal error preventing any further regular operation in the system
+
+    // Measure gain outputs
+    std::array<float, daq::NUM_CHANNELS> m_adc;
+    if (!hal.measure(batch.output_group, m_adc))
+      return false; // Fatal error preventing any further regular operation in the system
+
+    for (auto &route : batch) {
+      LOG_ANABRID_DEBUG_CALIBRATION(m_adc[route.i_out % 8]);
       // Calculate necessary gain correction
-      auto gain_correction = 1.0f / m_adc;
+      auto gain_correction = 1.0f / m_adc[route.i_out % 8];
       LOG_ANABRID_DEBUG_CALIBRATION(gain_correction);
       // Set gain correction on C-block, which will automatically get applied when writing to hardware
-      if (!cblock->set_gain_correction(i_in_idx, gain_correction)) {
+      if (!cblock->set_gain_correction(route.lane, gain_correction)) {
         LOG_ANABRID_DEBUG_CALIBRATION("Gain correction could not be set as it is out of range. Resetting this "
                                       "channel to default corretion");
-        (void)cblock->set_gain_correction(i_in_idx, 1.0f);
+        (void)cblock->set_gain_correction(route.lane, 1.0f);
         success = false;
+      } else if (cache) {
+        cache->store(cblock_eui, CalibrationCache::Kind::ROUTE_GAIN, batch.cache_element(route),
+                     {gain_correction});
       }
 
       // Deactivate this lane again
-      (void)cblock->set_factor(i_in_idx, 0.0f);
-      if (!cblock->write_to_hardware()) // This write_to_hardware could be left out, but it's a nice safety
-                                        // measure
-        return false;                   // Fatal error preventing any further regular operation in the system
-      LOG_ANABRID_DEBUG_CALIBRATION(" ");
+      (void)cblock->set_factor(route.lane, 0.0f);
     }
+    if (!cblock->write_to_hardware()) // This write_to_hardware could be left out, but it's a nice safety
+                                      // measure
+      return false;                   // Fatal error preventing any further regular operation in the system
+    LOG_ANABRID_DEBUG_CALIBRATION(" ");
   }
 
   // Restore C-block factors
@@ -194,7 +201,7 @@ FLASHMEM bool platform::Cluster::calibrate_routes(daq::BaseDAQ *daq) {
     return false; // Fatal error preventing any further regular operation in the system
 
   // Calibrate offsets again, since they have been changed by correcting the coefficients
-  if (!calibrate_offsets())
+  if (!hal.calibrate_offsets())
     return false; // Fatal error preventing any further regular operation in the system
 
   // Restore original U-block transmission modes and reference
@@ -210,9 +217,7 @@ FLASHMEM bool platform::Cluster::calibrate_routes(daq::BaseDAQ *daq) {
     return false; // Fatal error preventing any further regular operation in the system
   }
 
-  // Switch SHBlock into inject mode
-  shblock->set_state(blocks::SHBlock::State::INJECT);
-  if (!shblock->write_to_hardware())
+  if (!hal.finish())
     return false; // Fatal error preventing any further regular operation in the system
 
   return success;
@@ -229,6 +234,7 @@ FLASHMEM bool platform::Cluster::calibrate_m_blocks(daq::BaseDAQ *daq) {
 }
 
 FLASHMEM utils::status platform::Cluster::write_to_hardware() {
+  bus::CommandBatch batch;
   for (auto block : get_blocks()) {
     if (block)
       if (!block->write_to_hardware()) {
@@ -295,7 +301,7 @@ FLASHMEM void platform::Cluster::reset(entities::ResetAction action) {
   }
 }
 
-FLASHMEM entities::Entity *platform::Cluster::get_child_entity(const std::string &child_id) {
+FLASHMEM entities::Entity *platform::Cluster::get_child_entity(std::string_view child_id) {
   if (child_id == "M0")
     return m0block;
   else if (child_id == "M1")
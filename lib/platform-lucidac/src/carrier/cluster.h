@@ -5,6 +5,8 @@
 #pragma once
 
 #include "block/blocks.h"
+#include "carrier/calibration_cache.h"
+#include "carrier/route_calibration.h"
 #include "daq/base.h"
 #include "entity/entity.h"
 
@@ -43,7 +45,10 @@ public:
   std::array<blocks::FunctionBlock *, 6> get_blocks() const;
 
   bool calibrate_offsets();
-  bool calibrate_routes(daq::BaseDAQ *daq);
+  bool calibrate_routes(daq::BaseDAQ *daq, CalibrationCache *cache = nullptr);
+  //! Calibrates the gain of the used lanes, measuring up to eight of them at once through the given HAL.
+  //! Lanes with a valid entry in the cache are not measured again.
+  bool calibrate_routes(RouteCalibrationHAL &hal, CalibrationCache *cache = nullptr);
   bool calibrate_m_blocks(daq::BaseDAQ *daq);
 
   [[nodiscard]] utils::status write_to_hardware() override;
@@ -85,7 +90,7 @@ public:
 
   std::vector<Entity *> get_child_entities() override;
 
-  Entity *get_child_entity(const std::string &child_id) override;
+  Entity *get_child_entity(std::string_view child_id) override;
 
   utils::status config_self_from_json(JsonObjectConst cfg) override;
 };
@@ -0,0 +1,82 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "carrier/route_calibration.h"
+
+#include "block/iblock.h"
+#include "block/shblock.h"
+#include "block/ublock.h"
+#include "carrier/cluster.h"
+
+namespace {
+
+// Whether route can be measured together with the ones in batch, without their signals mixing
+bool fits_into(const platform::RouteCalibrationBatch &batch, const platform::RouteCalibrationBatch::Route &route,
+               bool upscaled, const blocks::IBlock &iblock) {
+  if (batch.size == batch.MAX_ROUTES or batch.output_group != route.i_out / 8 or batch.upscaled != upscaled)
+    return false;
+  for (auto &other : batch)
+    if (other.i_out == route.i_out or iblock.is_connected(route.lane, other.i_out) or
+        iblock.is_connected(other.lane, route.i_out))
+      return false;
+  return true;
+}
+
+} // namespace
+
+FLASHMEM std::vector<platform::RouteCalibrationBatch>
+platform::schedule_route_calibration(const blocks::UBlock &ublock, const blocks::IBlock &iblock,
+                                     std::bitset<32> skip_lanes) {
+  // One route per connected lane, its last output in the order of I-block outputs
+  std::array<int8_t, blocks::IBlock::NUM_INPUTS> lane_outputs;
+  lane_outputs.fill(-1);
+  for (auto i_out_idx : blocks::IBlock::OUTPUT_IDX_RANGE())
+    for (auto i_in_idx : blocks::IBlock::INPUT_IDX_RANGE())
+      if (iblock.is_connected(i_in_idx, i_out_idx) and ublock.is_output_connected(i_in_idx))
+        lane_outputs[i_in_idx] = i_out_idx;
+
+  // First fit in the same order, which puts neighbouring outputs into the same batch
+  std::vector<RouteCalibrationBatch> batches;
+  for (auto i_out_idx : blocks::IBlock::OUTPUT_IDX_RANGE())
+    for (auto i_in_idx : blocks::IBlock::INPUT_IDX_RANGE()) {
+      if (lane_outputs[i_in_idx] != i_out_idx or skip_lanes[i_in_idx])
+        continue;
+      RouteCalibrationBatch::Route route{i_in_idx, i_out_idx};
+      bool upscaled = iblock.get_upscaling(i_in_idx);
+
+      auto batch = batches.begin();
+      while (batch != batches.end() and !fits_into(*batch, route, upscaled, iblock))
+        ++batch;
+      if (batch == batches.end()) {
+        batch = batches.emplace(batches.end());
+        batch->output_group = i_out_idx / 8;
+        batch->upscaled = upscaled;
+      }
+      batch->routes[batch->size++] = route;
+    }
+  return batches;
+}
+
+FLASHMEM bool platform::ClusterRouteCalibrationHAL::calibrate_offsets() { return cluster.calibrate_offsets(); }
+
+FLASHMEM bool platform::ClusterRouteCalibrationHAL::measure(uint8_t output_group,
+                                                            std::array<float, daq::NUM_CHANNELS> &values) {
+  // Change SH-block into gain mode and select correct gain channel group
+  cluster.shblock->set_state(output_group ? blocks::SHBlock::State::GAIN_EIGHT_TO_FIFTEEN
+                                          : blocks::SHBlock::State::GAIN_ZERO_TO_SEVEN);
+  if (!cluster.shblock->write_to_hardware())
+    return false;
+
+  // Chill for a bit
+  delay(10);
+
+  values = daq->sample_avg(4, 10);
+  return true;
+}
+
+FLASHMEM bool platform::ClusterRouteCalibrationHAL::finish() {
+  // Switch SHBlock into inject mode
+  cluster.shblock->set_state(blocks::SHBlock::State::INJECT);
+  return cluster.shblock->write_to_hardware();
+}
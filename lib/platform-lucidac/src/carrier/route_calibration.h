@@ -0,0 +1,89 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include "daq/base.h"
+
+namespace blocks {
+class IBlock;
+class UBlock;
+} // namespace blocks
+
+namespace platform {
+
+class Cluster;
+
+/**
+ * Routes through a cluster whose gains are measured at the same time, one on each ADC channel.
+ *
+ * A route is a lane (U-block output, C-block coefficient and I-block input) and the I-block output
+ * it is measured at. All outputs of a batch are in the same group of eight, which the SH-block
+ * switches to the ADC, and each of them only receives the signal of its own lane.
+ **/
+struct RouteCalibrationBatch {
+  static constexpr uint8_t MAX_ROUTES = daq::NUM_CHANNELS;
+
+  struct Route {
+    uint8_t lane;
+    uint8_t i_out;
+  };
+
+  std::array<Route, MAX_ROUTES> routes{};
+  uint8_t size = 0;
+  //! Outputs 0-7 are group 0, outputs 8-15 are group 1.
+  uint8_t output_group = 0;
+  //! Whether the lanes are upscaled, which needs a smaller reference signal.
+  bool upscaled = false;
+
+  const Route *begin() const { return routes.data(); }
+  const Route *end() const { return routes.data() + size; }
+
+  //! Identifies a route of this batch in the CalibrationCache
+  uint16_t cache_element(const Route &route) const { return route.lane | route.i_out << 5 | upscaled << 9; }
+};
+
+/**
+ * Groups the routes of the current configuration into batches which can be measured at once.
+ *
+ * The gain correction is a property of the lane, so each connected lane is calibrated once.
+ * For a lane connected to several outputs, the last of them is used, as it was when calibrating one
+ * route after another. Lanes in skip_lanes are left out, e.g. because their calibration is cached.
+ **/
+std::vector<RouteCalibrationBatch> schedule_route_calibration(const blocks::UBlock &ublock,
+                                                              const blocks::IBlock &iblock,
+                                                              std::bitset<32> skip_lanes = {});
+
+/**
+ * The analog part of the route calibration, which is the SH-block and the ADCs.
+ * Everything else is done through the blocks of the cluster, @see Cluster::calibrate_routes.
+ **/
+class RouteCalibrationHAL {
+public:
+  //! Compensates the offsets with the current configuration.
+  virtual bool calibrate_offsets() = 0;
+  //! Switches the outputs of group (0 or 1) to the ADCs and returns the averaged values once they settled.
+  virtual bool measure(uint8_t output_group, std::array<float, daq::NUM_CHANNELS> &values) = 0;
+  //! Leaves the measurement mode, which is done after the last measurement.
+  virtual bool finish() = 0;
+};
+
+class ClusterRouteCalibrationHAL : public RouteCalibrationHAL {
+  Cluster &cluster;
+  daq::BaseDAQ *daq;
+
+public:
+  ClusterRouteCalibrationHAL(Cluster &cluster, daq::BaseDAQ *daq) : cluster(cluster), daq(daq) {}
+
+  bool calibrate_offsets() override;
+  bool measure(uint8_t output_group, std::array<float, daq::NUM_CHANNELS> &values) override;
+  bool finish() override;
+};
+
+} // namespace platform
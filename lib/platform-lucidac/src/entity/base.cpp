@@ -11,23 +11,13 @@ entities::EntityClassifier entities::Entity::get_entity_classifier() const {
   return {get_entity_class(), get_entity_type(), get_entity_version(), get_entity_variant()};
 }
 
-FLASHMEM
-entities::Entity* entities::Entity::resolve_child_entity(std::string paths[], size_t len) {
-    auto resolved_entity = this;
-    for (size_t path_depth = 0; path_depth < len; path_depth++) {
-      resolved_entity = resolved_entity->get_child_entity(paths[path_depth]);
-      if (!resolved_entity) {
-        return nullptr;
-      }
-    }
-    return resolved_entity;
-}
-
 FLASHMEM
 entities::Entity *entities::Entity::resolve_child_entity(JsonArrayConstIterator begin, JsonArrayConstIterator end) {
     auto resolved_entity = this;
     for (auto sub_path = begin; sub_path != end; ++sub_path) {
-      std::string child_entity_id = (*sub_path).as<const char *>();
+      auto child_entity_id = (*sub_path).as<const char *>();
+      if (!child_entity_id)
+        return nullptr;
       resolved_entity = resolved_entity->get_child_entity(child_entity_id);
       if (!resolved_entity) {
         return nullptr;
@@ -56,7 +46,7 @@ FLASHMEM
 utils::status entities::Entity::config_children_from_json(JsonObjectConst &cfg) {
     for (JsonPairConst keyval : cfg) {
       if (keyval.key().c_str()[0] == '/' and keyval.key().size() > 1) {
-        std::string child_id(keyval.key().c_str() + 1);
+        auto child_id = keyval.key().c_str() + 1;
         auto child_entity = get_child_entity(child_id);
         if (!child_entity)
           return utils::status("Child entity '%s' does not exist at entity '%s'", child_id, get_entity_id().c_str());
@@ -114,49 +104,59 @@ void entities::Entity::classifier_to_json(JsonObject& out) {
   }
 }
 
+FLASHMEM void entities::Entity::mark_dirty() {
+  for (auto child_ptr : get_child_entities())
+    if (child_ptr)
+      child_ptr->mark_dirty();
+}
+
+FLASHMEM utils::status entities::Entity::force_write_to_hardware() {
+  mark_dirty();
+  return write_to_hardware();
+}
+
 FLASHMEM utils::status entities::Entity::user_set_config(JsonObjectConst msg_in, JsonObject &msg_out) {
 #ifdef ANABRID_DEBUG_COMMS
   Serial.println(__PRETTY_FUNCTION__);
 #endif
-  auto self_entity_id = get_entity_id();
+  utils::status res = stage_config(msg_in);
+  if (!res)
+    return res;
+
+  // Actually write to hardware
+  if (msg_in["force"] | false)
+    return force_write_to_hardware();
+  return write_to_hardware();
+}
+
+FLASHMEM utils::status entities::Entity::stage_config(JsonObjectConst msg_in) {
+  auto &self_entity_id = get_entity_id();
   if (!msg_in.containsKey("entity") or !msg_in.containsKey("config")) {
     return utils::status(1, "Malformed message.");
   }
 
-  // Convert JSON array of possible anything to string array
-  auto path_json = msg_in["entity"].as<JsonArrayConst>();
-  auto path_depth = path_json.size();
-  std::string path[path_depth];
-  copyArray(path_json, path, path_depth);
+  // The path is resolved directly from the message, without copying its elements
+  auto path = msg_in["entity"].as<JsonArrayConst>();
 
   // Sanity check path, which must at least be addressed to us
-  if (!path_depth) {
+  if (!path.size()) {
     return utils::status(2, "Invalid entity path (depth)");
   }
-  if (path[0] != self_entity_id) {
+  auto path_begin = path.begin();
+  auto path_head = (*path_begin).as<const char *>();
+  if (!path_head or self_entity_id != path_head) {
     return utils::status(3, "Message intended for another entity (%s but I am %s)",
-       path[0].c_str(), self_entity_id.c_str());
+       path_head ? path_head : "null", self_entity_id.c_str());
   }
 
   // Path may be to one of our sub-entities
-  auto resolved_entity = resolve_child_entity(path + 1, path_depth - 1);
+  auto resolved_entity = resolve_child_entity(++path_begin, path.end());
   if (!resolved_entity) {
     return utils::status(4, "Could not resolve child entity in given path");
   }
 
-  utils::status res = resolved_entity->config_from_json(msg_in["config"]);
-  if (!res) {
-    // Could enrich with "could not apply configuration..."
-    return res;
-  }
-
-  // Actually write to hardware
-  utils::status hw_res = write_to_hardware();
-  if(!hw_res) {
-    return hw_res;
-  }
-
-  return utils::status::success();
+  // Could enrich with "could not apply configuration..."
+  return resolved_entity->config_from_json(msg_in["config"]);
 }
 
 FLASHMEM utils::status entities::Entity::user_get_config(JsonObjectConst msg_in, JsonObject &msg_out) {
@@ -175,7 +175,7 @@ FLASHMEM utils::status entities::Entity::user_get_config(JsonObjectConst msg_in,
     auto path = msg_in["entity"].as<JsonArrayConst>();
     if (!path.size()) {
       entity = this;
-    } else if (path[0].as<std::string>() != get_entity_id()) {
+    } else if (!path[0].is<const char *>() or get_entity_id() != path[0].as<const char *>()) {
       return utils::status(1, "Requested entity %s but I am %s", path[0].as<const char*>(), get_entity_id().c_str());
     } else {
       auto path_begin = path.begin();
@@ -223,7 +223,7 @@ FLASHMEM utils::status entities::Entity::user_reset_config(JsonObjectConst msg_i
   reset(reset_request);
 
   if (msg_in["sync"] | true) {
-    auto status = write_to_hardware();
+    auto status = (msg_in["force"] | false) ? force_write_to_hardware() : write_to_hardware();
     if(!status) {
       return status;
     }
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -137,9 +138,7 @@ public:
 
   virtual std::vector<Entity *> get_child_entities() = 0;
 
-  virtual Entity *get_child_entity(const std::string &child_id) = 0;
-
-  Entity *resolve_child_entity(std::string paths[], size_t len);
+  virtual Entity *get_child_entity(std::string_view child_id) = 0;
 
   Entity *resolve_child_entity(JsonArrayConstIterator begin, JsonArrayConstIterator end);
 
@@ -150,9 +149,23 @@ public:
 
   virtual void reset(ResetAction action) {}
 
-  /// returns true in case of success
+  /**
+   * Writes the in-memory configuration to the hardware.
+   * Entities keep track of what changed since the last write and only write that,
+   * @see force_write_to_hardware() for a full resynchronisation.
+   **/
   [[nodiscard]] virtual utils::status write_to_hardware() { return utils::status::success(); }
 
+  /**
+   * Forgets what is known about the hardware state of this entity and all its children,
+   * such that the next write_to_hardware() writes the complete configuration.
+   * Entities which track changes override this, the default just traverses the children.
+   **/
+  virtual void mark_dirty();
+
+  /// Writes the complete configuration, regardless of what changed since the last write.
+  [[nodiscard]] utils::status force_write_to_hardware();
+
   /**
    * Deserialize a new configuration for this entity and all its children from a JsonObject.
    * @returns true in case of success, else false
@@ -169,6 +182,12 @@ public:
       config_children_to_json(cfg);
   }
 
+  /**
+   * Applies a set_circuit style message ({"entity": [...], "config": {...}}) to the in-memory
+   * configuration only. Call write_to_hardware() afterwards to make it effective.
+   **/
+  utils::status stage_config(JsonObjectConst msg_in);
+
   ///@addtogroup User-Functions
   ///@{
   utils::status user_set_config(JsonObjectConst msg_in, JsonObject &msg_out);
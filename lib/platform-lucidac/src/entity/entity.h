@@ -9,6 +9,7 @@
 #include "entity/base.h"
 
 #include "bus/bus.h"
+#include "metadata/cache.h"
 #include "metadata/metadata.h"
 #include "utils/logging.h"
 
@@ -46,6 +47,7 @@ public:
   }
 
   bool write_entity_classifier(const entities::EntityClassifier &classifier) {
+    cache.invalidate(address);
     return EEPROM25AA02::write(offsetof(MetadataMemoryLayoutV1, classifier), sizeof(classifier),
                                reinterpret_cast<const uint8_t *>(std::addressof(classifier)));
   }
@@ -58,8 +60,7 @@ namespace entities {
 
 template <class BlockT> BlockT *detect(const bus::addr_t block_address) {
   LOG(ANABRID_DEBUG_INIT, __PRETTY_FUNCTION__);
-  metadata::MetadataEditor reader(block_address);
-  auto classifier = reader.read_entity_classifier();
+  auto classifier = metadata::cache.get_classifier(block_address);
   LOG(ANABRID_DEBUG_INIT, (std::string("Read classifier ") + classifier.to_string() + " at address " +
                            std::to_string(block_address) + ".")
                               .c_str());
@@ -213,7 +213,7 @@ platform::LUCIDACFrontPanel::from_entity_classifier(entities::EntityClassifier c
 }
 
 FLASHMEM std::array<uint8_t, 8> platform::LUCIDACFrontPanel::get_entity_eui() const {
-  return metadata::MetadataEditor(bus::address_from_tuple(2, 0)).read_eui();
+  return metadata::cache.get_eui(bus::address_from_tuple(2, 0));
 }
 
 FLASHMEM utils::status platform::LUCIDACFrontPanel::config_self_from_json(JsonObjectConst cfg) {
@@ -37,7 +37,7 @@ public:
 
   utils::status config_self_from_json(JsonObjectConst cfg) override;
 
-  Entity *get_child_entity(const std::string &child_id) override { return nullptr; }
+  Entity *get_child_entity(std::string_view child_id) override { return nullptr; }
 
   std::vector<Entity *> get_child_entities() override { return {}; };
 
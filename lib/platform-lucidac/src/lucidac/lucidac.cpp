@@ -4,6 +4,7 @@
 // SPDX-License-Identifier: MIT OR GPL-2.0-or-later
 
 #include "lucidac.h"
+#include "bus/queue.h"
 #include "utils/mac.h"
 
 const SPISettings platform::LUCIDAC_HAL::F_ADC_SWITCHER_PRG_SPI_SETTINGS{
@@ -46,7 +47,7 @@ FLASHMEM bool LUCIDAC_HAL::write_adc_bus_mux(std::array<int8_t, 8> channels) {
   // Reset previous connections
   // It's easier to do a full reset then to remember all previous connections
   reset_adc_bus_mux();
-  delayNanoseconds(420);
+  bus::wait_nanoseconds(420);
 
   // Write data to chip
   for (uint8_t output_idx = 0; output_idx < channels.size(); output_idx++) {
@@ -62,6 +63,8 @@ FLASHMEM bool LUCIDAC_HAL::write_adc_bus_mux(std::array<int8_t, 8> channels) {
 
 FLASHMEM void LUCIDAC_HAL::reset_adc_bus_mux() { f_adc_switcher_matrix_reset.trigger(); }
 
+FLASHMEM float LUCIDAC_HAL::read_temperature() { return f_temperature.read_temperature(); }
+
 FLASHMEM bool LUCIDAC::init() {
   if (!Carrier::init())
     return false;
@@ -100,7 +103,7 @@ FLASHMEM std::vector<entities::Entity *> LUCIDAC::get_child_entities() {
   return entities;
 }
 
-FLASHMEM entities::Entity *LUCIDAC::get_child_entity(const std::string &child_id) {
+FLASHMEM entities::Entity *LUCIDAC::get_child_entity(std::string_view child_id) {
   if (child_id == "FP")
     return front_panel;
   return this->carrier::Carrier::get_child_entity(child_id);
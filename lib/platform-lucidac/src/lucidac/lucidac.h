@@ -49,15 +49,17 @@ public:
   enum class ACL { INTERNAL_ = 0, EXTERNAL_ = 1 };
 
   //! Write bits to ACL shift register, from I-block input 24 (first element) to 31 (last element)
-  bool write_acl(std::array<ACL, 8> acl);
+  virtual bool write_acl(std::array<ACL, 8> acl);
 
-  void reset_acl();
+  virtual void reset_acl();
 
   //! Write channel selection to ADC bus muxer.
   //! Each element in channels selects the input index for the n-th ADC bus output (-1 disables).
   bool write_adc_bus_mux(std::array<int8_t, 8> channels) override;
 
   void reset_adc_bus_mux() override;
+
+  float read_temperature() override;
 };
 
 class LUCIDAC : public carrier::Carrier, public utils::HeapSingleton<LUCIDAC> {
@@ -85,7 +87,7 @@ public:
 
   std::vector<Entity *> get_child_entities() override;
 
-  Entity *get_child_entity(const std::string &child_id) override;
+  Entity *get_child_entity(std::string_view child_id) override;
 
   utils::status config_self_from_json(JsonObjectConst cfg) override;
   void config_self_to_json(JsonObject &cfg) override;
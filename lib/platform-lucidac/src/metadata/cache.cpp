@@ -0,0 +1,64 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "metadata/cache.h"
+
+#include "entity/entity.h"
+
+namespace {
+metadata::EEPROMMetadataReader eeprom_reader;
+}
+
+metadata::MetadataCache metadata::cache{&eeprom_reader};
+
+FLASHMEM bool metadata::EEPROMMetadataReader::read(
+    bus::addr_t block_address, std::array<uint8_t, sizeof(entities::EntityClassifier)> &classifier,
+    std::array<uint8_t, 8> &eui) {
+  MetadataEditor editor(block_address);
+  // Reads return the number of bytes read, which is less than requested on errors
+  return editor.read(offsetof(MetadataMemoryLayoutV1, classifier), classifier.size(), classifier.data()) ==
+             classifier.size() and
+         editor.read(offsetof(MetadataMemoryLayoutV1, uuid), eui.size(), eui.data()) == eui.size();
+}
+
+FLASHMEM metadata::MetadataCache::MetadataCache(MetadataReader *reader) : reader(reader) {}
+
+FLASHMEM void metadata::MetadataCache::set_reader(MetadataReader *reader_) {
+  reader = reader_;
+  invalidate();
+}
+
+FLASHMEM const metadata::MetadataCache::Entry &metadata::MetadataCache::get(bus::addr_t address, Entry &scratch) {
+  for (size_t idx = 0; idx < num_entries; idx++)
+    if (entries[idx].address == address)
+      return entries[idx];
+
+  // Failed reads are not cached, so they are retried next time
+  Entry &entry = num_entries < entries.size() ? entries[num_entries] : scratch;
+  entry = {address, {}, {}};
+  if (reader->read(address, entry.classifier, entry.eui) and &entry != &scratch)
+    num_entries++;
+  return entry;
+}
+
+FLASHMEM entities::EntityClassifier metadata::MetadataCache::get_classifier(bus::addr_t block_address) {
+  Entry scratch;
+  auto &data = get(block_address, scratch).classifier;
+  return {data[0], data[1], data[2], data[3], data[4], data[5]};
+}
+
+FLASHMEM std::array<uint8_t, 8> metadata::MetadataCache::get_eui(bus::addr_t block_address) {
+  Entry scratch;
+  return get(block_address, scratch).eui;
+}
+
+FLASHMEM void metadata::MetadataCache::invalidate(bus::addr_t block_address) {
+  for (size_t idx = 0; idx < num_entries; idx++)
+    if (entries[idx].address == block_address) {
+      entries[idx] = entries[--num_entries];
+      return;
+    }
+}
+
+FLASHMEM void metadata::MetadataCache::invalidate() { num_entries = 0; }
@@ -0,0 +1,76 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "bus/bus.h"
+#include "entity/base.h"
+
+namespace metadata {
+
+/**
+ * Source of the metadata which is cached by MetadataCache.
+ * On the device, this is the EEPROM of each entity, see EEPROMMetadataReader.
+ **/
+class MetadataReader {
+public:
+  /// Reads the raw entity classifier and the EUI-64 of the entity at block_address.
+  virtual bool read(bus::addr_t block_address, std::array<uint8_t, sizeof(entities::EntityClassifier)> &classifier,
+                    std::array<uint8_t, 8> &eui) = 0;
+};
+
+class EEPROMMetadataReader : public MetadataReader {
+public:
+  bool read(bus::addr_t block_address, std::array<uint8_t, sizeof(entities::EntityClassifier)> &classifier,
+            std::array<uint8_t, 8> &eui) override;
+};
+
+/**
+ * Caches the entity classifier and EUI of each entity, which never change while it is plugged in.
+ *
+ * Entries are read once on first access, which is the entity detection in Carrier::init,
+ * after which listing entities does not access the bus anymore.
+ * When an entity may have changed, for instance when its classifier is written or
+ * the hardware is detected again, the cache must be invalidated.
+ **/
+class MetadataCache {
+public:
+  static constexpr size_t MAX_ENTRIES = 32;
+
+private:
+  struct Entry {
+    bus::addr_t address;
+    std::array<uint8_t, sizeof(entities::EntityClassifier)> classifier;
+    std::array<uint8_t, 8> eui;
+  };
+
+  std::array<Entry, MAX_ENTRIES> entries{};
+  size_t num_entries = 0;
+  MetadataReader *reader;
+
+  /// Returns the entry for address, reading it if necessary. If the cache is full, scratch is used instead.
+  const Entry &get(bus::addr_t address, Entry &scratch);
+
+public:
+  explicit MetadataCache(MetadataReader *reader);
+
+  MetadataReader *get_reader() const { return reader; }
+  /// Replaces the source of the metadata, which invalidates everything.
+  void set_reader(MetadataReader *reader_);
+
+  entities::EntityClassifier get_classifier(bus::addr_t block_address);
+  std::array<uint8_t, 8> get_eui(bus::addr_t block_address);
+
+  void invalidate(bus::addr_t block_address);
+  void invalidate();
+
+  size_t size() const { return num_entries; }
+};
+
+extern MetadataCache cache;
+
+} // namespace metadata
@@ -0,0 +1,122 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "simulation/analog.h"
+
+FLASHMEM bool simulation::SimulatedUBlockHAL::write_outputs(std::array<int8_t, 32> outputs_) {
+  outputs = outputs_;
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedUBlockHAL::write_transmission_modes_and_ref(
+    std::pair<Transmission_Mode, Transmission_Mode> modes_, Reference_Magnitude ref_) {
+  modes = modes_;
+  ref = ref_;
+  return true;
+}
+
+FLASHMEM void simulation::SimulatedUBlockHAL::reset_transmission_modes_and_ref() {
+  modes = {Transmission_Mode::ANALOG_INPUT, Transmission_Mode::ANALOG_INPUT};
+  ref = Reference_Magnitude::ONE;
+}
+
+FLASHMEM bool simulation::SimulatedCBlockHAL::write_factor(uint8_t idx, uint16_t raw) {
+  if (idx >= factors.size())
+    return false;
+  factors[idx] = functions::AD5452::raw_to_float(raw);
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedIBlockHAL::write_outputs(const std::array<uint32_t, 16> &outputs_) {
+  outputs = outputs_;
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedIBlockHAL::write_upscaling(std::bitset<32> upscaling_) {
+  upscaling = upscaling_;
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedMIntBlockHAL::write_ic(uint8_t idx, uint16_t raw) {
+  if (idx >= ic_values.size())
+    return false;
+  ic_values[idx] = raw_to_ic(raw);
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedMIntBlockHAL::write_time_factor_switches(std::bitset<8> switches) {
+  time_factor_switches = switches;
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedMMulBlockHAL::write_calibration_input_offsets(uint8_t idx, float offset_x,
+                                                                                 float offset_y) {
+  if (idx >= offsets.size())
+    return false;
+  offsets[idx].offset_x = offset_x;
+  offsets[idx].offset_y = offset_y;
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedMMulBlockHAL::reset_calibration_input_offsets() {
+  for (auto &offset : offsets)
+    offset.offset_x = offset.offset_y = 0.0f;
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedMMulBlockHAL::write_calibration_output_offset(uint8_t idx, float offset_z) {
+  if (idx >= offsets.size())
+    return false;
+  offsets[idx].offset_z = offset_z;
+  return true;
+}
+
+FLASHMEM bool simulation::SimulatedMMulBlockHAL::reset_calibration_output_offsets() {
+  for (auto &offset : offsets)
+    offset.offset_z = 0.0f;
+  return true;
+}
+
+FLASHMEM float simulation::AnalogCluster::lane_signal(uint8_t lane) const {
+  auto input = uhal.outputs[lane];
+  if (input < 0)
+    return 0.0f;
+
+  // Input 15 (for the first half of the outputs) or 14 (for the second half) may carry the B side signal
+  bool b_side = (lane < 16 and input == 15) or (lane >= 16 and input == 14);
+  auto mode = b_side ? uhal.modes.second : uhal.modes.first;
+  float ref = uhal.ref == blocks::UBlockHAL::Reference_Magnitude::ONE ? 1.0f : 0.1f;
+  switch (mode) {
+  case blocks::UBlockHAL::Transmission_Mode::ANALOG_INPUT:
+    return u_inputs[input];
+  case blocks::UBlockHAL::Transmission_Mode::POS_REF:
+    return ref;
+  case blocks::UBlockHAL::Transmission_Mode::NEG_REF:
+    return -ref;
+  default:
+    return 0.0f;
+  }
+}
+
+FLASHMEM float simulation::AnalogCluster::i_output(uint8_t i_out) const {
+  float sum = 0.0f;
+  for (uint8_t lane = 0; lane < blocks::IBlockHAL::NUM_INPUTS; lane++)
+    if (ihal.outputs[i_out] & blocks::IBlockHAL::INPUT_BITMASK(lane))
+      sum += lane_signal(lane) * chal.factors[lane] * lane_gains[lane] * (ihal.upscaling[lane] ? 10.0f : 1.0f);
+  return sum;
+}
+
+FLASHMEM bool simulation::AnalogCluster::calibrate_offsets() {
+  elapsed_us += OFFSET_CALIBRATION_US;
+  return true;
+}
+
+FLASHMEM bool simulation::AnalogCluster::measure(uint8_t output_group,
+                                                 std::array<float, daq::NUM_CHANNELS> &values) {
+  measurements++;
+  elapsed_us += MEASUREMENT_US;
+  for (uint8_t channel = 0; channel < daq::NUM_CHANNELS; channel++)
+    values[channel] = i_output(output_group * daq::NUM_CHANNELS + channel);
+  return true;
+}
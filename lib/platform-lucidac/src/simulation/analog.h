@@ -0,0 +1,115 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+#include "block/cblock.h"
+#include "block/iblock.h"
+#include "block/mblock.h"
+#include "block/ublock.h"
+#include "carrier/route_calibration.h"
+
+namespace simulation {
+
+// HALs which keep what was written to them, such that the analog signals can be computed from it
+
+class SimulatedUBlockHAL : public blocks::UBlockHAL {
+public:
+  std::array<int8_t, 32> outputs{-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+  std::pair<Transmission_Mode, Transmission_Mode> modes{Transmission_Mode::ANALOG_INPUT,
+                                                        Transmission_Mode::ANALOG_INPUT};
+  Reference_Magnitude ref = Reference_Magnitude::ONE;
+
+  bool write_outputs(std::array<int8_t, 32> outputs_) override;
+  bool write_transmission_modes_and_ref(std::pair<Transmission_Mode, Transmission_Mode> modes_,
+                                        Reference_Magnitude ref_) override;
+  void reset_transmission_modes_and_ref() override;
+};
+
+class SimulatedCBlockHAL : public blocks::CBlockHAL {
+public:
+  //! Factors as set by the written DAC codes, including their gain corrections
+  std::array<float, blocks::CBlock::NUM_COEFF> factors{};
+
+  bool write_factor(uint8_t idx, uint16_t raw) override;
+};
+
+class SimulatedIBlockHAL : public blocks::IBlockHAL {
+public:
+  std::array<uint32_t, NUM_OUTPUTS> outputs{};
+  std::bitset<NUM_INPUTS> upscaling;
+
+  bool write_outputs(const std::array<uint32_t, 16> &outputs_) override;
+  bool write_upscaling(std::bitset<32> upscaling_) override;
+};
+
+class SimulatedMIntBlockHAL : public blocks::MIntBlockHAL {
+public:
+  std::array<float, blocks::MIntBlock::NUM_INTEGRATORS> ic_values{};
+  //! Set for integrators with the slow time factor, see MIntBlock::write_to_hardware
+  std::bitset<blocks::MIntBlock::NUM_INTEGRATORS> time_factor_switches;
+  std::bitset<8> overload_flags;
+
+  bool write_ic(uint8_t idx, uint16_t raw) override;
+  bool write_time_factor_switches(std::bitset<8> switches) override;
+  std::bitset<8> read_overload_flags() override { return overload_flags; }
+  void reset_overload_flags() override { overload_flags.reset(); }
+};
+
+class SimulatedMMulBlockHAL : public blocks::MMulBlockHAL {
+public:
+  std::array<blocks::MultiplierCalibration, blocks::MMulBlock::NUM_MULTIPLIERS> offsets{};
+  std::bitset<8> overload_flags;
+
+  bool write_calibration_input_offsets(uint8_t idx, float offset_x, float offset_y) override;
+  bool reset_calibration_input_offsets() override;
+  bool write_calibration_output_offset(uint8_t idx, float offset_z) override;
+  bool reset_calibration_output_offsets() override;
+  std::bitset<8> read_overload_flags() override { return overload_flags; }
+  void reset_overload_flags() override { overload_flags.reset(); }
+};
+
+/**
+ * A static model of the U-, C- and I-block of a cluster, computing the I-block outputs from what was
+ * written to the simulated HALs. Each lane has a gain error, which the route calibration should correct.
+ *
+ * It also stands in for the SH-block and ADCs during the route calibration and keeps track of how long
+ * the calibration would take on the hardware.
+ **/
+class AnalogCluster : public platform::RouteCalibrationHAL {
+public:
+  // Settling times on the hardware, see Cluster::calibrate_offsets and ClusterRouteCalibrationHAL
+  static constexpr uint32_t OFFSET_CALIBRATION_US = 10000 + 10000 + 5000;
+  static constexpr uint32_t MEASUREMENT_US = 10000 + 4 * 10;
+
+  SimulatedUBlockHAL uhal;
+  SimulatedCBlockHAL chal;
+  SimulatedIBlockHAL ihal;
+
+  //! Signals at the U-block inputs, which are the M-block outputs.
+  std::array<float, 16> u_inputs{};
+  //! Actual gain of each lane, which is ideally one.
+  std::array<float, blocks::CBlock::NUM_COEFF> lane_gains;
+
+  unsigned int measurements = 0;
+  uint32_t elapsed_us = 0;
+
+  AnalogCluster() { lane_gains.fill(1.0f); }
+
+  //! Signal on a lane after the U-block
+  float lane_signal(uint8_t lane) const;
+  //! Signal at an I-block output
+  float i_output(uint8_t i_out) const;
+
+  bool calibrate_offsets() override;
+  bool measure(uint8_t output_group, std::array<float, daq::NUM_CHANNELS> &values) override;
+  bool finish() override { return true; }
+};
+
+} // namespace simulation
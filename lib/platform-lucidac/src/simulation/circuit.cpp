@@ -0,0 +1,148 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "simulation/circuit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+using blocks::MBlock;
+
+// Index of an input or output of a slot, in the numbering of the I-block outputs and U-block inputs
+uint8_t signal_index(size_t slot, uint8_t idx) {
+  return static_cast<MBlock::SLOT>(slot) == MBlock::SLOT::M0 ? MBlock::M0_OUTPUT(idx) : MBlock::M1_OUTPUT(idx);
+}
+
+} // namespace
+
+FLASHMEM simulation::CircuitSimulation::CircuitSimulation(const AnalogCluster &cluster, Slot m0, Slot m1)
+    : cluster(cluster), slots{m0, m1} {}
+
+FLASHMEM void simulation::CircuitSimulation::reset() {
+  // Probe the linear part with one unit signal at a time
+  AnalogCluster probe = cluster;
+  probe.u_inputs.fill(0.0f);
+  for (uint8_t out = 0; out < NUM_SIGNALS; out++)
+    constant[out] = probe.i_output(out);
+  for (uint8_t in = 0; in < NUM_SIGNALS; in++) {
+    probe.u_inputs.fill(0.0f);
+    probe.u_inputs[in] = 1.0f;
+    for (uint8_t out = 0; out < NUM_SIGNALS; out++)
+      matrix[out][in] = probe.i_output(out) - constant[out];
+  }
+
+  time_factors.fill(0.0f);
+  state.fill(0.0f);
+  outputs_.fill(0.0f);
+  has_multipliers = false;
+  for (size_t slot = 0; slot < slots.size(); slot++) {
+    if (auto integrators = slots[slot].integrators)
+      for (uint8_t idx = 0; idx < blocks::MIntBlock::NUM_INTEGRATORS; idx++) {
+        auto signal = signal_index(slot, idx);
+        time_factors[signal] = integrators->time_factor_switches[idx]
+                                   ? SLOW_TIME_FACTOR
+                                   : static_cast<float>(blocks::MIntBlock::DEFAULT_TIME_FACTOR);
+        state[signal] = integrators->ic_values[idx];
+      }
+    if (slots[slot].multipliers)
+      has_multipliers = true;
+  }
+
+  Signals derivatives;
+  evaluate(state, outputs_, derivatives);
+  update_overload_flags();
+  time_ = 0.0;
+}
+
+// NOT FLASHMEM
+void simulation::CircuitSimulation::evaluate(const Signals &state_, Signals &outputs, Signals &derivatives) {
+  for (size_t slot = 0; slot < slots.size(); slot++)
+    if (slots[slot].integrators)
+      for (uint8_t idx = 0; idx < blocks::MIntBlock::NUM_INTEGRATORS; idx++)
+        outputs[signal_index(slot, idx)] = state_[signal_index(slot, idx)];
+
+  Signals inputs;
+  for (unsigned int iteration = 0;; iteration++) {
+    for (uint8_t out = 0; out < NUM_SIGNALS; out++) {
+      float sum = constant[out];
+      for (uint8_t in = 0; in < NUM_SIGNALS; in++)
+        sum += matrix[out][in] * outputs[in];
+      inputs[out] = sum;
+    }
+    if (!has_multipliers)
+      break;
+
+    float change = 0.0f;
+    auto update = [&outputs, &change](uint8_t signal, float value) {
+      change = std::max(change, std::fabs(value - outputs[signal]));
+      outputs[signal] = value;
+    };
+    for (size_t slot = 0; slot < slots.size(); slot++) {
+      if (!slots[slot].multipliers)
+        continue;
+      for (uint8_t idx = 0; idx < blocks::MMulBlock::NUM_MULTIPLIERS; idx++) {
+        update(signal_index(slot, idx),
+               inputs[signal_index(slot, 2 * idx)] * inputs[signal_index(slot, 2 * idx + 1)]);
+        update(signal_index(slot, blocks::MMulBlock::NUM_MULTIPLIERS + idx), inputs[signal_index(slot, idx)]);
+      }
+    }
+    if (change < ALGEBRAIC_TOLERANCE or iteration + 1 == MAX_ALGEBRAIC_ITERATIONS)
+      break;
+  }
+
+  for (uint8_t signal = 0; signal < NUM_SIGNALS; signal++)
+    derivatives[signal] = time_factors[signal] * inputs[signal];
+}
+
+FLASHMEM void simulation::CircuitSimulation::update_overload_flags() {
+  for (size_t slot = 0; slot < slots.size(); slot++)
+    for (uint8_t idx = 0; idx < 8; idx++) {
+      if (std::fabs(outputs_[signal_index(slot, idx)]) <= OVERLOAD_LEVEL)
+        continue;
+      if (slots[slot].integrators)
+        slots[slot].integrators->overload_flags.set(idx);
+      if (slots[slot].multipliers)
+        slots[slot].multipliers->overload_flags.set(idx);
+    }
+}
+
+FLASHMEM double simulation::CircuitSimulation::max_step() const {
+  auto fastest = *std::max_element(time_factors.begin(), time_factors.end());
+  if (fastest <= 0.0f)
+    return std::numeric_limits<double>::infinity();
+  return 1.0 / (fastest * STEPS_PER_TIME_CONSTANT);
+}
+
+// NOT FLASHMEM
+void simulation::CircuitSimulation::advance(double dt) {
+  if (dt <= 0.0)
+    return;
+  auto steps = static_cast<unsigned long>(std::max(1.0, std::ceil(dt / max_step())));
+  auto h = static_cast<float>(dt / steps);
+
+  // Classical Runge-Kutta, the outputs of the last evaluation are the initial guess of the next one
+  Signals k1, k2, k3, k4, intermediate, outputs = outputs_;
+  auto add = [&intermediate, this](const Signals &derivatives, float factor) {
+    for (uint8_t signal = 0; signal < NUM_SIGNALS; signal++)
+      intermediate[signal] = state[signal] + factor * derivatives[signal];
+  };
+  for (unsigned long step = 0; step < steps; step++) {
+    evaluate(state, outputs, k1);
+    add(k1, h / 2);
+    evaluate(intermediate, outputs, k2);
+    add(k2, h / 2);
+    evaluate(intermediate, outputs, k3);
+    add(k3, h);
+    evaluate(intermediate, outputs, k4);
+    for (uint8_t signal = 0; signal < NUM_SIGNALS; signal++)
+      state[signal] += h / 6 * (k1[signal] + 2 * k2[signal] + 2 * k3[signal] + k4[signal]);
+  }
+
+  evaluate(state, outputs_, k1);
+  time_ += dt;
+  update_overload_flags();
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+#include "simulation/analog.h"
+
+namespace simulation {
+
+/**
+ * Numerical model of the dynamics of a cluster, computed from what was written to its simulated HALs.
+ *
+ * The computing elements are ideal. An integrator output starts at its IC and follows x' = k0 * i, with
+ * the time factor k0 and its input i. A multiplier outputs the product of its two inputs, the last four
+ * outputs of an MMulBlock repeat its first four inputs. The U-, C- and I-block are linear and evaluated
+ * as one matrix, which is probed from AnalogCluster::i_output once per reset(). Multipliers within a
+ * feedback loop make this an algebraic loop, which is solved by fixed-point iteration.
+ *
+ * The state is integrated with the classical Runge-Kutta method and a fixed step size, which is small
+ * compared to the time constant 1/k0 of the fastest integrator.
+ **/
+class CircuitSimulation {
+public:
+  //! Number of M-block inputs and outputs of a cluster, in the numbering of the I-block outputs and U-block inputs
+  static constexpr uint8_t NUM_SIGNALS = 16;
+  static constexpr float SLOW_TIME_FACTOR = 100.0f;
+  static constexpr unsigned int STEPS_PER_TIME_CONSTANT = 20;
+  static constexpr unsigned int MAX_ALGEBRAIC_ITERATIONS = 16;
+  static constexpr float ALGEBRAIC_TOLERANCE = 1e-7f;
+  //! Outputs beyond the machine unit raise the overload flag of their M-block
+  static constexpr float OVERLOAD_LEVEL = 1.0f;
+
+  using Signals = std::array<float, NUM_SIGNALS>;
+
+  //! An M-block slot holds integrators, multipliers or nothing
+  struct Slot {
+    SimulatedMIntBlockHAL *integrators = nullptr;
+    SimulatedMMulBlockHAL *multipliers = nullptr;
+  };
+
+protected:
+  const AnalogCluster &cluster;
+  std::array<Slot, 2> slots; // indexed by blocks::MBlock::SLOT
+
+  // Linear part, I-block outputs = matrix * U-block inputs + constant
+  std::array<Signals, NUM_SIGNALS> matrix{};
+  Signals constant{};
+
+  Signals time_factors{}; // zero for signals which are no integrator outputs
+  Signals state{};        // integrator outputs
+  Signals outputs_{};     // all M-block outputs at the current state
+  bool has_multipliers = false;
+  double time_ = 0.0;
+
+  //! Computes all M-block outputs from the integrator outputs, outputs_ is the initial guess.
+  void evaluate(const Signals &state_, Signals &outputs, Signals &derivatives);
+  void update_overload_flags();
+
+public:
+  CircuitSimulation(const AnalogCluster &cluster, Slot m0, Slot m1);
+
+  //! Reads the configuration from the HALs and puts all integrators at their IC, which is the start of OP.
+  void reset();
+  //! Advances the time by dt seconds, in as many steps as needed.
+  void advance(double dt);
+
+  //! M-block outputs at the current time, indexed like the U-block inputs
+  const Signals &outputs() const { return outputs_; }
+  double time() const { return time_; }
+  //! Largest step size the integration uses, in seconds
+  double max_step() const;
+};
+
+} // namespace simulation
@@ -0,0 +1,63 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "simulation/lucidac.h"
+
+#include "carrier/calibration_cache.h"
+#include "utils/logging.h"
+
+FLASHMEM bool simulation::SimulatedLUCIDAC_HAL::write_acl(std::array<ACL, 8> acl_) {
+  acl = acl_;
+  return true;
+}
+
+FLASHMEM void simulation::SimulatedLUCIDAC_HAL::reset_acl() { acl.fill(ACL::INTERNAL_); }
+
+FLASHMEM bool simulation::SimulatedLUCIDAC_HAL::write_adc_bus_mux(std::array<int8_t, 8> channels) {
+  adc_channels = channels;
+  return true;
+}
+
+FLASHMEM void simulation::SimulatedLUCIDAC_HAL::reset_adc_bus_mux() { adc_channels.fill(-1); }
+
+FLASHMEM bool simulation::SimulatedMetadataReader::read(
+    bus::addr_t block_address, std::array<uint8_t, sizeof(entities::EntityClassifier)> &classifier,
+    std::array<uint8_t, 8> &eui) {
+  // The classifier of a block is given by its class, only the EUI is taken from here
+  classifier.fill(0);
+  eui = {0x04, 0xE9, 0xE5, 0, 0, 0, 0, static_cast<uint8_t>(block_address)};
+  return true;
+}
+
+FLASHMEM simulation::SimulatedLUCIDAC::SimulatedLUCIDAC()
+    : LUCIDAC(new SimulatedLUCIDAC_HAL()), circuit(analog, {&m0_hal, nullptr}, {nullptr, &m1_hal}) {}
+
+FLASHMEM bool simulation::SimulatedLUCIDAC::init() {
+  LOG(ANABRID_DEBUG_INIT, __PRETTY_FUNCTION__);
+  // An address from the documentation range, formatted like the MAC address of a real one
+  entity_id = "00-00-5E-00-53-00";
+  metadata::cache.set_reader(&metadata_reader);
+
+  auto &cluster = clusters[0];
+  cluster.ublock = new blocks::UBlock(bus::idx_to_addr(0, bus::U_BLOCK_IDX, 0), &analog.uhal);
+  cluster.cblock = new blocks::CBlock(bus::idx_to_addr(0, bus::C_BLOCK_IDX, 0), &analog.chal);
+  cluster.iblock = new blocks::IBlock(bus::idx_to_addr(0, bus::I_BLOCK_IDX, 0), &analog.ihal);
+  cluster.m0block = new blocks::MIntBlock(blocks::MBlock::SLOT::M0, &m0_hal);
+  cluster.m1block = new blocks::MMulBlock(bus::idx_to_addr(0, bus::M1_BLOCK_IDX, 0), &m1_hal);
+  for (auto block : cluster.get_blocks())
+    if (block and !block->init())
+      return false;
+
+  reset(entities::ResetAction::EVERYTHING);
+  return static_cast<bool>(write_to_hardware());
+}
+
+FLASHMEM bool simulation::SimulatedLUCIDAC::calibrate_routes(daq::BaseDAQ *) {
+  auto &cache = platform::CalibrationCache::get();
+  cache.set_temperature(read_temperature());
+  for (auto &cluster : clusters)
+    if (!cluster.calibrate_routes(analog, &cache))
+      return false;
+  return true;
+}
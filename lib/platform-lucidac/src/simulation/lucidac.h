@@ -0,0 +1,64 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "lucidac/lucidac.h"
+#include "metadata/cache.h"
+#include "simulation/analog.h"
+#include "simulation/circuit.h"
+
+namespace simulation {
+
+class SimulatedLUCIDAC_HAL : public platform::LUCIDAC_HAL {
+public:
+  std::array<ACL, 8> acl{ACL::INTERNAL_, ACL::INTERNAL_, ACL::INTERNAL_, ACL::INTERNAL_,
+                         ACL::INTERNAL_, ACL::INTERNAL_, ACL::INTERNAL_, ACL::INTERNAL_};
+  std::array<int8_t, 8> adc_channels{-1, -1, -1, -1, -1, -1, -1, -1};
+
+  bool write_acl(std::array<ACL, 8> acl_) override;
+  void reset_acl() override;
+  bool write_adc_bus_mux(std::array<int8_t, 8> channels) override;
+  void reset_adc_bus_mux() override;
+  float read_temperature() override { return NAN; }
+};
+
+//! EUIs of the simulated blocks, derived from their bus address
+class SimulatedMetadataReader : public metadata::MetadataReader {
+public:
+  bool read(bus::addr_t block_address, std::array<uint8_t, sizeof(entities::EntityClassifier)> &classifier,
+            std::array<uint8_t, 8> &eui) override;
+};
+
+/**
+ * A LUCIDAC without hardware, made of simulated HALs and the behavioral model of CircuitSimulation.
+ *
+ * It has a MIntBlock in slot M0 and a MMulBlock in slot M1, but no SH-block and no CTRL-block.
+ * Route calibration measures the AnalogCluster instead, whose lanes are ideal unless lane_gains
+ * is changed. Everything else is the regular code of the carrier and its blocks.
+ **/
+class SimulatedLUCIDAC : public platform::LUCIDAC {
+protected:
+  SimulatedMetadataReader metadata_reader;
+
+public:
+  AnalogCluster analog;
+  SimulatedMIntBlockHAL m0_hal;
+  SimulatedMMulBlockHAL m1_hal;
+  CircuitSimulation circuit;
+
+  SimulatedLUCIDAC();
+
+  //! Builds the blocks instead of detecting them on the bus.
+  bool init() override;
+
+  bool calibrate_routes(daq::BaseDAQ *daq_) override;
+  //! There is no EEPROM to load from, the simulated multipliers need no calibration.
+  utils::status load_multiplier_calibration() override { return utils::status::success(); }
+};
+
+} // namespace simulation
@@ -0,0 +1,31 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "simulation/multiplier.h"
+
+FLASHMEM float simulation::AnalogMultipliers::Multiplier::output() const {
+  auto u = x + error_x + offset_x, v = y + error_y + offset_y;
+  return (u + cubic * u * u * u) * v + error_z + offset_z;
+}
+
+FLASHMEM bool simulation::AnalogMultipliers::write_input_offsets(uint8_t idx, float offset_x, float offset_y) {
+  if (idx >= multipliers.size())
+    return false;
+  multipliers[idx].offset_x = offset_x;
+  multipliers[idx].offset_y = offset_y;
+  return true;
+}
+
+FLASHMEM bool
+simulation::AnalogMultipliers::measure(std::array<float, blocks::MMulBlock::NUM_MULTIPLIERS> &outputs) {
+  measurements++;
+  elapsed_us += MEASUREMENT_US;
+  for (size_t idx = 0; idx < multipliers.size(); idx++) {
+    // Deterministic noise from a linear congruential generator, in [-noise, noise]
+    random_state = random_state * 1664525u + 1013904223u;
+    auto uniform = static_cast<float>(random_state >> 8) / static_cast<float>(1u << 24);
+    outputs[idx] = multipliers[idx].output() + noise * (2 * uniform - 1);
+  }
+  return true;
+}
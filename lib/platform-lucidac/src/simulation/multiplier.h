@@ -0,0 +1,45 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "block/multiplier_calibration.h"
+
+namespace simulation {
+
+/**
+ * A model of the multipliers of an MMulBlock with offset errors at their inputs and output,
+ * which the input offset calibration should compensate.
+ **/
+class AnalogMultipliers : public blocks::MultiplierCalibrationHAL {
+public:
+  static constexpr uint32_t MEASUREMENT_US = blocks::MMulBlockCalibrationHAL::SETTLING_TIME_MS * 1000 + 10;
+
+  struct Multiplier {
+    float x = 0.0f, y = 0.0f;                         ///< Input signals
+    float error_x = 0.0f, error_y = 0.0f, error_z = 0.0f; ///< Offset errors of the hardware
+    float offset_x = 0.0f, offset_y = 0.0f, offset_z = 0.0f; ///< Written calibration offsets
+    float cubic = 0.0f; ///< Non-linearity of the first input
+
+    float output() const;
+  };
+
+  std::array<Multiplier, blocks::MMulBlock::NUM_MULTIPLIERS> multipliers;
+  //! Amplitude of the uniformly distributed measurement noise
+  float noise = 0.0f;
+
+  unsigned int measurements = 0;
+  uint32_t elapsed_us = 0;
+
+  bool write_input_offsets(uint8_t idx, float offset_x, float offset_y) override;
+  bool measure(std::array<float, blocks::MMulBlock::NUM_MULTIPLIERS> &outputs) override;
+
+private:
+  uint32_t random_state = 1;
+};
+
+} // namespace simulation
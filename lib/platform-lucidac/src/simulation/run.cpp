@@ -0,0 +1,125 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include "simulation/run.h"
+
+#include <array>
+
+#include "daq/daq.h"
+#include "utils/logging.h"
+
+namespace {
+
+bool apply_circuit(simulation::SimulatedLUCIDAC &lucidac, run::Run &run) {
+  if (!run.circuit)
+    return true;
+  if (!run.circuit_staged) {
+    auto res = lucidac.stage_config(run.circuit->as<JsonObjectConst>());
+    if (!res) {
+      LOGMEV("Could not apply circuit of run: %s", res.msg.c_str());
+      return false;
+    }
+  }
+  auto res = lucidac.write_to_hardware();
+  if (!res) {
+    LOGMEV("Could not write circuit of run: %s", res.msg.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Computes IC and OP of run, returns false on errors
+bool simulate(simulation::SimulatedLUCIDAC &lucidac, run::Run &run, run::RunDataHandler *run_data_handler) {
+  auto &circuit = lucidac.circuit;
+  auto &daq_config = run.daq_config;
+  const double op_time = run.config.op_time * 1e-9;
+
+  // The integrators are held at their IC, so IC time makes no difference
+  circuit.reset();
+  if (!daq_config) {
+    circuit.advance(op_time);
+    return true;
+  }
+  if (!daq_config.is_valid()) {
+    LOG_ERROR("Invalid DAQ config.")
+    return false;
+  }
+
+  run_data_handler->prepare(run);
+  run_data_handler->init();
+
+  // Samples are collected into blocks like the ones of the DMA ring buffer
+  const size_t inner_count = daq_config.get_num_channels();
+  const size_t outer_count = daq::dma::BLOCK_SIZE / inner_count;
+  std::array<uint32_t, daq::dma::BLOCK_SIZE> block{};
+  size_t position = 0;
+  auto sample = [&]() {
+    auto &channels = lucidac.get_adc_channels();
+    auto &outputs = circuit.outputs();
+    for (size_t channel = 0; channel < inner_count; channel++) {
+      auto signal = channels[channel];
+      block[position * inner_count + channel] =
+          daq::BaseDAQ::float_to_raw(signal == carrier::Carrier::ADC_CHANNEL_DISABLED ? 0.0f : outputs[signal]);
+    }
+    if (++position == outer_count) {
+      run_data_handler->handle(block.data(), outer_count, inner_count, run);
+      position = 0;
+    }
+  };
+
+  if (daq_config.should_sample_op()) {
+    // Sample times are computed from their index, so the steps do not add up rounding errors
+    const double period = 1.0 / daq_config.get_sample_rate();
+    const auto num_samples = static_cast<uint64_t>(run.config.op_time * daq_config.get_sample_rate() / 1'000'000'000);
+    for (uint64_t idx = 0; idx < num_samples; idx++) {
+      sample();
+      circuit.advance((idx + 1) * period - circuit.time());
+    }
+  }
+  circuit.advance(op_time - circuit.time());
+  if (daq_config.should_sample_op_end())
+    sample();
+
+  if (position)
+    run_data_handler->handle(block.data(), position, inner_count, run);
+  run_data_handler->finish(run);
+  if (run_data_handler->overflowed) {
+    LOG_ERROR("Streaming error, some client could not keep up with the data rate.");
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+FLASHMEM void simulation::run_next(SimulatedLUCIDAC &lucidac, run::RunManager &manager,
+                                   run::RunStateChangeHandler *state_change_handler,
+                                   run::RunDataHandler *run_data_handler) {
+  auto &run = manager.queue.front();
+
+  bool error = !apply_circuit(lucidac, run);
+  // The simulated hardware keeps the circuit for repetitions of this run
+  run.circuit.reset();
+  if (!error and run.sweep) {
+    LOG_ERROR("Parameter sweeps are not supported by the simulation.");
+    error = true;
+  }
+  if (error) {
+    auto change = run.to(run::RunState::ERROR, 0);
+    state_change_handler->handle(change, run);
+    manager.queue.pop_front();
+    return;
+  }
+
+  if (run.config.calibrate and !lucidac.calibrate_routes(nullptr))
+    LOG_ERROR("Error during self-calibration. Machine will continue with reduced accuracy.");
+
+  error = !simulate(lucidac, run, run_data_handler);
+  auto change = run.to(error ? run::RunState::ERROR : run::RunState::DONE, run.config.op_time);
+  if (run.config.write_run_state_changes)
+    state_change_handler->handle(change, run);
+
+  if (!run.config.repetitive)
+    manager.queue.pop_front();
+}
@@ -0,0 +1,26 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include "run/run.h"
+#include "run/run_manager.h"
+#include "simulation/lucidac.h"
+
+namespace simulation {
+
+/**
+ * Counterpart of run::RunManager::run_next for a SimulatedLUCIDAC, which does the next run in the queue.
+ *
+ * The circuit coming with the run is applied and IC/OP are computed by its CircuitSimulation, sampling the
+ * signals selected by the ADC channels at the requested rate. The samples are passed to the run data handler
+ * as raw ADC values in blocks of daq::dma::BLOCK_SIZE, just as the DAQs do. The run is computed as fast as
+ * possible and not in real time, the reported OP time is the simulated one.
+ *
+ * Parameter sweeps are not supported and end in the ERROR state, halt_on_overload is ignored.
+ **/
+void run_next(SimulatedLUCIDAC &lucidac, run::RunManager &manager, run::RunStateChangeHandler *state_change_handler,
+              run::RunDataHandler *run_data_handler);
+
+} // namespace simulation
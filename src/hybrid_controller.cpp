@@ -104,7 +104,7 @@ FLASHMEM void setup() {
   //LOG("msg::handlers::DynamicRegistry set up with handlers")
   //msg::handlers::DynamicRegistry::dump();
 
-  msg::JsonLinesProtocol::get().init(4096); // Envelope size
+  msg::JsonLinesProtocol::get().init(); // Envelopes of all connections
 
   // This should be called sometime at startup
   daq::OneshotDAQ daq;
@@ -136,6 +136,13 @@ FLASHMEM void setup() {
     (void)carrier_.write_to_hardware();
   }
 
+  // Keep new M-block calibrations for the next startup, if the user wants so
+  auto &calibration_cache = platform::CalibrationCache::get();
+  if (calibration_cache.persistent and calibration_cache.has_unsaved_entries()) {
+    nvmconfig::PersistentSettingsWriter::get().write_to_eeprom();
+    calibration_cache.mark_saved();
+  }
+
   // Done.
   LOG(ANABRID_DEBUG_INIT, "Initialization done.");
 
@@ -4,14 +4,138 @@
 
 /**
  * @file Main entrance file for the Native environment
- * 
- * This file serves as entrance for the `pio run -e native` environment.
- * Currently is it supposed to be a placeholder to allow this command
- * to run successfully. It is implied by `pio run` without any specified
- * environment.
+ *
+ * This file serves as entrance for the `pio run -e native` environment, which builds
+ * a simulated LUCIDAC (see simulation::SimulatedLUCIDAC) behind the JSONL protocol.
+ * Clients connect via TCP/IP, by default on port 5732 as for the hardware, and can
+ * set up circuits and start runs, whose data is computed by a behavioral model of the
+ * analog elements. This allows testing clients without any hardware.
+ *
+ * Usage: `.pio/build/native/program [port]`
+ *
+ * Messages are handled by msg::JsonLinesProtocol and the handlers of msg::handlers::Registry,
+ * as on the hardware, which registers the message types not needing the hardware in native builds.
+ * There is no authentication, no network or system settings and no web server.
  **/
 
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
-#include <stdio.h>
-int main() { fprintf(stderr, "Main Firmware not yet supported in native simulator\n");  }
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <vector>
 
+#include <Arduino.h>
+
+#include "net/auth.h"
+#include "net/ethernet.h"
+#include "protocol/protocol.h"
+#include "protocol/registry.h"
+#include "run/run_manager.h"
+#include "simulation/lucidac.h"
+#include "simulation/run.h"
+
+namespace {
+
+constexpr uint16_t DEFAULT_PORT = 5732;
+
+/// A client connection, like msg::JsonlServer::Client on the hardware
+struct Client {
+  net::EthernetClient socket;
+  net::auth::AuthentificationContext user_context;
+  msg::JsonLinesProtocol::LineBuffer line_buffer;
+
+  explicit Client(int fd) : socket(fd) {}
+};
+
+/// Does the runs passed on by msg::JsonLinesProtocol::process_out_of_band_handlers on the simulated carrier
+void simulate_next_run(carrier::Carrier &carrier, run::RunStateChangeHandler *state_change_handler,
+                       run::RunDataHandler *run_data_handler) {
+  simulation::run_next(static_cast<simulation::SimulatedLUCIDAC &>(carrier), run::RunManager::get(),
+                       state_change_handler, run_data_handler);
+}
+
+int listen_on(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  int yes = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) or listen(fd, 4)) {
+    close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  return fd;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : DEFAULT_PORT;
+
+  // Constructed here, after everything it uses was initialized
+  static simulation::SimulatedLUCIDAC lucidac;
+  if (!lucidac.init()) {
+    fprintf(stderr, "Could not initialize the simulated LUCIDAC\n");
+    return 1;
+  }
+
+  msg::handlers::Registry::get().init(lucidac);
+  auto &protocol = msg::JsonLinesProtocol::get();
+  protocol.init();
+
+  int server = listen_on(port);
+  if (server < 0) {
+    fprintf(stderr, "Could not listen on port %u: %s\n", port, strerror(errno));
+    return 1;
+  }
+  fprintf(stderr, "Simulated LUCIDAC %s listening on port %u\n", lucidac.get_entity_id().c_str(), port);
+
+  // Clients are constructed in place and never moved, as the broadcast points to their sockets
+  std::list<Client> clients;
+  while (true) {
+    // Wait for input, but not while there are runs or buffered lines left to handle
+    bool busy = !run::RunManager::get().queue.empty();
+    std::vector<pollfd> fds{{server, POLLIN, 0}};
+    for (auto &client : clients) {
+      fds.push_back({client.socket.get_fd(), POLLIN, 0});
+      busy |= client.line_buffer.has_line();
+    }
+    poll(fds.data(), fds.size(), busy ? 0 : -1);
+
+    for (auto client = clients.begin(); client != clients.end();) {
+      if (client->socket.connected() and
+          (client->socket.available() > 0 or client->line_buffer.has_line()) and
+          protocol.process_tcp_input(client->socket, client->line_buffer, client->user_context))
+        client->socket.stop();
+      if (client->socket.connected()) {
+        ++client;
+      } else {
+        protocol.broadcast.remove(&client->socket);
+        client = clients.erase(client);
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(server, nullptr, nullptr);
+      if (fd >= 0) {
+        auto &client = clients.emplace_back(fd);
+        protocol.broadcast.add(&client.socket);
+      }
+    }
+
+    protocol.process_out_of_band_handlers(lucidac, simulate_next_run);
+  }
+}
@@ -85,14 +85,14 @@ void test_number_of_samples(RunConfig run_config, DAQConfig daq_config, size_t a
   // Check number of absolute and last samples seen
   delayMicroseconds(5);
   TEST_ASSERT_EQUAL(absolute_number_of_samples, dummy_run_data_handler.num_of_data_vectors_streamed);
-  TEST_ASSERT_EQUAL(absolute_number_of_samples % (dma::BUFFER_SIZE / daq_config.get_num_channels()),
+  TEST_ASSERT_EQUAL(absolute_number_of_samples % (dma::BLOCK_SIZE / daq_config.get_num_channels()),
                     ContinuousDAQ::get_number_of_data_vectors_in_buffer());
 }
 
 void setUp() {
   // This is called before *each* test.
   // The tests assume a certain buffer size
-  TEST_ASSERT_EQUAL(dma::BUFFER_SIZE, 32 * 8);
+  TEST_ASSERT_EQUAL(dma::BLOCK_SIZE, 16 * 8);
 }
 
 void tearDown() {
@@ -0,0 +1,175 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "block/cblock.h"
+#include "block/iblock.h"
+#include "bus/queue.h"
+#include "bus/recorder.h"
+#include "chips/AD5452.h"
+#include "chips/DAC60508.h"
+
+using namespace bus;
+using Type = Command::Type;
+
+// All tests run inside a batch, since anything else would access the hardware.
+RecordingExecutor recorder;
+CommandExecutor *hardware_executor;
+
+void setUp() {
+  recorder.clear();
+  hardware_executor = queue.get_executor();
+  queue.set_executor(&recorder);
+}
+
+void tearDown() { queue.set_executor(hardware_executor); }
+
+void assert_data(const std::vector<uint8_t> &expected, const RecordingExecutor::Record &record) {
+  TEST_ASSERT(Type::WRITE == record.type);
+  TEST_ASSERT_EQUAL(expected.size(), record.data.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), record.data.data(), expected.size());
+}
+
+void test_batch_executes_when_closed() {
+  functions::TriggerFunction trigger(address_from_tuple(8, 3));
+  functions::AD5452 dac(address_from_tuple(9, 1));
+  {
+    CommandBatch batch;
+    TEST_ASSERT(queue.is_active());
+    trigger.trigger();
+    dac.set_scale(static_cast<uint16_t>(0x1234));
+    TEST_ASSERT_EQUAL(2, queue.size());
+    TEST_ASSERT_EQUAL(0, recorder.records.size());
+  }
+  TEST_ASSERT_FALSE(queue.is_active());
+  TEST_ASSERT_FALSE(queue.is_pending());
+  TEST_ASSERT_EQUAL(1, recorder.executions);
+  TEST_ASSERT_EQUAL(2, recorder.records.size());
+
+  TEST_ASSERT(Type::TRIGGER == recorder.records[0].type);
+  TEST_ASSERT_EQUAL(trigger.address, recorder.records[0].address);
+
+  auto &write = recorder.records[1];
+  TEST_ASSERT_EQUAL(dac.address, write.address);
+  TEST_ASSERT_EQUAL_PTR(&functions::AD5452::DEFAULT_SPI_SETTINGS, write.settings);
+  // Setup time required by the AD5452
+  TEST_ASSERT_EQUAL(15, write.delay_ns);
+  assert_data({0x12, 0x34}, write);
+}
+
+void test_nested_batches_execute_once() {
+  {
+    CommandBatch outer;
+    queue.add_trigger(1);
+    {
+      CommandBatch inner;
+      queue.add_trigger(2);
+    }
+    TEST_ASSERT_EQUAL(0, recorder.executions);
+    queue.add_trigger(3);
+  }
+  TEST_ASSERT_EQUAL(1, recorder.executions);
+  TEST_ASSERT_EQUAL(3, recorder.records.size());
+  for (addr_t idx = 0; idx < 3; idx++)
+    TEST_ASSERT_EQUAL(idx + 1, recorder.records[idx].address);
+}
+
+void test_full_queue_is_flushed_in_order() {
+  constexpr size_t count = CommandQueue::MAX_COMMANDS + 10;
+  {
+    CommandBatch batch;
+    for (size_t idx = 0; idx < count; idx++)
+      queue.add_trigger(idx);
+    TEST_ASSERT_EQUAL(1, recorder.executions);
+    TEST_ASSERT_EQUAL(10, queue.size());
+  }
+  TEST_ASSERT_EQUAL(2, recorder.executions);
+  TEST_ASSERT_EQUAL(count, recorder.records.size());
+  for (size_t idx = 0; idx < count; idx++)
+    TEST_ASSERT_EQUAL(idx, recorder.records[idx].address);
+}
+
+void test_full_payload_is_flushed() {
+  uint8_t data[100] = {};
+  {
+    CommandBatch batch;
+    for (size_t idx = 0; idx < CommandQueue::MAX_PAYLOAD / sizeof(data) + 1; idx++) {
+      data[0] = idx;
+      TEST_ASSERT(queue.add_write(idx, ADDRESS_SPI_SETTINGS, data, sizeof(data)));
+    }
+    TEST_ASSERT_EQUAL(1, recorder.executions);
+    // Too large to ever be queued
+    uint8_t too_large[CommandQueue::MAX_PAYLOAD + 1] = {};
+    TEST_ASSERT_FALSE(queue.add_write(0, ADDRESS_SPI_SETTINGS, too_large, sizeof(too_large)));
+  }
+  TEST_ASSERT_EQUAL(CommandQueue::MAX_PAYLOAD / sizeof(data) + 1, recorder.records.size());
+  for (size_t idx = 0; idx < recorder.records.size(); idx++)
+    TEST_ASSERT_EQUAL(idx, recorder.records[idx].data[0]);
+}
+
+void test_cblock_write() {
+  blocks::CBlockHAL_V_1_1_X hal(idx_to_addr(0, C_BLOCK_IDX, 0));
+  {
+    CommandBatch batch;
+    for (uint8_t idx = 0; idx < 32; idx++)
+      TEST_ASSERT(hal.write_factor(idx, functions::AD5452::RAW_ZERO));
+  }
+  TEST_ASSERT_EQUAL(32, recorder.records.size());
+  for (uint8_t idx = 0; idx < 32; idx++) {
+    auto &record = recorder.records[idx];
+    TEST_ASSERT_EQUAL(idx_to_addr(0, C_BLOCK_IDX, idx + 1), record.address);
+    assert_data({functions::AD5452::RAW_ZERO >> 8, functions::AD5452::RAW_ZERO & 0xFF}, record);
+  }
+  // Address and data use different SPI modes, so each write but the first switches to the address and back
+  TEST_ASSERT_EQUAL(2 * 32 - 1, recorder.settings_changes);
+  TEST_ASSERT_LESS_OR_EQUAL(recorder.immediate_ns, recorder.batched_ns);
+}
+
+void test_same_settings_are_not_switched() {
+  // The DAC60508 uses the same settings as the address, in an object of its own
+  const uint16_t data = 0;
+  {
+    CommandBatch batch;
+    for (uint8_t idx = 0; idx < 32; idx++)
+      TEST_ASSERT(queue.add_write(idx, functions::DAC60508::DEFAULT_SPI_SETTINGS, &data, sizeof(data)));
+  }
+  TEST_ASSERT_EQUAL(32, recorder.records.size());
+  TEST_ASSERT_EQUAL(0, recorder.settings_changes);
+  // Only the first write waits for the clock polarity
+  TEST_ASSERT_EQUAL(recorder.immediate_ns - 31 * SETTLE_NS, recorder.batched_ns);
+}
+
+void test_iblock_write_keeps_reset_delay() {
+  blocks::IBlockHAL_V_1_2_X hal(idx_to_addr(0, I_BLOCK_IDX, 0));
+  std::array<uint32_t, 16> outputs{};
+  outputs[0] = blocks::IBlockHAL::INPUT_BITMASK(3);
+  {
+    CommandBatch batch;
+    TEST_ASSERT(hal.write_outputs(outputs));
+  }
+  TEST_ASSERT_EQUAL(4, recorder.records.size());
+  TEST_ASSERT(Type::TRIGGER == recorder.records[0].type);
+  TEST_ASSERT_EQUAL(idx_to_addr(0, I_BLOCK_IDX, 4), recorder.records[0].address);
+  TEST_ASSERT(Type::DELAY == recorder.records[1].type);
+  TEST_ASSERT_EQUAL(420, recorder.records[1].delay_ns);
+  TEST_ASSERT_EQUAL(idx_to_addr(0, I_BLOCK_IDX, 2), recorder.records[2].address);
+  assert_data({0, 0, 0, functions::ICommandRegisterFunction::chip_cmd_word(3, 0)}, recorder.records[2]);
+  TEST_ASSERT(Type::TRIGGER == recorder.records[3].type);
+  TEST_ASSERT_EQUAL(idx_to_addr(0, I_BLOCK_IDX, 3), recorder.records[3].address);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_batch_executes_when_closed);
+  RUN_TEST(test_nested_batches_execute_once);
+  RUN_TEST(test_full_queue_is_flushed_in_order);
+  RUN_TEST(test_full_payload_is_flushed);
+  RUN_TEST(test_cblock_write);
+  RUN_TEST(test_same_settings_are_not_switched);
+  RUN_TEST(test_iblock_write_keeps_reset_delay);
+  UNITY_END();
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "block/cblock.h"
+
+using namespace blocks;
+using functions::AD5452;
+
+/// Dummy HAL which keeps the last code written to each coefficient
+class RecordingCBlockHAL : public CBlockHAL {
+public:
+  std::array<uint16_t, CBlock::NUM_COEFF> codes{};
+
+  bool write_factor(uint8_t idx, uint16_t raw) override {
+    codes[idx] = raw;
+    return true;
+  }
+};
+
+RecordingCBlockHAL *hal;
+CBlock *cblock;
+
+void setUp() {
+  hal = new RecordingCBlockHAL();
+  cblock = new CBlock(bus::NULL_ADDRESS, hal);
+}
+
+void tearDown() {
+  delete cblock;
+  delete hal;
+}
+
+void test_factor_to_raw() {
+  TEST_ASSERT_EQUAL(AD5452::RAW_ZERO, CBlock::factor_to_raw(0.0f, 1.0f));
+  TEST_ASSERT_EQUAL(AD5452::RAW_ZERO + AD5452::RAW_DELTA_ONE, CBlock::factor_to_raw(1.0f, 1.0f));
+  TEST_ASSERT_EQUAL(AD5452::RAW_ZERO - AD5452::RAW_DELTA_ONE, CBlock::factor_to_raw(-1.0f, 1.0f));
+  // 11915.5 is rounded up
+  TEST_ASSERT_EQUAL(11916, CBlock::factor_to_raw(0.5f, 1.0f));
+  TEST_ASSERT_EQUAL(CBlock::factor_to_raw(0.5f, 1.0f), CBlock::factor_to_raw(0.625f, 0.8f));
+  TEST_ASSERT_EQUAL(AD5452::RAW_MAX, CBlock::factor_to_raw(1.01f, 1.1f));
+  TEST_ASSERT_EQUAL(AD5452::RAW_MIN, CBlock::factor_to_raw(-1.01f, 1.1f));
+}
+
+void test_batch_conversion_matches_single_conversion() {
+  std::array<float, CBlock::NUM_COEFF> factors, corrections;
+  std::array<uint16_t, CBlock::NUM_COEFF> raw;
+  for (uint8_t idx = 0; idx < CBlock::NUM_COEFF; idx++) {
+    factors[idx] = -1.01f + 2.02f * idx / (CBlock::NUM_COEFF - 1);
+    corrections[idx] = 0.9f + 0.2f * idx / (CBlock::NUM_COEFF - 1);
+  }
+  CBlock::factors_to_raw(factors, corrections, raw);
+  for (uint8_t idx = 0; idx < CBlock::NUM_COEFF; idx++)
+    TEST_ASSERT_EQUAL(CBlock::factor_to_raw(factors[idx], corrections[idx]), raw[idx]);
+}
+
+void test_codes_follow_factors_and_corrections() {
+  TEST_ASSERT_EACH_EQUAL_UINT16(CBlock::factor_to_raw(1.0f, 1.0f), cblock->get_raw_factors().data(),
+                                CBlock::NUM_COEFF);
+
+  TEST_ASSERT(cblock->set_factor(3, 0.25f));
+  TEST_ASSERT_EQUAL(CBlock::factor_to_raw(0.25f, 1.0f), cblock->get_raw_factors()[3]);
+  TEST_ASSERT(cblock->set_gain_correction(3, 1.05f));
+  TEST_ASSERT_EQUAL(CBlock::factor_to_raw(0.25f, 1.05f), cblock->get_raw_factors()[3]);
+
+  std::array<float, CBlock::NUM_COEFF> factors;
+  factors.fill(-0.5f);
+  cblock->set_factors(factors);
+  std::array<float, CBlock::NUM_COEFF> corrections;
+  corrections.fill(0.95f);
+  cblock->set_gain_corrections(corrections);
+  for (uint8_t idx = 0; idx < CBlock::NUM_COEFF; idx++)
+    TEST_ASSERT_EQUAL(CBlock::factor_to_raw(-0.5f, 0.95f), cblock->get_raw_factors()[idx]);
+
+  cblock->reset(entities::ResetAction::CALIBRATION_RESET);
+  TEST_ASSERT_EQUAL(CBlock::factor_to_raw(-0.5f, 1.0f), cblock->get_raw_factors()[0]);
+}
+
+void test_writes_transfer_codes() {
+  TEST_ASSERT(cblock->set_factor(0, 0.5f));
+  TEST_ASSERT(cblock->set_gain_correction(0, 0.96f));
+  TEST_ASSERT(cblock->set_factor(31, -0.125f));
+  TEST_ASSERT(cblock->write_to_hardware());
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(cblock->get_raw_factors().data(), hal->codes.data(), CBlock::NUM_COEFF);
+  TEST_ASSERT_EQUAL(CBlock::factor_to_raw(0.5f, 0.96f), hal->codes[0]);
+
+  TEST_ASSERT(cblock->set_factor(1, 0.75f));
+  TEST_ASSERT(cblock->write_factor_to_hardware(1));
+  TEST_ASSERT_EQUAL(CBlock::factor_to_raw(0.75f, 1.0f), hal->codes[1]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_factor_to_raw);
+  RUN_TEST(test_batch_conversion_matches_single_conversion);
+  RUN_TEST(test_codes_follow_factors_and_corrections);
+  RUN_TEST(test_writes_transfer_codes);
+  UNITY_END();
+}
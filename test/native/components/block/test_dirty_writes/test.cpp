@@ -0,0 +1,317 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "block/cblock.h"
+#include "block/ctrlblock.h"
+#include "block/iblock.h"
+#include "block/mblock.h"
+#include "block/ublock.h"
+#include "carrier/cluster.h"
+
+using namespace blocks;
+
+// Dummy HALs which count their transactions, one per call, to check that only what changed is written.
+// The C-Block HAL can be made to fail, to check that failed writes are retried.
+
+class CountingCBlockHAL : public CBlockHAL {
+public:
+  unsigned int transactions = 0;
+  bool fail = false;
+
+  bool write_factor(uint8_t idx, uint16_t raw) override {
+    transactions++;
+    return !fail;
+  }
+};
+
+class CountingMIntBlockHAL : public MIntBlockHAL {
+public:
+  unsigned int transactions = 0;
+
+  bool write_ic(uint8_t idx, uint16_t raw) override {
+    transactions++;
+    return true;
+  }
+  bool write_time_factor_switches(std::bitset<8> switches) override {
+    transactions++;
+    return true;
+  }
+  std::bitset<8> read_overload_flags() override { return {0}; }
+  void reset_overload_flags() override {}
+};
+
+class CountingUBlockHAL : public UBlockHAL {
+public:
+  unsigned int transactions = 0;
+
+  bool write_outputs(std::array<int8_t, 32> outputs) override {
+    transactions++;
+    return true;
+  }
+  bool write_transmission_modes_and_ref(std::pair<Transmission_Mode, Transmission_Mode> modes,
+                                        Reference_Magnitude ref) override {
+    transactions++;
+    return true;
+  }
+  void reset_transmission_modes_and_ref() override {}
+};
+
+class CountingIBlockHAL : public IBlockHAL {
+public:
+  unsigned int transactions = 0;
+
+  bool write_outputs(const std::array<uint32_t, 16> &outputs) override {
+    transactions++;
+    return true;
+  }
+  bool write_upscaling(std::bitset<32> upscaling) override {
+    transactions++;
+    return true;
+  }
+};
+
+class CountingCTRLBlockHAL : public CTRLBlockHALBase {
+public:
+  unsigned int transactions = 0;
+
+  bool write_adc_bus_muxers(ADCBus channel) override {
+    transactions++;
+    return true;
+  }
+  bool write_sync_id(uint8_t id) override { return true; }
+};
+
+CountingCBlockHAL *chal;
+CountingMIntBlockHAL *mhal;
+CountingUBlockHAL *uhal;
+CountingIBlockHAL *ihal;
+CBlock *cblock;
+MIntBlock *mintblock;
+UBlock *ublock;
+IBlock *iblock;
+platform::Cluster *cluster;
+
+// Number of transactions to write a complete cluster configuration:
+// 32 coefficients, 8 ICs and the time factor switches, U matrix and transmission modes, I matrix and upscaling.
+constexpr unsigned int FULL_WRITE = 32 + 8 + 1 + 2 + 2;
+
+unsigned int transactions() {
+  return chal->transactions + mhal->transactions + uhal->transactions + ihal->transactions;
+}
+
+void clear_transactions() {
+  chal->transactions = mhal->transactions = uhal->transactions = ihal->transactions = 0;
+}
+
+void write() { TEST_ASSERT(cluster->write_to_hardware()); }
+
+void setUp() {
+  chal = new CountingCBlockHAL();
+  mhal = new CountingMIntBlockHAL();
+  uhal = new CountingUBlockHAL();
+  ihal = new CountingIBlockHAL();
+  cblock = new CBlock(bus::NULL_ADDRESS, chal);
+  mintblock = new MIntBlock(MBlock::SLOT::M0, mhal);
+  ublock = new UBlock(bus::NULL_ADDRESS, uhal);
+  iblock = new IBlock(bus::NULL_ADDRESS, ihal);
+  cluster = new platform::Cluster(0);
+  cluster->cblock = cblock;
+  cluster->m0block = mintblock;
+  cluster->ublock = ublock;
+  cluster->iblock = iblock;
+}
+
+void tearDown() {
+  delete cluster;
+  delete iblock;
+  delete ublock;
+  delete mintblock;
+  delete cblock;
+  delete ihal;
+  delete uhal;
+  delete mhal;
+  delete chal;
+}
+
+void test_first_write_is_complete() {
+  write();
+  TEST_ASSERT_EQUAL(FULL_WRITE, transactions());
+}
+
+void test_unchanged_write_is_empty() {
+  write();
+  clear_transactions();
+  write();
+  TEST_ASSERT_EQUAL(0, transactions());
+}
+
+void test_cblock_writes_changed_coefficients() {
+  write();
+  clear_transactions();
+
+  TEST_ASSERT(cblock->set_factor(3, 0.5f));
+  TEST_ASSERT(cblock->set_factor(17, -0.25f));
+  write();
+  TEST_ASSERT_EQUAL(2, chal->transactions);
+
+  // Setting the same value again does not change anything
+  TEST_ASSERT(cblock->set_factor(3, 0.5f));
+  write();
+  TEST_ASSERT_EQUAL(2, chal->transactions);
+
+  // A gain correction changes the written value as well
+  TEST_ASSERT(cblock->set_gain_correction(5, 1.05f));
+  write();
+  TEST_ASSERT_EQUAL(3, chal->transactions);
+
+  // Resetting only touches the changed coefficients
+  cblock->reset(entities::ResetAction::CIRCUIT_RESET | entities::ResetAction::CALIBRATION_RESET);
+  write();
+  TEST_ASSERT_EQUAL(6, chal->transactions);
+  TEST_ASSERT_EQUAL(6, transactions());
+}
+
+void test_mintblock_writes_changed_elements() {
+  write();
+  clear_transactions();
+
+  TEST_ASSERT(mintblock->set_ic_value(2, 0.3f));
+  write();
+  TEST_ASSERT_EQUAL(1, mhal->transactions);
+
+  // Changing any time factor rewrites the switches register once
+  TEST_ASSERT(mintblock->set_time_factor(5, 100));
+  TEST_ASSERT(mintblock->set_time_factor(6, 100));
+  write();
+  TEST_ASSERT_EQUAL(2, mhal->transactions);
+  TEST_ASSERT_EQUAL(2, transactions());
+}
+
+void test_ublock_writes_changed_registers() {
+  write();
+  clear_transactions();
+
+  TEST_ASSERT(ublock->connect(3, 7));
+  TEST_ASSERT(ublock->connect(4, 8));
+  write();
+  TEST_ASSERT_EQUAL(1, uhal->transactions);
+
+  // Changes both the matrix and the transmission modes
+  TEST_ASSERT(ublock->connect_alternative(UBlock::Transmission_Mode::GROUND, 10));
+  write();
+  TEST_ASSERT_EQUAL(3, uhal->transactions);
+
+  // Disconnecting something which is not connected changes nothing
+  TEST_ASSERT_FALSE(ublock->disconnect(3, 9));
+  write();
+  TEST_ASSERT_EQUAL(3, uhal->transactions);
+  TEST_ASSERT_EQUAL(3, transactions());
+}
+
+void test_iblock_writes_changed_registers() {
+  write();
+  clear_transactions();
+
+  TEST_ASSERT(iblock->connect(3, 7));
+  write();
+  TEST_ASSERT_EQUAL(1, ihal->transactions);
+
+  TEST_ASSERT(iblock->set_upscaling(3, true));
+  write();
+  TEST_ASSERT_EQUAL(2, ihal->transactions);
+
+  // Already connected
+  TEST_ASSERT(iblock->connect(3, 7));
+  write();
+  TEST_ASSERT_EQUAL(2, ihal->transactions);
+  TEST_ASSERT_EQUAL(2, transactions());
+}
+
+void test_ctrlblock_writes_changed_adc_bus() {
+  CountingCTRLBlockHAL ctrlhal;
+  CTRLBlock ctrlblock(&ctrlhal);
+  TEST_ASSERT(ctrlblock.init());
+  TEST_ASSERT_EQUAL(1, ctrlhal.transactions);
+
+  ctrlblock.reset_adc_bus();
+  TEST_ASSERT(ctrlblock.write_to_hardware());
+  TEST_ASSERT_EQUAL(1, ctrlhal.transactions);
+
+  TEST_ASSERT(ctrlblock.set_adc_bus_to_cluster_gain(1));
+  TEST_ASSERT(ctrlblock.write_to_hardware());
+  TEST_ASSERT(ctrlblock.write_to_hardware());
+  TEST_ASSERT_EQUAL(2, ctrlhal.transactions);
+}
+
+void test_force_write_is_complete() {
+  write();
+  clear_transactions();
+  TEST_ASSERT(cluster->force_write_to_hardware());
+  TEST_ASSERT_EQUAL(FULL_WRITE, transactions());
+
+  // Afterwards, everything is in sync again
+  clear_transactions();
+  write();
+  TEST_ASSERT_EQUAL(0, transactions());
+}
+
+void test_failed_write_is_retried() {
+  write();
+  clear_transactions();
+
+  TEST_ASSERT(cblock->set_factor(3, 0.5f));
+  chal->fail = true;
+  TEST_ASSERT_FALSE(cluster->write_to_hardware());
+  chal->fail = false;
+  write();
+  TEST_ASSERT_EQUAL(2, chal->transactions);
+}
+
+void test_config_from_json() {
+  StaticJsonDocument<2048> doc;
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(doc, R"({
+    "/U": {"outputs": {"3": 1}},
+    "/I": {"outputs": {"5": [3]}},
+    "/M0": {"elements": {"1": {"ic": 0.25}}}
+  })"));
+  // All coefficients are given, but only one differs from the default
+  auto elements = doc.createNestedObject("/C").createNestedArray("elements");
+  for (unsigned int idx = 0; idx < CBlock::NUM_COEFF; idx++)
+    elements.add(idx == 3 ? 0.5f : 1.0f);
+  auto cfg = doc.as<JsonObjectConst>();
+
+  write();
+  clear_transactions();
+  TEST_ASSERT(cluster->config_from_json(cfg));
+  write();
+  TEST_ASSERT_EQUAL(1, chal->transactions);
+  TEST_ASSERT_EQUAL(1, uhal->transactions);
+  TEST_ASSERT_EQUAL(1, ihal->transactions);
+  TEST_ASSERT_EQUAL(1, mhal->transactions);
+
+  // Applying the same configuration again writes nothing, although outputs are cleared and set again
+  clear_transactions();
+  TEST_ASSERT(cluster->config_from_json(cfg));
+  write();
+  TEST_ASSERT_EQUAL(0, transactions());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_write_is_complete);
+  RUN_TEST(test_unchanged_write_is_empty);
+  RUN_TEST(test_cblock_writes_changed_coefficients);
+  RUN_TEST(test_mintblock_writes_changed_elements);
+  RUN_TEST(test_ublock_writes_changed_registers);
+  RUN_TEST(test_iblock_writes_changed_registers);
+  RUN_TEST(test_ctrlblock_writes_changed_adc_bus);
+  RUN_TEST(test_force_write_is_complete);
+  RUN_TEST(test_failed_write_is_retried);
+  RUN_TEST(test_config_from_json);
+  UNITY_END();
+}
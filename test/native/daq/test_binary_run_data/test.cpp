@@ -0,0 +1,89 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <array>
+#include <vector>
+
+#include "daq/base.h"
+#include "daq/binary_frame.h"
+
+using namespace daq;
+
+constexpr size_t outer_count = 16;
+constexpr size_t inner_count = 8;
+constexpr const char *run_id = "12345678-1234-1234-1234-123456789abc";
+
+// Synthetic DMA buffer, filled like the FlexIO DMA does (one 32bit word per sample)
+std::array<volatile uint32_t, outer_count * inner_count> dma_buffer;
+
+void setUp() {
+  for (size_t i = 0; i < dma_buffer.size(); i++)
+    dma_buffer[i] = (i * 131) % 16384;
+}
+
+void tearDown() {}
+
+std::vector<uint8_t> encode(size_t outer, size_t inner, uint32_t sequence) {
+  std::vector<uint8_t> frame(binary::frame_size(outer, inner));
+  binary::write_header(frame.data(), run_id, inner);
+  binary::update_header(frame.data(), outer, sequence);
+  binary::encode_samples(frame.data() + binary::HEADER_SIZE, dma_buffer.data(), outer * inner);
+  return frame;
+}
+
+void test_header_roundtrip() {
+  auto frame = encode(outer_count, inner_count, 42);
+  TEST_ASSERT_EQUAL(binary::HEADER_SIZE + outer_count * inner_count * 2, frame.size());
+
+  binary::FrameHeader header{};
+  TEST_ASSERT_TRUE(binary::decode_header(frame.data(), frame.size(), header));
+  TEST_ASSERT_EQUAL(inner_count, header.num_channels);
+  TEST_ASSERT_EQUAL(outer_count, header.num_samples);
+  TEST_ASSERT_EQUAL(42, header.sequence);
+  TEST_ASSERT_EQUAL_CHAR_ARRAY(run_id, header.run_id, binary::HEADER_LENGTH_RUN_ID);
+}
+
+void test_little_endian_layout() {
+  dma_buffer[0] = 0x3FFF;
+  auto frame = encode(1, 1, 0x01020304);
+  TEST_ASSERT_EQUAL_HEX8(0x04, frame[binary::HEADER_IDX_SEQUENCE]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, frame[binary::HEADER_IDX_SEQUENCE + 3]);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, frame[binary::HEADER_SIZE]);
+  TEST_ASSERT_EQUAL_HEX8(0x3F, frame[binary::HEADER_SIZE + 1]);
+}
+
+void test_rejects_garbage() {
+  auto frame = encode(outer_count, inner_count, 0);
+  binary::FrameHeader header{};
+  // truncated frame
+  TEST_ASSERT_FALSE(binary::decode_header(frame.data(), frame.size() - 1, header));
+  // JSON line instead of a frame
+  const char json[] = R"({"type":"run_data","msg":{"id":"12345678-1234-1234-1234-123456789abc"}})";
+  TEST_ASSERT_FALSE(binary::decode_header(reinterpret_cast<const uint8_t *>(json), sizeof(json), header));
+}
+
+void test_samples_decode_to_raw_to_float() {
+  auto frame = encode(outer_count, inner_count, 0);
+  for (size_t outer = 0; outer < outer_count; outer++) {
+    for (size_t inner = 0; inner < inner_count; inner++) {
+      auto idx = outer * inner_count + inner;
+      auto raw = binary::decode_sample(frame.data(), idx);
+      TEST_ASSERT_EQUAL(dma_buffer[idx], raw);
+      TEST_ASSERT_EQUAL_FLOAT(BaseDAQ::raw_to_float(dma_buffer[idx]), BaseDAQ::raw_to_float(raw));
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_header_roundtrip);
+  RUN_TEST(test_little_endian_layout);
+  RUN_TEST(test_rejects_garbage);
+  RUN_TEST(test_samples_decode_to_raw_to_float);
+  UNITY_END();
+}
@@ -0,0 +1,203 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "daq/block_ring.h"
+
+using namespace daq;
+
+constexpr size_t num_blocks = 4;
+constexpr size_t block_size = 16;
+using ring_t = BlockRing<volatile uint32_t, num_blocks, block_size>;
+
+std::array<volatile uint32_t, num_blocks * block_size> storage;
+ring_t ring{storage.data()};
+
+void setUp() {
+  for (auto &word : storage)
+    word = 0;
+  ring.reset();
+}
+
+void tearDown() {}
+
+/// What the DMA does: fill the current block, then the interrupt publishes it.
+void produce_block(uint32_t sequence) {
+  auto block = ring.producer_block();
+  for (size_t i = 0; i < block_size; i++)
+    block[i] = sequence;
+  ring.publish();
+}
+
+void test_empty() {
+  uint32_t sequence;
+  TEST_ASSERT_EQUAL(0, ring.available());
+  TEST_ASSERT_NULL(ring.front(sequence));
+}
+
+void test_in_order() {
+  for (uint32_t seq = 0; seq < 3; seq++)
+    produce_block(seq);
+  TEST_ASSERT_EQUAL(3, ring.available());
+
+  uint32_t sequence;
+  for (uint32_t seq = 0; seq < 3; seq++) {
+    auto block = ring.front(sequence);
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_EQUAL(seq, sequence);
+    TEST_ASSERT_EQUAL(seq, block[0]);
+    TEST_ASSERT_EQUAL(seq, block[block_size - 1]);
+    TEST_ASSERT_TRUE(ring.pop());
+  }
+  TEST_ASSERT_NULL(ring.front(sequence));
+  TEST_ASSERT_EQUAL(0, ring.get_lost());
+}
+
+void test_wraps_around() {
+  uint32_t sequence;
+  for (uint32_t seq = 0; seq < 10 * num_blocks; seq++) {
+    produce_block(seq);
+    auto block = ring.front(sequence);
+    TEST_ASSERT_EQUAL(seq, sequence);
+    TEST_ASSERT_EQUAL(seq, block[0]);
+    TEST_ASSERT_TRUE(ring.pop());
+  }
+  TEST_ASSERT_EQUAL(0, ring.get_lost());
+}
+
+void test_late_by_up_to_num_blocks_minus_one() {
+  // The producer always writes into the next block, so the consumer may be
+  // late by one block less than the ring has.
+  for (uint32_t seq = 0; seq < num_blocks - 1; seq++)
+    produce_block(seq);
+  uint32_t sequence;
+  for (uint32_t seq = 0; seq < num_blocks - 1; seq++) {
+    TEST_ASSERT_NOT_NULL(ring.front(sequence));
+    TEST_ASSERT_FALSE(ring.is_overwritten(sequence));
+    TEST_ASSERT_TRUE(ring.pop());
+  }
+}
+
+void test_overflow_is_detected_per_block() {
+  for (uint32_t seq = 0; seq < num_blocks + 2; seq++)
+    produce_block(seq);
+
+  uint32_t sequence;
+  // Blocks 0, 1 and 2 share their slots with blocks 4, 5 and the one the producer writes now.
+  for (uint32_t seq = 0; seq < 3; seq++) {
+    TEST_ASSERT_NOT_NULL(ring.front(sequence));
+    TEST_ASSERT_TRUE(ring.is_overwritten(sequence));
+  }
+  TEST_ASSERT_EQUAL(3, ring.skip_overwritten());
+  TEST_ASSERT_EQUAL(3, ring.get_lost());
+
+  // The remaining ones are still fine
+  for (uint32_t seq = 3; seq < num_blocks + 2; seq++) {
+    auto block = ring.front(sequence);
+    TEST_ASSERT_EQUAL(seq, sequence);
+    TEST_ASSERT_EQUAL(seq, block[0]);
+    TEST_ASSERT_TRUE(ring.pop());
+  }
+  TEST_ASSERT_EQUAL(3, ring.get_lost());
+}
+
+void test_overwritten_while_reading() {
+  produce_block(0);
+  uint32_t sequence;
+  ring.front(sequence);
+  // Consumer is slow while processing block 0
+  for (uint32_t seq = 1; seq <= num_blocks; seq++)
+    produce_block(seq);
+  TEST_ASSERT_FALSE(ring.pop());
+  TEST_ASSERT_EQUAL(1, ring.get_lost());
+}
+
+void test_high_water_mark() {
+  ring_t fresh_ring{storage.data()};
+  uint32_t sequence;
+  fresh_ring.publish();
+  fresh_ring.publish();
+  fresh_ring.front(sequence);
+  fresh_ring.pop();
+  fresh_ring.front(sequence);
+  fresh_ring.pop();
+  TEST_ASSERT_EQUAL(2, fresh_ring.get_high_water());
+  // Survives a reset, so it spans multiple runs
+  fresh_ring.reset();
+  fresh_ring.publish();
+  fresh_ring.front(sequence);
+  TEST_ASSERT_EQUAL(2, fresh_ring.get_high_water());
+}
+
+void run_threaded(std::chrono::microseconds consumer_delay) {
+  constexpr uint32_t total_blocks = 20000;
+  std::atomic<bool> done{false};
+
+  std::thread producer([&]() {
+    for (uint32_t seq = 0; seq < total_blocks; seq++) {
+      produce_block(seq);
+      if (seq % 64 == 0)
+        std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  uint32_t intact = 0, lost = 0, expected_sequence = 0;
+  while (!done or ring.available()) {
+    lost += ring.skip_overwritten();
+    uint32_t sequence;
+    auto block = ring.front(sequence);
+    if (!block)
+      continue;
+    TEST_ASSERT_GREATER_OR_EQUAL(expected_sequence, sequence);
+    expected_sequence = sequence + 1;
+
+    std::array<uint32_t, block_size> copy;
+    for (size_t i = 0; i < block_size; i++)
+      copy[i] = block[i];
+    if (consumer_delay.count())
+      std::this_thread::sleep_for(consumer_delay);
+
+    if (ring.pop()) {
+      // Whatever was read from an intact block must be exactly what the producer wrote
+      for (auto value : copy)
+        TEST_ASSERT_EQUAL(sequence, value);
+      intact++;
+    } else {
+      lost++;
+    }
+  }
+  producer.join();
+
+  TEST_ASSERT_EQUAL(total_blocks, ring.get_published());
+  TEST_ASSERT_EQUAL(total_blocks, ring.get_consumed());
+  TEST_ASSERT_EQUAL(lost, ring.get_lost());
+  TEST_ASSERT_EQUAL(total_blocks, intact + lost);
+}
+
+void test_threaded_producer() { run_threaded(std::chrono::microseconds(0)); }
+
+void test_threaded_slow_consumer() { run_threaded(std::chrono::microseconds(50)); }
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty);
+  RUN_TEST(test_in_order);
+  RUN_TEST(test_wraps_around);
+  RUN_TEST(test_late_by_up_to_num_blocks_minus_one);
+  RUN_TEST(test_overflow_is_detected_per_block);
+  RUN_TEST(test_overwritten_while_reading);
+  RUN_TEST(test_high_water_mark);
+  RUN_TEST(test_threaded_producer);
+  RUN_TEST(test_threaded_slow_consumer);
+  UNITY_END();
+}
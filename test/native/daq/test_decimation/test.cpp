@@ -0,0 +1,154 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "daq/decimation.h"
+
+using namespace daq;
+
+constexpr size_t inner_count = 4;
+constexpr size_t outer_count = 1000;
+
+// Synthetic raw DMA words, with some garbage in the upper bits which must be ignored
+std::array<volatile uint32_t, outer_count * inner_count> input;
+
+uint16_t raw(size_t outer, size_t channel) { return input[outer * inner_count + channel] & 0xFFFF; }
+
+void setUp() {
+  for (size_t i = 0; i < outer_count; i++)
+    for (size_t c = 0; c < inner_count; c++)
+      input[i * inner_count + c] = 0xABCD0000u | ((i * (c + 3) * 37 + c * 1000) % 16384);
+}
+
+void tearDown() {}
+
+/// Feeds the input in chunks of chunk_size vectors, like the DMA blocks do, and flushes at the end.
+std::vector<uint32_t> decimate(DecimationMode mode, uint16_t factor, size_t chunk_size) {
+  Decimator decimator(mode, factor, inner_count);
+  std::vector<uint32_t> output((outer_count * 2 + 2) * inner_count);
+  size_t produced = 0;
+  for (size_t chunk = 0; chunk < outer_count; chunk += chunk_size) {
+    size_t chunk_end = std::min(chunk + chunk_size, outer_count);
+    size_t offset = chunk;
+    while (offset < chunk_end) {
+      size_t n = std::min(chunk_end - offset, decimator.remaining_in_window());
+      produced += decimator.process(input.data() + offset * inner_count, n, output.data() + produced * inner_count);
+      offset += n;
+    }
+  }
+  produced += decimator.flush(output.data() + produced * inner_count);
+  output.resize(produced * inner_count);
+  return output;
+}
+
+std::vector<uint32_t> reference_boxcar(uint16_t factor) {
+  std::vector<uint32_t> output;
+  for (size_t start = 0; start < outer_count; start += factor) {
+    size_t end = std::min<size_t>(start + factor, outer_count);
+    for (size_t c = 0; c < inner_count; c++) {
+      uint64_t sum = 0;
+      for (size_t i = start; i < end; i++)
+        sum += raw(i, c);
+      output.push_back((sum + (end - start) / 2) / (end - start));
+    }
+  }
+  return output;
+}
+
+std::vector<uint32_t> reference_cic(uint16_t factor) {
+  // A second order CIC filter is a convolution with a triangular kernel of length 2N-1,
+  // evaluated at the end of each window. Incomplete windows yield no output.
+  std::vector<uint64_t> kernel(2 * factor - 1);
+  for (size_t j = 0; j < kernel.size(); j++)
+    kernel[j] = std::min(j + 1, kernel.size() - j);
+  const uint64_t gain = static_cast<uint64_t>(factor) * factor;
+
+  std::vector<uint32_t> output;
+  for (size_t end = factor - 1; end < outer_count; end += factor) {
+    for (size_t c = 0; c < inner_count; c++) {
+      uint64_t sum = 0;
+      for (size_t j = 0; j < kernel.size() and j <= end; j++)
+        sum += kernel[j] * raw(end - j, c);
+      output.push_back((sum + gain / 2) / gain);
+    }
+  }
+  return output;
+}
+
+std::vector<uint32_t> reference_minmax(uint16_t factor) {
+  std::vector<uint32_t> output;
+  for (size_t start = 0; start < outer_count; start += factor) {
+    size_t end = std::min<size_t>(start + factor, outer_count);
+    std::vector<uint32_t> mins, maxs;
+    for (size_t c = 0; c < inner_count; c++) {
+      uint16_t lo = UINT16_MAX, hi = 0;
+      for (size_t i = start; i < end; i++) {
+        lo = std::min(lo, raw(i, c));
+        hi = std::max(hi, raw(i, c));
+      }
+      mins.push_back(lo);
+      maxs.push_back(hi);
+    }
+    output.insert(output.end(), mins.begin(), mins.end());
+    output.insert(output.end(), maxs.begin(), maxs.end());
+  }
+  return output;
+}
+
+void assert_equal(const std::vector<uint32_t> &expected, const std::vector<uint32_t> &actual) {
+  TEST_ASSERT_EQUAL(expected.size(), actual.size());
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(expected.data(), actual.data(), expected.size());
+}
+
+void test_none_is_passthrough() {
+  auto output = decimate(DecimationMode::NONE, 10, 16);
+  TEST_ASSERT_EQUAL(outer_count * inner_count, output.size());
+  for (size_t i = 0; i < outer_count; i++)
+    for (size_t c = 0; c < inner_count; c++)
+      TEST_ASSERT_EQUAL(raw(i, c), output[i * inner_count + c]);
+}
+
+void test_boxcar() {
+  for (uint16_t factor : {1, 2, 7, 16, 100, 999, 2000})
+    for (size_t chunk_size : {1, 16, 128})
+      assert_equal(reference_boxcar(factor), decimate(DecimationMode::BOXCAR, factor, chunk_size));
+}
+
+void test_cic() {
+  for (uint16_t factor : {1, 2, 7, 16, 100, 256})
+    for (size_t chunk_size : {1, 16, 128})
+      assert_equal(reference_cic(factor), decimate(DecimationMode::CIC, factor, chunk_size));
+}
+
+void test_cic_constant_input_has_unit_gain() {
+  for (auto &word : input)
+    word = 16383;
+  auto output = decimate(DecimationMode::CIC, 256, 128);
+  // The first window is the transient response of the filter
+  for (size_t i = inner_count; i < output.size(); i++)
+    TEST_ASSERT_EQUAL(16383, output[i]);
+}
+
+void test_minmax() {
+  for (uint16_t factor : {1, 2, 7, 16, 100, 999, 2000})
+    for (size_t chunk_size : {1, 16, 128})
+      assert_equal(reference_minmax(factor), decimate(DecimationMode::MINMAX, factor, chunk_size));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_none_is_passthrough);
+  RUN_TEST(test_boxcar);
+  RUN_TEST(test_cic);
+  RUN_TEST(test_cic_constant_input_has_unit_gain);
+  RUN_TEST(test_minmax);
+  UNITY_END();
+}
@@ -0,0 +1,202 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "daq/base.h"
+#include "daq/binary_frame.h"
+#include "protocol/protocol_oob.h"
+#include "run/run.h"
+#include "run/sweep.h"
+#include "test_common.h"
+#include "utils/print-multiplexer.h"
+
+/*
+ * Run data goes from the DMA ring buffer through client::RunDataNotificationHandler (text run_data
+ * messages) or client::BinaryRunDataNotificationHandler (binary frames) and utils::PrintMultiplexer
+ * to the clients. Here, the clients are a Loopback connection and a fake Print which only counts.
+ */
+
+constexpr size_t inner_count = 8;
+constexpr size_t outer_count = daq::dma::BLOCK_SIZE / inner_count; // one block of the DMA ring buffer
+constexpr size_t num_samples = outer_count * inner_count;
+constexpr size_t num_chunks = 1000;
+constexpr const char *run_id = "12345678-1234-1234-1234-123456789abc";
+
+class FakeSocket : public Print {
+public:
+  size_t bytes = 0;
+  size_t calls = 0;
+
+  size_t write(uint8_t b) override {
+    bytes++;
+    calls++;
+    return 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override {
+    bytes += size;
+    calls++;
+    return size;
+  }
+
+  void reset() { bytes = calls = 0; }
+};
+
+/// A client whose send buffer only ever has room for part of a chunk
+class ShortSocket : public Print {
+public:
+  size_t write(uint8_t b) override { return 1; }
+  size_t write(const uint8_t *buffer, size_t size) override { return size / 2; }
+};
+
+std::array<volatile uint32_t, num_samples> dma_block;
+FakeSocket socket_;
+utils::PrintMultiplexer *target;
+run::Run run(run_id, run::RunConfig(), daq::DAQConfig(inner_count, 100'000));
+client::RunDataNotificationHandler *text_handler;
+client::BinaryRunDataNotificationHandler *binary_handler;
+
+void setUp() {
+  for (size_t i = 0; i < dma_block.size(); i++)
+    dma_block[i] = daq::BaseDAQ::float_to_raw(-1.0f + 2.0f * i / dma_block.size());
+  socket_.reset();
+  target = new utils::PrintMultiplexer();
+  text_handler = new client::RunDataNotificationHandler(test_carrier(), *target);
+  binary_handler = new client::BinaryRunDataNotificationHandler(test_carrier(), *target);
+}
+
+void tearDown() {
+  delete text_handler;
+  delete binary_handler;
+  delete target;
+}
+
+void test_text_message() {
+  Loopback connection;
+  target->add(&connection.socket);
+  text_handler->prepare(run);
+  text_handler->handle(dma_block.data(), outer_count, inner_count, run);
+  TEST_ASSERT_FALSE(text_handler->overflowed);
+
+  auto line = connection.receive();
+  TEST_ASSERT_EQUAL('\n', line.back());
+  DynamicJsonDocument message(16384);
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(message, line));
+  TEST_ASSERT_EQUAL_STRING("run_data", message["type"]);
+  TEST_ASSERT_EQUAL_STRING(run_id, message["msg"]["id"]);
+  TEST_ASSERT_EQUAL_STRING("04-E9-E5-00-00-01", message["msg"]["entity"][0]);
+  TEST_ASSERT(message["msg"]["point"].isNull());
+  auto data = message["msg"]["data"].as<JsonArrayConst>();
+  TEST_ASSERT_EQUAL(outer_count, data.size());
+  for (size_t outer_i = 0; outer_i < outer_count; outer_i++) {
+    TEST_ASSERT_EQUAL(inner_count, data[outer_i].size());
+    for (size_t inner_i = 0; inner_i < inner_count; inner_i++)
+      TEST_ASSERT_FLOAT_WITHIN(1e-3, daq::BaseDAQ::raw_to_float(dma_block[outer_i * inner_count + inner_i]),
+                               data[outer_i][inner_i].as<float>());
+  }
+}
+
+void test_text_message_of_sweep_point() {
+  Loopback connection;
+  target->add(&connection.socket);
+  run::Run point_run(run_id, run::RunConfig(), daq::DAQConfig(inner_count, 100'000));
+  point_run.sweep = std::make_shared<run::Sweep>();
+  text_handler->prepare(point_run);
+  text_handler->handle(dma_block.data(), outer_count, inner_count, point_run);
+
+  DynamicJsonDocument message(16384);
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(message, connection.receive()));
+  TEST_ASSERT_EQUAL(0, message["msg"]["point"].as<int>());
+  TEST_ASSERT_EQUAL(outer_count, message["msg"]["data"].size());
+}
+
+void test_binary_frame() {
+  Loopback connection;
+  target->add(&connection.socket);
+  binary_handler->prepare(run);
+  binary_handler->handle(dma_block.data(), outer_count, inner_count, run);
+  TEST_ASSERT_FALSE(binary_handler->overflowed);
+
+  auto frame = connection.receive();
+  auto bytes = reinterpret_cast<const uint8_t *>(frame.data());
+  // The header is amortized over one DMA block, the payload is exactly two bytes per sample
+  TEST_ASSERT_EQUAL(daq::binary::HEADER_SIZE + 2 * num_samples, frame.size());
+  daq::binary::FrameHeader header;
+  TEST_ASSERT(daq::binary::decode_header(bytes, frame.size(), header));
+  TEST_ASSERT_EQUAL(inner_count, header.num_channels);
+  TEST_ASSERT_EQUAL(outer_count, header.num_samples);
+  TEST_ASSERT_EQUAL(0, header.sequence);
+  for (size_t idx = 0; idx < num_samples; idx++)
+    TEST_ASSERT_EQUAL(dma_block[idx], daq::binary::decode_sample(bytes, idx));
+}
+
+void test_disconnected_client_misses_chunks() {
+  Loopback connection;
+  connection.socket.stop();
+  target->add(&connection.socket);
+  target->add(&socket_);
+  text_handler->prepare(run);
+  text_handler->handle(dma_block.data(), outer_count, inner_count, run);
+
+  // Other clients still get the chunk
+  TEST_ASSERT(text_handler->overflowed);
+  TEST_ASSERT_EQUAL(1, target->dropped_writes);
+  TEST_ASSERT_EQUAL(1, socket_.calls);
+}
+
+void test_short_write_misses_chunks() {
+  ShortSocket short_socket;
+  target->add(&short_socket);
+  target->add(&socket_);
+  binary_handler->prepare(run);
+  binary_handler->handle(dma_block.data(), outer_count, inner_count, run);
+
+  TEST_ASSERT(binary_handler->overflowed);
+  TEST_ASSERT_EQUAL(1, target->dropped_writes);
+  TEST_ASSERT_EQUAL(1, socket_.calls);
+}
+
+/// Streams num_chunks DMA blocks through handler to socket_ and reports what it took
+void benchmark(const char *name, run::RunDataHandler &handler) {
+  target->add(&socket_);
+  handler.prepare(run);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t chunk = 0; chunk < num_chunks; chunk++)
+    handler.handle(dma_block.data(), outer_count, inner_count, run);
+  std::chrono::duration<double, std::micro> duration = std::chrono::steady_clock::now() - start;
+  TEST_ASSERT_FALSE(handler.overflowed);
+  TEST_ASSERT_EQUAL(num_chunks, socket_.calls);
+
+  std::cout << name << ": " << static_cast<float>(socket_.bytes) / (num_chunks * num_samples)
+            << " bytes written per sample, " << static_cast<float>(socket_.calls) / num_chunks
+            << " writes per chunk, " << duration.count() / num_chunks << "us per chunk" << std::endl;
+}
+
+void test_benchmark_text() { benchmark("text", *text_handler); }
+
+void test_benchmark_binary() {
+  benchmark("binary", *binary_handler);
+  TEST_ASSERT_EQUAL(num_chunks * (daq::binary::HEADER_SIZE + 2 * num_samples), socket_.bytes);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_text_message);
+  RUN_TEST(test_text_message_of_sweep_point);
+  RUN_TEST(test_binary_frame);
+  RUN_TEST(test_disconnected_client_misses_chunks);
+  RUN_TEST(test_short_write_misses_chunks);
+  RUN_TEST(test_benchmark_text);
+  RUN_TEST(test_benchmark_binary);
+  UNITY_END();
+}
@@ -0,0 +1,187 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <array>
+#include <vector>
+
+#include "daq/trigger.h"
+
+using namespace daq;
+
+constexpr size_t inner_count = 2;
+constexpr size_t block_outer_count = 16;
+constexpr size_t num_blocks = 8;
+constexpr size_t history_outer_count = num_blocks * block_outer_count;
+
+// Simulated DMA ring buffer
+std::array<volatile uint32_t, history_outer_count * inner_count> ring;
+
+// Raw values of the trigger channel for a given vector index
+std::vector<uint16_t> signal;
+
+// Channel 0 carries the index of each vector, so emitted data can be traced back.
+// Channel 1 carries the signal the trigger looks at.
+void fill_vector(volatile uint32_t *dst, size_t index) {
+  dst[0] = index;
+  dst[1] = signal[index];
+}
+
+/// Runs the stream through a capture block by block and returns the indices of the emitted vectors.
+/// Intact_history is the number of vectors before each block which were not overwritten yet.
+std::vector<uint32_t> run_capture(const TriggerConfig &config, std::vector<bool> overload = {},
+                                  size_t intact_history = SIZE_MAX, bool *history_lost = nullptr) {
+  TriggerCapture capture(config, inner_count, ring.data(), ring.size(), 2 * block_outer_count);
+  std::vector<uint32_t> emitted;
+  auto emit = [&](const volatile uint32_t *data, size_t outer_count) {
+    for (size_t i = 0; i < outer_count; i++)
+      emitted.push_back(static_cast<uint32_t>(data[i * inner_count]));
+  };
+  for (size_t block = 0; block * block_outer_count < signal.size(); block++) {
+    auto dst = ring.data() + (block % num_blocks) * block_outer_count * inner_count;
+    for (size_t i = 0; i < block_outer_count; i++)
+      fill_vector(dst + i * inner_count, block * block_outer_count + i);
+    capture.feed(dst, block_outer_count, block < overload.size() and overload[block], emit, intact_history);
+  }
+  if (history_lost)
+    *history_lost = capture.is_history_lost();
+  return emitted;
+}
+
+std::vector<uint32_t> range(uint32_t from, uint32_t to) {
+  std::vector<uint32_t> r;
+  for (auto i = from; i < to; i++)
+    r.push_back(i);
+  return r;
+}
+
+void assert_equal(const std::vector<uint32_t> &expected, const std::vector<uint32_t> &actual) {
+  TEST_ASSERT_EQUAL(expected.size(), actual.size());
+  if (!expected.empty())
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected.data(), actual.data(), expected.size());
+}
+
+// The raw values are inverted: low raw values are high machine unit values.
+constexpr uint16_t RAW_HIGH = 1000, RAW_LOW = 15000, RAW_LEVEL = 8192;
+
+void setUp() {
+  // A square wave on the trigger channel: low, going high at 300, low again at 500
+  signal.assign(50 * block_outer_count, RAW_LOW);
+  for (size_t i = 300; i < 500; i++)
+    signal[i] = RAW_HIGH;
+}
+
+void tearDown() {}
+
+TriggerConfig make_config(TriggerMode mode, uint32_t pre, uint32_t post) {
+  TriggerConfig config;
+  config.mode = mode;
+  config.channel = 1;
+  config.level_raw = RAW_LEVEL;
+  config.pre = pre;
+  config.post = post;
+  return config;
+}
+
+void test_evaluator_levels() {
+  std::array<volatile uint32_t, 4 * inner_count> data = {0, RAW_LOW, 0, RAW_LOW, 0, RAW_HIGH, 0, RAW_LOW};
+  TriggerEvaluator above(make_config(TriggerMode::ABOVE, 0, 0), inner_count);
+  TEST_ASSERT_EQUAL(2, above.find(data.data(), 4, false));
+  TriggerEvaluator below(make_config(TriggerMode::BELOW, 0, 0), inner_count);
+  TEST_ASSERT_EQUAL(0, below.find(data.data(), 4, false));
+  TriggerEvaluator overload(make_config(TriggerMode::OVERLOAD, 0, 0), inner_count);
+  TEST_ASSERT_EQUAL(TriggerEvaluator::NOT_FOUND, overload.find(data.data(), 4, false));
+  TEST_ASSERT_EQUAL(0, overload.find(data.data(), 4, true));
+}
+
+void test_evaluator_edges_across_chunks() {
+  std::array<volatile uint32_t, 2 * inner_count> high = {0, RAW_HIGH, 0, RAW_HIGH};
+  std::array<volatile uint32_t, 2 * inner_count> low = {0, RAW_LOW, 0, RAW_LOW};
+  TriggerEvaluator rising(make_config(TriggerMode::RISING, 0, 0), inner_count);
+  // Starting high is no edge
+  TEST_ASSERT_EQUAL(TriggerEvaluator::NOT_FOUND, rising.find(high.data(), 2, false));
+  TEST_ASSERT_EQUAL(TriggerEvaluator::NOT_FOUND, rising.find(low.data(), 2, false));
+  TEST_ASSERT_EQUAL(0, rising.find(high.data(), 2, false));
+
+  TriggerEvaluator falling(make_config(TriggerMode::FALLING, 0, 0), inner_count);
+  TEST_ASSERT_EQUAL(TriggerEvaluator::NOT_FOUND, falling.find(high.data(), 2, false));
+  TEST_ASSERT_EQUAL(0, falling.find(low.data(), 2, false));
+}
+
+void test_float_level_is_inverted() {
+  // Positive machine units are small raw values
+  TEST_ASSERT_LESS_THAN(8192, BaseDAQ::float_to_raw(0.5f));
+  TEST_ASSERT_GREATER_THAN(8192, BaseDAQ::float_to_raw(-0.5f));
+  TEST_ASSERT_EQUAL(0, BaseDAQ::float_to_raw(2.0f));
+  TEST_ASSERT_EQUAL(16383, BaseDAQ::float_to_raw(-2.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.5f, BaseDAQ::raw_to_float(BaseDAQ::float_to_raw(0.5f)));
+}
+
+void test_no_trigger_emits_nothing() {
+  signal.assign(signal.size(), RAW_LOW);
+  assert_equal({}, run_capture(make_config(TriggerMode::RISING, 10, 10)));
+}
+
+void test_rising_edge_window() {
+  assert_equal(range(300 - 20, 300 + 50), run_capture(make_config(TriggerMode::RISING, 20, 50)));
+}
+
+void test_falling_edge_window() {
+  assert_equal(range(500 - 5, 500 + 100), run_capture(make_config(TriggerMode::FALLING, 5, 100)));
+}
+
+void test_pre_window_wraps_around_history() {
+  // 300 is in block 18, which lives in slot 2 of the ring, so the history wraps around
+  assert_equal(range(300 - 90, 300 + 1), run_capture(make_config(TriggerMode::ABOVE, 90, 1)));
+}
+
+void test_pre_window_is_limited() {
+  // The history can not hold more than the ring minus the blocks in flight
+  constexpr uint32_t max_pre = history_outer_count - 2 * block_outer_count;
+  assert_equal(range(300 - max_pre, 300 + 3), run_capture(make_config(TriggerMode::ABOVE, 1000, 3)));
+}
+
+void test_pre_window_at_start() {
+  // Triggering right away, there is no history yet
+  signal.assign(signal.size(), RAW_HIGH);
+  assert_equal(range(0, 10), run_capture(make_config(TriggerMode::ABOVE, 50, 10)));
+}
+
+void test_overwritten_history_is_not_emitted() {
+  // 300 is vector 12 of its block, of the block before only 5 vectors are intact
+  bool history_lost = false;
+  assert_equal(range(300 - 12 - 5, 300 + 10),
+               run_capture(make_config(TriggerMode::RISING, 50, 10), {}, 5, &history_lost));
+  TEST_ASSERT(history_lost);
+
+  run_capture(make_config(TriggerMode::RISING, 50, 10), {}, 3 * block_outer_count, &history_lost);
+  TEST_ASSERT_FALSE(history_lost);
+}
+
+void test_overload_trigger() {
+  std::vector<bool> overload(50, false);
+  for (size_t block = 10; block < overload.size(); block++)
+    overload[block] = true;
+  assert_equal(range(10 * block_outer_count - 4, 10 * block_outer_count + 40),
+               run_capture(make_config(TriggerMode::OVERLOAD, 4, 40), overload));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_evaluator_levels);
+  RUN_TEST(test_evaluator_edges_across_chunks);
+  RUN_TEST(test_float_level_is_inverted);
+  RUN_TEST(test_no_trigger_emits_nothing);
+  RUN_TEST(test_rising_edge_window);
+  RUN_TEST(test_falling_edge_window);
+  RUN_TEST(test_pre_window_wraps_around_history);
+  RUN_TEST(test_pre_window_is_limited);
+  RUN_TEST(test_pre_window_at_start);
+  RUN_TEST(test_overwritten_history_is_not_emitted);
+  RUN_TEST(test_overload_trigger);
+  UNITY_END();
+}
@@ -0,0 +1,238 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "block/blocks.h"
+#include "carrier/calibration_cache.h"
+#include "carrier/cluster.h"
+#include "metadata/cache.h"
+#include "simulation/analog.h"
+
+using namespace blocks;
+using namespace platform;
+using Kind = CalibrationCache::Kind;
+
+// Fake EEPROMs, giving each block an EUI from its address
+class FakeMetadataReader : public metadata::MetadataReader {
+public:
+  bool read(bus::addr_t block_address, std::array<uint8_t, sizeof(entities::EntityClassifier)> &classifier,
+            std::array<uint8_t, 8> &eui) override {
+    classifier = {};
+    eui = {0x04, 0xE9, 0xE5, 0, 0, 0, 0, static_cast<uint8_t>(block_address)};
+    return true;
+  }
+};
+
+FakeMetadataReader fake_reader;
+metadata::MetadataReader *eeprom_reader;
+
+const std::array<uint8_t, 8> eui_a{0x04, 0xE9, 0xE5, 0, 0, 0, 0, 1}, eui_b{0x04, 0xE9, 0xE5, 0, 0, 0, 0, 2};
+
+// Real-time clock which only advances when told to
+class ClockedCalibrationCache : public CalibrationCache {
+public:
+  uint32_t clock_s = 1'728'295'200;
+
+protected:
+  uint32_t get_clock_s() const override { return clock_s; }
+};
+
+ClockedCalibrationCache *cache;
+
+void setUp() {
+  cache = new ClockedCalibrationCache();
+  cache->set_temperature(30.5f);
+  eeprom_reader = metadata::cache.get_reader();
+  metadata::cache.set_reader(&fake_reader);
+}
+
+void tearDown() {
+  delete cache;
+  metadata::cache.set_reader(eeprom_reader);
+}
+
+void test_hit_and_miss() {
+  TEST_ASSERT_NULL(cache->lookup(eui_a, Kind::ROUTE_GAIN, 3));
+  cache->store(eui_a, Kind::ROUTE_GAIN, 3, {1.05f});
+
+  auto values = cache->lookup(eui_a, Kind::ROUTE_GAIN, 3);
+  TEST_ASSERT_NOT_NULL(values);
+  TEST_ASSERT_EQUAL_FLOAT(1.05f, (*values)[0]);
+  // Other elements, blocks and kinds are different entries
+  TEST_ASSERT_NULL(cache->lookup(eui_a, Kind::ROUTE_GAIN, 4));
+  TEST_ASSERT_NULL(cache->lookup(eui_b, Kind::ROUTE_GAIN, 3));
+  TEST_ASSERT_NULL(cache->lookup(eui_a, Kind::MULTIPLIER_OFFSETS, 3));
+
+  TEST_ASSERT_EQUAL(1, cache->get_statistics().hits);
+  TEST_ASSERT_EQUAL(4, cache->get_statistics().misses);
+  TEST_ASSERT_EQUAL(0, cache->get_statistics().stale);
+  // Only persistent kinds need saving
+  TEST_ASSERT_FALSE(cache->has_unsaved_entries());
+}
+
+void test_temperature_bands() {
+  cache->store(eui_a, Kind::ROUTE_GAIN, 0, {1.05f});
+  cache->set_temperature(31.9f);
+  TEST_ASSERT_NOT_NULL(cache->lookup(eui_a, Kind::ROUTE_GAIN, 0));
+  cache->set_temperature(32.1f);
+  TEST_ASSERT_NULL(cache->lookup(eui_a, Kind::ROUTE_GAIN, 0));
+  cache->set_temperature(NAN);
+  TEST_ASSERT_NULL(cache->lookup(eui_a, Kind::ROUTE_GAIN, 0));
+  TEST_ASSERT_EQUAL(CalibrationCache::UNKNOWN_TEMPERATURE_BAND, cache->get_temperature_band());
+
+  // Going back to the original temperature finds the entry again
+  cache->set_temperature(30.0f);
+  TEST_ASSERT_NOT_NULL(cache->lookup(eui_a, Kind::ROUTE_GAIN, 0));
+}
+
+void test_stale_entries() {
+  cache->store(eui_a, Kind::MULTIPLIER_OFFSETS, 0, {0.01f, -0.02f, 0.03f});
+  TEST_ASSERT_TRUE(cache->has_unsaved_entries());
+  cache->max_age_ms = 0;
+  TEST_ASSERT_NULL(cache->lookup(eui_a, Kind::MULTIPLIER_OFFSETS, 0));
+  TEST_ASSERT_EQUAL(1, cache->get_statistics().stale);
+
+  cache->max_age_ms = 3'600'000;
+  cache->enabled = false;
+  TEST_ASSERT_NULL(cache->lookup(eui_a, Kind::MULTIPLIER_OFFSETS, 0));
+}
+
+void test_eviction() {
+  for (uint16_t element = 0; element < CalibrationCache::MAX_ENTRIES + 10; element++)
+    cache->store(eui_a, Kind::ROUTE_GAIN, element, {1.0f});
+  TEST_ASSERT_EQUAL(CalibrationCache::MAX_ENTRIES, cache->size());
+  TEST_ASSERT_EQUAL(10, cache->get_statistics().evictions);
+  TEST_ASSERT_NOT_NULL(cache->lookup(eui_a, Kind::ROUTE_GAIN, CalibrationCache::MAX_ENTRIES + 9));
+
+  cache->invalidate(eui_a);
+  TEST_ASSERT_EQUAL(0, cache->size());
+}
+
+void test_persistent_settings() {
+  cache->persistent = true;
+  cache->store(eui_a, Kind::ROUTE_GAIN, 0, {1.05f});
+  cache->store(eui_b, Kind::MULTIPLIER_OFFSETS, 2, {0.01f, -0.02f, 0.03f});
+
+  DynamicJsonDocument doc(1024);
+  cache->settings_to_json(doc.to<JsonObject>(), true);
+  // Route gains are cheap to measure and depend on the circuit, so they are not persisted
+  TEST_ASSERT_EQUAL(1, doc["entries"].size());
+
+  ClockedCalibrationCache restored;
+  restored.set_temperature(30.5f);
+  restored.settings_from_json(doc.as<JsonObjectConst>(), true);
+  TEST_ASSERT_TRUE(restored.persistent);
+  TEST_ASSERT_EQUAL(1, restored.size());
+  auto values = restored.lookup(eui_b, Kind::MULTIPLIER_OFFSETS, 2);
+  TEST_ASSERT_NOT_NULL(values);
+  TEST_ASSERT_EQUAL_FLOAT(-0.02f, (*values)[1]);
+
+  // Entries without a clock stamp, as persisted by former firmware, are of unknown age
+  auto entry = doc["entries"][0].as<JsonArray>();
+  entry.remove(entry.size() - 1);
+  ClockedCalibrationCache unstamped;
+  unstamped.settings_from_json(doc.as<JsonObjectConst>(), true);
+  TEST_ASSERT_EQUAL(0, unstamped.size());
+
+  // Settings only
+  doc.clear();
+  cache->settings_to_json(doc.to<JsonObject>(), false);
+  TEST_ASSERT_FALSE(doc.containsKey("entries"));
+  TEST_ASSERT_EQUAL(3600, doc["max_age_s"]);
+}
+
+void test_persistent_entries_age() {
+  cache->persistent = true;
+  cache->store(eui_a, Kind::MULTIPLIER_OFFSETS, 0, {0.01f, -0.02f, 0.03f});
+  DynamicJsonDocument doc(1024);
+  cache->settings_to_json(doc.to<JsonObject>(), true);
+
+  // A restart half an hour later restores the entry, which becomes stale after the rest of the hour
+  ClockedCalibrationCache restarted;
+  restarted.set_temperature(30.5f);
+  restarted.clock_s = cache->clock_s + 1800;
+  restarted.settings_from_json(doc.as<JsonObjectConst>(), true);
+  TEST_ASSERT_EQUAL(1, restarted.size());
+  TEST_ASSERT_NOT_NULL(restarted.lookup(eui_a, Kind::MULTIPLIER_OFFSETS, 0));
+  restarted.max_age_ms = 1'800'000;
+  TEST_ASSERT_NULL(restarted.lookup(eui_a, Kind::MULTIPLIER_OFFSETS, 0));
+  TEST_ASSERT_EQUAL(1, restarted.get_statistics().stale);
+
+  // Saving again keeps the original stamp, so the entry is not renewed by being restored
+  restarted.max_age_ms = 3'600'000;
+  DynamicJsonDocument resaved(1024);
+  restarted.settings_to_json(resaved.to<JsonObject>(), true);
+  TEST_ASSERT_UINT32_WITHIN(1, cache->clock_s, resaved["entries"][0][4 + CalibrationCache::MAX_VALUES].as<uint32_t>());
+
+  // More than an hour later, it is not restored anymore
+  ClockedCalibrationCache later;
+  later.clock_s = cache->clock_s + 3600;
+  later.settings_from_json(doc.as<JsonObjectConst>(), true);
+  TEST_ASSERT_EQUAL(0, later.size());
+
+  // After a loss of power, the clock starts over before the stamp
+  ClockedCalibrationCache powered_off;
+  powered_off.clock_s = cache->clock_s - 86400;
+  powered_off.settings_from_json(doc.as<JsonObjectConst>(), true);
+  TEST_ASSERT_EQUAL(0, powered_off.size());
+}
+
+void test_route_calibration_reuses_entries() {
+  simulation::AnalogCluster sim;
+  UBlock ublock(bus::idx_to_addr(0, bus::U_BLOCK_IDX, 0), &sim.uhal);
+  CBlock cblock(bus::idx_to_addr(0, bus::C_BLOCK_IDX, 0), &sim.chal);
+  IBlock iblock(bus::idx_to_addr(0, bus::I_BLOCK_IDX, 0), &sim.ihal);
+  Cluster cluster;
+  cluster.ublock = &ublock;
+  cluster.cblock = &cblock;
+  cluster.iblock = &iblock;
+
+  for (uint8_t lane = 0; lane < 16; lane++) {
+    TEST_ASSERT(ublock.connect(lane, lane, true));
+    TEST_ASSERT(iblock.connect(lane, lane));
+    TEST_ASSERT(cblock.set_factor(lane, 0.5f));
+    sim.lane_gains[lane] = 0.95f + 0.005f * lane;
+  }
+  TEST_ASSERT(cluster.write_to_hardware());
+
+  TEST_ASSERT(cluster.calibrate_routes(sim, cache));
+  TEST_ASSERT_EQUAL(2, sim.measurements);
+  TEST_ASSERT_EQUAL(16, cache->size());
+
+  // The same circuit again is not measured anymore
+  cblock.reset_gain_corrections();
+  TEST_ASSERT(cluster.calibrate_routes(sim, cache));
+  TEST_ASSERT_EQUAL(2, sim.measurements);
+  TEST_ASSERT_EQUAL(16, cache->get_statistics().hits);
+  for (uint8_t lane = 0; lane < 16; lane++)
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 1.0f / sim.lane_gains[lane], cblock.get_gain_correction(lane));
+
+  // A changed route is measured again
+  TEST_ASSERT(iblock.disconnect(0, 0));
+  TEST_ASSERT(iblock.connect(0, 1));
+  TEST_ASSERT(cluster.calibrate_routes(sim, cache));
+  TEST_ASSERT_EQUAL(3, sim.measurements);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 1.0f / sim.lane_gains[0], cblock.get_gain_correction(0));
+
+  // As is everything at a different temperature, where lanes 0 and 1 now need separate batches
+  cache->set_temperature(40.0f);
+  TEST_ASSERT(cluster.calibrate_routes(sim, cache));
+  TEST_ASSERT_EQUAL(6, sim.measurements);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_hit_and_miss);
+  RUN_TEST(test_temperature_bands);
+  RUN_TEST(test_stale_entries);
+  RUN_TEST(test_eviction);
+  RUN_TEST(test_persistent_settings);
+  RUN_TEST(test_persistent_entries_age);
+  RUN_TEST(test_route_calibration_reuses_entries);
+  UNITY_END();
+}
@@ -0,0 +1,191 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <cmath>
+#include <vector>
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "block/blocks.h"
+#include "daq/daq.h"
+#include "run/run_manager.h"
+#include "simulation/lucidac.h"
+#include "simulation/run.h"
+
+using namespace blocks;
+using namespace platform;
+
+simulation::SimulatedLUCIDAC *lucidac;
+MIntBlock *intblock;
+
+// Integrators and multipliers in the numbering of the U-block inputs and I-block outputs
+const uint8_t x = MBlock::M0_OUTPUT(0), y = MBlock::M0_OUTPUT(1);
+const uint8_t mul_out = MBlock::M1_OUTPUT(0), mul_in_a = MBlock::M1_INPUT(0), mul_in_b = MBlock::M1_INPUT(1);
+
+void setUp() {
+  lucidac = new simulation::SimulatedLUCIDAC();
+  TEST_ASSERT(lucidac->init());
+  intblock = static_cast<MIntBlock *>(lucidac->clusters[0].m0block);
+}
+
+void tearDown() { delete lucidac; }
+
+void start() {
+  TEST_ASSERT(lucidac->write_to_hardware());
+  lucidac->circuit.reset();
+}
+
+void test_ramp() {
+  auto &cluster = lucidac->clusters[0];
+  TEST_ASSERT(intblock->set_ic_value(0, -1.0f));
+  TEST_ASSERT(cluster.add_constant(UBlock::Transmission_Mode::POS_REF, 0, 0.5f, x));
+  start();
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, -1.0f, lucidac->circuit.outputs()[x]);
+
+  // Slope is k0 * 0.5 = 5000 per second, up to the resolution of the coefficient DAC
+  lucidac->circuit.advance(2e-4);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.0f, lucidac->circuit.outputs()[x]);
+  TEST_ASSERT(lucidac->m0_hal.overload_flags.none());
+
+  // Beyond the machine unit
+  lucidac->circuit.advance(2.2e-4);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 1.1f, lucidac->circuit.outputs()[x]);
+  TEST_ASSERT(lucidac->m0_hal.overload_flags[0]);
+}
+
+void test_exponential_decay_with_slow_integrator() {
+  auto &cluster = lucidac->clusters[0];
+  TEST_ASSERT(intblock->set_ic_value(0, 1.0f));
+  TEST_ASSERT(intblock->set_time_factor(0, 100));
+  TEST_ASSERT(cluster.route(x, 0, -1.0f, x));
+  start();
+
+  lucidac->circuit.advance(0.01);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5, std::exp(-1.0f), lucidac->circuit.outputs()[x]);
+}
+
+void test_harmonic_oscillator() {
+  auto &cluster = lucidac->clusters[0];
+  TEST_ASSERT(intblock->set_ic_value(0, 1.0f));
+  TEST_ASSERT(intblock->set_ic_value(1, 0.0f));
+  TEST_ASSERT(cluster.route(y, 0, 1.0f, x));
+  TEST_ASSERT(cluster.route(x, 1, -1.0f, y));
+  start();
+
+  // Two periods, compared to x = cos(k0 t) and y = -sin(k0 t), up to the resolution of the IC DAC
+  for (int step = 1; step <= 100; step++) {
+    lucidac->circuit.advance(4 * M_PI / 10000 / 100);
+    auto phase = 10000 * lucidac->circuit.time();
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, std::cos(phase), lucidac->circuit.outputs()[x]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, -std::sin(phase), lucidac->circuit.outputs()[y]);
+  }
+  TEST_ASSERT(lucidac->m0_hal.overload_flags.none());
+}
+
+void test_multiplier_in_feedback() {
+  // x' = -x^2, which is x = 1 / (1 + k0 t)
+  auto &cluster = lucidac->clusters[0];
+  TEST_ASSERT(intblock->set_ic_value(0, 1.0f));
+  TEST_ASSERT(cluster.route(x, 0, 1.0f, mul_in_a));
+  TEST_ASSERT(cluster.route(x, 1, 1.0f, mul_in_b));
+  TEST_ASSERT(cluster.route(mul_out, 2, -1.0f, x));
+  start();
+
+  lucidac->circuit.advance(1e-4);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5, 0.5f, lucidac->circuit.outputs()[x]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5, 0.25f, lucidac->circuit.outputs()[mul_out]);
+  // The identity outputs repeat the multiplier inputs
+  TEST_ASSERT_FLOAT_WITHIN(1e-5, 0.5f, lucidac->circuit.outputs()[MBlock::M1_OUTPUT(4)]);
+}
+
+class CollectingRunDataHandler : public run::RunDataHandler {
+public:
+  std::vector<uint32_t> data;
+  std::vector<size_t> chunks;
+  bool prepared = false, finished = false;
+
+  void prepare(run::Run &run) override {
+    data.clear();
+    prepared = true;
+  }
+  void handle(volatile uint32_t *data_, size_t outer_count, size_t inner_count, const run::Run &run) override {
+    chunks.push_back(outer_count);
+    for (size_t idx = 0; idx < outer_count * inner_count; idx++)
+      data.push_back(data_[idx]);
+  }
+  void stream(volatile uint32_t *buffer, run::Run &run) override {}
+  void finish(const run::Run &run) override { finished = true; }
+};
+
+class CollectingRunStateChangeHandler : public run::RunStateChangeHandler {
+public:
+  std::vector<run::RunState> states;
+
+  void handle(run::RunStateChange change, const run::Run &run) override { states.push_back(change.new_); }
+};
+
+void test_run_samples_adc_channels() {
+  auto &cluster = lucidac->clusters[0];
+  TEST_ASSERT(intblock->set_ic_value(0, -1.0f));
+  TEST_ASSERT(cluster.add_constant(UBlock::Transmission_Mode::POS_REF, 0, 0.2f, x));
+  TEST_ASSERT(lucidac->set_adc_channel(0, x));
+  TEST_ASSERT(lucidac->write_to_hardware());
+
+  run::RunConfig config;
+  config.op_time = 1'000'000; // 1ms, in which x goes from -1 to +1
+  auto &manager = run::RunManager::get();
+  manager.queue.emplace_back("run", config, daq::DAQConfig(4, 100'000));
+
+  CollectingRunDataHandler data_handler;
+  CollectingRunStateChangeHandler state_change_handler;
+  simulation::run_next(*lucidac, manager, &state_change_handler, &data_handler);
+
+  TEST_ASSERT(manager.queue.empty());
+  TEST_ASSERT_EQUAL(1, state_change_handler.states.size());
+  TEST_ASSERT(state_change_handler.states[0] == run::RunState::DONE);
+  TEST_ASSERT(data_handler.finished);
+
+  // 100 samples during OP and one at its end, in blocks of the DMA ring buffer
+  const size_t outer_count = daq::dma::BLOCK_SIZE / 4;
+  TEST_ASSERT_EQUAL(101 * 4, data_handler.data.size());
+  TEST_ASSERT_EQUAL((101 + outer_count - 1) / outer_count, data_handler.chunks.size());
+  TEST_ASSERT_EQUAL(outer_count, data_handler.chunks[0]);
+
+  for (size_t idx = 0; idx <= 100; idx++) {
+    auto value = daq::BaseDAQ::raw_to_float(data_handler.data[idx * 4]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, -1.0f + 0.02f * idx, value);
+    // Disabled channels read zero
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.0f, daq::BaseDAQ::raw_to_float(data_handler.data[idx * 4 + 1]));
+  }
+}
+
+void test_run_without_channels() {
+  run::RunConfig config;
+  config.op_time = 1'000'000;
+  auto &manager = run::RunManager::get();
+  manager.queue.emplace_back("run", config, daq::DAQConfig(0, 100'000));
+
+  CollectingRunDataHandler data_handler;
+  CollectingRunStateChangeHandler state_change_handler;
+  simulation::run_next(*lucidac, manager, &state_change_handler, &data_handler);
+
+  // There is nothing to sample, so the data handler is left alone
+  TEST_ASSERT_EQUAL(1, state_change_handler.states.size());
+  TEST_ASSERT(state_change_handler.states[0] == run::RunState::DONE);
+  TEST_ASSERT_FALSE(data_handler.prepared);
+  TEST_ASSERT_EQUAL(0, data_handler.chunks.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ramp);
+  RUN_TEST(test_exponential_decay_with_slow_integrator);
+  RUN_TEST(test_harmonic_oscillator);
+  RUN_TEST(test_multiplier_in_feedback);
+  RUN_TEST(test_run_samples_adc_channels);
+  RUN_TEST(test_run_without_channels);
+  UNITY_END();
+}
@@ -0,0 +1,124 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <map>
+
+#include "block/cblock.h"
+#include "block/ublock.h"
+#include "carrier/cluster.h"
+#include "entity/entity.h"
+#include "metadata/cache.h"
+
+using namespace entities;
+using namespace metadata;
+
+using RawClassifier = std::array<uint8_t, sizeof(EntityClassifier)>;
+
+// Fake EEPROMs, counting how often each one is read
+class FakeMetadataReader : public MetadataReader {
+public:
+  std::map<bus::addr_t, RawClassifier> classifiers;
+  std::map<bus::addr_t, unsigned int> reads;
+
+  bool read(bus::addr_t block_address, RawClassifier &classifier, std::array<uint8_t, 8> &eui) override {
+    reads[block_address]++;
+    classifier = classifiers[block_address];
+    eui = {0x04, 0xE9, 0xE5, 0, 0, 0, 0, static_cast<uint8_t>(block_address)};
+    return true;
+  }
+};
+
+FakeMetadataReader fake_reader;
+MetadataReader *eeprom_reader;
+
+const bus::addr_t u_address = bus::idx_to_addr(0, bus::U_BLOCK_IDX, 0);
+const bus::addr_t c_address = bus::idx_to_addr(0, bus::C_BLOCK_IDX, 0);
+
+void setUp() {
+  fake_reader.reads.clear();
+  fake_reader.classifiers[u_address] = {static_cast<uint8_t>(EntityClass::U_BLOCK), 1, 1, 2, 0, 1};
+  fake_reader.classifiers[c_address] = {static_cast<uint8_t>(EntityClass::C_BLOCK), 1, 1, 1, 0, 1};
+  eeprom_reader = cache.get_reader();
+  cache.set_reader(&fake_reader);
+}
+
+void tearDown() { cache.set_reader(eeprom_reader); }
+
+void test_repeated_access_reads_once() {
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT(EntityClass::U_BLOCK == cache.get_classifier(u_address).class_enum);
+    TEST_ASSERT_EQUAL(u_address, cache.get_eui(u_address)[7]);
+  }
+  TEST_ASSERT_EQUAL(1, fake_reader.reads[u_address]);
+  TEST_ASSERT_EQUAL(1, cache.size());
+}
+
+void test_invalidate() {
+  cache.get_classifier(u_address);
+  cache.get_classifier(c_address);
+
+  // A single entity
+  cache.invalidate(u_address);
+  TEST_ASSERT_EQUAL(1, cache.size());
+  fake_reader.classifiers[u_address] = {static_cast<uint8_t>(EntityClass::UNKNOWN), 0, 0, 0, 0, 0};
+  TEST_ASSERT(EntityClass::UNKNOWN == cache.get_classifier(u_address).class_enum);
+  TEST_ASSERT(EntityClass::C_BLOCK == cache.get_classifier(c_address).class_enum);
+  TEST_ASSERT_EQUAL(2, fake_reader.reads[u_address]);
+  TEST_ASSERT_EQUAL(1, fake_reader.reads[c_address]);
+
+  // Everything
+  cache.invalidate();
+  TEST_ASSERT_EQUAL(0, cache.size());
+  cache.get_classifier(c_address);
+  TEST_ASSERT_EQUAL(2, fake_reader.reads[c_address]);
+}
+
+void test_full_cache_reads_through() {
+  for (bus::addr_t address = 0; address < MetadataCache::MAX_ENTRIES + 1; address++)
+    cache.get_eui(address);
+  TEST_ASSERT_EQUAL(MetadataCache::MAX_ENTRIES, cache.size());
+
+  // Cached entries are still served from the cache, the others read each time
+  bus::addr_t uncached = MetadataCache::MAX_ENTRIES;
+  TEST_ASSERT_EQUAL(uncached, cache.get_eui(uncached)[7]);
+  cache.get_eui(0);
+  TEST_ASSERT_EQUAL(1, fake_reader.reads[0]);
+  TEST_ASSERT_EQUAL(2, fake_reader.reads[uncached]);
+}
+
+void test_detection_and_listing_read_once() {
+  auto ublock = detect<blocks::UBlock>(u_address);
+  auto cblock = detect<blocks::CBlock>(c_address);
+  TEST_ASSERT_NOT_NULL(ublock);
+  TEST_ASSERT_NOT_NULL(cblock);
+
+  platform::Cluster cluster(0);
+  cluster.ublock = ublock;
+  cluster.cblock = cblock;
+
+  for (int i = 0; i < 3; i++) {
+    StaticJsonDocument<1024> doc;
+    auto obj = doc.to<JsonObject>();
+    cluster.classifier_to_json(obj);
+    TEST_ASSERT_EQUAL_STRING("04-E9-E5-00-00-00-00-09", doc["/0"]["/C"]["eui"]);
+  }
+  TEST_ASSERT_EQUAL(1, fake_reader.reads[u_address]);
+  TEST_ASSERT_EQUAL(1, fake_reader.reads[c_address]);
+
+  delete ublock;
+  delete cblock;
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_repeated_access_reads_once);
+  RUN_TEST(test_invalidate);
+  RUN_TEST(test_full_cache_reads_through);
+  RUN_TEST(test_detection_and_listing_read_once);
+  UNITY_END();
+}
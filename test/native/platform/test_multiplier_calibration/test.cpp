@@ -0,0 +1,154 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <cmath>
+#include <iostream>
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "block/multiplier_calibration.h"
+#include "simulation/multiplier.h"
+
+using namespace blocks;
+
+using Search = MultiplierOffsetSearch;
+using Calibrations = std::array<MultiplierCalibration, MMulBlock::NUM_MULTIPLIERS>;
+
+simulation::AnalogMultipliers *sim;
+
+void setUp() {
+  sim = new simulation::AnalogMultipliers();
+  // Different errors for each multiplier, in the circuit used to calibrate the X offsets
+  const float errors[MMulBlock::NUM_MULTIPLIERS][3] = {
+      {0.01f, 0.02f, -0.005f}, {-0.043f, 0.0f, 0.012f}, {0.077f, -0.01f, 0.0f}, {-0.002f, 0.03f, -0.031f}};
+  for (size_t idx = 0; idx < sim->multipliers.size(); idx++) {
+    auto &multiplier = sim->multipliers[idx];
+    multiplier.y = 1.0f;
+    multiplier.error_x = errors[idx][0];
+    multiplier.error_y = errors[idx][1];
+    multiplier.error_z = errors[idx][2];
+  }
+}
+
+void tearDown() { delete sim; }
+
+// The X offset at which the output of a linear multiplier is zero
+float root_x(const simulation::AnalogMultipliers::Multiplier &m) {
+  return -(m.error_z + m.offset_z) / (m.y + m.error_y + m.offset_y) - m.x - m.error_x;
+}
+
+// Measurements of the previous search, which stepped one multiplier at a time through the range
+unsigned int linear_search_measurements() {
+  unsigned int measurements = 0;
+  for (auto multiplier : sim->multipliers)
+    for (multiplier.offset_x = Search::MIN_OFFSET; multiplier.offset_x < Search::MAX_OFFSET;
+         multiplier.offset_x += 0.01f) {
+      measurements++;
+      if (multiplier.output() >= 0)
+        break;
+    }
+  return measurements;
+}
+
+void test_finds_all_offsets_at_once() {
+  Calibrations calibration{};
+  Search::Results results;
+  TEST_ASSERT(Search::run(*sim, Search::Input::X, calibration, results));
+
+  for (size_t idx = 0; idx < sim->multipliers.size(); idx++) {
+    auto &multiplier = sim->multipliers[idx];
+    TEST_ASSERT(results[idx].bracketed);
+    TEST_ASSERT_FLOAT_WITHIN(Search::OUTPUT_TOLERANCE, 0.0f, results[idx].residual);
+    TEST_ASSERT_FLOAT_WITHIN(Search::OUTPUT_TOLERANCE, root_x(multiplier), results[idx].offset);
+    // Offsets are applied to the hardware and returned, the other input is left alone
+    TEST_ASSERT_EQUAL_FLOAT(results[idx].offset, multiplier.offset_x);
+    TEST_ASSERT_EQUAL_FLOAT(results[idx].offset, calibration[idx].offset_x);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, multiplier.offset_y);
+  }
+
+  // Both ends of the range, one secant step for a linear response and the residuals
+  TEST_ASSERT_EQUAL(4, sim->measurements);
+  auto linear = linear_search_measurements();
+  std::cout << "Multiplier offset search takes " << sim->measurements << " measurements instead of " << linear
+            << std::endl;
+  TEST_ASSERT_LESS_THAN(linear / 4, sim->measurements);
+}
+
+void test_keeps_offsets_of_other_input() {
+  Calibrations calibration{};
+  for (size_t idx = 0; idx < sim->multipliers.size(); idx++) {
+    auto &multiplier = sim->multipliers[idx];
+    std::swap(multiplier.x, multiplier.y);
+    std::swap(multiplier.error_x, multiplier.error_y);
+    calibration[idx].offset_x = 0.005f * idx;
+  }
+
+  Search::Results results;
+  TEST_ASSERT(Search::run(*sim, Search::Input::Y, calibration, results));
+  for (size_t idx = 0; idx < sim->multipliers.size(); idx++) {
+    TEST_ASSERT(results[idx].bracketed);
+    TEST_ASSERT_FLOAT_WITHIN(Search::OUTPUT_TOLERANCE, 0.0f, results[idx].residual);
+    TEST_ASSERT_EQUAL_FLOAT(0.005f * idx, sim->multipliers[idx].offset_x);
+    TEST_ASSERT_EQUAL_FLOAT(results[idx].offset, calibration[idx].offset_y);
+  }
+}
+
+void test_converges_for_nonlinear_response() {
+  for (auto &multiplier : sim->multipliers)
+    multiplier.cubic = 40.0f;
+
+  Calibrations calibration{};
+  Search::Results results;
+  TEST_ASSERT(Search::run(*sim, Search::Input::X, calibration, results));
+  for (auto &result : results) {
+    TEST_ASSERT(result.bracketed);
+    TEST_ASSERT_FLOAT_WITHIN(Search::OUTPUT_TOLERANCE, 0.0f, result.residual);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(3 + Search::MAX_STEPS, sim->measurements);
+}
+
+void test_reports_offsets_out_of_range() {
+  sim->multipliers[2].error_x = 0.3f;
+
+  Calibrations calibration{};
+  Search::Results results;
+  TEST_ASSERT(Search::run(*sim, Search::Input::X, calibration, results));
+  // The best bound is used and the remaining error is reported
+  TEST_ASSERT_FALSE(results[2].bracketed);
+  TEST_ASSERT_EQUAL_FLOAT(Search::MIN_OFFSET, results[2].offset);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, sim->multipliers[2].output(), results[2].residual);
+  TEST_ASSERT_GREATER_THAN(0.1f, results[2].residual);
+  // Others are not affected
+  for (auto idx : {0, 1, 3}) {
+    TEST_ASSERT(results[idx].bracketed);
+    TEST_ASSERT_FLOAT_WITHIN(Search::OUTPUT_TOLERANCE, 0.0f, results[idx].residual);
+  }
+}
+
+void test_tolerates_noise() {
+  sim->noise = 0.0003f;
+
+  Calibrations calibration{};
+  Search::Results results;
+  TEST_ASSERT(Search::run(*sim, Search::Input::X, calibration, results));
+  for (size_t idx = 0; idx < sim->multipliers.size(); idx++) {
+    TEST_ASSERT(results[idx].bracketed);
+    TEST_ASSERT_FLOAT_WITHIN(Search::OUTPUT_TOLERANCE + 2 * sim->noise, 0.0f, results[idx].residual);
+    TEST_ASSERT_FLOAT_WITHIN(2 * (Search::OUTPUT_TOLERANCE + sim->noise), root_x(sim->multipliers[idx]),
+                             results[idx].offset);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(3 + Search::MAX_STEPS, sim->measurements);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_finds_all_offsets_at_once);
+  RUN_TEST(test_keeps_offsets_of_other_input);
+  RUN_TEST(test_converges_for_nonlinear_response);
+  RUN_TEST(test_reports_offsets_out_of_range);
+  RUN_TEST(test_tolerates_noise);
+  UNITY_END();
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <iostream>
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "block/blocks.h"
+#include "carrier/cluster.h"
+#include "carrier/route_calibration.h"
+#include "simulation/analog.h"
+
+using namespace blocks;
+using namespace platform;
+
+simulation::AnalogCluster *sim;
+UBlock *ublock;
+CBlock *cblock;
+IBlock *iblock;
+
+void setUp() {
+  sim = new simulation::AnalogCluster();
+  ublock = new UBlock(0, &sim->uhal);
+  cblock = new CBlock(0, &sim->chal);
+  iblock = new IBlock(0, &sim->ihal);
+}
+
+void tearDown() {
+  delete ublock;
+  delete cblock;
+  delete iblock;
+  delete sim;
+}
+
+void route(uint8_t u_in, uint8_t lane, uint8_t i_out) {
+  TEST_ASSERT(ublock->connect(u_in, lane, true));
+  TEST_ASSERT(iblock->connect(lane, i_out, false, true));
+}
+
+void test_batches_use_all_adc_channels() {
+  for (uint8_t lane = 0; lane < 8; lane++)
+    route(lane, lane, lane);
+
+  auto batches = schedule_route_calibration(*ublock, *iblock);
+  TEST_ASSERT_EQUAL(1, batches.size());
+  TEST_ASSERT_EQUAL(8, batches[0].size);
+  TEST_ASSERT_EQUAL(0, batches[0].output_group);
+}
+
+void test_output_groups_are_separate() {
+  route(0, 0, 7);
+  route(1, 1, 8);
+
+  auto batches = schedule_route_calibration(*ublock, *iblock);
+  TEST_ASSERT_EQUAL(2, batches.size());
+  TEST_ASSERT_EQUAL(0, batches[0].output_group);
+  TEST_ASSERT_EQUAL(1, batches[1].output_group);
+}
+
+void test_mixing_signals_are_separate() {
+  // Lanes summed on the same output
+  route(0, 0, 0);
+  route(1, 1, 0);
+  // Lane 3 is measured on output 3, but also reaches output 2
+  route(2, 2, 2);
+  route(3, 3, 2);
+  route(3, 3, 3);
+  // Unused lanes are not calibrated
+  TEST_ASSERT(iblock->connect(4, 4));
+
+  auto batches = schedule_route_calibration(*ublock, *iblock);
+  TEST_ASSERT_EQUAL(2, batches.size());
+  TEST_ASSERT_EQUAL(2, batches[0].size);
+  TEST_ASSERT_EQUAL(2, batches[1].size);
+  // Each lane is calibrated once, on its last output
+  TEST_ASSERT_EQUAL(3, batches[1].routes[1].lane);
+  TEST_ASSERT_EQUAL(3, batches[1].routes[1].i_out);
+}
+
+void test_upscaled_lanes_are_separate() {
+  route(0, 0, 0);
+  route(1, 1, 1);
+  TEST_ASSERT(iblock->set_upscaling(1, true));
+
+  auto batches = schedule_route_calibration(*ublock, *iblock);
+  TEST_ASSERT_EQUAL(2, batches.size());
+  TEST_ASSERT_FALSE(batches[0].upscaled);
+  TEST_ASSERT_TRUE(batches[1].upscaled);
+}
+
+void test_calibrate_routes_in_simulation() {
+  // All 32 lanes, two of them summed on each output
+  for (uint8_t lane = 0; lane < 32; lane++) {
+    route(lane % 16, lane, lane / 2);
+    TEST_ASSERT(cblock->set_factor(lane, 0.5f));
+    sim->lane_gains[lane] = 0.92f + 0.005f * lane;
+  }
+  TEST_ASSERT(ublock->write_to_hardware());
+  TEST_ASSERT(cblock->write_to_hardware());
+  TEST_ASSERT(iblock->write_to_hardware());
+
+  Cluster cluster;
+  cluster.ublock = ublock;
+  cluster.cblock = cblock;
+  cluster.iblock = iblock;
+  TEST_ASSERT(cluster.calibrate_routes(*sim));
+
+  for (uint8_t lane = 0; lane < 32; lane++) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 1.0f / sim->lane_gains[lane], cblock->get_gain_correction(lane));
+    // The configuration is restored, now with corrected gains
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.5f, cblock->get_factor(lane));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.5f, sim->chal.factors[lane] * sim->lane_gains[lane]);
+  }
+  TEST_ASSERT(sim->uhal.modes.first == UBlockHAL::Transmission_Mode::ANALOG_INPUT);
+
+  // One measurement per batch instead of one per route
+  TEST_ASSERT_EQUAL(4, sim->measurements);
+  auto one_by_one_us = 32 * (simulation::AnalogCluster::OFFSET_CALIBRATION_US +
+                             simulation::AnalogCluster::MEASUREMENT_US) +
+                       simulation::AnalogCluster::OFFSET_CALIBRATION_US;
+  std::cout << "Route calibration of 32 lanes takes " << sim->elapsed_us / 1000 << " ms instead of "
+            << one_by_one_us / 1000 << " ms" << std::endl;
+  TEST_ASSERT_LESS_THAN(one_by_one_us / 4, sim->elapsed_us);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_batches_use_all_adc_channels);
+  RUN_TEST(test_output_groups_are_separate);
+  RUN_TEST(test_mixing_signals_are_separate);
+  RUN_TEST(test_upscaled_lanes_are_separate);
+  RUN_TEST(test_calibrate_routes_in_simulation);
+  UNITY_END();
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "protocol/dispatch.h"
+#include "test_common.h"
+#include "utils/StringPrint.h"
+
+using namespace msg::handlers;
+
+// Compile time checks
+constexpr auto small_table = make_dispatch_table<int>({{"ping", 1}, {"help", 2}, {"abc", 3}});
+static_assert(small_table.is_unique());
+static_assert(*small_table.find("ping") == 1);
+static_assert(*small_table.find("help") == 2);
+static_assert(*small_table.find("abc") == 3);
+static_assert(small_table.find("zzz") == nullptr);
+static_assert(small_table[0].msg_type == "abc");
+static_assert(!make_dispatch_table<int>({{"ping", 1}, {"ping", 2}}).is_unique());
+
+// Swallows the responses of the benchmark, but counts their bytes
+class CountingPrint : public Print {
+public:
+  size_t count = 0;
+
+  size_t write(uint8_t) override { return ++count, 1; }
+  size_t write(const uint8_t *buffer, size_t size) override { return count += size, size; }
+};
+
+void setUp() { test_protocol(); }
+
+void tearDown() {}
+
+void test_builtin_table_is_sorted() {
+  auto table = detail::get_builtin_table();
+  TEST_ASSERT(table.size() > 0);
+  TEST_ASSERT(table.size() <= Registry::MAX_BUILTIN_HANDLERS);
+  for (auto entry = table.begin() + 1; entry != table.end(); entry++)
+    TEST_ASSERT(entry[-1].msg_type < entry->msg_type);
+}
+
+void test_registry_finds_builtins() {
+  auto &registry = Registry::get();
+  for (auto &entry : detail::get_builtin_table()) {
+    auto found = registry.find(entry.msg_type);
+    TEST_ASSERT(found.clearance == entry.value.clearance);
+    if (found.handler)
+      TEST_ASSERT_EQUAL(entry.value.result_code_prefix, found.handler->result_prefix);
+  }
+  // Native builds register the handlers which do not need the hardware
+  TEST_ASSERT_NOT_NULL(registry.find("ping").handler);
+  TEST_ASSERT_NOT_NULL(registry.find("set_circuit").handler);
+  TEST_ASSERT_NOT_NULL(registry.find("start_run").handler);
+  TEST_ASSERT_NULL(registry.find("sys_stats").handler);
+
+  TEST_ASSERT_NULL(registry.find("pong").handler);
+  TEST_ASSERT_NULL(registry.find("").handler);
+  TEST_ASSERT_NULL(registry.find("zzz").handler);
+  // Prefixes are not matches
+  TEST_ASSERT_NULL(registry.find("ota_update").handler);
+  TEST_ASSERT_NULL(registry.find("pingping").handler);
+  // Built-in message types can not be replaced at runtime
+  TEST_ASSERT_FALSE(registry.set("ping", registry.find("help").handler, net::auth::SecurityLevel::RequiresNothing));
+}
+
+const char *const messages[] = {
+    R"({"id":"1","type":"ping","msg":{}})",
+    R"({"id":"2","type":"help","msg":{}})",
+    R"({"id":"3","type":"get_entities","msg":{}})",
+    R"({"id":"4","type":"sys_stats","msg":{}})",
+    R"({"id":"5","type":"unknown","msg":{}})",
+};
+constexpr size_t num_messages = sizeof(messages) / sizeof(messages[0]);
+
+void test_handle_message() {
+  auto &protocol = test_protocol();
+  msg::EnvelopeLease envelopes(protocol.envelopes, msg::EnvelopeKind::TCP);
+  net::auth::AuthentificationContext user_context;
+  const int codes[num_messages] = {0, 0, 0, -10, -10};
+  for (size_t idx = 0; idx < num_messages; idx++) {
+    TEST_ASSERT(DeserializationError::Ok == deserializeJson(envelopes->in, messages[idx]));
+    utils::StringPrint output;
+    protocol.handleMessage(*envelopes, user_context, output);
+    DynamicJsonDocument response(4096);
+    TEST_ASSERT(DeserializationError::Ok == deserializeJson(response, output.str()));
+    TEST_ASSERT_EQUAL(codes[idx], response["code"].as<int>());
+  }
+}
+
+/**
+ * Benchmark of JsonLinesProtocol::handleMessage, which looks up the handler and clearance in the
+ * registry. For comparison, the dispatch step alone is measured with the registry and with the
+ * previous way, which copied the message type into a std::string and looked it up twice in a std::map.
+ */
+void test_benchmark_dispatch() {
+  constexpr size_t iterations = 100'000;
+  using clock = std::chrono::steady_clock;
+  auto &protocol = test_protocol();
+  auto &registry = Registry::get();
+  msg::EnvelopeLease envelopes(protocol.envelopes, msg::EnvelopeKind::TCP);
+  net::auth::AuthentificationContext user_context;
+  CountingPrint output;
+
+  auto start = clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    deserializeJson(envelopes->in, messages[i % num_messages]);
+    protocol.handleMessage(*envelopes, user_context, output);
+  }
+  std::chrono::duration<double> handle_time = clock::now() - start;
+  TEST_ASSERT(output.count > iterations);
+
+  const char *const msg_types[num_messages] = {"ping", "help", "get_entities", "sys_stats", "unknown"};
+  std::map<std::string, Registry::RegistryEntry> map;
+  for (auto &entry : detail::get_builtin_table())
+    map[std::string(entry.msg_type)] = registry.find(entry.msg_type);
+
+  size_t found = 0;
+  start = clock::now();
+  for (size_t i = 0; i < iterations * 10; i++) {
+    auto entry = registry.find(msg_types[i % num_messages]);
+    found += entry.handler and user_context.can_do(entry.clearance);
+  }
+  std::chrono::duration<double> table_time = clock::now() - start;
+  // Ping, help and get_entities have handlers in native builds
+  const size_t expected = iterations * 10 / num_messages * 3;
+  TEST_ASSERT_EQUAL(expected, found);
+
+  found = 0;
+  start = clock::now();
+  for (size_t i = 0; i < iterations * 10; i++) {
+    std::string msg_type = msg_types[i % num_messages];
+    auto handler_found = map.find(msg_type);
+    auto handler = handler_found != map.end() ? handler_found->second.handler : nullptr;
+    auto clearance_found = map.find(msg_type);
+    auto clearance = clearance_found != map.end() ? clearance_found->second.clearance
+                                                  : net::auth::SecurityLevel::RequiresNothing;
+    found += handler and user_context.can_do(clearance);
+  }
+  std::chrono::duration<double> map_time = clock::now() - start;
+  TEST_ASSERT_EQUAL(expected, found);
+
+  std::cout << "handleMessage: " << iterations / handle_time.count() << " messages/s, dispatch with the registry: "
+            << iterations * 10 / table_time.count() << " lookups/s, std::map with two lookups: "
+            << iterations * 10 / map_time.count() << " lookups/s" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_builtin_table_is_sorted);
+  RUN_TEST(test_registry_finds_builtins);
+  RUN_TEST(test_handle_message);
+  RUN_TEST(test_benchmark_dispatch);
+  UNITY_END();
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <algorithm>
+#include <string>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "protocol/envelope_pool.h"
+#include "protocol/protocol.h"
+
+using msg::EnvelopeKind;
+using msg::EnvelopeLease;
+using msg::EnvelopePool;
+
+// As configured by JsonLinesProtocol::init(), but with two TCP envelopes
+using msg::JsonLinesProtocol;
+constexpr size_t MAX_LINE_LENGTH = JsonLinesProtocol::MAX_LINE_LENGTH;
+const EnvelopePool::Shard shards[EnvelopePool::NUM_KINDS] = {
+    {1, JsonLinesProtocol::MAX_SERIAL_MESSAGE_SIZE, MAX_LINE_LENGTH},
+    {2, JsonLinesProtocol::MAX_TCP_MESSAGE_SIZE, MAX_LINE_LENGTH},
+    {1, JsonLinesProtocol::MAX_WEB_MESSAGE_SIZE, MAX_LINE_LENGTH},
+    {1, 0, 512},
+};
+
+EnvelopePool *pool;
+
+void setUp() {
+  pool = new EnvelopePool();
+  pool->init(shards);
+}
+
+void tearDown() { delete pool; }
+
+void test_shards() {
+  // About 40KiB as configured by JsonLinesProtocol::init(), plus the second TCP envelope
+  TEST_ASSERT_GREATER_OR_EQUAL(4096 + 2 * 16384 + 8192 + 4 * MAX_LINE_LENGTH + 512, pool->size());
+  TEST_ASSERT_LESS_THAN(4096 + 2 * 16384 + 8192 + 4 * MAX_LINE_LENGTH + 1024, pool->size());
+
+  auto serial = pool->acquire(EnvelopeKind::Serial);
+  TEST_ASSERT_NOT_NULL(serial);
+  TEST_ASSERT(EnvelopeKind::Serial == serial->kind);
+  TEST_ASSERT_EQUAL(JsonLinesProtocol::MAX_SERIAL_MESSAGE_SIZE, serial->in.capacity());
+  TEST_ASSERT_EQUAL(MAX_LINE_LENGTH, serial->out.capacity());
+  // A shard does not lend envelopes of another one
+  TEST_ASSERT_NULL(pool->acquire(EnvelopeKind::Serial));
+  TEST_ASSERT_EQUAL(1, pool->get_statistics(EnvelopeKind::Serial).exhausted);
+
+  auto tcp_1 = pool->acquire(EnvelopeKind::TCP), tcp_2 = pool->acquire(EnvelopeKind::TCP);
+  TEST_ASSERT_NOT_NULL(tcp_1);
+  TEST_ASSERT_NOT_NULL(tcp_2);
+  TEST_ASSERT(tcp_1 != tcp_2);
+  TEST_ASSERT_NULL(pool->acquire(EnvelopeKind::TCP));
+  TEST_ASSERT_EQUAL(2, pool->get_statistics(EnvelopeKind::TCP).in_use);
+
+  pool->release(tcp_1);
+  TEST_ASSERT_EQUAL(1, pool->get_statistics(EnvelopeKind::TCP).in_use);
+  TEST_ASSERT_EQUAL(2, pool->get_statistics(EnvelopeKind::TCP).peak);
+  TEST_ASSERT(tcp_1 == pool->acquire(EnvelopeKind::TCP));
+
+  auto broadcast = pool->acquire(EnvelopeKind::Broadcast);
+  TEST_ASSERT_NOT_NULL(broadcast);
+  TEST_ASSERT_EQUAL(0, broadcast->in.capacity());
+  TEST_ASSERT_EQUAL(512, broadcast->out.capacity());
+}
+
+void test_lease() {
+  {
+    EnvelopeLease outer(*pool, EnvelopeKind::Web);
+    TEST_ASSERT(outer);
+    // A connection handling messages while another one does, which has to wait
+    EnvelopeLease inner(*pool, EnvelopeKind::Web);
+    TEST_ASSERT_FALSE(inner);
+    TEST_ASSERT_EQUAL(1, pool->get_statistics(EnvelopeKind::Web).in_use);
+  }
+  TEST_ASSERT_EQUAL(0, pool->get_statistics(EnvelopeKind::Web).in_use);
+  TEST_ASSERT_EQUAL(1, pool->get_statistics(EnvelopeKind::Web).peak);
+  TEST_ASSERT_EQUAL(1, pool->get_statistics(EnvelopeKind::Web).exhausted);
+  EnvelopeLease again(*pool, EnvelopeKind::Web);
+  TEST_ASSERT(again);
+}
+
+void test_envelopes_are_independent() {
+  EnvelopeLease serial(*pool, EnvelopeKind::Serial), tcp(*pool, EnvelopeKind::TCP);
+  char serial_line[] = R"({"id":"1","type":"ping"})";
+  char tcp_line[] = R"({"id":"2","type":"help"})";
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(serial->in, serial_line));
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(tcp->in, tcp_line));
+  serial->out["type"] = "ping";
+  tcp->out["type"] = "help";
+
+  TEST_ASSERT_EQUAL_STRING("1", serial->in["id"]);
+  TEST_ASSERT_EQUAL_STRING("2", tcp->in["id"]);
+  TEST_ASSERT_EQUAL_STRING("ping", serial->out["type"]);
+  TEST_ASSERT_EQUAL_STRING("help", tcp->out["type"]);
+}
+
+// A set_circuit message with count elements like value
+std::string message(const std::string &value, size_t count) {
+  std::string line = R"({"id":"1","type":"set_circuit","msg":{"elements":[)" + value;
+  for (size_t idx = 1; idx < count; idx++)
+    line += "," + value;
+  return line + "]}}";
+}
+
+void test_message_size_limit() {
+  // Besides its elements, the message takes the slots of two objects with four members in total
+  const size_t max_elements = (JsonLinesProtocol::MAX_TCP_MESSAGE_SIZE - JSON_OBJECT_SIZE(4)) / JSON_ARRAY_SIZE(1);
+  for (auto value : {"-1", "0"}) {
+    auto line = message(value, max_elements);
+    TEST_ASSERT_LESS_THAN(MAX_LINE_LENGTH, line.size());
+    EnvelopeLease tcp(*pool, EnvelopeKind::TCP);
+    TEST_ASSERT(DeserializationError::Ok == deserializeJson(tcp->in, &line[0]));
+    TEST_ASSERT_EQUAL(max_elements, tcp->in["msg"]["elements"].size());
+
+    // Released envelopes are empty again
+    auto *envelopes = &*tcp;
+    pool->release(envelopes);
+    TEST_ASSERT_EQUAL(0, envelopes->in.memoryUsage());
+  }
+
+  // The limit is the size of the parsed message, not the length of the line
+  auto line = message("0", max_elements + 1);
+  TEST_ASSERT_LESS_THAN(MAX_LINE_LENGTH, line.size());
+  EnvelopeLease tcp(*pool, EnvelopeKind::TCP);
+  TEST_ASSERT(DeserializationError::NoMemory == deserializeJson(tcp->in, &line[0]));
+}
+
+void test_statistics() {
+  EnvelopeLease tcp(*pool, EnvelopeKind::TCP);
+  StaticJsonDocument<1024> stats;
+  pool->to_json(stats.to<JsonObject>());
+  TEST_ASSERT_EQUAL(pool->size(), stats["arena_size"].as<size_t>());
+  TEST_ASSERT_EQUAL(2, stats["tcp"]["slots"].as<int>());
+  TEST_ASSERT_EQUAL(1, stats["tcp"]["in_use"].as<int>());
+  TEST_ASSERT_EQUAL(1, stats["tcp"]["peak"].as<int>());
+  TEST_ASSERT_EQUAL(0, stats["serial"]["in_use"].as<int>());
+  TEST_ASSERT_EQUAL(512, stats["broadcast"]["out_size"].as<int>());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_shards);
+  RUN_TEST(test_lease);
+  RUN_TEST(test_envelopes_are_independent);
+  RUN_TEST(test_message_size_limit);
+  RUN_TEST(test_statistics);
+  UNITY_END();
+}
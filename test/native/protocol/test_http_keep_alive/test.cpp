@@ -0,0 +1,323 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "web/http_api.h"
+
+using web::HttpRequest;
+using web::HttpResult;
+
+// A connection which received some data, everything written to it is only sent on flush.
+struct FakeSocket {
+  static constexpr size_t MSS = 1460;
+
+  std::string received;
+  size_t received_pos = 0;
+  std::string pending, sent;
+  size_t segments = 0;
+
+  int available() { return received.size() - received_pos; }
+  int read(uint8_t *buf, size_t size) {
+    size = std::min(size, received.size() - received_pos);
+    received.copy(reinterpret_cast<char *>(buf), size, received_pos);
+    received_pos += size;
+    return size;
+  }
+
+  size_t writeFully(const uint8_t *buf, size_t size) {
+    pending.append(reinterpret_cast<const char *>(buf), size);
+    return size;
+  }
+  void flush() {
+    segments += (pending.size() + MSS - 1) / MSS;
+    sent += pending;
+    pending.clear();
+  }
+};
+
+// Answers each envelope with itself, like JsonLinesProtocol answers a message with its id.
+struct EchoApi {
+  std::string envelope;
+  size_t calls = 0;
+
+  bool accepts(const HttpRequest &request) { return request.is_path("/api"); }
+  void print_headers(Print &output) { output.print("Server: test\r\n"); }
+  bool parse(char *data, size_t length) {
+    calls++;
+    envelope.assign(data ? data : "", length);
+    return length and envelope.front() == '{' and envelope.back() == '}';
+  }
+  void reply(Print &output) {
+    if (envelope.empty()) {
+      output.print("{\"error\":\"Empty input\"}");
+    } else if (envelope.front() != '{' or envelope.back() != '}') {
+      output.print("{\"error\":\"Error parsing JSON\"}");
+    } else {
+      output.print("{\"echo\":");
+      output.print(envelope.c_str());
+      output.print("}");
+    }
+  }
+};
+
+// A response as the client sees it, with the chunked body put together
+struct Response {
+  std::string status, connection, transfer_encoding, content_type, body;
+};
+
+// Takes the next complete response from what was sent
+bool parse_response(std::string &sent, Response &response) {
+  auto head_end = sent.find("\r\n\r\n");
+  if (head_end == std::string::npos)
+    return false;
+  response = Response();
+  auto head = sent.substr(0, head_end + 2);
+  size_t pos = head.find("\r\n");
+  response.status = head.substr(9, pos - 9);
+  for (pos += 2; pos < head.size();) {
+    auto line_end = head.find("\r\n", pos);
+    auto line = head.substr(pos, line_end - pos);
+    auto colon = line.find(": ");
+    auto name = line.substr(0, colon), value = line.substr(colon + 2);
+    if (name == "Connection")
+      response.connection = value;
+    else if (name == "Transfer-Encoding")
+      response.transfer_encoding = value;
+    else if (name == "Content-Type")
+      response.content_type = value;
+    else
+      TEST_ASSERT(name == "Server" or name == "Content-Length");
+    pos = line_end + 2;
+  }
+
+  pos = head_end + 4;
+  if (response.transfer_encoding == "chunked") {
+    while (true) {
+      auto size_end = sent.find("\r\n", pos);
+      if (size_end == std::string::npos)
+        return false;
+      auto size = std::stoul(sent.substr(pos, size_end - pos), nullptr, 16);
+      pos = size_end + 2;
+      if (sent.size() < pos + size + 2)
+        return false;
+      TEST_ASSERT_EQUAL_STRING("\r\n", sent.substr(pos + size, 2).c_str());
+      response.body += sent.substr(pos, size);
+      pos += size + 2;
+      if (!size)
+        break;
+    }
+  } else if (response.connection == "close") {
+    response.body = sent.substr(pos);
+    pos = sent.size();
+  }
+  sent.erase(0, pos);
+  return true;
+}
+
+std::string request(const std::string &body, const char *content_type = "application/json",
+                    const char *extra_headers = "") {
+  return std::string("POST /api HTTP/1.1\r\nHost: lucidac\r\nContent-Type: ") + content_type +
+         "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" + extra_headers + "\r\n" + body;
+}
+
+std::string envelope(size_t id) { return "{\"id\":" + std::to_string(id) + ",\"type\":\"ping\",\"msg\":{}}"; }
+
+// Large enough for a 4096 byte envelope and the request head, like LucidacHttpClient
+using Reader = web::HttpRequestReader<4096 + 1024>;
+Reader *reader;
+FakeSocket *connection;
+EchoApi *api;
+
+HttpResult process() { return web::process_http_requests(*connection, *reader, 10000, *api); }
+
+void setUp() {
+  reader = new Reader();
+  connection = new FakeSocket();
+  api = new EchoApi();
+}
+
+void tearDown() {
+  delete reader;
+  delete connection;
+  delete api;
+}
+
+void test_sequential_calls() {
+  auto start = std::chrono::steady_clock::now();
+  constexpr size_t num_calls = 1000;
+  Response response;
+  for (size_t id = 0; id < num_calls; id++) {
+    connection->received += request(envelope(id));
+    TEST_ASSERT(HttpResult::KeepAlive == process());
+    TEST_ASSERT(parse_response(connection->sent, response));
+    TEST_ASSERT_EQUAL_STRING("200 OK", response.status.c_str());
+    TEST_ASSERT_EQUAL_STRING("keep-alive", response.connection.c_str());
+    TEST_ASSERT_EQUAL_STRING("application/json", response.content_type.c_str());
+    TEST_ASSERT_EQUAL_STRING(("{\"echo\":" + envelope(id) + "}").c_str(), response.body.c_str());
+    TEST_ASSERT(connection->sent.empty());
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << num_calls << " calls on one connection: " << elapsed.count() * 1e6 / num_calls << " us per call, "
+            << static_cast<float>(connection->segments) / num_calls << " TCP segments per response" << std::endl;
+  TEST_ASSERT_EQUAL(num_calls, api->calls);
+  // Each response is a single segment
+  TEST_ASSERT_EQUAL(num_calls, connection->segments);
+  TEST_ASSERT_EQUAL(0, connection->available());
+}
+
+void test_pipelined_requests() {
+  constexpr size_t num_calls = 20;
+  for (size_t id = 0; id < num_calls; id++)
+    connection->received += request(envelope(id));
+  // The head of the next request is incomplete
+  connection->received += "POST /api HTTP/1.1\r\nContent-";
+
+  TEST_ASSERT(HttpResult::KeepAlive == process());
+  TEST_ASSERT_EQUAL(num_calls, api->calls);
+  // The responses are sent together
+  TEST_ASSERT_LESS_THAN(num_calls, connection->segments);
+  Response response;
+  for (size_t id = 0; id < num_calls; id++) {
+    TEST_ASSERT(parse_response(connection->sent, response));
+    TEST_ASSERT_EQUAL_STRING(("{\"echo\":" + envelope(id) + "}").c_str(), response.body.c_str());
+  }
+  TEST_ASSERT(connection->sent.empty());
+
+  connection->received += "Length: 2\r\n\r\n{}";
+  TEST_ASSERT(HttpResult::KeepAlive == process());
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("{\"echo\":{}}", response.body.c_str());
+}
+
+void test_batch_body() {
+  std::string body;
+  for (size_t id = 0; id < 100; id++)
+    body += envelope(id) + (id % 2 ? "\r\n" : "\n");
+  // Blank lines are no envelopes, the last one needs no newline
+  body += "\n  \n" + envelope(100);
+  connection->received += request(body, "application/x-ndjson");
+
+  // The body arrives in small pieces, so its response spans several calls
+  auto received = connection->received;
+  connection->received.clear();
+  for (size_t pos = 0; pos < received.size(); pos += 100) {
+    connection->received += received.substr(pos, 100);
+    TEST_ASSERT(HttpResult::KeepAlive == process());
+  }
+
+  Response response;
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("200 OK", response.status.c_str());
+  TEST_ASSERT_EQUAL_STRING("application/x-ndjson", response.content_type.c_str());
+  std::string expected;
+  for (size_t id = 0; id <= 100; id++)
+    expected += "{\"echo\":" + envelope(id) + "}\n";
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), response.body.c_str());
+  TEST_ASSERT(connection->sent.empty());
+}
+
+void test_batch_lines_longer_than_the_buffer_are_dropped() {
+  std::string body = envelope(0) + "\n{\"long\":\"" + std::string(Reader::size() + 100, 'x') + "\"}\n" + envelope(1);
+  connection->received += request(body, "application/jsonl");
+  while (connection->available())
+    TEST_ASSERT(HttpResult::KeepAlive == process());
+
+  Response response;
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING(("{\"echo\":" + envelope(0) + "}\n{\"echo\":" + envelope(1) + "}\n").c_str(),
+                           response.body.c_str());
+  TEST_ASSERT_EQUAL(1, reader->dropped());
+}
+
+void test_connection_close() {
+  connection->received += request(envelope(1), "application/json", "Connection: close\r\n");
+  connection->received += request(envelope(2));
+  TEST_ASSERT(HttpResult::Close == process());
+  TEST_ASSERT_EQUAL(1, api->calls);
+  Response response;
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("close", response.connection.c_str());
+  TEST_ASSERT_EQUAL_STRING("chunked", response.transfer_encoding.c_str());
+}
+
+void test_http_1_0() {
+  connection->received += "POST /api HTTP/1.0\r\nContent-Length: 4\r\nConnection: keep-alive\r\n\r\n{\"\"}";
+  TEST_ASSERT(HttpResult::Close == process());
+  // The body is delimited by closing the connection
+  Response response;
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("close", response.connection.c_str());
+  TEST_ASSERT_EQUAL_STRING("", response.transfer_encoding.c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"echo\":{\"\"}}", response.body.c_str());
+}
+
+void test_errors() {
+  connection->received += request("");
+  connection->received += request("no json");
+  connection->received += "OPTIONS /api HTTP/1.1\r\nOrigin: http://localhost\r\n\r\n";
+  connection->received += "DELETE /api?id=1 HTTP/1.1\r\n\r\n";
+  TEST_ASSERT(HttpResult::KeepAlive == process());
+
+  Response response;
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("400 Bad Request", response.status.c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"error\":\"Empty input\"}", response.body.c_str());
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("400 Bad Request", response.status.c_str());
+  TEST_ASSERT_EQUAL_STRING("keep-alive", response.connection.c_str());
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("204 No Content", response.status.c_str());
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("405 Method Not Allowed", response.status.c_str());
+  TEST_ASSERT(connection->sent.empty());
+
+  // Envelopes must fit into the buffer
+  connection->received += request(std::string(Reader::size() + 1, ' '));
+  TEST_ASSERT(HttpResult::Close == process());
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("413 Content Too Large", response.status.c_str());
+  TEST_ASSERT_EQUAL_STRING("close", response.connection.c_str());
+
+  reader->clear();
+  connection->received += "GET /api HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+  TEST_ASSERT(HttpResult::Close == process());
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("400 Bad Request", response.status.c_str());
+}
+
+void test_other_requests_are_handed_over() {
+  connection->received += request(envelope(1));
+  const std::string other = "GET /index.html HTTP/1.1\r\nHost: lucidac\r\n\r\n";
+  connection->received += other;
+  TEST_ASSERT(HttpResult::Other == process());
+
+  // The response to the first request is sent, the second one is left as it was received
+  Response response;
+  TEST_ASSERT(parse_response(connection->sent, response));
+  TEST_ASSERT_EQUAL_STRING("200 OK", response.status.c_str());
+  TEST_ASSERT_EQUAL_STRING(other.c_str(), std::string(reader->unread_data(), reader->unread_length()).c_str());
+  TEST_ASSERT_EQUAL_STRING("/index.html", std::string(reader->request().path, reader->request().path_length).c_str());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sequential_calls);
+  RUN_TEST(test_pipelined_requests);
+  RUN_TEST(test_batch_body);
+  RUN_TEST(test_batch_lines_longer_than_the_buffer_are_dropped);
+  RUN_TEST(test_connection_close);
+  RUN_TEST(test_http_1_0);
+  RUN_TEST(test_errors);
+  RUN_TEST(test_other_requests_are_handed_over);
+  UNITY_END();
+}
@@ -0,0 +1,172 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "protocol/pipeline.h"
+
+using clock_type = std::chrono::steady_clock;
+
+// A connection which received some data. Everything written to it is only sent on flush,
+// where the time is noted to measure the latency of each response.
+struct FakeSocket {
+  static constexpr size_t MSS = 1460;
+
+  std::string received;
+  size_t received_pos = 0;
+  std::string pending, sent;
+  size_t writes = 0, segments = 0;
+  std::vector<clock_type::time_point> response_times;
+
+  int available() { return received.size() - received_pos; }
+  int read(uint8_t *buf, size_t size) {
+    size = std::min(size, received.size() - received_pos);
+    received.copy(reinterpret_cast<char *>(buf), size, received_pos);
+    received_pos += size;
+    return size;
+  }
+
+  size_t writeFully(const uint8_t *buf, size_t size) {
+    writes++;
+    pending.append(reinterpret_cast<const char *>(buf), size);
+    return size;
+  }
+  void flush() {
+    if (pending.empty())
+      return;
+    segments += (pending.size() + MSS - 1) / MSS;
+    auto now = clock_type::now();
+    response_times.insert(response_times.end(), std::count(pending.begin(), pending.end(), '\n'), now);
+    sent += pending;
+    pending.clear();
+  }
+};
+
+DynamicJsonDocument envelope_in(4096), envelope_out(1024);
+utils::LineBuffer<4096> line_buffer;
+
+// Parses a message and answers with its id, like JsonLinesProtocol does
+void handle_line(char *line, Print &output) {
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(envelope_in, line));
+  auto out = envelope_out.to<JsonObject>();
+  out["id"] = envelope_in["id"].as<const char *>();
+  out["type"] = envelope_in["type"].as<const char *>();
+  out.createNestedObject("msg");
+  out["code"] = 0;
+  serializeJson(out, output);
+  output.write('\n');
+}
+
+std::string make_requests(size_t count) {
+  std::string requests;
+  for (size_t idx = 0; idx < count; idx++)
+    requests += R"({"id":"request-)" + std::to_string(idx) +
+                R"(","type":"set_circuit","msg":{"entity":["04-E9-E5-00-00-01","0"],"config":{)"
+                R"("/U":{"outputs":[0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15]},)"
+                R"("/I":{"outputs":{"0":[0,1],"1":2,"5":[3,4,5]}}}}})"
+                "\n";
+  return requests;
+}
+
+void setUp() { line_buffer.clear(); }
+
+void tearDown() {}
+
+void test_all_pipelined_messages_in_one_pass() {
+  constexpr size_t count = 100;
+  FakeSocket socket{make_requests(count)};
+
+  TEST_ASSERT(msg::process_lines(socket, line_buffer, UINT32_MAX, handle_line));
+
+  TEST_ASSERT_EQUAL(count, socket.response_times.size());
+  TEST_ASSERT_FALSE(line_buffer.has_line());
+  // Responses are in order and sent in full segments
+  size_t pos = 0;
+  for (size_t idx = 0; idx < count; idx++) {
+    pos = socket.sent.find("\"request-" + std::to_string(idx) + "\"", pos);
+    TEST_ASSERT(pos != std::string::npos);
+  }
+  auto full_segments = (socket.sent.size() + FakeSocket::MSS - 1) / FakeSocket::MSS;
+  TEST_ASSERT_EQUAL(full_segments, socket.segments);
+  TEST_ASSERT_EQUAL(full_segments, socket.writes);
+}
+
+void test_budget_leaves_messages_for_later() {
+  FakeSocket socket{make_requests(3)};
+
+  // At least one message is handled, even without any budget
+  TEST_ASSERT(msg::process_lines(socket, line_buffer, 0, handle_line));
+  TEST_ASSERT_EQUAL(1, socket.response_times.size());
+  TEST_ASSERT(line_buffer.has_line());
+
+  TEST_ASSERT(msg::process_lines(socket, line_buffer, 0, handle_line));
+  TEST_ASSERT(msg::process_lines(socket, line_buffer, 0, handle_line));
+  TEST_ASSERT_EQUAL(3, socket.response_times.size());
+  TEST_ASSERT_FALSE(line_buffer.has_line());
+}
+
+void test_failed_connection() {
+  struct FailingSocket : FakeSocket {
+    size_t writeFully(const uint8_t *buf, size_t size) { return 0; }
+  } socket;
+  socket.received = make_requests(1);
+  TEST_ASSERT_FALSE(msg::process_lines(socket, line_buffer, UINT32_MAX, handle_line));
+}
+
+/**
+ * Latency of pipelined requests, which all arrive at once. Each round of the main loop
+ * also does other work (serial, web server, out of band handlers), which is simulated
+ * by busy waiting. Handling one message per round is compared to handling all of them.
+ **/
+void measure_latency(const char *name, uint32_t budget_us, size_t &rounds, std::chrono::duration<double> &max) {
+  constexpr size_t count = 100;
+  constexpr auto other_work = std::chrono::microseconds(100);
+  FakeSocket socket{make_requests(count)};
+  line_buffer.clear();
+
+  auto start = clock_type::now();
+  for (rounds = 0; socket.response_times.size() < count; rounds++) {
+    TEST_ASSERT(msg::process_lines(socket, line_buffer, budget_us, handle_line));
+    for (auto until = clock_type::now() + other_work; clock_type::now() < until;)
+      ;
+  }
+
+  std::chrono::duration<double> sum{0};
+  max = {};
+  for (auto time : socket.response_times) {
+    sum += time - start;
+    max = std::max<std::chrono::duration<double>>(max, time - start);
+  }
+  std::cout << name << ": " << rounds << " rounds, " << socket.segments << " segments, latency mean "
+            << sum.count() / count * 1e6 << " us, max " << max.count() * 1e6 << " us" << std::endl;
+}
+
+void test_latency_under_pipelining() {
+  size_t single_rounds, pipelined_rounds;
+  std::chrono::duration<double> single_max, pipelined_max;
+  measure_latency("One message per round", 0, single_rounds, single_max);
+  measure_latency("Pipelined", 10000, pipelined_rounds, pipelined_max);
+
+  TEST_ASSERT_EQUAL(100, single_rounds);
+  TEST_ASSERT_LESS_THAN(single_rounds, pipelined_rounds);
+  TEST_ASSERT(pipelined_max < single_max);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_all_pipelined_messages_in_one_pass);
+  RUN_TEST(test_budget_leaves_messages_for_later);
+  RUN_TEST(test_failed_connection);
+  RUN_TEST(test_latency_under_pipelining);
+  UNITY_END();
+}
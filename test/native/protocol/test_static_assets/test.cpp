@@ -0,0 +1,135 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "web/assets.h"
+
+// An entry as generated by lib/communication/assets/download-and-stage.sh
+const uint8_t content[] = {0x1f, 0x8b, 0x08, 0x00, '\r', '\n'};
+const char validators[] = "Last-Modified: Mon, 07 Oct 2024 10:00:00 GMT\r\n"
+                          "Cache-Control: max-age=604800\r\n"
+                          "ETag: \"513cd5d2fe5b69f6\"\r\n";
+const char headers[] = "Content-Type: text/html\r\n"
+                       "Content-Encoding: gzip\r\n"
+                       "Last-Modified: Mon, 07 Oct 2024 10:00:00 GMT\r\n"
+                       "Cache-Control: max-age=604800\r\n"
+                       "ETag: \"513cd5d2fe5b69f6\"\r\n";
+const web::StaticFile file{"index.html", content, sizeof(content), headers, validators, "\"513cd5d2fe5b69f6\"",
+                           1728295200};
+
+/**
+ * Records what an awot::Response sends, including its quirk of appending CRLF to everything written
+ * after the headers, unless it knows the body is delimited by Content-Length (see aWOT.cpp).
+ **/
+struct FakeAwotResponse {
+  std::string sent;
+  std::vector<std::pair<const char *, const char *>> headers;
+  int status_code = 0;
+  bool content_length_set = false, headers_sent = false;
+
+  void status(int code) {
+    status_code = code;
+    sent += "HTTP/1.1 " + std::to_string(code) + (code == 304 ? " Not Modified\r\n" : " OK\r\n");
+    if (code == 304)
+      content_length_set = true;
+  }
+  void set(const char *name, const char *value) {
+    headers.emplace_back(name, value);
+    if (std::string(name) == "Content-Length")
+      content_length_set = true;
+  }
+  void beginHeaders() {
+    for (auto &header : headers)
+      sent += std::string(header.first) + ": " + header.second + "\r\n";
+  }
+  void printP(const char *text) { sent += text; }
+  void endHeaders() {
+    sent += "\r\n";
+    headers_sent = true;
+  }
+  size_t write(uint8_t *buffer, size_t length) {
+    sent.append(reinterpret_cast<char *>(buffer), length);
+    if (headers_sent and !content_length_set)
+      sent += "\r\n";
+    return length;
+  }
+  void flush() {}
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_if_none_match() {
+  TEST_ASSERT(file.matches("\"513cd5d2fe5b69f6\""));
+  TEST_ASSERT(file.matches("W/\"513cd5d2fe5b69f6\""));
+  TEST_ASSERT(file.matches("\"0f668e0cbb3da393\", \"513cd5d2fe5b69f6\""));
+  TEST_ASSERT(file.matches("*"));
+
+  TEST_ASSERT_FALSE(file.matches(nullptr));
+  TEST_ASSERT_FALSE(file.matches(""));
+  TEST_ASSERT_FALSE(file.matches("\"0f668e0cbb3da393\""));
+  // Only the complete, quoted entity tag matches
+  TEST_ASSERT_FALSE(file.matches("\"513cd5d2fe5b69f\""));
+  TEST_ASSERT_FALSE(file.matches("513cd5d2fe5b69f6"));
+}
+
+void test_header_block() {
+  // The validators are part of the headers, and name the entity tag
+  TEST_ASSERT_NOT_NULL(strstr(file.http_headers, file.http_validators));
+  TEST_ASSERT_NOT_NULL(strstr(file.http_validators, file.etag));
+
+  // Complete header lines, without the blank line ending the head
+  for (auto block : {file.http_headers, file.http_validators}) {
+    std::string lines(block);
+    TEST_ASSERT_EQUAL_STRING("\r\n", lines.substr(lines.size() - 2).c_str());
+    for (size_t pos = 0; pos < lines.size();) {
+      auto end = lines.find("\r\n", pos);
+      auto line = lines.substr(pos, end - pos);
+      TEST_ASSERT_NOT_EQUAL(std::string::npos, line.find(": "));
+      TEST_ASSERT_EQUAL(std::string::npos, line.find('\n'));
+      // Left to the web server, which has to know about it
+      TEST_ASSERT_NOT_EQUAL(0, line.find("Content-Length"));
+      pos = end + 2;
+    }
+  }
+}
+
+void test_response() {
+  FakeAwotResponse res;
+  web::write_static_response(res, file, false, "test");
+  std::string expected = std::string("HTTP/1.1 200 OK\r\n"
+                                     "Server: test\r\n"
+                                     "Connection: close\r\n"
+                                     "Content-Length: 6\r\n") +
+                         headers + "\r\n" + std::string(reinterpret_cast<const char *>(content), sizeof(content));
+  // Exactly the content follows the head, without anything appended
+  TEST_ASSERT_EQUAL(expected.size(), res.sent.size());
+  TEST_ASSERT(expected == res.sent);
+}
+
+void test_not_modified_response() {
+  FakeAwotResponse res;
+  web::write_static_response(res, file, true, "test");
+  std::string expected = std::string("HTTP/1.1 304 Not Modified\r\n"
+                                     "Server: test\r\n"
+                                     "Connection: close\r\n") +
+                         validators + "\r\n";
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), res.sent.c_str());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_if_none_match);
+  RUN_TEST(test_header_block);
+  RUN_TEST(test_response);
+  RUN_TEST(test_not_modified_response);
+  UNITY_END();
+}
@@ -0,0 +1,378 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "test_common.h"
+#include "utils/StringPrint.h"
+#include "web/frame_writer.h"
+#include "web/message_reader.h"
+#include "web/websocket_api.h"
+
+using namespace websockets::internals;
+using Result = web::WebsocketReadResult;
+
+// A connection which received some data, of which it returns at most chunk_size bytes per read
+struct FakeSocket {
+  std::string received;
+  size_t pos = 0, chunk_size = 1460;
+  std::string sent;
+  size_t writes = 0;
+
+  int available() { return received.size() - pos; }
+  int read(uint8_t *buf, size_t size) {
+    size = std::min({size, received.size() - pos, chunk_size});
+    received.copy(reinterpret_cast<char *>(buf), size, pos);
+    pos += size;
+    return size;
+  }
+  size_t writeFully(const uint8_t *buf, size_t size) {
+    writes++;
+    sent.append(reinterpret_cast<const char *>(buf), size);
+    return size;
+  }
+};
+
+// A frame as a browser sends it, masked with some key
+std::string client_frame(uint8_t opcode, const std::string &payload, bool fin = true, bool masked = true) {
+  const char key[] = "\x37\xfa\x21\x3d";
+  uint8_t header[MAX_HEADER_SIZE];
+  auto header_size = WriteHeader(header, payload.size(), opcode, fin, masked ? key : nullptr);
+  std::string frame(reinterpret_cast<char *>(header), header_size);
+  for (size_t idx = 0; idx < payload.size(); idx++)
+    frame += masked ? static_cast<char>(payload[idx] ^ key[idx % 4]) : payload[idx];
+  return frame;
+}
+
+struct Frame {
+  bool fin;
+  uint8_t opcode;
+  std::string payload;
+};
+
+// Splits what a server sent into its frames, which are never masked
+std::vector<Frame> server_frames(const std::string &data) {
+  std::vector<Frame> frames;
+  for (size_t pos = 0; pos < data.size();) {
+    auto header = reinterpret_cast<const uint8_t *>(data.data() + pos);
+    TEST_ASSERT_EQUAL_HEX8(0, header[1] & 0x80);
+    uint64_t length = header[1] & 0x7F;
+    size_t header_size = 2;
+    if (length == 126) {
+      length = (header[2] << 8) | header[3];
+      header_size = 4;
+    } else if (length == 127) {
+      length = 0;
+      for (size_t i = 0; i < 8; i++)
+        length = (length << 8) | header[2 + i];
+      header_size = 10;
+    }
+    frames.push_back({static_cast<bool>(header[0] & 0x80), static_cast<uint8_t>(header[0] & 0x0F),
+                      data.substr(pos + header_size, length)});
+    pos += header_size + length;
+  }
+  return frames;
+}
+
+web::WebsocketMessageReader<4096> *reader;
+
+void test_messages_in_small_chunks() {
+  const auto data = client_frame(ContentType::Text, "{\"type\":\"ping\"}") +
+                    client_frame(ContentType::Text, std::string(300, 'x'));
+  FakeSocket socket;
+  socket.chunk_size = 7;
+
+  // The data arrives a few bytes at a time, messages are complete as soon as their last byte is there
+  std::vector<std::string> messages;
+  for (size_t end = 5; end < data.size() + 5; end += 5) {
+    socket.received = data.substr(0, end);
+    for (Result result; (result = reader->read(socket)) != Result::None;) {
+      TEST_ASSERT(Result::Message == result);
+      TEST_ASSERT_EQUAL(ContentType::Text, reader->message_type());
+      // Null-terminated for parsing in place
+      TEST_ASSERT_EQUAL(reader->length(), strlen(reader->data()));
+      messages.emplace_back(reader->data(), reader->length());
+    }
+    TEST_ASSERT_EQUAL(socket.received.size(), socket.pos);
+  }
+  TEST_ASSERT_EQUAL(2, messages.size());
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"ping\"}", messages[0].c_str());
+  TEST_ASSERT_EQUAL_STRING(std::string(300, 'x').c_str(), messages[1].c_str());
+}
+
+void test_fragments_with_control_frame_in_between() {
+  FakeSocket socket{client_frame(ContentType::Text, "abc", false) + client_frame(ContentType::Ping, "hi") +
+                    client_frame(ContentType::Continuation, "def", false) +
+                    client_frame(ContentType::Continuation, "ghi")};
+
+  TEST_ASSERT(Result::Ping == reader->read(socket));
+  TEST_ASSERT_EQUAL_STRING("hi", reader->data());
+  TEST_ASSERT(Result::Message == reader->read(socket));
+  TEST_ASSERT_EQUAL(9, reader->length());
+  TEST_ASSERT_EQUAL_STRING("abcdefghi", reader->data());
+}
+
+void test_close_frames() {
+  FakeSocket socket{client_frame(ContentType::Close, std::string("\x03\xe8", 2)) +
+                    client_frame(ContentType::Close, "")};
+  TEST_ASSERT(Result::Close == reader->read(socket));
+  TEST_ASSERT_EQUAL(1000, reader->close_code());
+  TEST_ASSERT(Result::Close == reader->read(socket));
+  TEST_ASSERT_EQUAL(1005, reader->close_code());
+}
+
+void test_maximum_message_size() {
+  web::WebsocketMessageReader<16> small_reader;
+  FakeSocket socket{client_frame(ContentType::Text, std::string(16, 'a')) +
+                    client_frame(ContentType::Text, std::string(17, 'b'))};
+  TEST_ASSERT(Result::Message == small_reader.read(socket));
+  TEST_ASSERT_EQUAL(16, small_reader.length());
+
+  // Refused after its header, without reading the payload, and for good
+  TEST_ASSERT(Result::MessageTooBig == small_reader.read(socket));
+  TEST_ASSERT_EQUAL(17, socket.available());
+  TEST_ASSERT(Result::MessageTooBig == small_reader.read(socket));
+
+  // Fragments count together
+  small_reader.clear();
+  socket = FakeSocket{client_frame(ContentType::Text, std::string(10, 'a'), false) +
+                      client_frame(ContentType::Continuation, std::string(10, 'a'))};
+  TEST_ASSERT(Result::MessageTooBig == small_reader.read(socket));
+}
+
+void test_protocol_errors() {
+  const std::string frames[] = {
+      client_frame(ContentType::Text, "unmasked", true, false),
+      client_frame(ContentType::Continuation, "nothing to continue"),
+      client_frame(ContentType::Ping, "fragmented", false),
+      client_frame(ContentType::Ping, std::string(126, 'p')),
+      client_frame(0x3, "reserved opcode"),
+      client_frame(ContentType::Text, "abc", false) + client_frame(ContentType::Text, "def"),
+  };
+  for (auto &frame : frames) {
+    reader->clear();
+    FakeSocket socket{frame};
+    TEST_ASSERT(Result::ProtocolError == reader->read(socket));
+  }
+}
+
+void test_frame_writer() {
+  FakeSocket socket;
+  {
+    web::WebsocketFrameWriter<FakeSocket> output(socket);
+    output.print("{\"type\":\"ping\"}");
+    TEST_ASSERT(output.send());
+  }
+  auto frames = server_frames(socket.sent);
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT(frames[0].fin);
+  TEST_ASSERT_EQUAL(ContentType::Text, frames[0].opcode);
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"ping\"}", frames[0].payload.c_str());
+
+  // Longer messages are fragmented, each frame written in one piece
+  socket = FakeSocket{};
+  std::string long_message;
+  for (size_t idx = 0; long_message.size() < 5000; idx++)
+    long_message += std::to_string(idx) + ",";
+  {
+    web::WebsocketFrameWriter<FakeSocket> output(socket);
+    output.print(long_message.c_str());
+    TEST_ASSERT(output.send());
+  }
+  frames = server_frames(socket.sent);
+  const size_t num_frames = (long_message.size() + 1456 - 1) / 1456;
+  TEST_ASSERT_EQUAL(num_frames, frames.size());
+  TEST_ASSERT_EQUAL(num_frames, socket.writes);
+  std::string payload;
+  for (size_t idx = 0; idx < frames.size(); idx++) {
+    TEST_ASSERT_EQUAL(idx == frames.size() - 1, frames[idx].fin);
+    TEST_ASSERT_EQUAL(idx ? ContentType::Continuation : ContentType::Text, frames[idx].opcode);
+    payload += frames[idx].payload;
+  }
+  TEST_ASSERT_EQUAL_STRING(long_message.c_str(), payload.c_str());
+}
+
+// Indents JSON like json.dumps(indent=4) of a Python client. Strings must not contain structural characters.
+std::string indent(const std::string &json) {
+  std::string out;
+  size_t depth = 0;
+  auto newline = [&] {
+    out += '\n';
+    out.append(4 * depth, ' ');
+  };
+  for (char c : json) {
+    if (c == '{' or c == '[') {
+      out += c;
+      depth++;
+      newline();
+    } else if (c == '}' or c == ']') {
+      depth--;
+      newline();
+      out += c;
+    } else if (c == ',') {
+      out += c;
+      newline();
+    } else if (c == ':') {
+      out += ": ";
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// A set_circuit message of about 4KB, with coefficients in full precision
+std::string make_set_circuit() {
+  std::string config = R"("/U":{"outputs":[)";
+  for (int idx = 0; idx < 32; idx++)
+    config += std::to_string(idx % 16) + (idx < 31 ? "," : "]},");
+  config += R"("/C":{"elements":[)";
+  for (int idx = 0; idx < 32; idx++) {
+    char element[32];
+    snprintf(element, sizeof(element), "%.16g", ((idx * 7919) % 2000 - 1000) / 1000.0 * 0.987654321);
+    config += element + std::string(idx < 31 ? "," : "]},");
+  }
+  config += R"("/I":{"outputs":{)";
+  for (int idx = 0; idx < 15; idx++)
+    config += "\"" + std::to_string(idx) + "\":[" + std::to_string(2 * idx) + "," + std::to_string(2 * idx + 1) +
+              (idx < 14 ? "]," : "]}}");
+  return indent(R"({"id":"8a4e3c1e-6f50-4a8e-9d43-1b2f6f2a7c02","type":"set_circuit","msg":{)"
+                R"("entity":["04-E9-E5-00-00-01","0"],"config":{)" +
+                config + "}}}");
+}
+
+net::auth::AuthentificationContext user_context;
+
+// What LucidacWebsocketsClient does with the messages of a client, see web/server.cpp
+void round_trip(FakeSocket &socket) {
+  TEST_ASSERT_EQUAL(0, web::process_websocket_input(socket, socket, *reader, user_context));
+}
+
+// What the websockets library and JsonLinesProtocol::process_string_input did before:
+// the payload is read into a std::string, unmasked, parsed from there and the response is printed
+// into another std::string, which is joined with the frame header into yet another one.
+void round_trip_with_strings(FakeSocket &socket) {
+  uint8_t header[MAX_HEADER_SIZE];
+  socket.read(header, 2);
+  size_t length = header[1] & 0x7F;
+  if (length == 126) {
+    socket.read(header + 2, 2);
+    length = (header[2] << 8) | header[3];
+  }
+  uint8_t mask[4];
+  socket.read(mask, 4);
+  std::string payload(length, '\0');
+  uint8_t buffer[1024];
+  for (size_t done = 0; done < length;) {
+    auto count = socket.read(buffer, std::min(sizeof(buffer), length - done));
+    for (int i = 0; i < count; i++)
+      payload[done + i] = static_cast<char>(buffer[i]);
+    done += count;
+  }
+  for (size_t i = 0; i < length; i++)
+    payload[i] = payload[i] ^ mask[i % 4];
+
+  auto &protocol = msg::JsonLinesProtocol::get();
+  msg::EnvelopeLease envelopes(protocol.envelopes, msg::EnvelopeKind::Web);
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(envelopes->in, payload));
+  utils::StringPrint response;
+  protocol.handleMessage(*envelopes, user_context, response);
+  auto header_size = WriteHeader(header, response.str().size(), ContentType::Text, true);
+  std::string frame(reinterpret_cast<char *>(header), header_size);
+  frame += response.str();
+  socket.writeFully(reinterpret_cast<const uint8_t *>(frame.data()), frame.size());
+}
+
+void test_process_websocket_input() {
+  FakeSocket socket{client_frame(ContentType::Ping, "hi") + client_frame(ContentType::Text, "{\"type\":\"ping\"}") +
+                    client_frame(ContentType::Binary, "ignored") + client_frame(ContentType::Text, "{no json") +
+                    client_frame(ContentType::Close, std::string("\x03\xe8", 2))};
+  TEST_ASSERT_EQUAL(1000, web::process_websocket_input(socket, socket, *reader, user_context));
+
+  auto frames = server_frames(socket.sent);
+  TEST_ASSERT_EQUAL(3, frames.size());
+  TEST_ASSERT_EQUAL(ContentType::Pong, frames[0].opcode);
+  TEST_ASSERT_EQUAL_STRING("hi", frames[0].payload.c_str());
+  TEST_ASSERT_EQUAL(ContentType::Text, frames[1].opcode);
+  TEST_ASSERT_EQUAL(0, frames[1].payload.find(R"({"id":"","type":"ping","msg":{"micros":)"));
+  TEST_ASSERT_EQUAL(0, frames[2].payload.find("{'error':'Error while parsing JSON"));
+
+  // Connections are closed on errors, with the status code telling why
+  web::WebsocketMessageReader<16> small_reader;
+  socket = FakeSocket{client_frame(ContentType::Text, std::string(17, 'b'))};
+  TEST_ASSERT_EQUAL(1009, web::process_websocket_input(socket, socket, small_reader, user_context));
+  reader->clear();
+  socket = FakeSocket{client_frame(ContentType::Continuation, "nothing to continue")};
+  TEST_ASSERT_EQUAL(1002, web::process_websocket_input(socket, socket, *reader, user_context));
+}
+
+template <class RoundTrip> void benchmark(const char *name, RoundTrip run, bool allocation_free) {
+  const size_t rounds = 1000;
+  FakeSocket socket{client_frame(ContentType::Text, make_set_circuit())};
+  // Once before measuring, such that the socket's own buffers have grown already
+  run(socket);
+  auto frames = server_frames(socket.sent);
+  TEST_ASSERT_EQUAL(1, frames.size());
+  auto &response = frames[0].payload;
+  TEST_ASSERT_EQUAL(0, response.find(R"({"id":"8a4e3c1e-6f50-4a8e-9d43-1b2f6f2a7c02","type":"set_circuit")"));
+  TEST_ASSERT_EQUAL(response.size() - 9, response.find(R"("code":0})"));
+
+  allocations = allocated_bytes = 0;
+  std::chrono::duration<double, std::micro> elapsed{};
+  for (size_t round = 0; round < rounds; round++) {
+    socket.pos = 0;
+    socket.sent.clear();
+    auto start = std::chrono::steady_clock::now();
+    count_allocations = true;
+    run(socket);
+    count_allocations = false;
+    elapsed += std::chrono::steady_clock::now() - start;
+  }
+  std::cout << name << ": " << elapsed.count() / rounds << " us, " << allocated_bytes / rounds << " heap bytes in "
+            << allocations / rounds << " allocations per round trip of a " << socket.received.size()
+            << " bytes set_circuit frame" << std::endl;
+  if (allocation_free)
+    TEST_ASSERT_EQUAL(0, allocations);
+}
+
+void test_benchmark_set_circuit_round_trip() {
+  auto message = make_set_circuit();
+  TEST_ASSERT_GREATER_THAN(3584, message.size());
+  TEST_ASSERT_LESS_OR_EQUAL(reader->size(), message.size());
+
+  benchmark("std::string staging", round_trip_with_strings, false);
+  benchmark("streaming reader and frame writer", round_trip, true);
+  TEST_ASSERT(ublock.is_connected(3, 3));
+  TEST_ASSERT(iblock.is_connected(4, 2));
+}
+
+void setUp() {
+  test_protocol();
+  reader = new web::WebsocketMessageReader<4096>();
+}
+
+void tearDown() { delete reader; }
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_messages_in_small_chunks);
+  RUN_TEST(test_fragments_with_control_frame_in_between);
+  RUN_TEST(test_close_frames);
+  RUN_TEST(test_maximum_message_size);
+  RUN_TEST(test_protocol_errors);
+  RUN_TEST(test_frame_writer);
+  RUN_TEST(test_process_websocket_input);
+  RUN_TEST(test_benchmark_set_circuit_round_trip);
+  UNITY_END();
+}
@@ -0,0 +1,239 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "daq/binary_frame.h"
+#include "web/send_queue.h"
+
+using namespace websockets::internals;
+using web::WebsocketSendQueue;
+
+// A loopback TCP connection, whose send buffer takes up to window bytes until the peer reads them.
+// The peer parses the frames it receives.
+struct LoopbackSocket {
+  size_t window;
+  std::vector<uint8_t> in_flight, received;
+  size_t writes = 0;
+
+  struct Frame {
+    uint8_t opcode;
+    std::vector<uint8_t> payload;
+  };
+  std::vector<Frame> frames;
+
+  explicit LoopbackSocket(size_t window) : window(window) {}
+
+  int availableForWrite() { return window - in_flight.size(); }
+  size_t write(const uint8_t *data, size_t length) {
+    writes++;
+    length = std::min(length, window - in_flight.size());
+    in_flight.insert(in_flight.end(), data, data + length);
+    return length;
+  }
+
+  // The peer reads up to max_bytes and parses all complete frames
+  void read(size_t max_bytes = SIZE_MAX) {
+    auto length = std::min(max_bytes, in_flight.size());
+    received.insert(received.end(), in_flight.begin(), in_flight.begin() + length);
+    in_flight.erase(in_flight.begin(), in_flight.begin() + length);
+
+    size_t pos = 0;
+    while (received.size() - pos >= 2) {
+      TEST_ASSERT_EQUAL_HEX8(0x80, received[pos] & 0xF0); // fin, no extensions
+      TEST_ASSERT_EQUAL_HEX8(0x00, received[pos + 1] & 0x80); // not masked
+      uint64_t payload_length = received[pos + 1] & 0x7F;
+      size_t header_size = 2;
+      if (payload_length == 126) {
+        if (received.size() - pos < 4)
+          break;
+        payload_length = (received[pos + 2] << 8) | received[pos + 3];
+        header_size = 4;
+      } else if (payload_length == 127) {
+        if (received.size() - pos < 10)
+          break;
+        payload_length = 0;
+        for (size_t i = 0; i < 8; i++)
+          payload_length = (payload_length << 8) | received[pos + 2 + i];
+        header_size = 10;
+      }
+      if (received.size() - pos < header_size + payload_length)
+        break;
+      auto payload = received.begin() + pos + header_size;
+      frames.push_back({static_cast<uint8_t>(received[pos] & 0x0F), {payload, payload + payload_length}});
+      pos += header_size + payload_length;
+    }
+    received.erase(received.begin(), received.begin() + pos);
+  }
+};
+
+// A binary run_data frame of one DMA block with eight channels
+constexpr size_t num_channels = 8, num_samples = 16;
+uint8_t run_data[daq::binary::frame_size(num_samples, num_channels)];
+
+void set_sequence(uint32_t sequence) { daq::binary::update_header(run_data, num_samples, sequence); }
+
+uint32_t get_sequence(const std::vector<uint8_t> &payload) {
+  return payload[8] | (payload[9] << 8) | (payload[10] << 16) | (payload[11] << 24);
+}
+
+WebsocketSendQueue *queue;
+
+void setUp() {
+  daq::binary::write_header(run_data, "12345678-1234-1234-1234-123456789abc", num_channels);
+  for (size_t idx = daq::binary::HEADER_SIZE; idx < sizeof(run_data); idx++)
+    run_data[idx] = idx;
+  queue = new WebsocketSendQueue();
+}
+
+void tearDown() { delete queue; }
+
+void test_frame_headers() {
+  uint8_t header[MAX_HEADER_SIZE];
+  TEST_ASSERT_EQUAL(2, WriteHeader(header, 125, ContentType::Text, true));
+  TEST_ASSERT_EQUAL_HEX8(0x81, header[0]);
+  TEST_ASSERT_EQUAL_HEX8(125, header[1]);
+
+  TEST_ASSERT_EQUAL(4, WriteHeader(header, 300, ContentType::Binary, true));
+  TEST_ASSERT_EQUAL_HEX8(0x82, header[0]);
+  TEST_ASSERT_EQUAL_HEX8(126, header[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, header[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x2C, header[3]);
+
+  TEST_ASSERT_EQUAL(10, WriteHeader(header, 65536, ContentType::Binary, false));
+  TEST_ASSERT_EQUAL_HEX8(0x02, header[0]);
+  TEST_ASSERT_EQUAL_HEX8(127, header[1]);
+  const uint8_t length_64[] = {0, 0, 0, 0, 0, 1, 0, 0};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(length_64, header + 2, 8);
+
+  TEST_ASSERT_EQUAL(6, WriteHeader(header, 0, ContentType::Ping, true, "abcd"));
+  TEST_ASSERT_EQUAL_HEX8(0x80, header[1]);
+  TEST_ASSERT_EQUAL_MEMORY("abcd", header + 2, 4);
+}
+
+void test_frames_go_directly_to_the_socket() {
+  LoopbackSocket socket(64 * 1024);
+  for (uint32_t sequence = 0; sequence < 100; sequence++) {
+    set_sequence(sequence);
+    TEST_ASSERT(queue->send_frame(socket, ContentType::Binary, run_data, sizeof(run_data)));
+    socket.read();
+  }
+  TEST_ASSERT_EQUAL(0, queue->get_statistics().bytes_copied);
+  // The header and the payload, each written from where it is
+  TEST_ASSERT_EQUAL(200, socket.writes);
+  TEST_ASSERT_EQUAL(100, socket.frames.size());
+  set_sequence(99);
+  TEST_ASSERT_EQUAL(ContentType::Binary, socket.frames.back().opcode);
+  TEST_ASSERT_EQUAL_MEMORY(run_data, socket.frames.back().payload.data(), sizeof(run_data));
+}
+
+void test_slow_client_misses_whole_frames() {
+  // The peer stops reading for a while, so the socket and then the queue run full
+  LoopbackSocket socket(1000);
+  const uint32_t num_frames = 200;
+  for (uint32_t sequence = 0; sequence < num_frames; sequence++) {
+    set_sequence(sequence);
+    queue->send_frame(socket, ContentType::Binary, run_data, sizeof(run_data));
+    TEST_ASSERT_LESS_OR_EQUAL(WebsocketSendQueue::CAPACITY, queue->size());
+    if (sequence >= num_frames / 2)
+      socket.read(sizeof(run_data) / 2);
+  }
+  while (!queue->empty() or !socket.in_flight.empty()) {
+    queue->drain(socket);
+    socket.read();
+  }
+
+  auto &statistics = queue->get_statistics();
+  TEST_ASSERT_FALSE(queue->is_broken());
+  TEST_ASSERT_GREATER_THAN(0, statistics.dropped_frames);
+  TEST_ASSERT_EQUAL(num_frames, statistics.frames + statistics.dropped_frames);
+  TEST_ASSERT_EQUAL(statistics.frames, socket.frames.size());
+  TEST_ASSERT(socket.received.empty());
+  // Frames are complete and in order, with gaps where they were dropped
+  for (size_t idx = 1; idx < socket.frames.size(); idx++)
+    TEST_ASSERT_GREATER_THAN(get_sequence(socket.frames[idx - 1].payload),
+                             get_sequence(socket.frames[idx].payload));
+}
+
+void test_writes_keep_their_order() {
+  LoopbackSocket socket(100);
+  set_sequence(0);
+  TEST_ASSERT(queue->send_frame(socket, ContentType::Binary, run_data, sizeof(run_data)));
+  TEST_ASSERT_FALSE(queue->empty());
+
+  // Bytes of the websockets library, like a response, go after what is queued
+  uint8_t header[MAX_HEADER_SIZE];
+  const char response[] = "{\"type\":\"ping\"}\n";
+  auto header_size = WriteHeader(header, sizeof(response) - 1, ContentType::Text, true);
+  TEST_ASSERT(queue->write(socket, header, header_size));
+  TEST_ASSERT(queue->write(socket, reinterpret_cast<const uint8_t *>(response), sizeof(response) - 1));
+  // More than fits is refused, instead of being dropped in parts
+  static uint8_t too_large[WebsocketSendQueue::CAPACITY];
+  TEST_ASSERT_FALSE(queue->write(socket, too_large, sizeof(too_large)));
+
+  while (!queue->empty() or !socket.in_flight.empty()) {
+    queue->drain(socket);
+    socket.read(30);
+  }
+  TEST_ASSERT_EQUAL(2, socket.frames.size());
+  TEST_ASSERT_EQUAL(ContentType::Binary, socket.frames[0].opcode);
+  TEST_ASSERT_EQUAL(ContentType::Text, socket.frames[1].opcode);
+  TEST_ASSERT_EQUAL_MEMORY(response, socket.frames[1].payload.data(), sizeof(response) - 1);
+}
+
+void test_broken_queue_refuses_everything() {
+  LoopbackSocket socket(1000);
+  set_sequence(0);
+  TEST_ASSERT(queue->send_frame(socket, ContentType::Binary, run_data, sizeof(run_data)));
+  // A client which did not take its data in time is given up on
+  queue->mark_broken();
+  TEST_ASSERT(queue->is_broken());
+  TEST_ASSERT_FALSE(queue->send_frame(socket, ContentType::Binary, run_data, sizeof(run_data)));
+  TEST_ASSERT_FALSE(queue->write(socket, run_data, sizeof(run_data)));
+  TEST_ASSERT_EQUAL(1, queue->get_statistics().frames);
+  TEST_ASSERT_EQUAL(1, queue->get_statistics().dropped_frames);
+}
+
+void benchmark(const char *name, size_t window, size_t read_per_frame, uint32_t num_frames) {
+  LoopbackSocket socket(window);
+  WebsocketSendQueue benchmark_queue;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t sequence = 0; sequence < num_frames; sequence++) {
+    set_sequence(sequence);
+    benchmark_queue.send_frame(socket, ContentType::Binary, run_data, sizeof(run_data));
+    // The peer only takes the bytes and does not parse them
+    auto length = std::min(read_per_frame, socket.in_flight.size());
+    socket.in_flight.erase(socket.in_flight.begin(), socket.in_flight.begin() + length);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  auto &statistics = benchmark_queue.get_statistics();
+  std::cout << name << ": " << static_cast<uint32_t>(num_frames / elapsed.count()) << " frames/s, "
+            << statistics.dropped_frames << " of " << num_frames << " frames dropped, "
+            << static_cast<float>(statistics.bytes_copied) / num_frames << " bytes copied per frame of "
+            << sizeof(run_data) << " bytes" << std::endl;
+  TEST_ASSERT_EQUAL(num_frames, statistics.frames + statistics.dropped_frames);
+}
+
+void test_benchmark() {
+  benchmark("fast client", 64 * 1024, SIZE_MAX, 100'000);
+  benchmark("client at half the rate", 4 * 1024, sizeof(run_data) / 2, 100'000);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_headers);
+  RUN_TEST(test_frames_go_directly_to_the_socket);
+  RUN_TEST(test_slow_client_misses_whole_frames);
+  RUN_TEST(test_writes_keep_their_order);
+  RUN_TEST(test_broken_queue_refuses_everything);
+  RUN_TEST(test_benchmark);
+  UNITY_END();
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "test_common.h"
+#include "utils/line_buffer.h"
+
+// A socket with some received data, of which it returns at most chunk_size bytes per read
+struct FakeSocket {
+  std::string data;
+  size_t pos = 0, chunk_size = 1460;
+
+  int available() { return data.size() - pos; }
+  int read(uint8_t *buf, size_t size) {
+    size = std::min({size, data.size() - pos, chunk_size});
+    data.copy(reinterpret_cast<char *>(buf), size, pos);
+    pos += size;
+    return size;
+  }
+};
+
+// Requests go through the real JsonLinesProtocol::process_tcp_input, the message registry and
+// the set_circuit handler, i.e. Carrier::user_set_extended_config, on the dummy HALs of test_common.h.
+Loopback *connection;
+msg::JsonLinesProtocol::LineBuffer line_buffer;
+
+void process_tcp_input() {
+  count_allocations = true;
+  bool failed = test_protocol().process_tcp_input(connection->socket, line_buffer, connection->user_context);
+  count_allocations = false;
+  TEST_ASSERT_FALSE(failed);
+}
+
+// Parses the responses, one per line
+std::vector<DynamicJsonDocument> responses() {
+  std::vector<DynamicJsonDocument> documents;
+  auto data = connection->receive();
+  for (size_t pos = 0, end; (end = data.find('\n', pos)) != std::string::npos; pos = end + 1) {
+    documents.emplace_back(4096);
+    TEST_ASSERT(DeserializationError::Ok == deserializeJson(documents.back(), data.substr(pos, end - pos)));
+  }
+  return documents;
+}
+
+void setUp() {
+  test_protocol();
+  connection = new Loopback();
+  line_buffer.clear();
+  allocations = 0;
+}
+
+void tearDown() { delete connection; }
+
+const char ping[] = R"({"id":"8a4e3c1e-6f50-4a8e-9d43-1b2f6f2a7c01","type":"ping","msg":{}})"
+                    "\n";
+
+const char set_circuit[] =
+    R"({"id":"8a4e3c1e-6f50-4a8e-9d43-1b2f6f2a7c02","type":"set_circuit","msg":{)"
+    R"("entity":["04-E9-E5-00-00-01","0"],"config":{)"
+    R"("/U":{"outputs":[0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15]},)"
+    R"("/C":{"elements":[0.5,-0.5,0.25,-0.25,1.0,-1.0,0.1,-0.1,0.5,-0.5,0.25,-0.25,1.0,-1.0,0.1,-0.1,)"
+    R"(0.5,-0.5,0.25,-0.25,1.0,-1.0,0.1,-0.1,0.5,-0.5,0.25,-0.25,1.0,-1.0,0.1,-0.1]},)"
+    R"("/I":{"outputs":{"0":[0,1],"1":2,"5":[3,4,5]},"upscaling":{"4":true}})"
+    R"(}}})"
+    "\n";
+
+void test_ping_does_not_allocate() {
+  connection->send(ping);
+  process_tcp_input();
+
+  TEST_ASSERT_EQUAL(0, allocations);
+  auto response = responses();
+  TEST_ASSERT_EQUAL(1, response.size());
+  TEST_ASSERT_EQUAL_STRING("8a4e3c1e-6f50-4a8e-9d43-1b2f6f2a7c01", response[0]["id"]);
+  TEST_ASSERT_EQUAL(0, response[0]["code"]);
+  TEST_ASSERT(response[0]["msg"]["micros"].is<unsigned long>());
+}
+
+void test_set_circuit_does_not_allocate() {
+  connection->send(set_circuit);
+  process_tcp_input();
+
+  TEST_ASSERT_EQUAL(0, allocations);
+  auto response = responses();
+  TEST_ASSERT_EQUAL(1, response.size());
+  TEST_ASSERT_EQUAL_STRING("set_circuit", response[0]["type"]);
+  TEST_ASSERT_EQUAL(0, response[0]["code"]);
+  TEST_ASSERT(ublock.is_connected(3, 3));
+  TEST_ASSERT_EQUAL_FLOAT(-0.25f, cblock.get_factor(3));
+  TEST_ASSERT(iblock.is_connected(4, 5));
+}
+
+void test_pipelined_messages_in_small_chunks() {
+  // Several messages in one stream, received in arbitrary pieces
+  std::string data = std::string(ping) + set_circuit + ping;
+  for (size_t pos = 0; pos < data.size(); pos += 7) {
+    connection->send(data.substr(pos, 7));
+    process_tcp_input();
+  }
+
+  TEST_ASSERT_EQUAL(0, allocations);
+  auto response = responses();
+  TEST_ASSERT_EQUAL(3, response.size());
+  TEST_ASSERT_EQUAL_STRING("set_circuit", response[1]["type"]);
+  TEST_ASSERT_EQUAL(0, response[1]["code"]);
+}
+
+void test_line_buffer() {
+  utils::LineBuffer<16> buffer;
+  FakeSocket socket{"abc\n\ndef"};
+  TEST_ASSERT_EQUAL_STRING("abc", buffer.read_line(socket));
+  TEST_ASSERT(buffer.has_line());
+  TEST_ASSERT_EQUAL_STRING("", buffer.read_line(socket));
+  TEST_ASSERT_NULL(buffer.read_line(socket));
+  socket.data += "ghi\n";
+  TEST_ASSERT_EQUAL_STRING("defghi", buffer.read_line(socket));
+  TEST_ASSERT_NULL(buffer.read_line(socket));
+  TEST_ASSERT_FALSE(buffer.overflowed());
+
+  // Overlong lines are dropped completely, the following ones are kept
+  socket.data += std::string(40, 'x') + "\nshort\n";
+  TEST_ASSERT_EQUAL_STRING("short", buffer.read_line(socket));
+  TEST_ASSERT(buffer.overflowed());
+  TEST_ASSERT_FALSE(buffer.overflowed());
+
+  // A line filling the whole buffer still fits
+  socket.data += std::string(15, 'y') + "\n";
+  TEST_ASSERT_EQUAL_STRING(std::string(15, 'y').c_str(), buffer.read_line(socket));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ping_does_not_allocate);
+  RUN_TEST(test_set_circuit_does_not_allocate);
+  RUN_TEST(test_pipelined_messages_in_small_chunks);
+  RUN_TEST(test_line_buffer);
+  UNITY_END();
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <chrono>
+#include <iostream>
+
+#include "daq/daq.h"
+#include "run/run_manager.h"
+#include "test_common.h"
+
+// A start_run message whose circuit sets all elements of the C-Block of test_carrier()
+const char start_run[] =
+    R"({"id":"12345678-1234-1234-1234-123456789012","config":{"op_time":1000},"circuit":{)"
+    R"("entity":["04-E9-E5-00-00-01","0"],"config":{)"
+    R"("/C":{"elements":[0.5,-0.5,0.25,-0.25,1.0,-1.0,0.1,-0.1,0.5,-0.5,0.25,-0.25,1.0,-1.0,0.1,-0.1,)"
+    R"(0.5,-0.5,0.25,-0.25,1.0,-1.0,0.1,-0.1,0.5,-0.5,0.25,-0.25,1.0,-1.0,0.1,-0.1]})"
+    R"(}}})";
+
+/// Queues a run without circuit, which is the one going on, and a run with the circuit above
+void queue_runs() {
+  auto &manager = run::RunManager::get();
+  StaticJsonDocument<2048> msg_in;
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(msg_in, R"({"id":"1","config":{}})"));
+  auto msg = msg_in.as<JsonObjectConst>();
+  manager.queue.push_back(run::Run::from_json(msg));
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(msg_in, start_run));
+  msg = msg_in.as<JsonObjectConst>();
+  manager.queue.push_back(run::Run::from_json(msg));
+}
+
+void setUp() {
+  run::RunManager::get().clear_queue();
+  cblock.set_factors({});
+}
+
+void tearDown() { run::RunManager::get().clear_queue(); }
+
+void test_staged_circuit_is_undone_when_not_run() {
+  auto &manager = run::RunManager::get();
+  queue_runs();
+  TEST_ASSERT(manager.stage_next_circuit(test_carrier()));
+  TEST_ASSERT(manager.queue[1].circuit_staged);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.5f, cblock.get_factor(0));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, -0.1f, cblock.get_factor(31));
+  // Only one circuit is staged at a time
+  TEST_ASSERT_FALSE(manager.stage_next_circuit(test_carrier()));
+
+  manager.clear_queue();
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.0f, cblock.get_factor(0));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.0f, cblock.get_factor(31));
+}
+
+void test_headroom_of_dma_buffer() {
+  using daq::dma::get_headroom_us;
+  // All but one block of the ring buffer, with one data vector per sample
+  const uint32_t data_vectors = (daq::dma::NUM_BLOCKS - 1) * daq::dma::BLOCK_SIZE;
+  TEST_ASSERT_EQUAL(data_vectors, get_headroom_us(daq::DAQConfig(1, 1'000'000)));
+  TEST_ASSERT_EQUAL(data_vectors / 8, get_headroom_us(daq::DAQConfig(8, 1'000'000)));
+  TEST_ASSERT_EQUAL(data_vectors * 1000, get_headroom_us(daq::DAQConfig(1, 1'000)));
+  // Runs without data acquisition are not limited
+  TEST_ASSERT_EQUAL(UINT32_MAX, get_headroom_us(daq::DAQConfig(0, 1'000'000)));
+
+  // With the default buffer, staging is skipped at the highest sample rates
+  TEST_ASSERT(2 * run::RunManager::STAGING_TIME_ESTIMATE_US > get_headroom_us(daq::DAQConfig(8, 1'000'000)));
+  TEST_ASSERT(2 * run::RunManager::STAGING_TIME_ESTIMATE_US < get_headroom_us(daq::DAQConfig(1, 100'000)));
+}
+
+/**
+ * Benchmark of staging, i.e. taking the snapshot of the configuration with config_to_json and
+ * applying the next circuit with stage_config. On the device, this must fit into the time the
+ * DMA buffer takes to fill up, see RunManager::stage_next_circuit.
+ */
+void test_benchmark_staging() {
+  constexpr size_t iterations = 1000;
+  auto &manager = run::RunManager::get();
+  std::chrono::duration<double, std::micro> staging_time{0};
+  for (size_t i = 0; i < iterations; i++) {
+    queue_runs();
+    auto start = std::chrono::steady_clock::now();
+    TEST_ASSERT(manager.stage_next_circuit(test_carrier()));
+    staging_time += std::chrono::steady_clock::now() - start;
+    manager.clear_queue();
+  }
+
+  std::cout << "staging: " << staging_time.count() / iterations << "us on average, "
+            << manager.get_staging_time_us() << "us at most" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_staged_circuit_is_undone_when_not_run);
+  RUN_TEST(test_headroom_of_dma_buffer);
+  RUN_TEST(test_benchmark_staging);
+  UNITY_END();
+}
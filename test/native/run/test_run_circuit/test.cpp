@@ -0,0 +1,80 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <cstring>
+#include <deque>
+
+#include "block/cblock.h"
+#include "carrier/cluster.h"
+#include "run/run.h"
+
+using namespace blocks;
+
+class DummyCBlockHAL : public CBlockHAL {
+public:
+  bool write_factor(uint8_t idx, uint16_t raw) override { return true; }
+};
+
+DummyCBlockHAL *chal;
+CBlock *cblock;
+platform::Cluster *cluster;
+
+void setUp() {
+  chal = new DummyCBlockHAL();
+  cblock = new CBlock(bus::NULL_ADDRESS, chal);
+  cluster = new platform::Cluster(0);
+  cluster->cblock = cblock;
+}
+
+void tearDown() {
+  delete cluster;
+  delete cblock;
+  delete chal;
+}
+
+// A start_run message as it arrives on a connection, which parses it in place
+const char start_run[] = R"({"id":"12345678-1234-1234-1234-123456789012","config":{"op_time":1000},)"
+                         R"("circuit":{"entity":["0"],"config":{"/C":{"elements":{"3":0.5,"7":-0.25}}}}})";
+
+void test_circuit_outlives_message() {
+  char line[sizeof(start_run)];
+  std::memcpy(line, start_run, sizeof(start_run));
+  std::deque<run::Run> queue;
+  {
+    StaticJsonDocument<1024> msg_in;
+    TEST_ASSERT(DeserializationError::Ok == deserializeJson(msg_in, line));
+    auto msg = msg_in.as<JsonObjectConst>();
+    queue.push_back(run::Run::from_json(msg));
+  }
+
+  // The next message overwrites the line buffer
+  std::memset(line, 'x', sizeof(line) - 1);
+
+  auto &run = queue.front();
+  TEST_ASSERT(run.circuit);
+  TEST_ASSERT_EQUAL_STRING("12345678-1234-1234-1234-123456789012", run.id.c_str());
+  TEST_ASSERT(cluster->stage_config(run.circuit->as<JsonObjectConst>()));
+  TEST_ASSERT(cblock->write_to_hardware());
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.5f, cblock->get_factor(3));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, -0.25f, cblock->get_factor(7));
+}
+
+void test_run_without_circuit() {
+  StaticJsonDocument<256> msg_in;
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(msg_in, R"({"id":"1","config":{}})"));
+  auto msg = msg_in.as<JsonObjectConst>();
+  auto run = run::Run::from_json(msg);
+  TEST_ASSERT_FALSE(run.circuit);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_circuit_outlives_message);
+  RUN_TEST(test_run_without_circuit);
+  UNITY_END();
+}
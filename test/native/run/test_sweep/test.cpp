@@ -0,0 +1,214 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <array>
+
+#include "block/cblock.h"
+#include "block/mblock.h"
+#include "carrier/cluster.h"
+#include "daq/reduction.h"
+#include "run/sweep.h"
+
+using namespace blocks;
+
+/// Dummy HAL which records each write, to check that a sweep only writes what changed
+class CountingCBlockHAL : public CBlockHAL {
+public:
+  std::array<unsigned int, CBlock::NUM_COEFF> writes{};
+  std::array<uint16_t, CBlock::NUM_COEFF> values{};
+
+  bool write_factor(uint8_t idx, uint16_t raw) override {
+    writes[idx]++;
+    values[idx] = raw;
+    return true;
+  }
+};
+
+class CountingMIntBlockHAL : public MIntBlockHAL {
+public:
+  std::array<unsigned int, MIntBlock::NUM_INTEGRATORS> writes{};
+  std::array<uint16_t, MIntBlock::NUM_INTEGRATORS> values{};
+
+  bool write_ic(uint8_t idx, uint16_t raw) override {
+    writes[idx]++;
+    values[idx] = raw;
+    return true;
+  }
+  bool write_time_factor_switches(std::bitset<8> switches) override { return true; }
+  std::bitset<8> read_overload_flags() override { return {0}; }
+  void reset_overload_flags() override {}
+};
+
+CountingCBlockHAL *chal;
+CountingMIntBlockHAL *mhal;
+CBlock *cblock;
+MIntBlock *mintblock;
+platform::Cluster *cluster;
+
+void setUp() {
+  chal = new CountingCBlockHAL();
+  mhal = new CountingMIntBlockHAL();
+  cblock = new CBlock(bus::NULL_ADDRESS, chal);
+  mintblock = new MIntBlock(MBlock::SLOT::M0, mhal);
+  cluster = new platform::Cluster(0);
+  cluster->cblock = cblock;
+  cluster->m0block = mintblock;
+}
+
+void tearDown() {
+  delete cluster;
+  delete mintblock;
+  delete cblock;
+  delete mhal;
+  delete chal;
+}
+
+utils::status parse(run::Sweep &sweep, const char *json) {
+  StaticJsonDocument<2048> doc;
+  TEST_ASSERT(DeserializationError::Ok == deserializeJson(doc, json));
+  return sweep.from_json(doc.as<JsonObjectConst>(), *cluster);
+}
+
+unsigned int total_writes() {
+  unsigned int total = 0;
+  for (auto w : chal->writes)
+    total += w;
+  for (auto w : mhal->writes)
+    total += w;
+  return total;
+}
+
+void test_values_and_range() {
+  run::Sweep sweep;
+  TEST_ASSERT(parse(sweep, R"({"mutations": [
+      {"entity": ["0", "C"], "element": 3, "values": [0.5, 0.25, -0.5]},
+      {"entity": ["0", "M0"], "element": 1, "range": {"from": -1, "to": 1, "steps": 3}}]})"));
+  TEST_ASSERT_EQUAL(3, sweep.get_num_points());
+  TEST_ASSERT(sweep.get_reduction() == daq::ReductionMode::FINAL);
+
+  const float coefficients[] = {0.5f, 0.25f, -0.5f};
+  const float ics[] = {-1.0f, 0.0f, 1.0f};
+  for (size_t point = 0; point < 3; point++) {
+    TEST_ASSERT(sweep.apply_next_point(*cluster));
+    TEST_ASSERT_EQUAL(point, sweep.get_point());
+    TEST_ASSERT_EQUAL_FLOAT(coefficients[point], cblock->get_factor(3));
+    TEST_ASSERT_EQUAL(CBlock::factor_to_raw(coefficients[point], 1.0f), chal->values[3]);
+    TEST_ASSERT_EQUAL_FLOAT(ics[point], mintblock->get_ic_value(1));
+    TEST_ASSERT_EQUAL(MIntBlockHAL::ic_to_raw(ics[point]), mhal->values[1]);
+  }
+  TEST_ASSERT(sweep.is_done());
+  TEST_ASSERT_FALSE(sweep.apply_next_point(*cluster));
+}
+
+void test_only_changed_elements_are_written() {
+  run::Sweep sweep;
+  // The IC stays the same for two points, and the first value equals the current one
+  TEST_ASSERT(parse(sweep, R"({"mutations": [
+      {"entity": ["0", "C"], "element": 7, "values": [0.1, 0.2, 0.3, 0.4]},
+      {"entity": ["0", "M0"], "element": 2, "values": [0, 0, 0.5, 0.5]}]})"));
+  while (!sweep.is_done())
+    TEST_ASSERT(sweep.apply_next_point(*cluster));
+  TEST_ASSERT_EQUAL(4, chal->writes[7]);
+  TEST_ASSERT_EQUAL(1, mhal->writes[2]);
+  TEST_ASSERT_EQUAL(5, total_writes());
+}
+
+void test_entities_are_resolved_for_each_point() {
+  run::Sweep sweep;
+  TEST_ASSERT(parse(sweep, R"({"mutations": [{"entity": ["0", "C"], "element": 3, "values": [0.5, 0.25, -0.5]}]})"));
+  TEST_ASSERT(sweep.apply_next_point(*cluster));
+
+  // The C-Block is replaced while the sweep is queued
+  CountingCBlockHAL other_chal;
+  CBlock other_cblock(bus::NULL_ADDRESS, &other_chal);
+  cluster->cblock = &other_cblock;
+  TEST_ASSERT(sweep.apply_next_point(*cluster));
+  TEST_ASSERT_EQUAL_FLOAT(0.25f, other_cblock.get_factor(3));
+  TEST_ASSERT_EQUAL(1, other_chal.writes[3]);
+  TEST_ASSERT_EQUAL(1, chal->writes[3]);
+
+  // And is gone for the last point, which fails
+  cluster->cblock = nullptr;
+  TEST_ASSERT_FALSE(sweep.apply_next_point(*cluster));
+  TEST_ASSERT_EQUAL(2, sweep.get_point());
+  cluster->cblock = cblock;
+}
+
+void test_invalid_sweeps() {
+  run::Sweep sweep;
+  // Wrong root
+  TEST_ASSERT_FALSE(parse(sweep, R"({"mutations": [{"entity": ["1", "C"], "element": 0, "values": [0]}]})"));
+  // Unknown block
+  TEST_ASSERT_FALSE(parse(sweep, R"({"mutations": [{"entity": ["0", "M1"], "element": 0, "values": [0]}]})"));
+  // Only C and M-Int blocks can be swept
+  cluster->ublock = new UBlock();
+  TEST_ASSERT_FALSE(parse(sweep, R"({"mutations": [{"entity": ["0", "U"], "element": 0, "values": [0]}]})"));
+  delete cluster->ublock;
+  // Element out of range
+  TEST_ASSERT_FALSE(parse(sweep, R"({"mutations": [{"entity": ["0", "C"], "element": 32, "values": [0]}]})"));
+  TEST_ASSERT_FALSE(parse(sweep, R"({"mutations": [{"entity": ["0", "M0"], "element": 8, "values": [0]}]})"));
+  // Value out of range
+  TEST_ASSERT_FALSE(parse(sweep, R"({"mutations": [{"entity": ["0", "M0"], "element": 0, "values": [0, 1.5]}]})"));
+  TEST_ASSERT_FALSE(
+      parse(sweep, R"({"mutations": [{"entity": ["0", "C"], "element": 0, "range": {"from": 0, "to": 2, "steps": 5}}]})"));
+  // Different number of points
+  TEST_ASSERT_FALSE(parse(sweep, R"({"mutations": [
+      {"entity": ["0", "C"], "element": 0, "values": [0, 0.1]},
+      {"entity": ["0", "C"], "element": 1, "values": [0]}]})"));
+  // No mutations, unknown reduction
+  TEST_ASSERT_FALSE(parse(sweep, R"({"mutations": []})"));
+  TEST_ASSERT_FALSE(
+      parse(sweep, R"({"mutations": [{"entity": ["0", "C"], "element": 0, "values": [0]}], "reduction": "median"})"));
+  // Nothing was written on the way
+  TEST_ASSERT_EQUAL(0, total_writes());
+}
+
+void test_reduction_parsing() {
+  run::Sweep sweep;
+  TEST_ASSERT(
+      parse(sweep, R"({"mutations": [{"entity": ["0", "C"], "element": 0, "values": [0]}], "reduction": "minmax"})"));
+  TEST_ASSERT(sweep.get_reduction() == daq::ReductionMode::MINMAX);
+  TEST_ASSERT(
+      parse(sweep, R"({"mutations": [{"entity": ["0", "C"], "element": 0, "values": [0]}], "reduction": "trace"})"));
+  TEST_ASSERT(sweep.get_reduction() == daq::ReductionMode::NONE);
+}
+
+void test_reducer() {
+  constexpr size_t inner_count = 2;
+  // Garbage in the upper bits must be ignored
+  std::array<volatile uint32_t, 4 * inner_count> data = {0xAB000010, 500, 30, 0xCD000200, 20, 100, 15, 300};
+  std::array<uint32_t, 2 * inner_count> out{};
+
+  daq::Reducer empty(daq::ReductionMode::FINAL, inner_count);
+  TEST_ASSERT_EQUAL(0, empty.result(out.data()));
+
+  daq::Reducer last(daq::ReductionMode::FINAL, inner_count);
+  last.process(data.data(), 3);
+  last.process(data.data() + 3 * inner_count, 1);
+  TEST_ASSERT_EQUAL(1, last.result(out.data()));
+  TEST_ASSERT_EQUAL(15, out[0]);
+  TEST_ASSERT_EQUAL(300, out[1]);
+
+  daq::Reducer minmax(daq::ReductionMode::MINMAX, inner_count);
+  minmax.process(data.data(), 1);
+  minmax.process(data.data() + inner_count, 3);
+  TEST_ASSERT_EQUAL(2, minmax.result(out.data()));
+  const uint32_t expected[] = {15, 100, 30, 0x200};
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, out.data(), 4);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_values_and_range);
+  RUN_TEST(test_only_changed_elements_are_written);
+  RUN_TEST(test_entities_are_resolved_for_each_point);
+  RUN_TEST(test_invalid_sweeps);
+  RUN_TEST(test_reduction_parsing);
+  RUN_TEST(test_reducer);
+  UNITY_END();
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2024 anabrid GmbH
+// Contact: https://www.anabrid.com/licensing/
+//
+// SPDX-License-Identifier: MIT OR GPL-2.0-or-later
+
+#pragma once
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "block/cblock.h"
+#include "block/iblock.h"
+#include "block/ublock.h"
+#include "carrier/carrier.h"
+#include "net/auth.h"
+#include "net/ethernet.h"
+#include "protocol/protocol.h"
+#include "protocol/registry.h"
+
+// Counts heap allocations and their bytes while enabled. All C++ allocations go through operator new,
+// on glibc also plain malloc calls (as done by ArduinoJson's default allocator) are counted, and
+// operator new ends up in the counted malloc.
+
+bool count_allocations = false;
+size_t allocations = 0, allocated_bytes = 0;
+
+void count(size_t size) {
+  if (count_allocations) {
+    allocations++;
+    allocated_bytes += size;
+  }
+}
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  count(size);
+  return __libc_malloc(size);
+}
+void *calloc(size_t num, size_t size) {
+  count(num * size);
+  return __libc_calloc(num, size);
+}
+void *realloc(void *ptr, size_t size) {
+  count(size);
+  return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+void *operator new(size_t size) {
+#ifndef __GLIBC__
+  count(size);
+#endif
+  if (void *ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+class DummyCarrierHAL : public carrier::Carrier_HAL {
+public:
+  bool write_adc_bus_mux(std::array<int8_t, 8> channels) override { return true; }
+  void reset_adc_bus_mux() override {}
+};
+
+class TestCarrier : public carrier::Carrier {
+public:
+  using Carrier::Carrier;
+  void set_entity_id(const char *id) { entity_id = id; }
+};
+
+DummyCarrierHAL carrier_hal;
+blocks::UBlockHAL_Dummy uhal;
+blocks::CBlockHALDummy chal;
+blocks::IBlockHALDummy ihal;
+blocks::UBlock ublock(bus::NULL_ADDRESS, &uhal);
+blocks::CBlock cblock(bus::NULL_ADDRESS, &chal);
+blocks::IBlock iblock(bus::NULL_ADDRESS, &ihal);
+
+/// A carrier "04-E9-E5-00-00-01" with a single cluster of the U-, C- and I-Block above, on dummy HALs.
+TestCarrier &test_carrier() {
+  static TestCarrier *carrier = [] {
+    platform::Cluster cluster(0);
+    cluster.ublock = &ublock;
+    cluster.cblock = &cblock;
+    cluster.iblock = &iblock;
+    auto carrier = new TestCarrier({cluster}, &carrier_hal);
+    carrier->set_entity_id("04-E9-E5-00-00-01");
+    return carrier;
+  }();
+  return *carrier;
+}
+
+/// The JSONL protocol with the message handlers of native builds registered for test_carrier().
+msg::JsonLinesProtocol &test_protocol() {
+  static bool initialized = false;
+  if (!initialized) {
+    msg::handlers::Registry::get().init(test_carrier());
+    msg::JsonLinesProtocol::get().init();
+    initialized = true;
+  }
+  return msg::JsonLinesProtocol::get();
+}
+
+/// A connection whose other end is held by the test, which sends the requests and receives the responses.
+class Loopback {
+  int peer = -1;
+
+  static int open_pair(int &peer) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+      return -1;
+    peer = fds[1];
+    return fds[0];
+  }
+
+public:
+  net::EthernetClient socket;
+  net::auth::AuthentificationContext user_context;
+
+  Loopback() : socket(open_pair(peer)) {}
+  Loopback(const Loopback &) = delete;
+  Loopback &operator=(const Loopback &) = delete;
+  ~Loopback() { close(peer); }
+
+  void send(const std::string &data) {
+    TEST_ASSERT_EQUAL(data.size(), ::send(peer, data.data(), data.size(), 0));
+  }
+
+  /// All data the connection sent so far
+  std::string receive() {
+    std::string data;
+    char buffer[4096];
+    for (ssize_t count; (count = recv(peer, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0;)
+      data.append(buffer, count);
+    return data;
+  }
+};